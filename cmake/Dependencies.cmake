@@ -5,6 +5,13 @@ include(FetchContent)
 find_package(Threads REQUIRED)
 find_package(OpenSSL REQUIRED)
 
+# Optional: NUMA-local shard placement in thread-per-core mode
+find_library(NUMA_LIBRARY numa)
+find_path(NUMA_INCLUDE_DIR numa.h)
+
+# shm_open lives in librt before glibc 2.34
+find_library(RT_LIBRARY rt)
+
 # JSON library
 function(setup_json_library)
   FetchContent_Declare(json
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "interfaces.h"
+
+// Kinds of requests that are limited separately
+enum class AdmissionClass {
+    Ingest,  // Event saves, held until they are acknowledged
+    Query,   // Mean, series and aggregate queries
+    Export,  // Raw event exports, held until the whole stream is written
+    Stream,  // Rolling-mean event streams, held until the subscriber goes away
+};
+
+// Decides whether a request is served or shed before any of its body is parsed.
+// Each class of request has a bound on the number in flight, and every event name has a
+// token bucket that limits its sustained save rate.
+class AdmissionController : public IStatusProvider {
+public:
+    explicit AdmissionController(const ServerConfig& config);
+
+    // Slot of an admitted request, released when the ticket is destroyed.
+    // A rejected ticket is empty and tells when to retry.
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&& other) noexcept;
+        ~Ticket();
+
+        explicit operator bool() const { return inFlight_ != nullptr; }
+
+        // Whole seconds after which a rejected request is likely to be admitted
+        int retryAfterSeconds() const { return retryAfterSeconds_; }
+
+    private:
+        friend class AdmissionController;
+
+        std::atomic<int>* inFlight_ = nullptr;
+        int retryAfterSeconds_ = 0;
+    };
+
+    // Admits a request of the given class; ingest requests also draw a token of eventName
+    Ticket admit(AdmissionClass admissionClass, std::string_view eventName = {});
+
+    // Whether any limit is configured
+    bool enabled() const;
+
+    // Implements IStatusProvider
+    std::string statusName() const override { return "admission"; }
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    struct TokenBucket {
+        double tokens;
+        std::chrono::steady_clock::time_point refilledAt;
+    };
+
+    bool acquireSlot(std::atomic<int>& inFlight, int limit);
+    bool takeToken(std::string_view eventName, int& retryAfterSeconds);
+
+    const int maxInFlightIngest_;
+    const int maxInFlightQueries_;
+    const int maxInFlightExports_;
+    const int maxInFlightStreams_;
+    const double eventRate_;
+    const double eventBurst_;
+
+    std::atomic<int> inFlightIngest_{0};
+    std::atomic<int> inFlightQueries_{0};
+    std::atomic<int> inFlightExports_{0};
+    std::atomic<int> inFlightStreams_{0};
+    std::atomic<uint64_t> admitted_{0};
+    std::atomic<uint64_t> shedInFlight_{0};
+    std::atomic<uint64_t> shedRate_{0};
+
+    std::mutex bucketsMutex_;
+    std::unordered_map<std::string, TokenBucket> buckets_;
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include "interfaces.h"
+
+// Appends little-endian binary fields to a byte buffer
+class ByteWriter {
+public:
+    explicit ByteWriter(std::string& buffer) : buffer_(buffer) {}
+
+    void putU8(uint8_t value) { buffer_.push_back(static_cast<char>(value)); }
+    void putU16(uint16_t value) { putLittleEndian(value, 2); }
+    void putU32(uint32_t value) { putLittleEndian(value, 4); }
+    void putU64(uint64_t value) { putLittleEndian(value, 8); }
+
+    void putDouble(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        putU64(bits);
+    }
+
+    // Length-prefixed string of at most 64 KiB
+    void putString(std::string_view value) {
+        if (value.size() > UINT16_MAX) {
+            throw std::length_error("String too long for binary encoding");
+        }
+        putU16(static_cast<uint16_t>(value.size()));
+        buffer_.append(value);
+    }
+
+    // One event as name, timestamp and values
+    void putEvent(std::string_view eventName, const std::vector<double>& values, uint64_t timestamp) {
+        putString(eventName);
+        putU64(timestamp);
+        putU16(static_cast<uint16_t>(values.size()));
+        for (double value : values) {
+            putDouble(value);
+        }
+    }
+
+private:
+    void putLittleEndian(uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            buffer_.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    std::string& buffer_;
+};
+
+// Reads little-endian binary fields; throws std::out_of_range on truncated input
+class ByteReader {
+public:
+    explicit ByteReader(std::string_view data) : data_(data) {}
+
+    uint8_t getU8() { return static_cast<uint8_t>(getLittleEndian(1)); }
+    uint16_t getU16() { return static_cast<uint16_t>(getLittleEndian(2)); }
+    uint32_t getU32() { return static_cast<uint32_t>(getLittleEndian(4)); }
+    uint64_t getU64() { return getLittleEndian(8); }
+
+    double getDouble() {
+        uint64_t bits = getU64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string getString() {
+        std::size_t size = getU16();
+        require(size);
+        std::string value(data_.substr(position_, size));
+        position_ += size;
+        return value;
+    }
+
+    // Counterpart of ByteWriter::putEvent
+    EventData getEvent(std::string& eventName) {
+        eventName = getString();
+        EventData event;
+        event.timestamp = getU64();
+        event.values.resize(getU16());
+        for (double& value : event.values) {
+            value = getDouble();
+        }
+        return event;
+    }
+
+    std::size_t remaining() const { return data_.size() - position_; }
+
+private:
+    void require(std::size_t size) const {
+        if (remaining() < size) {
+            throw std::out_of_range("Truncated binary record");
+        }
+    }
+
+    uint64_t getLittleEndian(int bytes) {
+        require(static_cast<std::size_t>(bytes));
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data_[position_ + i])) << (8 * i);
+        }
+        position_ += static_cast<std::size_t>(bytes);
+        return value;
+    }
+
+    std::string_view data_;
+    std::size_t position_ = 0;
+};
+
+// CRC-32 (IEEE 802.3) of a byte range, used to detect torn or corrupt records on disk
+inline uint32_t crc32(std::string_view data) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t i = 0; i < entries.size(); ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char c : data) {
+        crc = table[(crc ^ c) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
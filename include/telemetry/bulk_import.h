@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Input formats understood by the bulk importer. CSV lines are `event,timestamp,v1,...,v10`,
+// optionally below a header line; NDJSON lines are objects with `event`, `date` (or `timestamp`)
+// and `values` like the body of POST /paths/{event}.
+enum class ImportFormat {
+    Csv,
+    Ndjson,
+};
+
+// Picks the format from the extension: .csv, or .ndjson / .jsonl; throws std::invalid_argument otherwise
+ImportFormat importFormatOf(const std::string& path);
+
+struct ImportStats {
+    std::size_t files = 0;
+    std::size_t series = 0;
+    std::size_t events = 0;
+    std::size_t rejected = 0; // Malformed lines and paths without exactly 10 values
+};
+
+// Parses the input files on `threads` threads and writes their events as a snapshot, every series
+// sorted by timestamp. Files are memory-mapped and split into line-aligned ranges that the threads
+// parse into private tables, so parsing shares nothing until the tables are merged.
+ImportStats importToSnapshot(const std::vector<std::string>& inputs, const std::string& snapshotPath,
+                             std::size_t threads);
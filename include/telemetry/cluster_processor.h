@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include "interfaces.h"
+#include "hash_ring.h"
+#include "http_client.h"
+
+// Processor of a cluster router: owns no data and forwards every event to the node
+// that owns its name on the consistent-hash ring. Saves and means are coroutines that wait for
+// the owning node without holding a thread; their synchronous forms wait for the coroutine.
+class ClusterProcessor : public ITelemetryProcessor {
+public:
+    // Nodes are given as "host:port"
+    explicit ClusterProcessor(const std::vector<std::string>& nodes, int virtualNodes = 64);
+    ~ClusterProcessor() override = default;
+
+    // Prevent copying or moving
+    ClusterProcessor(const ClusterProcessor&) = delete;
+    ClusterProcessor& operator=(const ClusterProcessor&) = delete;
+    ClusterProcessor(ClusterProcessor&&) = delete;
+    ClusterProcessor& operator=(ClusterProcessor&&) = delete;
+
+    // Implementation of ITelemetryProcessor
+    bool saveEvent(const std::string& eventName,
+                  const std::vector<double>& values,
+                  uint64_t timestamp) override;
+
+    Task<SaveStatus> saveEventTask(std::string eventName,
+                                   std::vector<double> values,
+                                   uint64_t timestamp) override;
+
+    double calculateMeanLength(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    Task<double> calculateMeanLengthTask(
+        std::string eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<PathAggregate> calculateAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<SeriesBucket> calculateSeries(
+        const std::string& eventName,
+        uint64_t bucketSeconds,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<PathAggregate> calculateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) override;
+
+    std::vector<SampledAggregate> calculateSampledAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override;
+
+    std::shared_ptr<IRollingMean> subscribeRollingMean(
+        const std::string& eventName,
+        uint64_t windowSeconds) override;
+
+    void registerStandingQuery(
+        const std::string& name,
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp) override;
+
+    std::optional<PathAggregate> readStandingQuery(const std::string& name) override;
+
+    bool removeStandingQuery(const std::string& name) override;
+
+    // Always nullopt: versions live on the data nodes, so routed results are never reused
+    std::optional<uint64_t> eventsVersion(const std::vector<std::string>& eventNames) override;
+
+    // Node index that owns the event
+    std::size_t ownerOf(const std::string& eventName) const { return ring_.ownerOf(eventName); }
+
+private:
+    ConsistentHashRing ring_;
+    std::vector<std::unique_ptr<HttpClient>> clients_; // Aligned with ring_.members()
+};
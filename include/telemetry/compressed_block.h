@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include "interfaces.h"
+
+// Immutable block of events compressed Gorilla-style: timestamps as delta-of-delta,
+// values XOR-ed against their predecessor with leading/trailing zero elision.
+// The block keeps its time range and totals so that scans can skip or sum it without decoding.
+class CompressedBlock {
+public:
+    // Compresses events in their given order. With a scale other than 1, values are stored as
+    // round(value * scale), which suits fixed-point data such as whole milliseconds.
+    static CompressedBlock encode(const std::vector<EventData>& events, double scale = 1.0);
+
+    // Streaming decoder; yields the events in their original order
+    class Decoder {
+    public:
+        explicit Decoder(const CompressedBlock& block) : block_(block), words_(block.words().data()) {}
+
+        // Decodes the next event into event, reusing its value storage; false at the end
+        bool next(EventData& event);
+
+    private:
+        uint64_t readBits(int count);
+        bool readBit() { return readBits(1) != 0; }
+
+        const CompressedBlock& block_;
+        const uint64_t* words_;
+        std::size_t bitPosition_ = 0;
+        std::size_t decoded_ = 0;
+        uint64_t timestamp_ = 0;
+        int64_t delta_ = 0;
+        uint64_t value_ = 0;
+        bool haveValue_ = false;
+        int leading_ = 0;
+        int meaningful_ = 0;
+    };
+
+    // Calls visitor for every event, decoding one event at a time
+    template <typename Visitor>
+    void forEach(Visitor&& visitor) const {
+        Decoder decoder(*this);
+        EventData event;
+        while (decoder.next(event)) {
+            visitor(event);
+        }
+    }
+
+    std::size_t size() const { return count_; }
+    uint64_t minTimestamp() const { return minTimestamp_; }
+    uint64_t maxTimestamp() const { return maxTimestamp_; }
+
+    // Totals of the whole block
+    PathAggregate aggregate() const { return PathAggregate{sum_, count_}; }
+
+    // Bytes held by the compressed stream
+    std::size_t compressedBytes() const { return wordCount_ * sizeof(uint64_t); }
+
+    // The bit stream, in memory or in a mapped cold segment
+    std::span<const uint64_t> words() const {
+        return {owner_ ? relocated_ : bits_.data(), wordCount_};
+    }
+
+    // Switches to an identical copy of the stream at words, kept alive by owner, and frees the
+    // in-memory stream. Used to move cold blocks into memory-mapped files.
+    void relocate(const uint64_t* words, std::shared_ptr<const void> owner);
+
+    // Whether the stream lives outside the heap
+    bool isRelocated() const { return owner_ != nullptr; }
+
+private:
+    std::vector<uint64_t> bits_; // Bit stream, most significant bit first within each word
+    std::size_t wordCount_ = 0;
+    const uint64_t* relocated_ = nullptr;
+    std::shared_ptr<const void> owner_;
+    std::size_t count_ = 0;
+    uint64_t minTimestamp_ = 0;
+    uint64_t maxTimestamp_ = 0;
+    double sum_ = 0.0;
+    double scale_ = 1.0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "interfaces.h"
+
+// Base for storage decorators; forwards every operation to the wrapped storage.
+// saveEventAsync and saveEvents are deliberately not forwarded, so they go through the decorator's saveEvent.
+class ForwardingStorage : public ITelemetryStorage {
+public:
+    explicit ForwardingStorage(ITelemetryStorage& inner) : inner_(inner) {}
+
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override {
+        return inner_.saveEvent(eventName, values, timestamp);
+    }
+
+    std::vector<EventData> getFilteredEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override {
+        return inner_.getFilteredEvents(eventName, startTimestamp, endTimestamp);
+    }
+
+    PathAggregate aggregateEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override {
+        return inner_.aggregateEvents(eventName, startTimestamp, endTimestamp);
+    }
+
+    std::vector<SeriesBucket> aggregateSeries(
+        const std::string& eventName,
+        uint64_t bucketWidth,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override {
+        return inner_.aggregateSeries(eventName, bucketWidth, startTimestamp, endTimestamp);
+    }
+
+    std::vector<PathAggregate> aggregateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) override {
+        return inner_.aggregateWindows(eventName, windows);
+    }
+
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override {
+        inner_.readEvents(eventName, startTimestamp, endTimestamp, cursor, maxEvents, out);
+    }
+
+    SampledAggregate sampleAggregate(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override {
+        return inner_.sampleAggregate(eventName, startTimestamp, endTimestamp);
+    }
+
+    std::optional<uint64_t> eventVersion(const std::string& eventName) override {
+        return inner_.eventVersion(eventName);
+    }
+
+    double storedLength(const std::string& eventName, const std::vector<double>& values) override {
+        return inner_.storedLength(eventName, values);
+    }
+
+protected:
+    ITelemetryStorage& inner_;
+};
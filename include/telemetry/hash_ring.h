@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+// Consistent-hash ring mapping event names to the cluster members that own them
+class ConsistentHashRing {
+public:
+    // Places virtualNodes points on the ring for every member
+    explicit ConsistentHashRing(std::vector<std::string> members, int virtualNodes = 64);
+
+    // Returns the index of the member that owns the key
+    std::size_t ownerOf(std::string_view key) const;
+
+    const std::vector<std::string>& members() const { return members_; }
+
+    // 64-bit FNV-1a with a final avalanche step, stable across processes and builds
+    static uint64_t hash(std::string_view key);
+
+private:
+    std::vector<std::string> members_;
+    std::vector<std::pair<uint64_t, std::size_t>> ring_; // Sorted by point
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include "task.h"
+
+// Response of a peer telemetry server
+struct HttpClientResponse {
+    int statusCode;
+    std::string body;
+};
+
+// Minimal HTTP/1.1 client for talking to peer telemetry servers.
+// Keeps a small pool of keep-alive connections and is safe to share between threads.
+// Requests either block the caller or run as coroutines on the client's own I/O thread.
+class HttpClient {
+public:
+    HttpClient(std::string host, int port,
+               std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+    ~HttpClient();
+
+    // Prevent copying or moving
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+    HttpClient(HttpClient&&) = delete;
+    HttpClient& operator=(HttpClient&&) = delete;
+
+    // Sends a request with a JSON body; throws BackendUnavailableError on I/O failure
+    HttpClientResponse request(const std::string& method,
+                               const std::string& target,
+                               const std::string& body);
+
+    // Sends a request without holding the caller's thread. Exchanges run non-blocking on one
+    // epoll thread per client, started on first use, which also resumes the awaiting coroutine;
+    // every request in flight has a connection of its own. Throws BackendUnavailableError on
+    // I/O failure or when the peer does not answer within the timeout.
+    Task<HttpClientResponse> requestTask(std::string method, std::string target, std::string body);
+
+    const std::string& host() const { return host_; }
+    int port() const { return port_; }
+
+private:
+    class Reader;
+    class Reactor;
+
+    std::string formatRequest(const std::string& method, const std::string& target, const std::string& body) const;
+    Reactor& reactor();
+    int connect();
+    bool exchange(int fd, HttpClientResponse& response, bool& keepAlive, bool& receivedAny);
+    static bool readResponse(Reader& reader, HttpClientResponse& response, bool& keepAlive);
+    int takeIdle();
+    void release(int fd);
+
+    std::string host_;
+    int port_;
+    std::chrono::milliseconds timeout_;
+    std::mutex mutex_;
+    std::vector<int> idle_;
+    std::unique_ptr<Reactor> reactor_; // Guarded by mutex_ until started
+};
@@ -18,6 +18,9 @@ public:
     bool run() override;
     void stop() override;
 
+    // Publishes the provider's fields under GET /status; call before run()
+    void addStatusProvider(IStatusProvider& provider);
+
 private:
     // Private implementation details - not exposed in header
     class Impl;
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Lock statistics are compiled in with -DTELEMETRY_LOCK_STATS=1 (CMake option TELEMETRY_LOCK_STATS).
+// Without it the instrumented mutex and its guards reduce to a plain std::shared_mutex.
+#ifndef TELEMETRY_LOCK_STATS
+#define TELEMETRY_LOCK_STATS 0
+#endif
+
+namespace lockstats {
+
+enum class LockMode { Shared, Exclusive };
+
+// Bucket 0 counts durations under 1 us, bucket i durations in [2^(i-1), 2^i) us; the last is open-ended
+constexpr std::size_t kHistogramBuckets = 24;
+
+// Totals of one lock mode at one call site
+struct ModeStats {
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0; // Acquisitions that had to wait
+    uint64_t totalWaitNs = 0;
+    uint64_t maxWaitNs = 0;
+    uint64_t totalHoldNs = 0;
+    uint64_t maxHoldNs = 0;
+    std::array<uint64_t, kHistogramBuckets> waitHistogram{};
+    std::array<uint64_t, kHistogramBuckets> holdHistogram{};
+};
+
+struct SiteStats {
+    std::string lockName;
+    std::string siteName;
+    ModeStats shared;
+    ModeStats exclusive;
+};
+
+constexpr bool enabled() { return TELEMETRY_LOCK_STATS != 0; }
+
+// Statistics of every registered call site
+std::vector<SiteStats> snapshot();
+
+// Zeroes the statistics of every registered call site
+void reset();
+
+namespace detail {
+
+inline uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace detail
+
+// Counters of one call site, registered for snapshot() for as long as it exists.
+// Sites are meant to live at namespace scope; all locks acquired through a site share its counters.
+class SiteCounters {
+public:
+    SiteCounters(const char* lockName, const char* siteName);
+    ~SiteCounters();
+
+    // Prevent copying or moving
+    SiteCounters(const SiteCounters&) = delete;
+    SiteCounters& operator=(const SiteCounters&) = delete;
+    SiteCounters(SiteCounters&&) = delete;
+    SiteCounters& operator=(SiteCounters&&) = delete;
+
+    void record(LockMode mode, bool contended, uint64_t waitNs, uint64_t holdNs);
+
+    SiteStats read() const;
+    void reset();
+
+private:
+    struct Counters {
+        std::atomic<uint64_t> acquisitions{0};
+        std::atomic<uint64_t> contended{0};
+        std::atomic<uint64_t> totalWaitNs{0};
+        std::atomic<uint64_t> maxWaitNs{0};
+        std::atomic<uint64_t> totalHoldNs{0};
+        std::atomic<uint64_t> maxHoldNs{0};
+        std::array<std::atomic<uint64_t>, kHistogramBuckets> waitHistogram{};
+        std::array<std::atomic<uint64_t>, kHistogramBuckets> holdHistogram{};
+    };
+
+    const char* lockName_;
+    const char* siteName_;
+    Counters counters_[2]; // Indexed by LockMode
+};
+
+// Call-site tag of a disabled build; holds nothing
+struct DisabledSite {
+    constexpr DisabledSite(const char*, const char*) noexcept {}
+};
+
+template <bool Enabled>
+using BasicLockSite = std::conditional_t<Enabled, SiteCounters, DisabledSite>;
+
+// Scoped lock that records its wait and hold time at its site when Enabled
+template <bool Enabled, LockMode Mode>
+class BasicLockGuard {
+public:
+    BasicLockGuard(std::shared_mutex& mutex, BasicLockSite<Enabled>& site) : mutex_(mutex) {
+        if constexpr (Enabled) {
+            timing_.site = &site;
+            // An uncontended acquisition costs one clock read
+            if (tryAcquire()) {
+                timing_.acquiredNs = detail::nowNs();
+            } else {
+                const auto start = detail::nowNs();
+                acquire();
+                timing_.acquiredNs = detail::nowNs();
+                timing_.waitNs = timing_.acquiredNs - start;
+                timing_.contended = true;
+            }
+        } else {
+            (void)site;
+            acquire();
+        }
+    }
+
+    ~BasicLockGuard() {
+        if constexpr (Enabled) {
+            const auto holdNs = detail::nowNs() - timing_.acquiredNs;
+            release();
+            timing_.site->record(Mode, timing_.contended, timing_.waitNs, holdNs);
+        } else {
+            release();
+        }
+    }
+
+    // Prevent copying or moving
+    BasicLockGuard(const BasicLockGuard&) = delete;
+    BasicLockGuard& operator=(const BasicLockGuard&) = delete;
+    BasicLockGuard(BasicLockGuard&&) = delete;
+    BasicLockGuard& operator=(BasicLockGuard&&) = delete;
+
+private:
+    struct Timing {
+        SiteCounters* site = nullptr;
+        uint64_t acquiredNs = 0;
+        uint64_t waitNs = 0;
+        bool contended = false;
+    };
+    struct NoTiming {};
+
+    bool tryAcquire() {
+        if constexpr (Mode == LockMode::Shared) {
+            return mutex_.try_lock_shared();
+        } else {
+            return mutex_.try_lock();
+        }
+    }
+
+    void acquire() {
+        if constexpr (Mode == LockMode::Shared) {
+            mutex_.lock_shared();
+        } else {
+            mutex_.lock();
+        }
+    }
+
+    void release() {
+        if constexpr (Mode == LockMode::Shared) {
+            mutex_.unlock_shared();
+        } else {
+            mutex_.unlock();
+        }
+    }
+
+    std::shared_mutex& mutex_;
+    [[no_unique_address]] std::conditional_t<Enabled, Timing, NoTiming> timing_;
+};
+
+// Reader-writer mutex whose acquisitions name their call site
+template <bool Enabled>
+class BasicInstrumentedSharedMutex {
+public:
+    using Site = BasicLockSite<Enabled>;
+    using SharedLock = BasicLockGuard<Enabled, LockMode::Shared>;
+    using ExclusiveLock = BasicLockGuard<Enabled, LockMode::Exclusive>;
+
+    SharedLock lockShared(Site& site) { return SharedLock(mutex_, site); }
+    ExclusiveLock lock(Site& site) { return ExclusiveLock(mutex_, site); }
+
+private:
+    std::shared_mutex mutex_;
+};
+
+using LockSite = BasicLockSite<enabled()>;
+using InstrumentedSharedMutex = BasicInstrumentedSharedMutex<enabled()>;
+
+} // namespace lockstats
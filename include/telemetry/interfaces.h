@@ -1,9 +1,17 @@
 #pragma once
 
+#include <array>
+#include <cmath>
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <map>
+#include <functional>
 #include <optional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include "task.h"
 
 // Event data structure for storing telemetry path data
 struct EventData {
@@ -11,6 +19,144 @@ struct EventData {
     uint64_t timestamp;
 };
 
+// Partial aggregate of path lengths, mergeable across shards and nodes
+struct PathAggregate {
+    double sum = 0.0;    // Sum of all path values
+    uint64_t count = 0;  // Number of paths
+};
+
+// Sample-based estimate of a PathAggregate, mergeable across segments, shards and nodes.
+// The mean is a ratio estimate, sum / count; its variance is kept as the coefficients of
+// Var(sum - m * count) = v0 + v1 * m + v2 * m^2 so that parts can be added before m is known.
+struct SampledAggregate {
+    double sum = 0.0;        // Estimated sum of path lengths
+    double count = 0.0;      // Estimated number of paths
+    uint64_t sampleSize = 0; // Sampled paths behind the estimated part; exactly known parts add none
+    std::array<double, 3> variance{};
+
+    void merge(const SampledAggregate& other) {
+        sum += other.sum;
+        count += other.count;
+        sampleSize += other.sampleSize;
+        for (std::size_t i = 0; i < variance.size(); ++i) {
+            variance[i] += other.variance[i];
+        }
+    }
+
+    double mean() const { return count > 0.0 ? sum / count : 0.0; }
+
+    // Half-width of the confidence interval of mean() for the normal quantile z (1.96 for 95%)
+    double marginOfError(double z = 1.96) const {
+        if (count <= 0.0) {
+            return 0.0;
+        }
+        const double m = mean();
+        const double spread = variance[0] + variance[1] * m + variance[2] * m * m;
+        return spread > 0.0 ? z * std::sqrt(spread) / count : 0.0;
+    }
+};
+
+// Resumable position of a chunked read over the stored events of one name.
+// Positions stay valid while events are added, so a reader need not hold any lock between chunks.
+struct EventCursor {
+    uint64_t partition = 0; // Shard being read, for storages made of several
+    uint64_t block = 0;     // Storage-defined segment of the partition
+    uint64_t offset = 0;    // Event within the segment
+    bool done = false;      // Set once every stored event has been visited
+};
+
+// Aggregate of the events in one time bucket of a series
+struct SeriesBucket {
+    uint64_t bucketStart = 0;  // First timestamp covered by the bucket
+    PathAggregate aggregate;
+};
+
+// Closed time range [start, end] of one window of a batch query
+struct TimeWindow {
+    uint64_t start = 0;
+    uint64_t end = 0;
+};
+
+// Groups partial aggregates into fixed-width time buckets starting at origin + k * width.
+// The current bucket is cached, so a time-ordered sweep looks each bucket up only once.
+class SeriesAccumulator {
+public:
+    SeriesAccumulator(uint64_t origin, uint64_t width) : origin_(origin), width_(width) {
+        if (width_ == 0) {
+            throw std::invalid_argument("Bucket width must be positive");
+        }
+    }
+
+    // Prevent copying, current_ points into buckets_
+    SeriesAccumulator(const SeriesAccumulator&) = delete;
+    SeriesAccumulator& operator=(const SeriesAccumulator&) = delete;
+
+    // Start of the bucket holding timestamp, which must not precede the origin
+    uint64_t bucketStartOf(uint64_t timestamp) const {
+        return origin_ + (timestamp - origin_) / width_ * width_;
+    }
+
+    void add(uint64_t timestamp, const PathAggregate& part) {
+        auto start = bucketStartOf(timestamp);
+        if (current_ == nullptr || currentStart_ != start) {
+            current_ = &buckets_[start];
+            currentStart_ = start;
+        }
+        current_->sum += part.sum;
+        current_->count += part.count;
+    }
+
+    // Non-empty buckets in time order
+    std::vector<SeriesBucket> buckets() const {
+        std::vector<SeriesBucket> result;
+        result.reserve(buckets_.size());
+        for (const auto& [start, aggregate] : buckets_) {
+            result.push_back(SeriesBucket{start, aggregate});
+        }
+        return result;
+    }
+
+private:
+    const uint64_t origin_;
+    const uint64_t width_;
+    std::map<uint64_t, PathAggregate> buckets_;
+    PathAggregate* current_ = nullptr;
+    uint64_t currentStart_ = 0;
+};
+
+// Raised when an operation is not available in this server role
+class UnsupportedOperationError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Raised when a backend the request depends on cannot be reached
+class BackendUnavailableError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Raised when a query runs past its deadline and a partial result was not acceptable
+class QueryTimeoutError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Current state of a sliding-window mean
+struct RollingMeanSnapshot {
+    double mean;
+    uint64_t count;
+};
+
+// Live sliding-window mean, shared by all subscribers of the same window
+class IRollingMean {
+public:
+    virtual ~IRollingMean() = default;
+
+    // Returns the mean over the window as of now
+    virtual RollingMeanSnapshot snapshot() = 0;
+};
+
 // Interface for telemetry data storage
 class ITelemetryStorage {
 public:
@@ -21,11 +167,133 @@ public:
                           const std::vector<double>& values, 
                           uint64_t timestamp) = 0;
 
+    // Saves an event and reports through onDurable once it is persisted. Returns false if the
+    // event was rejected, in which case onDurable is never called. The default suits in-memory
+    // storage, where an event is durable as soon as it is saved.
+    virtual bool saveEventAsync(const std::string& eventName,
+                                const std::vector<double>& values,
+                                uint64_t timestamp,
+                                const std::function<void(bool durable)>& onDurable) {
+        if (!saveEvent(eventName, values, timestamp)) {
+            return false;
+        }
+        onDurable(true);
+        return true;
+    }
+
+    // Saves a batch of events of one name and returns how many were accepted. The default saves
+    // them one by one, so decorators see every event; bulk loaders should prefer this over saveEvent.
+    virtual std::size_t saveEvents(const std::string& eventName, const std::vector<EventData>& events) {
+        std::size_t saved = 0;
+        for (const auto& event : events) {
+            saved += saveEvent(eventName, event.values, event.timestamp) ? 1 : 0;
+        }
+        return saved;
+    }
+
     // Retrieves events filtered by optional time range
     virtual std::vector<EventData> getFilteredEvents(
         const std::string& eventName, 
         std::optional<uint64_t> startTimestamp = std::nullopt, 
         std::optional<uint64_t> endTimestamp = std::nullopt) = 0;
+
+    // Sums the values of events in the optional time range without materializing them.
+    // The default folds getFilteredEvents; implementations should override it with a copy-free scan.
+    virtual PathAggregate aggregateEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) {
+        PathAggregate aggregate;
+        for (const auto& event : getFilteredEvents(eventName, startTimestamp, endTimestamp)) {
+            aggregate.sum += std::accumulate(event.values.begin(), event.values.end(), 0.0);
+            ++aggregate.count;
+        }
+        return aggregate;
+    }
+
+    // Sums the events in the optional time range per bucket of bucketWidth seconds. Buckets are
+    // aligned to startTimestamp, or to multiples of the width when there is none; empty buckets
+    // are omitted. The default folds getFilteredEvents; implementations should override it.
+    virtual std::vector<SeriesBucket> aggregateSeries(
+        const std::string& eventName,
+        uint64_t bucketWidth,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) {
+        SeriesAccumulator series(startTimestamp.value_or(0), bucketWidth);
+        for (const auto& event : getFilteredEvents(eventName, startTimestamp, endTimestamp)) {
+            series.add(event.timestamp,
+                       PathAggregate{std::accumulate(event.values.begin(), event.values.end(), 0.0), 1});
+        }
+        return series.buckets();
+    }
+
+    // Sums the events of each window, in the order of windows, which may overlap and must have
+    // start <= end. The default queries the windows one by one; implementations should override
+    // it with a single sweep over the span the windows cover.
+    virtual std::vector<PathAggregate> aggregateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) {
+        std::vector<PathAggregate> aggregates;
+        aggregates.reserve(windows.size());
+        for (const auto& window : windows) {
+            aggregates.push_back(aggregateEvents(eventName, window.start, window.end));
+        }
+        return aggregates;
+    }
+
+    // Appends up to maxEvents further events in the optional time range to out, starting at cursor
+    // and advancing it. Events come in storage order, which need not be timestamp order; events
+    // saved during the read may or may not be included. The default re-reads getFilteredEvents
+    // for every chunk; implementations should override it with a bounded scan.
+    virtual void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) {
+        auto events = getFilteredEvents(eventName, startTimestamp, endTimestamp);
+        while (maxEvents > 0 && cursor.offset < events.size()) {
+            out.push_back(std::move(events[cursor.offset++]));
+            --maxEvents;
+        }
+        cursor.done = cursor.offset >= events.size();
+    }
+
+    // Estimates the aggregate of the events in the optional time range from samples kept on
+    // ingest, in time independent of the number of events. The default is the exact aggregate.
+    virtual SampledAggregate sampleAggregate(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) {
+        auto exact = aggregateEvents(eventName, startTimestamp, endTimestamp);
+        SampledAggregate sampled;
+        sampled.sum = exact.sum;
+        sampled.count = static_cast<double>(exact.count);
+        return sampled;
+    }
+
+    // Version of the events of eventName: it grows with every change to them and never repeats
+    // while the storage exists, so equal versions mean equal query results. Cheap enough to read
+    // before every query. The default is nullopt, for storages that do not track versions.
+    virtual std::optional<uint64_t> eventVersion(const std::string& eventName) {
+        (void)eventName;
+        return std::nullopt;
+    }
+
+    // Path length of values as the storage keeps them for eventName, so that totals kept
+    // outside the storage agree with its aggregates. The default keeps values unchanged.
+    virtual double storedLength(const std::string& eventName, const std::vector<double>& values) {
+        (void)eventName;
+        return std::accumulate(values.begin(), values.end(), 0.0);
+    }
+};
+
+// Outcome of an asynchronous save
+enum class SaveStatus {
+    Saved,     // Stored and, with persistence enabled, durable
+    Rejected,  // Invalid event
+    Failed,    // Accepted but could not be persisted
 };
 
 // Interface for telemetry processing
@@ -38,18 +306,138 @@ public:
                           const std::vector<double>& values, 
                           uint64_t timestamp) = 0;
 
+    // Processes a new event and reports the outcome through done, possibly on another thread
+    // once the event is durable. The default completes synchronously through saveEvent.
+    virtual void saveEventAsync(const std::string& eventName,
+                                const std::vector<double>& values,
+                                uint64_t timestamp,
+                                std::function<void(SaveStatus)> done) {
+        done(saveEvent(eventName, values, timestamp) ? SaveStatus::Saved : SaveStatus::Rejected);
+    }
+
+    // Coroutine form of saveEventAsync: completes once the event is saved and, with persistence,
+    // durable, without holding a thread meanwhile. The default awaits saveEventAsync.
+    virtual Task<SaveStatus> saveEventTask(std::string eventName,
+                                           std::vector<double> values,
+                                           uint64_t timestamp) {
+        co_return co_await CallbackAwaiter<SaveStatus>([&](std::function<void(SaveStatus)> done) {
+            saveEventAsync(eventName, values, timestamp, std::move(done));
+        });
+    }
+
     // Calculates mean path length with optional time range filtering
     virtual double calculateMeanLength(
         const std::string& eventName, 
         std::optional<uint64_t> startTimestamp = std::nullopt, 
         std::optional<uint64_t> endTimestamp = std::nullopt) = 0;
+
+    // Coroutine form of calculateMeanLength, for processors whose backend answers asynchronously.
+    // The query context is that of the thread the task starts on. The default calculates the
+    // mean synchronously.
+    virtual Task<double> calculateMeanLengthTask(
+        std::string eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) {
+        co_return calculateMeanLength(eventName, startTimestamp, endTimestamp);
+    }
+
+    // Calculates partial aggregates for several events, in the order of eventNames
+    virtual std::vector<PathAggregate> calculateAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) = 0;
+
+    // Calculates per-bucket aggregates of one event over buckets of bucketSeconds,
+    // aligned as in ITelemetryStorage::aggregateSeries
+    virtual std::vector<SeriesBucket> calculateSeries(
+        const std::string& eventName,
+        uint64_t bucketSeconds,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) = 0;
+
+    // Calculates the aggregates of one event over several time windows, in the order of windows,
+    // as ITelemetryStorage::aggregateWindows
+    virtual std::vector<PathAggregate> calculateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) = 0;
+
+    // Estimates the aggregates of several events from ingest-time samples, in the order of eventNames
+    virtual std::vector<SampledAggregate> calculateSampledAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) = 0;
+
+    // Reads the next chunk of raw events for an export, as ITelemetryStorage::readEvents
+    virtual void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) = 0;
+
+    // Subscribes to the mean over the trailing window of the given width in seconds
+    virtual std::shared_ptr<IRollingMean> subscribeRollingMean(
+        const std::string& eventName,
+        uint64_t windowSeconds) = 0;
+
+    // Defines the standing query called name, replacing any previous definition: the aggregate of
+    // eventName over the optional time range, computed once from history and then updated by
+    // every save it covers
+    virtual void registerStandingQuery(
+        const std::string& name,
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp) = 0;
+
+    // Current aggregate of a standing query without scanning, or nullopt if none is called name
+    virtual std::optional<PathAggregate> readStandingQuery(const std::string& name) = 0;
+
+    // Drops a standing query; returns false if none is called name
+    virtual bool removeStandingQuery(const std::string& name) = 0;
+
+    // Recomputes every standing query from history after the storage was reloaded underneath
+    // the processor, as a replica does when it loads a snapshot. The default keeps no queries.
+    virtual void reseedStandingQueries() {}
+
+    // Combined version of the events of eventNames, as ITelemetryStorage::eventVersion: it changes
+    // whenever any of them does. nullopt if the processor cannot tell, and results must not be reused.
+    virtual std::optional<uint64_t> eventsVersion(const std::vector<std::string>& eventNames) = 0;
 };
 
 // Configuration for the HTTP server
 struct ServerConfig {
     std::string address;
     int port;
-    int threadCount;
+    int threadCount;                    // Worker threads of each listener
+    int streamIntervalMs = 1000;        // Push interval of server-sent event streams
+    int listenerCount = 1;              // Independent acceptors sharing the port through SO_REUSEPORT
+    int backlog = 128;                  // Pending connection queue of each listening socket
+    std::size_t maxRequestSize = 4096;  // Larger requests are refused by the HTTP parser
+    int headerTimeoutMs = 0;            // Time allowed to receive request headers, 0 for the library default
+    int bodyTimeoutMs = 0;              // Time allowed to receive a request body, 0 for the library default
+    int keepAliveTimeoutMs = 0;         // Idle time before a keep-alive connection is closed, 0 for the library default
+    int maxInFlightIngest = 0;          // Concurrent event saves before new ones are shed, 0 for no limit
+    int maxInFlightQueries = 0;         // Concurrent queries before new ones are shed, 0 for no limit
+    int maxInFlightExports = 0;         // Concurrent raw event exports before new ones are shed, 0 for no limit
+    int maxInFlightStreams = 0;         // Concurrent rolling-mean streams before new ones are shed, 0 for no limit
+    double eventRateLimit = 0.0;        // Sustained saves per second of each event name, 0 for no limit
+    double eventRateBurst = 0.0;        // Saves an idle event name may take at once, at least 1
+    int queryTimeoutMs = 0;             // Deadline of every query, 0 for none; clients may ask for less
+    int traceSampleEvery = 0;           // Trace one request in this many, 0 to disable tracing
+    std::string traceFile = "telemetry-trace.json"; // Written by POST /trace/dump
+};
+
+// Interface for components that report runtime status
+class IStatusProvider {
+public:
+    virtual ~IStatusProvider() = default;
+
+    // Name of the status section, e.g. "replication"
+    virtual std::string statusName() const = 0;
+
+    // Current status fields
+    virtual std::map<std::string, double> statusFields() const = 0;
 };
 
 // Interface for HTTP server
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Flat JSON object formatted into the calling thread's reusable buffer with std::to_chars.
+// Once the buffer has grown to fit the thread's largest body, building a response allocates
+// nothing. The body returned by finish() stays valid until the thread starts the next object,
+// so objects must not be nested or interleaved on one thread.
+class JsonBody {
+public:
+    JsonBody();
+
+    JsonBody& add(std::string_view name, double value);
+    JsonBody& add(std::string_view name, uint64_t value);
+    JsonBody& add(std::string_view name, bool value);
+    JsonBody& add(std::string_view name, std::string_view value);
+    JsonBody& add(std::string_view name, const char* value) { return add(name, std::string_view(value)); }
+
+    // Closes the object and returns the body
+    std::string_view finish();
+
+    // {"error":message}, the body of every error response
+    static std::string_view error(std::string_view message);
+
+    // Formats doubles as nlohmann::json does: shortest round-trip form, integral values with
+    // a trailing ".0", and null for NaN and infinities
+    static void appendNumber(std::string& out, double value);
+
+    // Appends text as a quoted JSON string
+    static void appendString(std::string& out, std::string_view text);
+
+private:
+    void key(std::string_view name);
+
+    std::string& buffer_;
+    bool first_ = true;
+};
+
+// Bodies that never change
+inline constexpr std::string_view kEmptyJsonBody = "{}";
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "interfaces.h"
+#include "forwarding_storage.h"
+
+// I/O mechanism used to make appends durable
+enum class PersistenceBackend {
+    Auto,     // io_uring when the kernel allows it, a flusher thread otherwise
+    IoUring,  // Batched writes and fsyncs submitted through io_uring with registered buffers
+    Threads,  // Batched pwrite and fdatasync on a dedicated flusher thread
+};
+
+// Parses "auto", "io_uring" or "threads"; throws std::invalid_argument otherwise
+PersistenceBackend parsePersistenceBackend(const std::string& name);
+
+// Append-only file whose appends complete asynchronously once they are durable.
+// Concurrent appends are grouped into batches that share one write and one fsync;
+// completions run in append order on the appender's own thread.
+class IDurableAppender : public IStatusProvider {
+public:
+    using Completion = std::function<void(bool durable)>;
+
+    // Queues a record; done(true) runs once it and every earlier record are on disk.
+    // After a failed write every later append completes with false.
+    virtual void append(std::string record, Completion done) = 0;
+
+    // Blocks until every queued record has completed
+    virtual void flush() = 0;
+
+    std::string statusName() const override { return "persistence"; }
+};
+
+// Opens (creating if needed) an append-only file at path
+std::unique_ptr<IDurableAppender> openDurableAppender(const std::string& path,
+                                                      PersistenceBackend backend = PersistenceBackend::Auto);
+
+// Storage decorator that writes every saved event to a durable log.
+// Events are visible to queries as soon as they are stored; callers of saveEventAsync
+// are acknowledged once the log record is on disk. Once a log write has failed nothing can be
+// made durable any more, so every later save throws BackendUnavailableError instead of keeping
+// in memory an event that a restart would lose. Events already in flight when the write failed
+// stay stored, although their callers are told that they were not persisted.
+class DurableStorage : public ForwardingStorage {
+public:
+    DurableStorage(ITelemetryStorage& inner, IDurableAppender& log);
+
+    // Blocks until the event is durable
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    bool saveEventAsync(const std::string& eventName,
+                        const std::vector<double>& values,
+                        uint64_t timestamp,
+                        const std::function<void(bool durable)>& onDurable) override;
+
+    // Replays the log at path into storage and returns the number of events it accepted; records
+    // the storage rejects, such as values beyond a narrower precision than they were logged at,
+    // are skipped. A torn or corrupt tail left by a crash is cut off so that new records follow
+    // valid ones.
+    // The log is mapped and read front to back; it is never checkpointed, so replay time grows
+    // with everything ever logged.
+    static std::size_t recover(const std::string& path, ITelemetryStorage& storage);
+
+private:
+    IDurableAppender& log_;
+    std::atomic<bool> failed_{false}; // Set by the first append that did not become durable
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include "interfaces.h"
+
+// Deadline of the query running on the calling thread. Installed for the lifetime of the object;
+// storage scans poll it between chunks so that a long scan gives up its lock and its worker in time.
+class QueryContext {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // allowPartial lets scans stop at the deadline and return what they have covered so far
+    QueryContext(Clock::time_point deadline, bool allowPartial);
+    ~QueryContext();
+
+    // Prevent copying or moving, the context is registered by address
+    QueryContext(const QueryContext&) = delete;
+    QueryContext& operator=(const QueryContext&) = delete;
+    QueryContext(QueryContext&&) = delete;
+    QueryContext& operator=(QueryContext&&) = delete;
+
+    // Context of the calling thread, nullptr when queries run without a deadline
+    static QueryContext* current();
+
+    // Takes the contexts installed on the calling thread since outer was current off the thread
+    // without ending them. Called by whoever started a coroutine that owns a context once it has
+    // suspended, since it may resume and end on another thread; code running after a suspension
+    // reaches the context through a pointer taken before it.
+    static void detachAbove(QueryContext* outer);
+
+    // Polled by scans at chunk boundaries. Returns false while the query may go on. Past the
+    // deadline it returns true, marking the result partial, if partial results are allowed,
+    // and throws QueryTimeoutError otherwise.
+    static bool deadlineReached();
+
+    Clock::time_point deadline() const { return deadline_; }
+    bool allowPartial() const { return allowPartial_; }
+
+    // Whether some data was skipped because of the deadline
+    bool partial() const { return partial_; }
+    void markPartial() { partial_ = true; }
+
+private:
+    const Clock::time_point deadline_;
+    const bool allowPartial_;
+    bool partial_ = false;
+    bool attached_ = true;
+    QueryContext* previous_;
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "interfaces.h"
+#include "forwarding_storage.h"
+#include "telemetry_storage.h"
+
+// One ingested event in leader order
+struct ReplicationRecord {
+    uint64_t sequence;      // 1-based, gap-free
+    uint64_t appendedAtMs;  // Leader wall clock when the record was appended
+    std::string eventName;
+    EventData event;
+};
+
+// Bounded in-memory tail of the leader's ordered ingest log
+class ReplicationLog {
+public:
+    explicit ReplicationLog(std::size_t capacity = 1 << 20);
+
+    // Appends a record and wakes waiting followers; returns its sequence
+    uint64_t append(const std::string& eventName, const std::vector<double>& values, uint64_t timestamp);
+
+    // Copies up to maxRecords records starting at sequence `from`.
+    // Returns false when `from` is no longer (or not yet) covered by the log.
+    bool read(uint64_t from, std::size_t maxRecords, std::vector<ReplicationRecord>& out) const;
+
+    // Waits until a record with sequence `from` exists or the timeout elapses
+    void waitFor(uint64_t from, std::chrono::milliseconds timeout) const;
+
+    // Sequence of the newest record, 0 while the log is empty
+    uint64_t headSequence() const;
+
+    // Sequence of the oldest retained record
+    uint64_t firstSequence() const;
+
+    // Random, non-zero identity of this log. A restarted leader numbers its records from 1
+    // again, so followers only resume by sequence within the same epoch.
+    uint64_t epoch() const { return epoch_; }
+
+    // Wakes all waiting readers, e.g. on shutdown
+    void notifyAll() const;
+
+private:
+    const std::size_t capacity_;
+    const uint64_t epoch_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable appended_;
+    std::deque<ReplicationRecord> records_;
+    uint64_t headSequence_ = 0;
+};
+
+// Leader-side storage decorator that records every saved event in the replication log
+class ReplicatedStorage : public ForwardingStorage {
+public:
+    ReplicatedStorage(TelemetryStorage& storage, ReplicationLog& log);
+
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    // Freezes the whole store into events and returns the log sequence it corresponds to.
+    // Writers are held off while the compressed blocks are copied, not while they are decoded.
+    uint64_t snapshot(TelemetryStorage::Frozen& events);
+
+private:
+    TelemetryStorage& storage_;
+    ReplicationLog& log_;
+    std::mutex writeMutex_; // Keeps storage order and log order identical
+};
+
+// Wire protocol between leader and followers: [u8 type][u32 length][payload]
+namespace replication {
+
+enum class FrameType : uint8_t {
+    Hello = 1,          // follower -> leader: u64 next sequence, 0 to request a snapshot, u64 leader epoch, 0 if unknown
+    SnapshotBegin = 2,  // u64 sequence the snapshot corresponds to, u64 leader epoch
+    SnapshotEvent = 3,  // one event
+    SnapshotEnd = 4,
+    Record = 5,         // u64 sequence, u64 appended-at ms, event
+    Heartbeat = 6,      // u64 head sequence, u64 leader wall clock ms, u64 leader epoch
+};
+
+bool sendFrame(int fd, FrameType type, const std::string& payload);
+bool receiveFrame(int fd, FrameType& type, std::string& payload);
+
+// Wall clock in milliseconds since the UNIX epoch
+uint64_t nowMs();
+
+} // namespace replication
+
+// Serves the replication log to followers over TCP
+class ReplicationLeader : public IStatusProvider {
+public:
+    ReplicationLeader(ReplicatedStorage& storage, ReplicationLog& log, std::string address, int port);
+    ~ReplicationLeader() override;
+
+    // Prevent copying or moving
+    ReplicationLeader(const ReplicationLeader&) = delete;
+    ReplicationLeader& operator=(const ReplicationLeader&) = delete;
+    ReplicationLeader(ReplicationLeader&&) = delete;
+    ReplicationLeader& operator=(ReplicationLeader&&) = delete;
+
+    // Starts accepting followers; throws std::runtime_error if the port cannot be bound
+    void start();
+    void stop();
+
+    // Implements IStatusProvider
+    std::string statusName() const override { return "replication"; }
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    struct Session {
+        int fd;
+        std::atomic<bool> finished{false};
+        std::thread thread;
+    };
+
+    void acceptLoop();
+    void serveFollower(Session& session);
+    bool sendSnapshot(int fd, uint64_t& nextSequence);
+    void reapFinishedSessions();
+
+    ReplicatedStorage& storage_;
+    ReplicationLog& log_;
+    std::string address_;
+    int port_;
+    int listenFd_ = -1;
+    std::atomic<bool> running_{false};
+    std::atomic<int> followers_{0};
+    std::thread acceptThread_;
+    std::mutex sessionsMutex_;
+    std::list<Session> sessions_;
+};
+
+// Applies the leader's log to a local read-only replica
+class ReplicationFollower : public IStatusProvider {
+public:
+    // Snapshots are loaded into storage directly, after which the applier's standing queries are
+    // reseeded; tail records go through applier so that processor-level state such as rolling
+    // windows and standing queries follows the leader
+    ReplicationFollower(std::string leaderHost, int leaderPort,
+                        TelemetryStorage& storage, ITelemetryProcessor& applier);
+    ~ReplicationFollower() override;
+
+    // Prevent copying or moving
+    ReplicationFollower(const ReplicationFollower&) = delete;
+    ReplicationFollower& operator=(const ReplicationFollower&) = delete;
+    ReplicationFollower(ReplicationFollower&&) = delete;
+    ReplicationFollower& operator=(ReplicationFollower&&) = delete;
+
+    void start();
+    void stop();
+
+    uint64_t appliedSequence() const { return appliedSequence_; }
+
+    // False until the first snapshot is loaded and while a resync reloads the store, when
+    // queries would see an empty or partly loaded copy of the leader's data
+    bool synchronized() const { return synchronized_; }
+
+    // Implements IStatusProvider
+    std::string statusName() const override { return "replication"; }
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    void run();
+    void follow(int fd);
+    int connectToLeader();
+
+    std::string leaderHost_;
+    int leaderPort_;
+    TelemetryStorage& storage_;
+    ITelemetryProcessor& applier_;
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> synchronized_{false};
+    std::atomic<int> fd_{-1};
+    std::atomic<uint64_t> appliedSequence_{0};
+    std::atomic<uint64_t> leaderEpoch_{0}; // Epoch of the log appliedSequence_ counts in, 0 if none
+    std::atomic<uint64_t> appliedAppendedAtMs_{0};
+    std::atomic<uint64_t> leaderSequence_{0};
+    std::atomic<uint64_t> lastHeartbeatMs_{0};
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopped_;
+};
+
+// Processor of a read replica: serves queries and rejects writes
+class ReadOnlyProcessor : public ITelemetryProcessor {
+public:
+    explicit ReadOnlyProcessor(ITelemetryProcessor& inner) : inner_(inner) {}
+
+    // Queries throw BackendUnavailableError while the follower is not synchronized
+    ReadOnlyProcessor(ITelemetryProcessor& inner, const ReplicationFollower& follower)
+        : inner_(inner), follower_(&follower) {}
+
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    double calculateMeanLength(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<PathAggregate> calculateAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<SeriesBucket> calculateSeries(
+        const std::string& eventName,
+        uint64_t bucketSeconds,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<PathAggregate> calculateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) override;
+
+    std::vector<SampledAggregate> calculateSampledAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override;
+
+    std::shared_ptr<IRollingMean> subscribeRollingMean(
+        const std::string& eventName,
+        uint64_t windowSeconds) override;
+
+    void registerStandingQuery(
+        const std::string& name,
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp) override;
+
+    std::optional<PathAggregate> readStandingQuery(const std::string& name) override;
+
+    bool removeStandingQuery(const std::string& name) override;
+
+    void reseedStandingQueries() override;
+
+    // nullopt while the follower is not synchronized, so that no stale tag is confirmed
+    std::optional<uint64_t> eventsVersion(const std::vector<std::string>& eventNames) override;
+
+private:
+    void requireSynchronized() const;
+
+    ITelemetryProcessor& inner_;
+    const ReplicationFollower* follower_ = nullptr;
+};
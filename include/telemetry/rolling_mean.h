@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include "interfaces.h"
+
+// Sliding time window over one event, updated incrementally on ingest
+class RollingWindow : public IRollingMean {
+public:
+    using Clock = std::function<uint64_t()>;
+
+    RollingWindow(uint64_t widthSeconds, Clock clock);
+
+    // Adds one event's path sum, expiring entries that fell out of the window
+    void add(uint64_t timestamp, double pathSum);
+
+    // Implements IRollingMean
+    RollingMeanSnapshot snapshot() override;
+
+private:
+    void expire(uint64_t now);
+
+    const uint64_t widthSeconds_;
+    Clock clock_;
+    std::mutex mutex_;
+    std::deque<std::pair<uint64_t, double>> entries_; // Sorted by timestamp
+    double sum_ = 0.0;
+};
+
+// Registry of rolling windows keyed by event name and window width
+class RollingMeanTracker {
+public:
+    using Clock = RollingWindow::Clock;
+    using Seeder = std::function<std::vector<EventData>(uint64_t fromTimestamp)>;
+    using LengthOf = std::function<double(const std::string& eventName, const std::vector<double>& values)>;
+
+    // lengthOf gives an event's path length as the storage keeps it, so that windows fed on
+    // ingest agree with the stored history they were seeded from; by default values are
+    // added unchanged
+    explicit RollingMeanTracker(Clock clock = &systemClockSeconds, LengthOf lengthOf = {});
+
+    // Prevent copying or moving
+    RollingMeanTracker(const RollingMeanTracker&) = delete;
+    RollingMeanTracker& operator=(const RollingMeanTracker&) = delete;
+    RollingMeanTracker(RollingMeanTracker&&) = delete;
+    RollingMeanTracker& operator=(RollingMeanTracker&&) = delete;
+
+    // Persists an event through save() and feeds it into the live windows of its event.
+    // Seeding a window of the same event is excluded meanwhile, so a seeding scan never sees an
+    // event twice; saves of other events are not held up by it.
+    bool ingest(const std::string& eventName,
+                const std::vector<double>& values,
+                uint64_t timestamp,
+                const std::function<bool()>& save);
+
+    // Returns the window shared by all subscribers of eventName/widthSeconds,
+    // creating it and seeding it from history on first use while saves of eventName wait
+    std::shared_ptr<IRollingMean> subscribe(const std::string& eventName,
+                                            uint64_t widthSeconds,
+                                            const Seeder& seed);
+
+    // Current UNIX time in seconds
+    static uint64_t systemClockSeconds();
+
+private:
+    struct Entry {
+        uint64_t widthSeconds;
+        std::weak_ptr<RollingWindow> window;
+    };
+
+    // Windows of one event. Saves of the event hold mutex shared, seeding holds it exclusively.
+    struct EventWindows {
+        std::shared_mutex mutex;
+        std::vector<Entry> entries;
+    };
+
+    void pruneExpired();
+
+    Clock clock_;
+    LengthOf lengthOf_;
+    // Guards the map only; saves of events without windows hold it shared, so that a first
+    // subscriber's seeding scan sees every save that did not find its window
+    std::map<std::string, std::shared_ptr<EventWindows>> windows_;
+    std::shared_mutex mutex_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include "interfaces.h"
+
+// Applies the runtime settings of a JSON config file to config, e.g.
+// {"threads": 4, "listeners": 2, "backlog": 1024, "maxRequestSize": 8192, "keepAliveTimeoutMs": 5000}.
+// Keys that are absent leave the current value; unknown keys and invalid values throw std::runtime_error.
+void applyConfigFile(const std::string& path, ServerConfig& config);
+
+// Throws std::invalid_argument if the config cannot be served
+void validateServerConfig(const ServerConfig& config);
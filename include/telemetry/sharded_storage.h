@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "interfaces.h"
+#include "telemetry_storage.h"
+
+// Storage split into per-thread shards for the thread-per-core mode.
+// Each calling thread is bound to one shard on first use and, if requested, pinned to that
+// shard's CPU, so ingest threads never share a lock or a cache line. Shards are placed on the
+// NUMA node of their CPU; queries merge the shards' partial results.
+class ShardedStorage : public ITelemetryStorage {
+public:
+    ShardedStorage(std::size_t shardCount, bool pinThreads, PrecisionPolicy precision = {},
+                   TieringPolicy tiering = {});
+    ~ShardedStorage() override;
+
+    // Prevent copying or moving
+    ShardedStorage(const ShardedStorage&) = delete;
+    ShardedStorage& operator=(const ShardedStorage&) = delete;
+    ShardedStorage(ShardedStorage&&) = delete;
+    ShardedStorage& operator=(ShardedStorage&&) = delete;
+
+    // Implements ITelemetryStorage
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    // Events of all shards, ordered by timestamp
+    std::vector<EventData> getFilteredEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    PathAggregate aggregateEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    // Buckets merged across shards
+    std::vector<SeriesBucket> aggregateSeries(
+        const std::string& eventName,
+        uint64_t bucketWidth,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    // Window aggregates added up across shards
+    std::vector<PathAggregate> aggregateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) override;
+
+    // Reads the shards one after another; cursor.partition is the shard
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override;
+
+    SampledAggregate sampleAggregate(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    // Sum of the shards' versions, which grows whenever any of them does
+    std::optional<uint64_t> eventVersion(const std::string& eventName) override;
+
+    // Shards share one precision policy
+    double storedLength(const std::string& eventName, const std::vector<double>& values) override;
+
+    std::size_t shardCount() const { return shards_.size(); }
+
+    // Tier sizes summed over the shards
+    TierStats tierStats();
+
+    // Blocks until every shard's scheduled compactions and spills have finished
+    void waitForCompactions();
+
+    // Index of the shard the calling thread writes to, binding the thread on first use
+    std::size_t localShard();
+
+    // While alive, saves from the thread that created it go to the shards in turn, without
+    // binding or pinning the thread. For bulk loads on the main thread, whose CPU affinity
+    // every thread it starts afterwards inherits.
+    class BulkLoad {
+    public:
+        explicit BulkLoad(ShardedStorage& storage);
+        ~BulkLoad();
+
+        // Prevent copying or moving
+        BulkLoad(const BulkLoad&) = delete;
+        BulkLoad& operator=(const BulkLoad&) = delete;
+        BulkLoad(BulkLoad&&) = delete;
+        BulkLoad& operator=(BulkLoad&&) = delete;
+
+    private:
+        uint64_t previous_; // Instance the thread was bulk loading before, usually none
+    };
+
+private:
+    struct Shard;
+    struct ShardDeleter {
+        void operator()(Shard* shard) const;
+    };
+
+    void pinToShardCpu(std::size_t shard) const;
+
+    std::vector<std::unique_ptr<Shard, ShardDeleter>> shards_;
+    std::vector<int> cpus_; // CPUs this process may run on, shard i belongs to cpus_[i % size]
+    std::atomic<std::size_t> nextShard_{0};
+    std::atomic<std::size_t> nextLoadShard_{0}; // Shard of the next bulk-loaded event
+    const bool pinThreads_;
+    const uint64_t instanceId_; // Keys the per-thread shard binding
+};
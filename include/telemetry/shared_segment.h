@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "interfaces.h"
+#include "forwarding_storage.h"
+#include "replication.h"
+
+// Geometry of a POSIX shared-memory segment holding the path lengths of every event name.
+// Each name gets fixed columns of eventsPerSeries timestamps and lengths, allocated up front;
+// untouched pages cost nothing until the name's events reach them.
+struct SegmentOptions {
+    std::string name;                         // shm_open name, a leading '/' is added if missing
+    std::size_t maxSeries = 64;               // Event names the segment can hold
+    std::size_t eventsPerSeries = 1 << 20;    // Events of one name the segment can hold
+};
+
+// Process-shared mapping of a segment; the layout lives in the implementation
+class SharedSegment;
+
+// Ingest-side storage decorator that also publishes every saved event into a shared-memory
+// segment, for query processes on the same host to read without copying. The segment is
+// created, or reset if it exists, on construction and only one writer may hold it at a time.
+// Events of a name beyond eventsPerSeries, and names beyond maxSeries, are counted as dropped
+// and make readers refuse to answer for them.
+class SharedSegmentWriter : public ForwardingStorage, public IStatusProvider {
+public:
+    // Throws std::runtime_error if the segment cannot be created, mapped or locked
+    SharedSegmentWriter(ITelemetryStorage& inner, const SegmentOptions& options);
+    ~SharedSegmentWriter() override;
+
+    // Prevent copying or moving
+    SharedSegmentWriter(const SharedSegmentWriter&) = delete;
+    SharedSegmentWriter& operator=(const SharedSegmentWriter&) = delete;
+    SharedSegmentWriter(SharedSegmentWriter&&) = delete;
+    SharedSegmentWriter& operator=(SharedSegmentWriter&&) = delete;
+
+    // Saves through the wrapped storage and publishes the event's length as the storage keeps it
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    // Implements IStatusProvider
+    std::string statusName() const override { return "sharedMemory"; }
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    // Marks names that did not fit the directory
+    static constexpr std::size_t kDroppedSeries = SIZE_MAX;
+
+    std::unique_ptr<SharedSegment> segment_;
+    std::mutex publishMutex_; // One publisher at a time; readers never take it
+    std::unordered_map<std::string, std::size_t> seriesIndex_; // Directory entry of every name seen
+};
+
+// Read-only storage over a segment published by another process. Queries read the shared
+// columns in place, skipping or summing whole blocks through their published summaries, and
+// never block the writer. Only aggregates are published, so raw events cannot be read.
+class SharedSegmentReader : public ITelemetryStorage, public IStatusProvider {
+public:
+    // Throws std::runtime_error if the segment does not exist or has an unknown layout
+    explicit SharedSegmentReader(const std::string& name);
+    ~SharedSegmentReader() override;
+
+    // Prevent copying or moving
+    SharedSegmentReader(const SharedSegmentReader&) = delete;
+    SharedSegmentReader& operator=(const SharedSegmentReader&) = delete;
+    SharedSegmentReader(SharedSegmentReader&&) = delete;
+    SharedSegmentReader& operator=(SharedSegmentReader&&) = delete;
+
+    // Always throws UnsupportedOperationError; the segment has a single writer
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    // Always throw UnsupportedOperationError; only path lengths are published
+    std::vector<EventData> getFilteredEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override;
+
+    // The aggregates below throw BackendUnavailableError for names that overflowed the segment
+    // or while the writer keeps resetting it
+    PathAggregate aggregateEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<SeriesBucket> aggregateSeries(
+        const std::string& eventName,
+        uint64_t bucketWidth,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    // Published event count of the name, offset by the writer's resets so it never repeats
+    std::optional<uint64_t> eventVersion(const std::string& eventName) override;
+
+    // Implements IStatusProvider
+    std::string statusName() const override { return "sharedMemory"; }
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    std::unique_ptr<SharedSegment> segment_;
+};
+
+// Processor of a shared-memory query process: serves queries from the segment and rejects
+// writes and standing queries, which only the ingest process sees events for
+class SegmentQueryProcessor : public ReadOnlyProcessor {
+public:
+    using ReadOnlyProcessor::ReadOnlyProcessor;
+
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override;
+
+    void registerStandingQuery(
+        const std::string& name,
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp) override;
+
+    std::optional<PathAggregate> readStandingQuery(const std::string& name) override;
+
+    bool removeStandingQuery(const std::string& name) override;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+#include "interfaces.h"
+
+// Storage snapshots hold whole series so that a server can load a backfill at startup instead
+// of replaying it one write at a time. After an 8-byte magic the file is a sequence of records
+// framed like the durable log, [u32 payload length][u32 CRC-32 of payload][payload], each holding
+// up to kSnapshotChunkEvents consecutive events of one series: name, u32 count, then per event
+// u64 timestamp, u16 value count and f64 values.
+constexpr std::size_t kSnapshotChunkEvents = 65536;
+
+struct SnapshotStats {
+    std::size_t series = 0;
+    std::size_t events = 0;
+    std::size_t rejected = 0; // Events the storage refused, e.g. at a narrower precision
+};
+
+// Writes the series in their given order to a temporary file, syncs it and renames it to path,
+// so that a crash never leaves a partial snapshot behind; throws std::runtime_error on I/O errors
+void writeSnapshot(const std::string& path, const std::map<std::string, std::vector<EventData>>& series);
+
+// Saves every event of the snapshot at path into storage in batches.
+// Throws std::runtime_error if the file cannot be read or is damaged.
+SnapshotStats loadSnapshot(const std::string& path, ITelemetryStorage& storage);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "interfaces.h"
+
+// Registry of named queries whose aggregates are maintained on ingest, so reading one costs
+// a map lookup instead of a scan
+class StandingQueryRegistry {
+public:
+    using Seeder = std::function<PathAggregate(const std::string& eventName,
+                                               std::optional<uint64_t> startTimestamp,
+                                               std::optional<uint64_t> endTimestamp)>;
+    using LengthOf = std::function<double(const std::string& eventName, const std::vector<double>& values)>;
+
+    StandingQueryRegistry() = default;
+
+    // lengthOf gives an event's path length as the storage keeps it, so that queries agree with
+    // the storage's aggregates at narrower precisions; by default values are added unchanged
+    explicit StandingQueryRegistry(LengthOf lengthOf) : lengthOf_(std::move(lengthOf)) {}
+
+    // Prevent copying or moving
+    StandingQueryRegistry(const StandingQueryRegistry&) = delete;
+    StandingQueryRegistry& operator=(const StandingQueryRegistry&) = delete;
+    StandingQueryRegistry(StandingQueryRegistry&&) = delete;
+    StandingQueryRegistry& operator=(StandingQueryRegistry&&) = delete;
+
+    // Persists an event through save() and adds it to every query whose range holds it.
+    // Seeding a query over the same event is excluded meanwhile, so a seeding scan never sees an
+    // event twice; saves of other events are not held up by it.
+    bool ingest(const std::string& eventName,
+                const std::vector<double>& values,
+                uint64_t timestamp,
+                const std::function<bool()>& save);
+
+    // Defines the query called name, replacing any previous definition, and seeds its
+    // aggregate from history while saves of eventName are held off
+    void define(const std::string& name,
+                const std::string& eventName,
+                std::optional<uint64_t> startTimestamp,
+                std::optional<uint64_t> endTimestamp,
+                const Seeder& seed);
+
+    // Seeds every query's aggregate from history again, holding off saves of one event at a time
+    void reseed(const Seeder& seed);
+
+    // Aggregate of the query as of the last save it covers, or nullopt if none is called name
+    std::optional<PathAggregate> read(const std::string& name) const;
+
+    // Returns false if no query is called name
+    bool remove(const std::string& name);
+
+private:
+    struct Query {
+        std::string eventName;
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        mutable std::mutex mutex; // Readers see sum and count of the same set of events
+        PathAggregate aggregate;
+
+        bool covers(uint64_t timestamp) const {
+            return (!startTimestamp || timestamp >= *startTimestamp) &&
+                   (!endTimestamp || timestamp <= *endTimestamp);
+        }
+    };
+
+    // Queries over one event. Saves of the event hold mutex shared, seeding holds it exclusively.
+    struct EventQueries {
+        std::shared_mutex mutex;
+        std::vector<std::shared_ptr<Query>> queries;
+    };
+
+    std::shared_ptr<EventQueries> queriesOf(const std::string& eventName);
+    void unlink(const std::shared_ptr<Query>& query);
+
+    LengthOf lengthOf_;
+    // The maps are guarded by mutex_; saves of events without queries hold it shared, so that
+    // seeding a first query over an event sees every save that did not find it
+    std::map<std::string, std::shared_ptr<Query>> byName_;
+    std::map<std::string, std::shared_ptr<EventQueries>> byEvent_;
+    mutable std::shared_mutex mutex_;
+};
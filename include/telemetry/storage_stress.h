@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "interfaces.h"
+
+// Builds a fresh, empty storage for one run
+using StorageFactory = std::function<std::unique_ptr<ITelemetryStorage>()>;
+
+// Storage implementations the harness can run, by name
+using StorageRegistry = std::map<std::string, StorageFactory>;
+
+// Workload of one stress run
+struct StressScenario {
+    std::string name;
+    double writeRatio = 0.5;             // Share of operations that save an event; the rest query
+    double zipfExponent = 0.0;           // Skew of the event-name distribution, 0 for uniform
+    double lateFraction = 0.0;           // Share of saves whose timestamp lies in the past
+    uint64_t maxLatenessSeconds = 3600;  // How far back a late timestamp may lie
+    std::size_t eventNames = 64;
+    std::size_t operationsPerThread = 20000;
+};
+
+// Throughput, latency and correctness of one run at one thread count
+struct StressResult {
+    std::size_t threads = 0;
+    uint64_t operations = 0;
+    double seconds = 0.0;
+    double operationsPerSecond = 0.0;
+    double writeP50Micros = 0.0;
+    double writeP99Micros = 0.0;
+    double readP50Micros = 0.0;
+    double readP99Micros = 0.0;
+    std::size_t violations = 0;        // Disagreements with the reference model
+    std::vector<std::string> failures; // Descriptions of the first violations
+};
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(std::size_t n, double exponent) : cdf_(n) {
+        double total = 0.0;
+        for (std::size_t rank = 0; rank < n; ++rank) {
+            total += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+            cdf_[rank] = total;
+        }
+        for (auto& value : cdf_) {
+            value /= total;
+        }
+    }
+
+    template <typename Generator>
+    std::size_t operator()(Generator& generator) {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+        auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+        return it == cdf_.end() ? cdf_.size() - 1 : static_cast<std::size_t>(it - cdf_.begin());
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+// In-memory storages of this tree: plain, per precision, sharded and tiered
+StorageRegistry builtinStorages();
+
+// Uniform ingest, mixed, read-heavy, late-arriving and hot-key workloads
+std::vector<StressScenario> builtinScenarios();
+
+// Runs scenario on a fresh storage with the given number of threads. Every thread logs what it
+// saves, so the logs together form the reference model. While the run lasts, every thread must
+// see its own saves in full-range counts. Afterwards every event name is checked against the
+// model through getFilteredEvents, readEvents and aggregateEvents over whole and partial ranges.
+StressResult runStress(const StorageFactory& factory, const StressScenario& scenario,
+                       std::size_t threads, uint64_t seed = 1);
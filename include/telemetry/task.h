@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Lazily started coroutine producing a T. Awaiting it runs the body on the awaiting thread up to
+// its first suspension; the awaiting coroutine resumes on whichever thread the body completes.
+// Arguments taken by reference must outlive the task, so coroutine APIs take them by value.
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // Hands the thread straight to the awaiting coroutine instead of growing the stack
+        auto final_suspend() noexcept {
+            struct Transfer {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    return handle.promise().continuation;
+                }
+                void await_resume() noexcept {}
+            };
+            return Transfer{};
+        }
+
+        template <typename U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~Task() { reset(); }
+
+    // Prevent copying, a task is awaited once
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    // The result, or the exception the body ended with
+    T await_resume() {
+        auto& promise = handle_.promise();
+        if (promise.error) {
+            std::rethrow_exception(promise.error);
+        }
+        return std::move(*promise.value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    void reset() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Coroutine that starts at once and frees itself when it ends; nobody awaits it, so it must
+// handle its own errors. Used at the edges, e.g. by request handlers that answer when done.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+// Awaitable over an operation that reports its result through a callback, possibly on another
+// thread: start receives the callback and must arrange for it to be called exactly once.
+// Whichever of the suspension and the callback comes second resumes the coroutine, so a
+// callback that runs before start returns simply continues on the calling thread.
+template <typename T>
+class CallbackAwaiter {
+public:
+    using Start = std::function<void(std::function<void(T)>)>;
+
+    explicit CallbackAwaiter(Start start) : start_(std::move(start)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        start_([this](T result) {
+            result_.emplace(std::move(result));
+            if (arrived_.exchange(true, std::memory_order_acq_rel)) {
+                handle_.resume();
+            }
+        });
+        return !arrived_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    T await_resume() { return std::move(*result_); }
+
+private:
+    Start start_;
+    std::coroutine_handle<> handle_;
+    std::optional<T> result_;
+    std::atomic<bool> arrived_{false};
+};
+
+namespace detail {
+
+template <typename T>
+struct SyncWaitState {
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    std::optional<T> value;
+    std::exception_ptr error;
+};
+
+template <typename T>
+DetachedTask signalWhenDone(Task<T> task, SyncWaitState<T>& state) {
+    std::optional<T> value;
+    std::exception_ptr error;
+    try {
+        value.emplace(co_await task);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Notify under the lock: the waiter may destroy the state as soon as it sees done
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.value = std::move(value);
+    state.error = error;
+    state.done = true;
+    state.finished.notify_one();
+}
+
+} // namespace detail
+
+// Runs a task to completion, blocking the calling thread while it is suspended. This is how the
+// synchronous interfaces adapt coroutine implementations; it must not be called on a thread
+// the task needs in order to complete.
+template <typename T>
+T syncWait(Task<T> task) {
+    detail::SyncWaitState<T> state;
+    detail::signalWhenDone(std::move(task), state);
+
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.finished.wait(lock, [&] { return state.done; });
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+    return std::move(*state.value);
+}
@@ -4,6 +4,8 @@
 #include <vector>
 #include <optional>
 #include "interfaces.h"
+#include "rolling_mean.h"
+#include "standing_query.h"
 
 class TelemetryProcessor : public ITelemetryProcessor {
 public:
@@ -21,11 +23,71 @@ public:
                   const std::vector<double>& values, 
                   uint64_t timestamp) override;
 
+    void saveEventAsync(const std::string& eventName,
+                        const std::vector<double>& values,
+                        uint64_t timestamp,
+                        std::function<void(SaveStatus)> done) override;
+
     double calculateMeanLength(
         const std::string& eventName, 
         std::optional<uint64_t> startTimestamp = std::nullopt, 
         std::optional<uint64_t> endTimestamp = std::nullopt) override;
 
+    std::vector<PathAggregate> calculateAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<SeriesBucket> calculateSeries(
+        const std::string& eventName,
+        uint64_t bucketSeconds,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<PathAggregate> calculateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) override;
+
+    std::vector<SampledAggregate> calculateSampledAggregates(
+        const std::vector<std::string>& eventNames,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override;
+
+    std::shared_ptr<IRollingMean> subscribeRollingMean(
+        const std::string& eventName,
+        uint64_t windowSeconds) override;
+
+    void registerStandingQuery(
+        const std::string& name,
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp) override;
+
+    std::optional<PathAggregate> readStandingQuery(const std::string& name) override;
+
+    bool removeStandingQuery(const std::string& name) override;
+
+    void reseedStandingQueries() override;
+
+    // Sum of the storage's event versions, or nullopt if the storage does not track them
+    std::optional<uint64_t> eventsVersion(const std::vector<std::string>& eventNames) override;
+
 private:
+    // Saves through the standing queries and rolling windows, so both see the event
+    bool ingest(const std::string& eventName,
+                const std::vector<double>& values,
+                uint64_t timestamp,
+                const std::function<bool()>& save);
+
     ITelemetryStorage& storage_;
+    RollingMeanTracker rollingMeans_;
+    StandingQueryRegistry standingQueries_;
 };
@@ -3,14 +3,43 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <shared_mutex>
+#include <set>
+#include <functional>
+#include <random>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "interfaces.h"
+#include "compressed_block.h"
+#include "instrumented_mutex.h"
+#include "tiering.h"
+#include "value_precision.h"
 
-// Thread-safe storage for telemetry events
+// Thread-safe storage for telemetry events, organised like a log-structured merge tree.
+// Recent events of each name are appended to an uncompressed head (the memtable); once the head
+// is full it is sorted by timestamp and sealed into a compressed block, an immutable sorted run.
+// Scans merge the runs and the head one event at a time, so events come out in timestamp order
+// whatever order they arrived in. When late events make runs overlap, a background thread merges
+// the overlapping recent runs into disjoint ones.
+// Values are held at the precision the policy assigns to their event name. With tiering enabled,
+// the oldest sealed blocks of each series move to memory-mapped files once they turn cold.
 class TelemetryStorage : public ITelemetryStorage {
 public:
-    TelemetryStorage() = default;
-    ~TelemetryStorage() override = default;
+    // Events per sealed block
+    static constexpr std::size_t kBlockSize = 512;
+
+    // Width of the time segments that keep a reservoir sample for approximate queries
+    static constexpr uint64_t kSampleSegmentSeconds = 3600;
+
+    // Path lengths kept per segment
+    static constexpr std::size_t kReservoirSize = 64;
+
+    // Most recent sealed runs a compaction may rewrite, which bounds its cost for very late events
+    static constexpr std::size_t kCompactionRuns = 64;
+
+    explicit TelemetryStorage(PrecisionPolicy precision = {}, TieringPolicy tiering = {})
+        : precision_(std::move(precision)), tiering_(std::move(tiering)) {}
+    ~TelemetryStorage() override = default; // The compactor is declared last and joined first
     
     // Prevent copying or moving
     TelemetryStorage(const TelemetryStorage&) = delete;
@@ -18,17 +47,216 @@ public:
     TelemetryStorage(TelemetryStorage&&) = delete;
     TelemetryStorage& operator=(TelemetryStorage&&) = delete;
     
-    // Implements ITelemetryStorage
+    // Implements ITelemetryStorage; rejects values not representable at the event's precision
     bool saveEvent(const std::string& eventName, 
                   const std::vector<double>& values, 
                   uint64_t timestamp) override;
 
+    // Appends the whole batch under one write lock
+    std::size_t saveEvents(const std::string& eventName, const std::vector<EventData>& events) override;
+
     std::vector<EventData> getFilteredEvents(
         const std::string& eventName, 
         std::optional<uint64_t> startTimestamp = std::nullopt, 
         std::optional<uint64_t> endTimestamp = std::nullopt) override;
 
+    PathAggregate aggregateEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<SeriesBucket> aggregateSeries(
+        const std::string& eventName,
+        uint64_t bucketWidth,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    std::vector<PathAggregate> aggregateWindows(
+        const std::string& eventName,
+        const std::vector<TimeWindow>& windows) override;
+
+    // Events come in timestamp order. The cursor block is the timestamp to resume at and the
+    // offset counts events of that timestamp already read; events with equal timestamps keep
+    // their arrival order through sealing and compaction, so positions survive both.
+    // The lock is held for one chunk.
+    void readEvents(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp,
+        std::optional<uint64_t> endTimestamp,
+        EventCursor& cursor,
+        std::size_t maxEvents,
+        std::vector<EventData>& out) override;
+
+    // Segments inside the range contribute their exact totals; segments the range cuts are
+    // estimated from their reservoir, so the cost grows with the segments spanned, not the events
+    SampledAggregate sampleAggregate(
+        const std::string& eventName,
+        std::optional<uint64_t> startTimestamp = std::nullopt,
+        std::optional<uint64_t> endTimestamp = std::nullopt) override;
+
+    // Storage-wide save count as of the newest event of the name, or as of the last clear()
+    // for names without events. Compactions and tiering leave it unchanged.
+    std::optional<uint64_t> eventVersion(const std::string& eventName) override;
+
+    // Length rounded to the precision the policy assigns to the name
+    double storedLength(const std::string& eventName, const std::vector<double>& values) override {
+        return ::storedLength(values, precision_.precisionOf(eventName));
+    }
+
+    // Copy of every series that is read without the lock; defined below the class
+    class Frozen;
+
+    // Copies every series under the shared lock without decoding it, which costs a copy of the
+    // compressed blocks rather than a decode of every event
+    Frozen freeze();
+
+    // Removes all events
+    void clear();
+
+    // Sizes of the in-memory and memory-mapped tiers
+    TierStats tierStats();
+
+    // Blocks until every scheduled compaction and spill to the cold tier has finished
+    void waitForCompactions();
+
+    // Compactions run so far
+    std::size_t compactions();
+
+private:
+    // Reads one sorted run, a sealed block or the head, in timestamp order
+    class RunReader;
+
+    // Unsealed events in flat columns; only the value column of the series' precision is used
+    struct Head {
+        std::vector<uint64_t> timestamps;
+        std::vector<uint32_t> offsets{0}; // Values of event i are [offsets[i], offsets[i + 1])
+        std::vector<double> doubles;
+        std::vector<float> floats;
+        std::vector<uint32_t> milliseconds;
+        uint64_t minTimestamp = UINT64_MAX;
+        uint64_t maxTimestamp = 0;
+    };
+
+    // One path length drawn into a reservoir
+    struct Sample {
+        uint64_t timestamp;
+        double length;
+    };
+
+    // Exact totals and a uniform reservoir sample of the events in one time segment
+    struct SampleSegment {
+        PathAggregate total;
+        uint64_t minTimestamp = UINT64_MAX;
+        uint64_t maxTimestamp = 0;
+        std::vector<Sample> reservoir;
+    };
+
+    // All events of one name, oldest first
+    struct EventSeries {
+        ValuePrecision precision;
+        std::vector<CompressedBlock> sealed;
+        std::size_t coldBlocks = 0; // Leading sealed blocks relocated to cold segments
+        uint64_t rewrites = 0; // Bumped whenever a compaction replaces sealed blocks
+        uint64_t newestTimestamp = 0;
+        uint64_t sealedMaxTimestamp = 0; // Newest timestamp in any sealed block
+        uint64_t version = 0; // lastVersion_ as of the newest event
+        Head head;
+        std::map<uint64_t, SampleSegment> segments; // By segment start
+    };
+
+    // Acquire mutex_ on behalf of a call site, timing the wait in traced requests
+    lockstats::InstrumentedSharedMutex::SharedLock readLock(lockstats::LockSite& site);
+    lockstats::InstrumentedSharedMutex::ExclusiveLock writeLock(lockstats::LockSite& site);
+
+    // Series of eventName, created with the precision the policy assigns to it
+    EventSeries& seriesOf(const std::string& eventName, ValuePrecision precision);
+
+    // Appends an event to the head of series, sealing the head once it is full
+    void append(const std::string& eventName, EventSeries& series,
+                const std::vector<double>& values, uint64_t timestamp);
+
+    // Seals the head of series into a compressed block sorted by timestamp
+    static void seal(EventSeries& series);
+
+    // Queues eventName for the compactor, starting it on first use
+    void scheduleCompaction(const std::string& eventName);
+
+    // Queues eventName for a spill to the cold tier on the compactor thread
+    void scheduleSpill(const std::string& eventName);
+
+    // Compactor thread: merges the runs of queued names and spills their cold blocks until stopped
+    void runCompactions(std::stop_token stop);
+
+    // Merges the overlapping recent runs of eventName into disjoint ones. The runs are copied
+    // under the read lock, merged without the lock and installed under the write lock unless
+    // the series changed shape in the meantime.
+    void compact(const std::string& eventName);
+
+    // End of the next segment's worth of cold blocks after the cold prefix of series, or the end
+    // of that prefix while there are not that many
+    std::size_t coldRunEnd(const EventSeries& series) const;
+
+    // Moves the cold blocks of eventName to disk one segment at a time. Each run is copied under
+    // the read lock, written to its segment file without the lock and relocated under the write
+    // lock unless the series changed shape in the meantime.
+    void spill(const std::string& eventName);
+
+    // Sums the values of head events [first, last) in a wide accumulator
+    static PathAggregate sumHead(const EventSeries& series, std::size_t first, std::size_t last);
+
+    // Calls visitor for every event of series in the optional time range, in timestamp order;
+    // events with equal timestamps come in arrival order. A visitor returning bool stops the
+    // scan by returning false.
+    template <typename Visitor>
+    static void scan(const EventSeries& series,
+                     std::optional<uint64_t> startTimestamp,
+                     std::optional<uint64_t> endTimestamp,
+                     Visitor&& visitor);
+
+    // Widens head event i of series back to doubles into data, reusing its value storage
+    static void headEvent(const EventSeries& series, std::size_t i, EventData& data);
+
+    // Calls visitor for every head event of series in the optional time range
+    template <typename Visitor>
+    static void scanHead(const EventSeries& series,
+                         std::optional<uint64_t> startTimestamp,
+                         std::optional<uint64_t> endTimestamp,
+                         Visitor&& visitor);
+
+    // Adds an event to the reservoir of its segment (Algorithm R)
+    void sample(EventSeries& series, uint64_t timestamp, double length);
+
+    const PrecisionPolicy precision_;
+    const TieringPolicy tiering_;
+    std::size_t spillFailures_ = 0; // Guarded by the write lock
+    std::map<std::string, EventSeries> events_;
+    std::minstd_rand sampler_; // Reservoir replacement choices, guarded by the write lock
+    uint64_t generation_ = 0; // Bumped by clear(), guarded by the write lock
+    uint64_t lastVersion_ = 0; // Bumped by every save and clear(), guarded by the write lock
+    uint64_t clearedVersion_ = 0; // lastVersion_ as of the last clear(), guarded by the write lock
+    lockstats::InstrumentedSharedMutex mutex_; // Reader-writer lock, profiled with TELEMETRY_LOCK_STATS
+
+    // Names with overlapping runs or cold blocks to spill; taken after mutex_ when both are held
+    std::mutex compactionMutex_;
+    std::condition_variable_any compactionWake_;
+    std::condition_variable compactionIdle_;
+    std::set<std::string> compactionQueue_;
+    std::set<std::string> spillQueue_;
+    bool compacting_ = false;
+    std::size_t compactions_ = 0;
+    std::jthread compactor_; // Last, so that it is stopped before the state it uses goes away
+};
+
+// Sealed blocks are copied compressed, or shared when they live in cold segments, and heads as
+// they are; events are decoded only when visited
+class TelemetryStorage::Frozen {
+public:
+    // Visits every event, in timestamp order per name, until visitor returns false.
+    // Returns whether every event was visited.
+    bool forEachEvent(const std::function<bool(const std::string&, const EventData&)>& visitor) const;
+
 private:
-    std::map<std::string, std::vector<EventData>> events_;
-    std::shared_mutex mutex_; // C++17 shared mutex for reader-writer lock
+    friend class TelemetryStorage;
+
+    std::vector<std::pair<std::string, EventSeries>> series_;
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include "compressed_block.h"
+
+// When sealed blocks leave RAM for memory-mapped segment files
+struct TieringPolicy {
+    std::string directory;          // Empty keeps every block in memory
+    uint64_t hotSeconds = 86400;    // Blocks ending this long before their series' newest event are cold
+    std::size_t segmentBlocks = 16; // Cold blocks written together as one segment file
+
+    bool enabled() const { return !directory.empty(); }
+};
+
+// Blocks and compressed bytes held in each tier
+struct TierStats {
+    std::size_t hotBlocks = 0;
+    std::size_t coldBlocks = 0;
+    std::size_t hotBytes = 0;
+    std::size_t coldBytes = 0;
+    std::size_t spillFailures = 0;
+};
+
+// Reports tier sizes under "tiering" in GET /status
+class TierStatusProvider : public IStatusProvider {
+public:
+    explicit TierStatusProvider(std::function<TierStats()> stats) : stats_(std::move(stats)) {}
+
+    std::string statusName() const override { return "tiering"; }
+
+    std::map<std::string, double> statusFields() const override {
+        auto stats = stats_();
+        return {{"hotBlocks", static_cast<double>(stats.hotBlocks)},
+                {"coldBlocks", static_cast<double>(stats.coldBlocks)},
+                {"hotBytes", static_cast<double>(stats.hotBytes)},
+                {"coldBytes", static_cast<double>(stats.coldBytes)},
+                {"spillFailures", static_cast<double>(stats.spillFailures)}};
+    }
+
+private:
+    std::function<TierStats()> stats_;
+};
+
+// Segment file holding the bit streams of a run of blocks back to back, mapped read-only. The
+// file is unlinked as soon as it is mapped: it only extends memory and is reclaimed when the last
+// block relocated into it goes away, even after a crash. Writing one does disk I/O, so storage
+// does it without holding its lock and only relocates the blocks under it.
+class ColdSegment {
+public:
+    // Writes the streams of blocks into a new segment file in directory and maps it. Throws
+    // std::runtime_error if the file cannot be written or mapped.
+    ColdSegment(const std::string& directory, std::span<const CompressedBlock> blocks);
+
+    // Moves blocks holding the same streams as those written into the mapping. Their time ranges
+    // and totals stay in memory as the segment's zone map, so scans only page in the streams
+    // they decode.
+    void relocate(std::span<CompressedBlock> blocks) const;
+
+private:
+    std::shared_ptr<const void> mapping_; // Null when the blocks had no streams
+    const uint64_t* words_ = nullptr;
+};
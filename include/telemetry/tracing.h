@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Sampled per-request phase tracing. A sampled request records its spans into a ring buffer
+// of the thread that runs it; the buffers can be written out as Chrome trace-event JSON and
+// opened in chrome://tracing or Perfetto. Spans of unsampled requests cost one thread-local read.
+namespace tracing {
+
+namespace detail {
+
+inline thread_local bool threadSampled = false;
+
+uint64_t nowNs();
+void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+} // namespace detail
+
+// Traces one request in every sampleEvery, keeping the newest spansPerThread spans of each
+// thread; 0 disables tracing. Spans recorded so far are discarded.
+void configure(uint32_t sampleEvery, std::size_t spansPerThread = 16384);
+
+bool enabled();
+
+// Root span of a request; decides whether the request is sampled
+class RequestScope {
+public:
+    explicit RequestScope(const char* name);
+    ~RequestScope();
+
+    // Prevent copying or moving
+    RequestScope(const RequestScope&) = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+    RequestScope(RequestScope&&) = delete;
+    RequestScope& operator=(RequestScope&&) = delete;
+
+private:
+    const char* name_ = nullptr; // Set only for sampled requests
+    uint64_t startNs_ = 0;
+};
+
+// Timed phase of the current request. name must be a string literal.
+class Span {
+public:
+    explicit Span(const char* name) noexcept {
+        if (detail::threadSampled) {
+            name_ = name;
+            startNs_ = detail::nowNs();
+        }
+    }
+
+    ~Span() {
+        if (name_ != nullptr) {
+            detail::record(name_, startNs_, detail::nowNs());
+        }
+    }
+
+    // Prevent copying or moving
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+    Span(Span&&) = delete;
+    Span& operator=(Span&&) = delete;
+
+private:
+    const char* name_ = nullptr;
+    uint64_t startNs_ = 0;
+};
+
+// Writes the recorded spans of all threads to path as Chrome trace-event JSON and returns
+// the number of spans written. Throws std::runtime_error if the file cannot be written.
+std::size_t writeChromeTrace(const std::string& path);
+
+} // namespace tracing
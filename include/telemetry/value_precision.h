@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "interfaces.h"
+
+// How stored path values are represented in memory
+enum class ValuePrecision {
+    Double,        // 8 bytes, any value
+    Float32,       // 4 bytes, finite values within float range, ~7 significant digits
+    Milliseconds,  // 4 bytes, whole milliseconds from 0 to about 49.7 days
+};
+
+// Parses "double", "float32" or "ms"; throws std::invalid_argument otherwise
+ValuePrecision parseValuePrecision(const std::string& name);
+
+// Whether value (in seconds) can be stored at the given precision
+bool isRepresentable(double value, ValuePrecision precision);
+
+// Sum of values after rounding each to the given precision, in the order the storage adds them
+double storedLength(const std::vector<double>& values, ValuePrecision precision);
+
+// Storage precision of every event name: a server-wide default with per-event overrides
+struct PrecisionPolicy {
+    ValuePrecision defaultPrecision = ValuePrecision::Double;
+    std::map<std::string, ValuePrecision> perEvent;
+
+    ValuePrecision precisionOf(const std::string& eventName) const {
+        auto it = perEvent.find(eventName);
+        return it != perEvent.end() ? it->second : defaultPrecision;
+    }
+};
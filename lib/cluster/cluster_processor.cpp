@@ -0,0 +1,306 @@
+#include "telemetry/cluster_processor.h"
+#include "telemetry/query_context.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Splits "host:port" into its parts
+std::pair<std::string, int> parseNode(const std::string& node) {
+    auto colon = node.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == node.size()) {
+        throw std::invalid_argument("Cluster node must be given as host:port: " + node);
+    }
+    return {node.substr(0, colon), std::stoi(node.substr(colon + 1))};
+}
+
+json timeRangeBody(std::optional<uint64_t> startTimestamp, std::optional<uint64_t> endTimestamp) {
+    json body = json::object();
+    if (startTimestamp) {
+        body["startTimestamp"] = *startTimestamp;
+    }
+    if (endTimestamp) {
+        body["endTimestamp"] = *endTimestamp;
+    }
+
+    // Nodes get what is left of the caller's deadline
+    if (auto* context = QueryContext::current()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            context->deadline() - QueryContext::Clock::now()).count();
+        body["timeoutMs"] = std::max<int64_t>(1, remaining);
+        body["allowPartial"] = context->allowPartial();
+    }
+    return body;
+}
+
+// A node that ran out of time fails the whole query
+void throwIfTimedOut(const HttpClientResponse& response) {
+    if (response.statusCode == 504) {
+        throw QueryTimeoutError("Query exceeded its deadline on a cluster node");
+    }
+}
+
+// A node's partial answer makes the merged result partial
+void propagatePartial(const json& result, QueryContext* context = QueryContext::current()) {
+    if (context != nullptr && result.value("partial", false)) {
+        context->markPartial();
+    }
+}
+
+// Entries of a node's answer to GET /aggregates, in the order of the events asked for
+json partialAggregates(const HttpClientResponse& response, QueryContext* context) {
+    throwIfTimedOut(response);
+    if (response.statusCode != 200) {
+        throw BackendUnavailableError("Aggregate query failed with status " +
+                                      std::to_string(response.statusCode));
+    }
+
+    try {
+        auto result = json::parse(response.body);
+        propagatePartial(result, context);
+        return result.at("aggregates");
+    } catch (const json::exception& e) {
+        throw BackendUnavailableError(std::string("Malformed aggregate response: ") + e.what());
+    }
+}
+
+// Asks every owning node once for GET /aggregates over its events, in parallel, and hands each
+// returned entry to collect together with the entry's index in eventNames
+void scatterAggregates(const ConsistentHashRing& ring,
+                       const std::vector<std::unique_ptr<HttpClient>>& clients,
+                       const std::vector<std::string>& eventNames,
+                       json query,
+                       const std::function<void(std::size_t, const json&)>& collect) {
+    // Group the events by owning node so that every node is asked once
+    std::map<std::size_t, std::vector<std::size_t>> eventsByNode;
+    for (std::size_t i = 0; i < eventNames.size(); ++i) {
+        eventsByNode[ring.ownerOf(eventNames[i])].push_back(i);
+    }
+
+    // Scatter the partial queries in parallel
+    std::vector<std::pair<const std::vector<std::size_t>*, std::future<HttpClientResponse>>> pending;
+    for (const auto& [node, indices] : eventsByNode) {
+        auto body = query;
+        body["events"] = json::array();
+        for (auto index : indices) {
+            body["events"].push_back(eventNames[index]);
+        }
+        pending.emplace_back(&indices, std::async(std::launch::async,
+            [client = clients[node].get(), payload = body.dump()] {
+                return client->request("GET", "/aggregates", payload);
+            }));
+    }
+
+    // Gather the partial results back into request order
+    for (auto& [indices, future] : pending) {
+        auto partials = partialAggregates(future.get(), QueryContext::current());
+        try {
+            for (std::size_t i = 0; i < indices->size(); ++i) {
+                collect((*indices)[i], partials.at(i));
+            }
+        } catch (const json::exception& e) {
+            throw BackendUnavailableError(std::string("Malformed aggregate response: ") + e.what());
+        }
+    }
+}
+
+} // namespace
+
+ClusterProcessor::ClusterProcessor(const std::vector<std::string>& nodes, int virtualNodes)
+    : ring_(nodes, virtualNodes) {
+    for (const auto& node : ring_.members()) {
+        auto [host, port] = parseNode(node);
+        clients_.push_back(std::make_unique<HttpClient>(host, port));
+    }
+}
+
+bool ClusterProcessor::saveEvent(const std::string& eventName,
+                                 const std::vector<double>& values,
+                                 uint64_t timestamp) {
+    return syncWait(saveEventTask(eventName, values, timestamp)) == SaveStatus::Saved;
+}
+
+Task<SaveStatus> ClusterProcessor::saveEventTask(std::string eventName,
+                                                 std::vector<double> values,
+                                                 uint64_t timestamp) {
+    // Reject invalid paths here instead of paying a round trip for them
+    if (values.size() != 10) {
+        co_return SaveStatus::Rejected;
+    }
+
+    auto& owner = *clients_[ring_.ownerOf(eventName)];
+    auto body = json{{"values", values}, {"date", timestamp}}.dump();
+    auto response = co_await owner.requestTask("POST", "/paths/" + eventName, std::move(body));
+    if (response.statusCode >= 500) {
+        throw BackendUnavailableError("Node " + owner.host() + ":" + std::to_string(owner.port()) +
+                                      " failed with status " + std::to_string(response.statusCode));
+    }
+    co_return response.statusCode == 200 ? SaveStatus::Saved : SaveStatus::Rejected;
+}
+
+double ClusterProcessor::calculateMeanLength(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+    return syncWait(calculateMeanLengthTask(eventName, startTimestamp, endTimestamp));
+}
+
+Task<double> ClusterProcessor::calculateMeanLengthTask(
+    std::string eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    // Taken before the first suspension, after which the task runs on the client's thread
+    auto* context = QueryContext::current();
+    auto query = timeRangeBody(startTimestamp, endTimestamp);
+    query["events"] = json::array({eventName});
+
+    auto& owner = *clients_[ring_.ownerOf(eventName)];
+    auto response = co_await owner.requestTask("GET", "/aggregates", query.dump());
+    PathAggregate aggregate;
+    try {
+        auto partial = partialAggregates(response, context).at(0);
+        aggregate = PathAggregate{partial.at("sum").get<double>(), partial.at("count").get<uint64_t>()};
+    } catch (const json::exception& e) {
+        throw BackendUnavailableError(std::string("Malformed aggregate response: ") + e.what());
+    }
+    co_return aggregate.count == 0 ? 0.0 : aggregate.sum / aggregate.count;
+}
+
+std::vector<PathAggregate> ClusterProcessor::calculateAggregates(
+    const std::vector<std::string>& eventNames,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    std::vector<PathAggregate> aggregates(eventNames.size());
+    scatterAggregates(ring_, clients_, eventNames, timeRangeBody(startTimestamp, endTimestamp),
+        [&](std::size_t index, const json& partial) {
+            aggregates[index] = PathAggregate{partial.at("sum").get<double>(), partial.at("count").get<uint64_t>()};
+        });
+    return aggregates;
+}
+
+std::vector<SampledAggregate> ClusterProcessor::calculateSampledAggregates(
+    const std::vector<std::string>& eventNames,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    auto query = timeRangeBody(startTimestamp, endTimestamp);
+    query["approximate"] = true;
+
+    // Nodes return their raw estimates and variance terms, which merge like exact sums
+    std::vector<SampledAggregate> aggregates(eventNames.size());
+    scatterAggregates(ring_, clients_, eventNames, std::move(query),
+        [&](std::size_t index, const json& partial) {
+            auto& aggregate = aggregates[index];
+            aggregate.sum = partial.at("sum").get<double>();
+            aggregate.count = partial.at("count").get<double>();
+            aggregate.sampleSize = partial.at("sampleSize").get<uint64_t>();
+            aggregate.variance = partial.at("variance").get<std::array<double, 3>>();
+        });
+    return aggregates;
+}
+
+std::vector<SeriesBucket> ClusterProcessor::calculateSeries(
+    const std::string& eventName,
+    uint64_t bucketSeconds,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    // A series belongs to a single event and therefore to a single node
+    auto body = timeRangeBody(startTimestamp, endTimestamp);
+    body["resultUnit"] = "seconds";
+    body["bucketSeconds"] = bucketSeconds;
+
+    auto& owner = *clients_[ring_.ownerOf(eventName)];
+    auto response = owner.request("GET", "/paths/" + eventName + "/series", body.dump());
+    throwIfTimedOut(response);
+    if (response.statusCode != 200) {
+        throw BackendUnavailableError("Series query failed with status " +
+                                      std::to_string(response.statusCode));
+    }
+
+    try {
+        auto result = json::parse(response.body);
+        propagatePartial(result);
+        std::vector<SeriesBucket> buckets;
+        for (const auto& bucket : result.at("buckets")) {
+            auto count = bucket.at("count").get<uint64_t>();
+            buckets.push_back(SeriesBucket{bucket.at("bucketStart").get<uint64_t>(),
+                                           PathAggregate{bucket.at("mean").get<double>() * count, count}});
+        }
+        return buckets;
+    } catch (const json::exception& e) {
+        throw BackendUnavailableError(std::string("Malformed series response: ") + e.what());
+    }
+}
+
+std::vector<PathAggregate> ClusterProcessor::calculateWindows(
+    const std::string& eventName,
+    const std::vector<TimeWindow>& windows) {
+
+    // All windows of one event are answered by its node in one sweep
+    auto body = timeRangeBody(std::nullopt, std::nullopt);
+    body["resultUnit"] = "seconds";
+    body["windows"] = json::array();
+    for (const auto& window : windows) {
+        body["windows"].push_back(json{{"startTimestamp", window.start}, {"endTimestamp", window.end}});
+    }
+
+    auto& owner = *clients_[ring_.ownerOf(eventName)];
+    auto response = owner.request("GET", "/paths/" + eventName + "/windows", body.dump());
+    throwIfTimedOut(response);
+    if (response.statusCode != 200) {
+        throw BackendUnavailableError("Window query failed with status " +
+                                      std::to_string(response.statusCode));
+    }
+
+    try {
+        auto result = json::parse(response.body);
+        propagatePartial(result);
+        std::vector<PathAggregate> aggregates;
+        for (const auto& window : result.at("windows")) {
+            auto count = window.at("count").get<uint64_t>();
+            aggregates.push_back(PathAggregate{window.at("mean").get<double>() * count, count});
+        }
+        if (aggregates.size() != windows.size()) {
+            throw BackendUnavailableError("Window query answered " + std::to_string(aggregates.size()) +
+                                          " of " + std::to_string(windows.size()) + " windows");
+        }
+        return aggregates;
+    } catch (const json::exception& e) {
+        throw BackendUnavailableError(std::string("Malformed window response: ") + e.what());
+    }
+}
+
+void ClusterProcessor::readEvents(const std::string&, std::optional<uint64_t>, std::optional<uint64_t>,
+                                  EventCursor&, std::size_t, std::vector<EventData>&) {
+    throw UnsupportedOperationError("Raw events are exported by data nodes, not by the cluster router");
+}
+
+std::shared_ptr<IRollingMean> ClusterProcessor::subscribeRollingMean(const std::string&, uint64_t) {
+    throw UnsupportedOperationError("Rolling means are served by data nodes, not by the cluster router");
+}
+
+void ClusterProcessor::registerStandingQuery(const std::string&, const std::string&,
+                                             std::optional<uint64_t>, std::optional<uint64_t>) {
+    throw UnsupportedOperationError("Standing queries are served by data nodes, not by the cluster router");
+}
+
+std::optional<PathAggregate> ClusterProcessor::readStandingQuery(const std::string&) {
+    throw UnsupportedOperationError("Standing queries are served by data nodes, not by the cluster router");
+}
+
+bool ClusterProcessor::removeStandingQuery(const std::string&) {
+    throw UnsupportedOperationError("Standing queries are served by data nodes, not by the cluster router");
+}
+
+std::optional<uint64_t> ClusterProcessor::eventsVersion(const std::vector<std::string>&) {
+    return std::nullopt;
+}
@@ -0,0 +1,44 @@
+#include "telemetry/hash_ring.h"
+#include <algorithm>
+#include <stdexcept>
+
+ConsistentHashRing::ConsistentHashRing(std::vector<std::string> members, int virtualNodes)
+    : members_(std::move(members)) {
+    if (members_.empty()) {
+        throw std::invalid_argument("Hash ring needs at least one member");
+    }
+
+    ring_.reserve(members_.size() * virtualNodes);
+    for (std::size_t member = 0; member < members_.size(); ++member) {
+        for (int replica = 0; replica < virtualNodes; ++replica) {
+            ring_.emplace_back(hash(members_[member] + "#" + std::to_string(replica)), member);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+std::size_t ConsistentHashRing::ownerOf(std::string_view key) const {
+    // First point clockwise from the key, wrapping around the end of the ring
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), hash(key),
+        [](const auto& point, uint64_t value) { return point.first < value; });
+    if (it == ring_.end()) {
+        it = ring_.begin();
+    }
+    return it->second;
+}
+
+uint64_t ConsistentHashRing::hash(std::string_view key) {
+    uint64_t value = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        value ^= c;
+        value *= 1099511628211ULL;
+    }
+
+    // FNV alone clusters similar short keys; finish with the MurmurHash3 mixer
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
@@ -0,0 +1,668 @@
+#include "telemetry/http_client.h"
+#include "telemetry/interfaces.h"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <strings.h>
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+bool sendAll(int fd, const std::string& data) {
+    const char* cursor = data.data();
+    std::size_t remaining = data.size();
+    while (remaining > 0) {
+        ssize_t sent = ::send(fd, cursor, remaining, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        cursor += sent;
+        remaining -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+} // namespace
+
+// Buffered reader over a blocking socket, or over the bytes of a response received so far
+class HttpClient::Reader {
+public:
+    explicit Reader(int fd) : fd_(fd) {}
+
+    // closed tells whether the peer has finished sending
+    Reader(std::string received, bool closed) : buffer_(std::move(received)), closed_(closed) {}
+
+    // Reads one CRLF-terminated line, without the terminator
+    bool readLine(std::string& line) {
+        for (;;) {
+            auto end = buffer_.find("\r\n", position_);
+            if (end != std::string::npos) {
+                line.assign(buffer_, position_, end - position_);
+                position_ = end + 2;
+                return true;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    bool readExact(std::size_t size, std::string& out) {
+        while (buffer_.size() - position_ < size) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out.append(buffer_, position_, size);
+        position_ += size;
+        return true;
+    }
+
+    // False if the end of the stream has not been received yet
+    bool readToEnd(std::string& out) {
+        while (fill()) {
+        }
+        out.append(buffer_, position_, std::string::npos);
+        position_ = buffer_.size();
+        return fd_ >= 0 || closed_;
+    }
+
+    bool receivedAny() const { return received_; }
+
+private:
+    bool fill() {
+        if (fd_ < 0) {
+            return false;
+        }
+        char chunk[4096];
+        for (;;) {
+            ssize_t size = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0) {
+                return false;
+            }
+            received_ = true;
+            buffer_.erase(0, position_);
+            position_ = 0;
+            buffer_.append(chunk, static_cast<std::size_t>(size));
+            return true;
+        }
+    }
+
+    int fd_ = -1;
+    std::string buffer_;
+    std::size_t position_ = 0;
+    bool received_ = false;
+    bool closed_ = false;
+};
+
+// Runs the exchanges of requestTask on non-blocking sockets from one epoll thread. Exchanges are
+// keyed by their socket; their completions run on this thread.
+class HttpClient::Reactor {
+public:
+    using Completion = std::function<void(std::optional<HttpClientResponse>)>;
+
+    Reactor(std::string host, int port, std::chrono::milliseconds timeout);
+    ~Reactor();
+
+    // Prevent copying or moving
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+    Reactor(Reactor&&) = delete;
+    Reactor& operator=(Reactor&&) = delete;
+
+    // Queues a formatted request; done receives the response, or nothing on failure
+    void submit(std::string message, Completion done);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Exchange {
+        std::string message;
+        Completion done;
+        Clock::time_point deadline;
+        int fd = -1;
+        bool pooled = false;     // Runs on a kept-alive connection, which the peer may have closed
+        bool connecting = false;
+        bool retried = false;
+        std::size_t sent = 0;
+        std::string received;
+    };
+
+    void run();
+
+    // Gives the exchange a connection and waits until it can send
+    void begin(std::unique_ptr<Exchange> exchange, bool fresh);
+
+    // Sends or receives what the socket allows and completes the exchange once it has a response
+    void advance(int fd);
+
+    // Ends the exchange on fd, keeping the connection for reuse if keepAlive is set
+    void finish(int fd, std::optional<HttpClientResponse> response, bool keepAlive);
+
+    // Retries an exchange that failed on a stale kept-alive connection, otherwise fails it
+    void fail(int fd);
+
+    // Unregisters fd and takes its exchange
+    std::unique_ptr<Exchange> detach(int fd);
+
+    int connectNonBlocking(bool& connecting);
+
+    const std::string host_;
+    const int port_;
+    const std::chrono::milliseconds timeout_;
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Exchange>> submitted_; // Guarded by mutex_
+    bool stopping_ = false;                            // Guarded by mutex_
+
+    // Reactor thread only
+    std::unordered_map<int, std::unique_ptr<Exchange>> active_;
+    std::set<std::pair<Clock::time_point, int>> deadlines_;
+    std::vector<int> idle_;
+    std::optional<sockaddr_storage> address_;
+    socklen_t addressLength_ = 0;
+
+    std::thread thread_;
+};
+
+HttpClient::Reactor::Reactor(std::string host, int port, std::chrono::milliseconds timeout)
+    : host_(std::move(host)), port_(port), timeout_(timeout) {
+    epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0) {
+        if (epollFd_ >= 0) {
+            ::close(epollFd_);
+        }
+        if (wakeFd_ >= 0) {
+            ::close(wakeFd_);
+        }
+        throw BackendUnavailableError(std::string("Cannot create client event loop: ") + std::strerror(errno));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd_;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event);
+    thread_ = std::thread([this] { run(); });
+}
+
+HttpClient::Reactor::~Reactor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wakeFd_, &one, sizeof(one));
+    thread_.join();
+    ::close(wakeFd_);
+    ::close(epollFd_);
+}
+
+void HttpClient::Reactor::submit(std::string message, Completion done) {
+    auto exchange = std::make_unique<Exchange>();
+    exchange->message = std::move(message);
+    exchange->done = std::move(done);
+    exchange->deadline = Clock::now() + timeout_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_) {
+            submitted_.push_back(std::move(exchange));
+        }
+    }
+    if (exchange) {
+        exchange->done(std::nullopt);
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wakeFd_, &one, sizeof(one));
+}
+
+void HttpClient::Reactor::run() {
+    epoll_event events[64];
+    bool stopping = false;
+    while (!stopping) {
+        int timeoutMs = -1;
+        if (!deadlines_.empty()) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(deadlines_.begin()->first - Clock::now());
+            timeoutMs = static_cast<int>(std::max<int64_t>(0, wait.count()));
+        }
+        int ready = ::epoll_wait(epollFd_, events, 64, timeoutMs);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd != wakeFd_) {
+                advance(events[i].data.fd);
+                continue;
+            }
+
+            uint64_t count = 0;
+            [[maybe_unused]] auto drained = ::read(wakeFd_, &count, sizeof(count));
+            std::vector<std::unique_ptr<Exchange>> submitted;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                submitted_.swap(submitted);
+                stopping = stopping_;
+            }
+            for (auto& exchange : submitted) {
+                if (stopping) {
+                    exchange->done(std::nullopt);
+                } else {
+                    begin(std::move(exchange), false);
+                }
+            }
+        }
+
+        // Exchanges past their deadline fail without a retry
+        const auto now = Clock::now();
+        while (!deadlines_.empty() && deadlines_.begin()->first <= now) {
+            finish(deadlines_.begin()->second, std::nullopt, false);
+        }
+    }
+
+    while (!active_.empty()) {
+        finish(active_.begin()->first, std::nullopt, false);
+    }
+    for (int fd : idle_) {
+        ::close(fd);
+    }
+}
+
+void HttpClient::Reactor::begin(std::unique_ptr<Exchange> exchange, bool fresh) {
+    int fd = -1;
+    bool connecting = false;
+    const bool pooled = !fresh && !idle_.empty();
+    if (pooled) {
+        fd = idle_.back();
+        idle_.pop_back();
+    } else {
+        fd = connectNonBlocking(connecting);
+    }
+    if (fd < 0) {
+        exchange->done(std::nullopt);
+        return;
+    }
+
+    exchange->fd = fd;
+    exchange->pooled = pooled;
+    exchange->connecting = connecting;
+    exchange->sent = 0;
+    exchange->received.clear();
+
+    epoll_event event{};
+    event.events = EPOLLOUT;
+    event.data.fd = fd;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+    deadlines_.emplace(exchange->deadline, fd);
+    active_.emplace(fd, std::move(exchange));
+}
+
+void HttpClient::Reactor::advance(int fd) {
+    auto it = active_.find(fd);
+    if (it == active_.end()) {
+        return;
+    }
+    auto& exchange = *it->second;
+
+    if (exchange.connecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            fail(fd);
+            return;
+        }
+        exchange.connecting = false;
+    }
+
+    // Send the request, then wait for the response
+    if (exchange.sent < exchange.message.size()) {
+        while (exchange.sent < exchange.message.size()) {
+            ssize_t sent = ::send(fd, exchange.message.data() + exchange.sent,
+                                  exchange.message.size() - exchange.sent, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                fail(fd);
+                return;
+            }
+            exchange.sent += static_cast<std::size_t>(sent);
+        }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &event);
+        return;
+    }
+
+    bool closed = false;
+    char chunk[4096];
+    for (;;) {
+        ssize_t size = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (size > 0) {
+            exchange.received.append(chunk, static_cast<std::size_t>(size));
+            continue;
+        }
+        if (size == 0) {
+            closed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        fail(fd);
+        return;
+    }
+
+    // Responses are small, so the received bytes are parsed from the start each time
+    HttpClientResponse response{0, {}};
+    bool keepAlive = true;
+    bool complete = false;
+    try {
+        Reader reader(exchange.received, closed);
+        complete = readResponse(reader, response, keepAlive);
+    } catch (const std::logic_error&) {
+        // Malformed numbers in the framing
+        fail(fd);
+        return;
+    }
+    if (complete) {
+        finish(fd, std::move(response), keepAlive && !closed);
+    } else if (closed) {
+        fail(fd);
+    }
+}
+
+std::unique_ptr<HttpClient::Reactor::Exchange> HttpClient::Reactor::detach(int fd) {
+    auto it = active_.find(fd);
+    auto exchange = std::move(it->second);
+    active_.erase(it);
+    deadlines_.erase({exchange->deadline, fd});
+    ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    return exchange;
+}
+
+void HttpClient::Reactor::finish(int fd, std::optional<HttpClientResponse> response, bool keepAlive) {
+    auto exchange = detach(fd);
+    if (keepAlive) {
+        idle_.push_back(fd);
+    } else {
+        ::close(fd);
+    }
+    exchange->done(std::move(response));
+}
+
+void HttpClient::Reactor::fail(int fd) {
+    auto exchange = detach(fd);
+    ::close(fd);
+
+    // As in request(), a kept-alive connection closed by the peer processed nothing
+    if (exchange->pooled && exchange->received.empty() && !exchange->retried &&
+        Clock::now() < exchange->deadline) {
+        exchange->retried = true;
+        begin(std::move(exchange), true);
+        return;
+    }
+    exchange->done(std::nullopt);
+}
+
+int HttpClient::Reactor::connectNonBlocking(bool& connecting) {
+    // The address is resolved once, on this thread
+    if (!address_) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (::getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &addresses) != 0 ||
+            addresses == nullptr) {
+            return -1;
+        }
+        address_.emplace();
+        std::memcpy(&*address_, addresses->ai_addr, addresses->ai_addrlen);
+        addressLength_ = addresses->ai_addrlen;
+        ::freeaddrinfo(addresses);
+    }
+
+    int fd = ::socket(address_->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&*address_), addressLength_) == 0) {
+        connecting = false;
+        return fd;
+    }
+    if (errno == EINPROGRESS) {
+        connecting = true;
+        return fd;
+    }
+    ::close(fd);
+    return -1;
+}
+
+HttpClient::HttpClient(std::string host, int port, std::chrono::milliseconds timeout)
+    : host_(std::move(host)), port_(port), timeout_(timeout) {
+}
+
+HttpClient::~HttpClient() {
+    for (int fd : idle_) {
+        ::close(fd);
+    }
+}
+
+std::string HttpClient::formatRequest(const std::string& method,
+                                      const std::string& target,
+                                      const std::string& body) const {
+    return method + " " + target + " HTTP/1.1\r\n"
+        "Host: " + host_ + ":" + std::to_string(port_) + "\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "\r\n" + body;
+}
+
+HttpClientResponse HttpClient::request(const std::string& method,
+                                       const std::string& target,
+                                       const std::string& body) {
+    std::string message = formatRequest(method, target, body);
+
+    // An idle connection may have been closed by the peer meanwhile; in that case nothing
+    // was processed and the request is retried once on a fresh connection
+    for (;;) {
+        int fd = takeIdle();
+        const bool pooled = fd >= 0;
+        if (!pooled) {
+            fd = connect();
+        }
+
+        HttpClientResponse response{0, {}};
+        bool keepAlive = true;
+        bool receivedAny = false;
+        if (sendAll(fd, message) && exchange(fd, response, keepAlive, receivedAny)) {
+            if (keepAlive) {
+                release(fd);
+            } else {
+                ::close(fd);
+            }
+            return response;
+        }
+        ::close(fd);
+
+        if (!pooled || receivedAny) {
+            break;
+        }
+    }
+
+    throw BackendUnavailableError("Peer " + host_ + ":" + std::to_string(port_) + " did not answer");
+}
+
+Task<HttpClientResponse> HttpClient::requestTask(std::string method, std::string target, std::string body) {
+    auto message = formatRequest(method, target, body);
+    auto& loop = reactor();
+    auto response = co_await CallbackAwaiter<std::optional<HttpClientResponse>>(
+        [&](std::function<void(std::optional<HttpClientResponse>)> done) {
+            loop.submit(std::move(message), std::move(done));
+        });
+    if (!response) {
+        throw BackendUnavailableError("Peer " + host_ + ":" + std::to_string(port_) + " did not answer");
+    }
+    co_return std::move(*response);
+}
+
+HttpClient::Reactor& HttpClient::reactor() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!reactor_) {
+        reactor_ = std::make_unique<Reactor>(host_, port_, timeout_);
+    }
+    return *reactor_;
+}
+
+bool HttpClient::exchange(int fd, HttpClientResponse& response, bool& keepAlive, bool& receivedAny) {
+    Reader reader(fd);
+    bool complete = false;
+    try {
+        complete = readResponse(reader, response, keepAlive);
+    } catch (const std::logic_error&) {
+        // Malformed numbers in the framing
+    }
+    receivedAny = reader.receivedAny();
+    return complete;
+}
+
+bool HttpClient::readResponse(Reader& reader, HttpClientResponse& response, bool& keepAlive) {
+    // Status line, e.g. "HTTP/1.1 200 OK"
+    std::string line;
+    if (!reader.readLine(line) || line.size() < 12 || line.compare(0, 5, "HTTP/") != 0) {
+        return false;
+    }
+    response.statusCode = std::atoi(line.c_str() + 9);
+
+    std::optional<std::size_t> contentLength;
+    bool chunked = false;
+    for (;;) {
+        if (!reader.readLine(line)) {
+            return false;
+        }
+        if (line.empty()) {
+            break;
+        }
+        auto colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(std::min(line.find_first_not_of(' ', colon + 1), line.size()));
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+            contentLength = std::stoul(value);
+        } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+            chunked = strcasecmp(value.c_str(), "chunked") == 0;
+        } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+            keepAlive = strcasecmp(value.c_str(), "close") != 0;
+        }
+    }
+
+    if (chunked) {
+        for (;;) {
+            if (!reader.readLine(line)) {
+                return false;
+            }
+            std::size_t size = std::stoul(line, nullptr, 16);
+            if (size == 0) {
+                // Skip trailers up to the terminating empty line
+                while (reader.readLine(line) && !line.empty()) {
+                }
+                return true;
+            }
+            if (!reader.readExact(size, response.body) || !reader.readLine(line)) {
+                return false;
+            }
+        }
+    }
+
+    if (contentLength) {
+        return reader.readExact(*contentLength, response.body);
+    }
+
+    // No framing: the body runs until the peer closes the connection
+    keepAlive = false;
+    return reader.readToEnd(response.body);
+}
+
+int HttpClient::connect() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addresses = nullptr;
+    if (::getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &addresses) != 0) {
+        throw BackendUnavailableError("Cannot resolve peer " + host_);
+    }
+
+    timeval timeout{};
+    timeout.tv_sec = static_cast<time_t>(timeout_.count() / 1000);
+    timeout.tv_usec = static_cast<suseconds_t>((timeout_.count() % 1000) * 1000);
+
+    int fd = -1;
+    for (auto* address = addresses; address != nullptr; address = address->ai_next) {
+        fd = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(addresses);
+
+    if (fd < 0) {
+        throw BackendUnavailableError("Cannot connect to peer " + host_ + ":" + std::to_string(port_) +
+                                      ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+int HttpClient::takeIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.empty()) {
+        return -1;
+    }
+    int fd = idle_.back();
+    idle_.pop_back();
+    return fd;
+}
+
+void HttpClient::release(int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(fd);
+}
@@ -0,0 +1,113 @@
+#include "telemetry/tiering.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+// Names are only needed between creating and unlinking a file
+std::atomic<uint64_t> nextSegment{0};
+
+// Read-only mapping of one segment file, shared by the blocks relocated into it
+class SegmentMapping {
+public:
+    SegmentMapping(void* data, std::size_t size) : data_(data), size_(size) {}
+    ~SegmentMapping() { ::munmap(data_, size_); }
+
+    SegmentMapping(const SegmentMapping&) = delete;
+    SegmentMapping& operator=(const SegmentMapping&) = delete;
+
+    const uint64_t* words() const { return static_cast<const uint64_t*>(data_); }
+
+private:
+    void* data_;
+    std::size_t size_;
+};
+
+// Closes and unlinks a segment file on every exit path
+class SegmentFile {
+public:
+    explicit SegmentFile(std::string path) : path_(std::move(path)) {
+        fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot create cold segment " + path_ + ": " + std::strerror(errno));
+        }
+    }
+    ~SegmentFile() {
+        ::close(fd_);
+        ::unlink(path_.c_str());
+    }
+
+    SegmentFile(const SegmentFile&) = delete;
+    SegmentFile& operator=(const SegmentFile&) = delete;
+
+    int fd() const { return fd_; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+} // namespace
+
+ColdSegment::ColdSegment(const std::string& directory, std::span<const CompressedBlock> blocks) {
+    std::size_t words = 0;
+    for (const auto& block : blocks) {
+        words += block.words().size();
+    }
+    if (words == 0) {
+        return;
+    }
+
+    SegmentFile file(directory + "/segment-" + std::to_string(::getpid()) + "-" +
+                     std::to_string(nextSegment++) + ".cold");
+    std::size_t offset = 0;
+    for (const auto& block : blocks) {
+        auto stream = block.words();
+        const auto* data = reinterpret_cast<const char*>(stream.data());
+        std::size_t remaining = stream.size_bytes();
+        while (remaining > 0) {
+            ssize_t written = ::pwrite(file.fd(), data, remaining, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                throw std::runtime_error("Cannot write cold segment " + file.path() + ": " + std::strerror(errno));
+            }
+            data += written;
+            offset += static_cast<std::size_t>(written);
+            remaining -= static_cast<std::size_t>(written);
+        }
+    }
+
+    void* data = ::mmap(nullptr, offset, PROT_READ, MAP_SHARED, file.fd(), 0);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map cold segment " + file.path() + ": " + std::strerror(errno));
+    }
+    auto mapping = std::make_shared<const SegmentMapping>(data, offset);
+    words_ = mapping->words();
+    mapping_ = std::move(mapping);
+
+    // Cold blocks are decoded rarely and mostly at range edges; fetch on demand
+    ::madvise(data, offset, MADV_RANDOM);
+}
+
+void ColdSegment::relocate(std::span<CompressedBlock> blocks) const {
+    if (!mapping_) {
+        return;
+    }
+    const uint64_t* next = words_;
+    for (auto& block : blocks) {
+        auto size = block.words().size();
+        if (size > 0) {
+            block.relocate(next, mapping_);
+            next += size;
+        }
+    }
+}
@@ -0,0 +1,260 @@
+#include "telemetry/compressed_block.h"
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+uint64_t toBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double fromBits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Appends bit fields to a word vector, most significant bit first
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint64_t>& words) : words_(words) {}
+
+    void writeBits(uint64_t value, int count) {
+        if (count == 0) {
+            return;
+        }
+        if (count < 64) {
+            value &= (uint64_t{1} << count) - 1;
+        }
+
+        int used = static_cast<int>(bitCount_ % 64);
+        if (used == 0) {
+            words_.push_back(0);
+        }
+        int free = 64 - used;
+        if (count <= free) {
+            words_.back() |= value << (free - count);
+        } else {
+            int spill = count - free;
+            words_.back() |= value >> spill;
+            words_.push_back(value << (64 - spill));
+        }
+        bitCount_ += static_cast<std::size_t>(count);
+    }
+
+    void writeBit(bool bit) { writeBits(bit ? 1 : 0, 1); }
+
+private:
+    std::vector<uint64_t>& words_;
+    std::size_t bitCount_ = 0;
+};
+
+// Delta-of-delta buckets as (prefix, prefix length, payload bits)
+struct TimestampBucket {
+    uint64_t prefix;
+    int prefixBits;
+    int payloadBits;
+};
+
+constexpr TimestampBucket kTimestampBuckets[] = {
+    {0b10, 2, 7},
+    {0b110, 3, 9},
+    {0b1110, 4, 12},
+};
+
+} // namespace
+
+CompressedBlock CompressedBlock::encode(const std::vector<EventData>& events, double scale) {
+    CompressedBlock block;
+    block.count_ = events.size();
+    block.scale_ = scale;
+    if (events.empty()) {
+        return block;
+    }
+
+    BitWriter writer(block.bits_);
+    block.minTimestamp_ = events.front().timestamp;
+    block.maxTimestamp_ = events.front().timestamp;
+
+    uint64_t previousTimestamp = 0;
+    int64_t previousDelta = 0;
+    std::size_t previousCount = 0;
+    uint64_t previousValue = 0;
+    int leading = 0;
+    int meaningful = 0; // 0 until the first XOR window is established
+    bool first = true;
+    bool firstValue = true;
+
+    for (const auto& event : events) {
+        block.minTimestamp_ = std::min(block.minTimestamp_, event.timestamp);
+        block.maxTimestamp_ = std::max(block.maxTimestamp_, event.timestamp);
+        block.sum_ += std::accumulate(event.values.begin(), event.values.end(), 0.0);
+
+        // Number of values: usually identical to the previous event
+        if (first || event.values.size() != previousCount) {
+            if (!first) {
+                writer.writeBit(true);
+            }
+            writer.writeBits(event.values.size(), 16);
+            previousCount = event.values.size();
+        } else {
+            writer.writeBit(false);
+        }
+
+        // Timestamp: raw for the first event, delta-of-delta afterwards
+        if (first) {
+            writer.writeBits(event.timestamp, 64);
+        } else {
+            int64_t delta = static_cast<int64_t>(event.timestamp - previousTimestamp);
+            int64_t deltaOfDelta = delta - previousDelta;
+            previousDelta = delta;
+
+            if (deltaOfDelta == 0) {
+                writer.writeBit(false);
+            } else {
+                uint64_t encoded = zigzag(deltaOfDelta);
+                bool written = false;
+                for (const auto& bucket : kTimestampBuckets) {
+                    if (encoded < (uint64_t{1} << bucket.payloadBits)) {
+                        writer.writeBits(bucket.prefix, bucket.prefixBits);
+                        writer.writeBits(encoded, bucket.payloadBits);
+                        written = true;
+                        break;
+                    }
+                }
+                if (!written) {
+                    writer.writeBits(0b1111, 4);
+                    writer.writeBits(static_cast<uint64_t>(deltaOfDelta), 64);
+                }
+            }
+        }
+        previousTimestamp = event.timestamp;
+        first = false;
+
+        // Values: XOR against the previous value, storing only the meaningful bits
+        for (double value : event.values) {
+            uint64_t bits = toBits(scale == 1.0 ? value : std::round(value * scale));
+            if (firstValue) {
+                writer.writeBits(bits, 64);
+                previousValue = bits;
+                firstValue = false;
+                continue;
+            }
+
+            uint64_t xored = bits ^ previousValue;
+            previousValue = bits;
+            if (xored == 0) {
+                writer.writeBit(false);
+                continue;
+            }
+            writer.writeBit(true);
+
+            int newLeading = std::min(std::countl_zero(xored), 31);
+            int newTrailing = std::countr_zero(xored);
+            int trailing = 64 - leading - meaningful;
+            if (meaningful != 0 && newLeading >= leading && newTrailing >= trailing) {
+                // Fits the previous window
+                writer.writeBit(false);
+                writer.writeBits(xored >> trailing, meaningful);
+            } else {
+                leading = newLeading;
+                meaningful = 64 - newLeading - newTrailing;
+                writer.writeBit(true);
+                writer.writeBits(static_cast<uint64_t>(leading), 5);
+                writer.writeBits(static_cast<uint64_t>(meaningful - 1), 6);
+                writer.writeBits(xored >> newTrailing, meaningful);
+            }
+        }
+    }
+
+    block.bits_.shrink_to_fit();
+    block.wordCount_ = block.bits_.size();
+    return block;
+}
+
+void CompressedBlock::relocate(const uint64_t* words, std::shared_ptr<const void> owner) {
+    relocated_ = words;
+    owner_ = std::move(owner);
+    std::vector<uint64_t>().swap(bits_);
+}
+
+uint64_t CompressedBlock::Decoder::readBits(int count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    std::size_t word = bitPosition_ / 64;
+    int used = static_cast<int>(bitPosition_ % 64);
+    int available = 64 - used;
+    uint64_t value;
+    if (count <= available) {
+        value = words_[word] << used >> (64 - count);
+    } else {
+        int spill = count - available;
+        value = (words_[word] << used >> used) << spill;
+        value |= words_[word + 1] >> (64 - spill);
+    }
+    bitPosition_ += static_cast<std::size_t>(count);
+    return value;
+}
+
+bool CompressedBlock::Decoder::next(EventData& event) {
+    if (decoded_ == block_.count_) {
+        return false;
+    }
+    const bool first = decoded_ == 0;
+
+    if (first || readBit()) {
+        event.values.resize(readBits(16));
+    }
+
+    if (first) {
+        timestamp_ = readBits(64);
+    } else {
+        int64_t deltaOfDelta = 0;
+        if (readBit()) {
+            int bucket = 0;
+            while (bucket < 3 && readBit()) {
+                ++bucket;
+            }
+            if (bucket < 3) {
+                deltaOfDelta = unzigzag(readBits(kTimestampBuckets[bucket].payloadBits));
+            } else {
+                deltaOfDelta = static_cast<int64_t>(readBits(64));
+            }
+        }
+        delta_ += deltaOfDelta;
+        timestamp_ += static_cast<uint64_t>(delta_);
+    }
+    event.timestamp = timestamp_;
+
+    for (std::size_t i = 0; i < event.values.size(); ++i) {
+        if (!haveValue_) {
+            value_ = readBits(64);
+            haveValue_ = true;
+        } else if (readBit()) {
+            if (readBit()) {
+                leading_ = static_cast<int>(readBits(5));
+                meaningful_ = static_cast<int>(readBits(6)) + 1;
+            }
+            int trailing = 64 - leading_ - meaningful_;
+            value_ ^= readBits(meaningful_) << trailing;
+        }
+        event.values[i] = block_.scale_ == 1.0 ? fromBits(value_) : fromBits(value_) / block_.scale_;
+    }
+
+    ++decoded_;
+    return true;
+}
@@ -0,0 +1,115 @@
+#include "telemetry/instrumented_mutex.h"
+#include <algorithm>
+#include <bit>
+#include <mutex>
+
+namespace lockstats {
+
+namespace {
+
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Function-local so that sites at namespace scope in other translation units can register safely
+std::vector<SiteCounters*>& registry() {
+    static std::vector<SiteCounters*> sites;
+    return sites;
+}
+
+std::size_t bucketOf(uint64_t ns) {
+    return std::min<std::size_t>(std::bit_width(ns / 1000), kHistogramBuckets - 1);
+}
+
+void raiseTo(std::atomic<uint64_t>& maximum, uint64_t value) {
+    auto current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+SiteCounters::SiteCounters(const char* lockName, const char* siteName)
+    : lockName_(lockName), siteName_(siteName) {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().push_back(this);
+}
+
+SiteCounters::~SiteCounters() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto& sites = registry();
+    sites.erase(std::remove(sites.begin(), sites.end(), this), sites.end());
+}
+
+void SiteCounters::record(LockMode mode, bool contended, uint64_t waitNs, uint64_t holdNs) {
+    auto& counters = counters_[static_cast<int>(mode)];
+    counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) {
+        counters.contended.fetch_add(1, std::memory_order_relaxed);
+        counters.totalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+        raiseTo(counters.maxWaitNs, waitNs);
+    }
+    counters.totalHoldNs.fetch_add(holdNs, std::memory_order_relaxed);
+    raiseTo(counters.maxHoldNs, holdNs);
+    counters.waitHistogram[bucketOf(waitNs)].fetch_add(1, std::memory_order_relaxed);
+    counters.holdHistogram[bucketOf(holdNs)].fetch_add(1, std::memory_order_relaxed);
+}
+
+SiteStats SiteCounters::read() const {
+    auto readMode = [](const Counters& counters) {
+        ModeStats stats;
+        stats.acquisitions = counters.acquisitions.load(std::memory_order_relaxed);
+        stats.contended = counters.contended.load(std::memory_order_relaxed);
+        stats.totalWaitNs = counters.totalWaitNs.load(std::memory_order_relaxed);
+        stats.maxWaitNs = counters.maxWaitNs.load(std::memory_order_relaxed);
+        stats.totalHoldNs = counters.totalHoldNs.load(std::memory_order_relaxed);
+        stats.maxHoldNs = counters.maxHoldNs.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < kHistogramBuckets; ++i) {
+            stats.waitHistogram[i] = counters.waitHistogram[i].load(std::memory_order_relaxed);
+            stats.holdHistogram[i] = counters.holdHistogram[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    };
+
+    SiteStats stats;
+    stats.lockName = lockName_;
+    stats.siteName = siteName_;
+    stats.shared = readMode(counters_[static_cast<int>(LockMode::Shared)]);
+    stats.exclusive = readMode(counters_[static_cast<int>(LockMode::Exclusive)]);
+    return stats;
+}
+
+void SiteCounters::reset() {
+    for (auto& counters : counters_) {
+        counters.acquisitions.store(0, std::memory_order_relaxed);
+        counters.contended.store(0, std::memory_order_relaxed);
+        counters.totalWaitNs.store(0, std::memory_order_relaxed);
+        counters.maxWaitNs.store(0, std::memory_order_relaxed);
+        counters.totalHoldNs.store(0, std::memory_order_relaxed);
+        counters.maxHoldNs.store(0, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < kHistogramBuckets; ++i) {
+            counters.waitHistogram[i].store(0, std::memory_order_relaxed);
+            counters.holdHistogram[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::vector<SiteStats> snapshot() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<SiteStats> stats;
+    stats.reserve(registry().size());
+    for (const auto* site : registry()) {
+        stats.push_back(site->read());
+    }
+    return stats;
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (auto* site : registry()) {
+        site->reset();
+    }
+}
+
+} // namespace lockstats
@@ -0,0 +1,41 @@
+#include "telemetry/query_context.h"
+
+namespace {
+
+thread_local QueryContext* currentContext = nullptr;
+
+} // namespace
+
+QueryContext::QueryContext(Clock::time_point deadline, bool allowPartial)
+    : deadline_(deadline), allowPartial_(allowPartial), previous_(currentContext) {
+    currentContext = this;
+}
+
+QueryContext::~QueryContext() {
+    if (attached_) {
+        currentContext = previous_;
+    }
+}
+
+QueryContext* QueryContext::current() {
+    return currentContext;
+}
+
+void QueryContext::detachAbove(QueryContext* outer) {
+    while (currentContext != nullptr && currentContext != outer) {
+        currentContext->attached_ = false;
+        currentContext = currentContext->previous_;
+    }
+}
+
+bool QueryContext::deadlineReached() {
+    auto* context = currentContext;
+    if (context == nullptr || Clock::now() < context->deadline_) {
+        return false;
+    }
+    if (!context->allowPartial_) {
+        throw QueryTimeoutError("Query exceeded its deadline");
+    }
+    context->partial_ = true;
+    return true;
+}
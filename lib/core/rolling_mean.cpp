@@ -0,0 +1,144 @@
+#include "telemetry/rolling_mean.h"
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+
+RollingWindow::RollingWindow(uint64_t widthSeconds, Clock clock)
+    : widthSeconds_(widthSeconds), clock_(std::move(clock)) {
+}
+
+void RollingWindow::add(uint64_t timestamp, double pathSum) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t now = clock_();
+    expire(now);
+
+    // Events that are already older than the window never enter it
+    if (now >= widthSeconds_ && timestamp < now - widthSeconds_) {
+        return;
+    }
+
+    // Timestamps are nearly monotone, so appending is the common case
+    if (entries_.empty() || entries_.back().first <= timestamp) {
+        entries_.emplace_back(timestamp, pathSum);
+    } else {
+        auto position = std::upper_bound(entries_.begin(), entries_.end(), timestamp,
+            [](uint64_t value, const auto& entry) { return value < entry.first; });
+        entries_.emplace(position, timestamp, pathSum);
+    }
+    sum_ += pathSum;
+}
+
+RollingMeanSnapshot RollingWindow::snapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    expire(clock_());
+
+    if (entries_.empty()) {
+        return {0.0, 0};
+    }
+    return {sum_ / entries_.size(), entries_.size()};
+}
+
+void RollingWindow::expire(uint64_t now) {
+    if (now < widthSeconds_) {
+        return;
+    }
+
+    const uint64_t cutoff = now - widthSeconds_;
+    while (!entries_.empty() && entries_.front().first < cutoff) {
+        sum_ -= entries_.front().second;
+        entries_.pop_front();
+    }
+
+    // Reset the running sum whenever the window drains to drop accumulated rounding error
+    if (entries_.empty()) {
+        sum_ = 0.0;
+    }
+}
+
+RollingMeanTracker::RollingMeanTracker(Clock clock, LengthOf lengthOf)
+    : clock_(std::move(clock)), lengthOf_(std::move(lengthOf)) {
+}
+
+bool RollingMeanTracker::ingest(const std::string& eventName,
+                                const std::vector<double>& values,
+                                uint64_t timestamp,
+                                const std::function<bool()>& save) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = windows_.find(eventName);
+    if (it == windows_.end()) {
+        return save();
+    }
+    auto windows = it->second;
+    lock.unlock();
+
+    std::shared_lock<std::shared_mutex> eventLock(windows->mutex);
+    if (!save()) {
+        return false;
+    }
+
+    const double pathSum = lengthOf_ ? lengthOf_(eventName, values)
+                                     : std::accumulate(values.begin(), values.end(), 0.0);
+    for (const auto& entry : windows->entries) {
+        if (auto window = entry.window.lock()) {
+            window->add(timestamp, pathSum);
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<IRollingMean> RollingMeanTracker::subscribe(const std::string& eventName,
+                                                            uint64_t widthSeconds,
+                                                            const Seeder& seed) {
+    std::shared_ptr<EventWindows> windows;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        pruneExpired();
+        auto& slot = windows_[eventName];
+        if (!slot) {
+            slot = std::make_shared<EventWindows>();
+        }
+        windows = slot;
+    }
+
+    std::unique_lock<std::shared_mutex> eventLock(windows->mutex);
+    auto& entries = windows->entries;
+    std::erase_if(entries, [](const Entry& entry) { return entry.window.expired(); });
+    for (const auto& entry : entries) {
+        if (entry.widthSeconds == widthSeconds) {
+            if (auto window = entry.window.lock()) {
+                return window;
+            }
+        }
+    }
+
+    // First subscriber: build the window from history while saves of this event are held off
+    auto window = std::make_shared<RollingWindow>(widthSeconds, clock_);
+    const uint64_t now = clock_();
+    const uint64_t from = now >= widthSeconds ? now - widthSeconds : 0;
+    for (const auto& event : seed(from)) {
+        window->add(event.timestamp,
+                    std::accumulate(event.values.begin(), event.values.end(), 0.0));
+    }
+
+    entries.push_back(Entry{widthSeconds, window});
+    return window;
+}
+
+uint64_t RollingMeanTracker::systemClockSeconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+void RollingMeanTracker::pruneExpired() {
+    // Copies of an event's windows are only taken under mutex_, which the caller holds
+    // exclusively; one no other thread holds can be changed without its own lock
+    for (auto it = windows_.begin(); it != windows_.end();) {
+        if (it->second.use_count() > 1) {
+            ++it;
+            continue;
+        }
+        auto& entries = it->second->entries;
+        std::erase_if(entries, [](const Entry& entry) { return entry.window.expired(); });
+        it = entries.empty() ? windows_.erase(it) : std::next(it);
+    }
+}
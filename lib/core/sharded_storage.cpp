@@ -0,0 +1,276 @@
+#include "telemetry/sharded_storage.h"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef TELEMETRY_HAVE_NUMA
+#include <numa.h>
+#endif
+
+// Shards are aligned to cache lines so that neighbouring shards never share one
+struct alignas(64) ShardedStorage::Shard {
+    Shard(const PrecisionPolicy& precision, const TieringPolicy& tiering) : storage(precision, tiering) {}
+
+    TelemetryStorage storage;
+    int numaNode = -1; // Node the shard was allocated on, -1 when allocated normally
+};
+
+namespace {
+
+std::atomic<uint64_t> nextInstanceId{1};
+
+// Shard binding of the calling thread; the last lookup is cached since a worker thread
+// usually serves a single storage
+struct ThreadBinding {
+    uint64_t instanceId = 0;
+    std::size_t shard = 0;
+    std::unordered_map<uint64_t, std::size_t> others;
+    uint64_t bulkLoadInstanceId = 0; // Storage the thread is bulk loading, which it must not bind to
+};
+thread_local ThreadBinding binding;
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (cpus.empty()) {
+        cpus.push_back(0);
+    }
+    return cpus;
+}
+
+} // namespace
+
+void ShardedStorage::ShardDeleter::operator()(Shard* shard) const {
+#ifdef TELEMETRY_HAVE_NUMA
+    if (shard->numaNode >= 0) {
+        shard->~Shard();
+        numa_free(shard, sizeof(Shard));
+        return;
+    }
+#endif
+    delete shard;
+}
+
+ShardedStorage::ShardedStorage(std::size_t shardCount, bool pinThreads, PrecisionPolicy precision,
+                               TieringPolicy tiering)
+    : cpus_(allowedCpus()), pinThreads_(pinThreads), instanceId_(nextInstanceId++) {
+    if (shardCount == 0) {
+        throw std::invalid_argument("Sharded storage needs at least one shard");
+    }
+
+    shards_.reserve(shardCount);
+    for (std::size_t i = 0; i < shardCount; ++i) {
+#ifdef TELEMETRY_HAVE_NUMA
+        // The shard header lives on its CPU's node; the events it stores are allocated by
+        // the pinned owner thread and land on the same node through first-touch placement
+        if (numa_available() >= 0) {
+            int node = numa_node_of_cpu(cpus_[i % cpus_.size()]);
+            void* memory = node >= 0 ? numa_alloc_onnode(sizeof(Shard), node) : nullptr;
+            if (memory != nullptr) {
+                auto* shard = new (memory) Shard(precision, tiering);
+                shard->numaNode = node;
+                shards_.emplace_back(shard);
+                continue;
+            }
+        }
+#endif
+        shards_.emplace_back(new Shard(precision, tiering));
+    }
+}
+
+ShardedStorage::~ShardedStorage() = default;
+
+std::size_t ShardedStorage::localShard() {
+    if (binding.instanceId == instanceId_) {
+        return binding.shard;
+    }
+
+    auto it = binding.others.find(instanceId_);
+    std::size_t shard;
+    if (it != binding.others.end()) {
+        shard = it->second;
+    } else {
+        // New threads take the shards round-robin; with more threads than shards some share one
+        shard = nextShard_++ % shards_.size();
+        binding.others.emplace(instanceId_, shard);
+        if (pinThreads_) {
+            pinToShardCpu(shard);
+        }
+    }
+
+    binding.instanceId = instanceId_;
+    binding.shard = shard;
+    return shard;
+}
+
+void ShardedStorage::pinToShardCpu(std::size_t shard) const {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus_[shard % cpus_.size()], &set);
+    // Pinning is an optimisation; a thread that cannot be pinned still works correctly
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+}
+
+ShardedStorage::BulkLoad::BulkLoad(ShardedStorage& storage)
+    : previous_(binding.bulkLoadInstanceId) {
+    binding.bulkLoadInstanceId = storage.instanceId_;
+}
+
+ShardedStorage::BulkLoad::~BulkLoad() {
+    binding.bulkLoadInstanceId = previous_;
+}
+
+bool ShardedStorage::saveEvent(const std::string& eventName,
+                               const std::vector<double>& values,
+                               uint64_t timestamp) {
+    if (binding.bulkLoadInstanceId == instanceId_) {
+        const auto shard = nextLoadShard_.fetch_add(1, std::memory_order_relaxed) % shards_.size();
+        return shards_[shard]->storage.saveEvent(eventName, values, timestamp);
+    }
+
+    // The shard lock is only ever contended by queries, never by other writers
+    return shards_[localShard()]->storage.saveEvent(eventName, values, timestamp);
+}
+
+std::vector<EventData> ShardedStorage::getFilteredEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    std::vector<EventData> events;
+    for (const auto& shard : shards_) {
+        auto part = shard->storage.getFilteredEvents(eventName, startTimestamp, endTimestamp);
+        events.insert(events.end(),
+                      std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }
+
+    // Arrival order across shards is not defined, so present a stable one
+    std::stable_sort(events.begin(), events.end(),
+        [](const EventData& a, const EventData& b) { return a.timestamp < b.timestamp; });
+    return events;
+}
+
+PathAggregate ShardedStorage::aggregateEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    PathAggregate total;
+    for (const auto& shard : shards_) {
+        auto part = shard->storage.aggregateEvents(eventName, startTimestamp, endTimestamp);
+        total.sum += part.sum;
+        total.count += part.count;
+    }
+    return total;
+}
+
+std::vector<SeriesBucket> ShardedStorage::aggregateSeries(
+    const std::string& eventName,
+    uint64_t bucketWidth,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    // Every shard uses the same bucket grid, so bucket starts map onto themselves
+    SeriesAccumulator merged(startTimestamp.value_or(0), bucketWidth);
+    for (const auto& shard : shards_) {
+        for (const auto& bucket : shard->storage.aggregateSeries(eventName, bucketWidth, startTimestamp, endTimestamp)) {
+            merged.add(bucket.bucketStart, bucket.aggregate);
+        }
+    }
+    return merged.buckets();
+}
+
+std::vector<PathAggregate> ShardedStorage::aggregateWindows(
+    const std::string& eventName,
+    const std::vector<TimeWindow>& windows) {
+
+    std::vector<PathAggregate> merged(windows.size());
+    for (const auto& shard : shards_) {
+        auto aggregates = shard->storage.aggregateWindows(eventName, windows);
+        for (std::size_t i = 0; i < merged.size(); ++i) {
+            merged[i].sum += aggregates[i].sum;
+            merged[i].count += aggregates[i].count;
+        }
+    }
+    return merged;
+}
+
+std::optional<uint64_t> ShardedStorage::eventVersion(const std::string& eventName) {
+    uint64_t version = 0;
+    for (const auto& shard : shards_) {
+        version += *shard->storage.eventVersion(eventName);
+    }
+    return version;
+}
+
+double ShardedStorage::storedLength(const std::string& eventName, const std::vector<double>& values) {
+    return shards_.front()->storage.storedLength(eventName, values);
+}
+
+void ShardedStorage::readEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp,
+    EventCursor& cursor,
+    std::size_t maxEvents,
+    std::vector<EventData>& out) {
+
+    const auto wanted = out.size() + maxEvents;
+    while (cursor.partition < shards_.size() && out.size() < wanted) {
+        EventCursor shardCursor{0, cursor.block, cursor.offset, false};
+        shards_[cursor.partition]->storage.readEvents(eventName, startTimestamp, endTimestamp,
+                                                      shardCursor, wanted - out.size(), out);
+        if (shardCursor.done) {
+            ++cursor.partition;
+            cursor.block = 0;
+            cursor.offset = 0;
+        } else {
+            cursor.block = shardCursor.block;
+            cursor.offset = shardCursor.offset;
+        }
+    }
+    cursor.done = cursor.partition >= shards_.size();
+}
+
+SampledAggregate ShardedStorage::sampleAggregate(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    // Shards sample independently, so their estimates and variances add up
+    SampledAggregate total;
+    for (const auto& shard : shards_) {
+        total.merge(shard->storage.sampleAggregate(eventName, startTimestamp, endTimestamp));
+    }
+    return total;
+}
+
+TierStats ShardedStorage::tierStats() {
+    TierStats total;
+    for (const auto& shard : shards_) {
+        auto stats = shard->storage.tierStats();
+        total.hotBlocks += stats.hotBlocks;
+        total.coldBlocks += stats.coldBlocks;
+        total.hotBytes += stats.hotBytes;
+        total.coldBytes += stats.coldBytes;
+        total.spillFailures += stats.spillFailures;
+    }
+    return total;
+}
+
+void ShardedStorage::waitForCompactions() {
+    for (const auto& shard : shards_) {
+        shard->storage.waitForCompactions();
+    }
+}
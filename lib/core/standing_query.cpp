@@ -0,0 +1,134 @@
+#include "telemetry/standing_query.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+bool StandingQueryRegistry::ingest(const std::string& eventName,
+                                   const std::vector<double>& values,
+                                   uint64_t timestamp,
+                                   const std::function<bool()>& save) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = byEvent_.find(eventName);
+    if (it == byEvent_.end()) {
+        return save();
+    }
+    auto queries = it->second;
+    lock.unlock();
+
+    std::shared_lock<std::shared_mutex> eventLock(queries->mutex);
+    if (!save()) {
+        return false;
+    }
+
+    const double pathSum = lengthOf_ ? lengthOf_(eventName, values)
+                                     : std::accumulate(values.begin(), values.end(), 0.0);
+    for (const auto& query : queries->queries) {
+        if (query->covers(timestamp)) {
+            std::lock_guard<std::mutex> queryLock(query->mutex);
+            query->aggregate.sum += pathSum;
+            ++query->aggregate.count;
+        }
+    }
+    return true;
+}
+
+void StandingQueryRegistry::define(const std::string& name,
+                                   const std::string& eventName,
+                                   std::optional<uint64_t> startTimestamp,
+                                   std::optional<uint64_t> endTimestamp,
+                                   const Seeder& seed) {
+    auto query = std::make_shared<Query>();
+    query->eventName = eventName;
+    query->startTimestamp = startTimestamp;
+    query->endTimestamp = endTimestamp;
+
+    // The query is fed from its first save after the seeding scan, before it can be read by name
+    {
+        auto queries = queriesOf(eventName);
+        std::unique_lock<std::shared_mutex> eventLock(queries->mutex);
+        query->aggregate = seed(eventName, startTimestamp, endTimestamp);
+        queries->queries.push_back(query);
+    }
+
+    std::shared_ptr<Query> replaced;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto [it, inserted] = byName_.try_emplace(name, query);
+        if (!inserted) {
+            replaced = std::exchange(it->second, query);
+        }
+    }
+    if (replaced) {
+        unlink(replaced);
+    }
+}
+
+void StandingQueryRegistry::reseed(const Seeder& seed) {
+    std::vector<std::shared_ptr<EventQueries>> events;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& [eventName, queries] : byEvent_) {
+            events.push_back(queries);
+        }
+    }
+
+    for (const auto& queries : events) {
+        std::unique_lock<std::shared_mutex> eventLock(queries->mutex);
+        for (const auto& query : queries->queries) {
+            auto aggregate = seed(query->eventName, query->startTimestamp, query->endTimestamp);
+            std::lock_guard<std::mutex> queryLock(query->mutex);
+            query->aggregate = aggregate;
+        }
+    }
+}
+
+std::optional<PathAggregate> StandingQueryRegistry::read(const std::string& name) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = byName_.find(name);
+    if (it == byName_.end()) {
+        return std::nullopt;
+    }
+
+    std::lock_guard<std::mutex> queryLock(it->second->mutex);
+    return it->second->aggregate;
+}
+
+bool StandingQueryRegistry::remove(const std::string& name) {
+    std::shared_ptr<Query> query;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = byName_.find(name);
+        if (it == byName_.end()) {
+            return false;
+        }
+        query = std::move(it->second);
+        byName_.erase(it);
+    }
+
+    unlink(query);
+    return true;
+}
+
+std::shared_ptr<StandingQueryRegistry::EventQueries> StandingQueryRegistry::queriesOf(const std::string& eventName) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto& queries = byEvent_[eventName];
+    if (!queries) {
+        queries = std::make_shared<EventQueries>();
+    }
+    return queries;
+}
+
+void StandingQueryRegistry::unlink(const std::shared_ptr<Query>& query) {
+    {
+        auto queries = queriesOf(query->eventName);
+        std::unique_lock<std::shared_mutex> eventLock(queries->mutex);
+        std::erase(queries->queries, query);
+    }
+
+    // Copies are only taken under mutex_; one no other thread holds can be read without its lock
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = byEvent_.find(query->eventName);
+    if (it != byEvent_.end() && it->second.use_count() == 1 && it->second->queries.empty()) {
+        byEvent_.erase(it);
+    }
+}
@@ -1,22 +1,64 @@
 #include "telemetry/telemetry_processor.h"
-#include <numeric>
+#include "telemetry/tracing.h"
 #include <algorithm>
-#include <execution>
+#include <iterator>
 
 TelemetryProcessor::TelemetryProcessor(ITelemetryStorage& storage) 
-    : storage_(storage) {
+    : storage_(storage),
+      rollingMeans_(&RollingMeanTracker::systemClockSeconds,
+                    [&storage](const std::string& eventName, const std::vector<double>& values) {
+                        return storage.storedLength(eventName, values);
+                    }),
+      standingQueries_([&storage](const std::string& eventName, const std::vector<double>& values) {
+          return storage.storedLength(eventName, values);
+      }) {
 }
 
 bool TelemetryProcessor::saveEvent(const std::string& eventName, 
                                   const std::vector<double>& values, 
                                   uint64_t timestamp) {
+    tracing::Span span("processor.saveEvent");
+
     // Validate path length (must be exactly 10 elements)
     if (values.size() != 10) {
         return false;
     }
     
-    // Save to storage
-    return storage_.saveEvent(eventName, values, timestamp);
+    // Save to storage and feed any live rolling windows and standing queries
+    return ingest(eventName, values, timestamp, [&] {
+        return storage_.saveEvent(eventName, values, timestamp);
+    });
+}
+
+void TelemetryProcessor::saveEventAsync(const std::string& eventName,
+                                        const std::vector<double>& values,
+                                        uint64_t timestamp,
+                                        std::function<void(SaveStatus)> done) {
+    tracing::Span span("processor.saveEventAsync");
+
+    if (values.size() != 10) {
+        done(SaveStatus::Rejected);
+        return;
+    }
+
+    // The event is visible to queries once stored; the caller hears back once it is durable
+    bool accepted = ingest(eventName, values, timestamp, [&] {
+        return storage_.saveEventAsync(eventName, values, timestamp, [done](bool durable) {
+            done(durable ? SaveStatus::Saved : SaveStatus::Failed);
+        });
+    });
+    if (!accepted) {
+        done(SaveStatus::Rejected);
+    }
+}
+
+bool TelemetryProcessor::ingest(const std::string& eventName,
+                                const std::vector<double>& values,
+                                uint64_t timestamp,
+                                const std::function<bool()>& save) {
+    return rollingMeans_.ingest(eventName, values, timestamp, [&] {
+        return standingQueries_.ingest(eventName, values, timestamp, save);
+    });
 }
 
 double TelemetryProcessor::calculateMeanLength(
@@ -24,21 +66,127 @@ double TelemetryProcessor::calculateMeanLength(
     std::optional<uint64_t> startTimestamp, 
     std::optional<uint64_t> endTimestamp) {
     
-    // Retrieve filtered events
-    auto filteredEvents = storage_.getFilteredEvents(
-        eventName, startTimestamp, endTimestamp);
+    tracing::Span span("processor.calculateMeanLength");
+
+    // Reduce the matching events inside storage
+    auto aggregate = storage_.aggregateEvents(eventName, startTimestamp, endTimestamp);
     
-    if (filteredEvents.empty()) {
+    if (aggregate.count == 0) {
         return 0.0;
     }
     
-    // Compute the total sum over all events by summing each event's sum directly.
-    double totalSum = 0.0;
-    for (const auto& event : filteredEvents) {
-        totalSum += std::reduce(std::execution::par, 
-                               event.values.begin(), 
-                               event.values.end());
+    return aggregate.sum / aggregate.count;
+}
+
+std::vector<PathAggregate> TelemetryProcessor::calculateAggregates(
+    const std::vector<std::string>& eventNames,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("processor.calculateAggregates");
+
+    std::vector<PathAggregate> aggregates;
+    aggregates.reserve(eventNames.size());
+    std::transform(eventNames.begin(), eventNames.end(), std::back_inserter(aggregates),
+        [&](const std::string& eventName) {
+            return storage_.aggregateEvents(eventName, startTimestamp, endTimestamp);
+        });
+    return aggregates;
+}
+
+std::vector<SeriesBucket> TelemetryProcessor::calculateSeries(
+    const std::string& eventName,
+    uint64_t bucketSeconds,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("processor.calculateSeries");
+
+    // One sweep inside storage instead of a query per bucket
+    return storage_.aggregateSeries(eventName, bucketSeconds, startTimestamp, endTimestamp);
+}
+
+std::vector<PathAggregate> TelemetryProcessor::calculateWindows(
+    const std::string& eventName,
+    const std::vector<TimeWindow>& windows) {
+
+    tracing::Span span("processor.calculateWindows");
+
+    // One sweep inside storage instead of a query per window
+    return storage_.aggregateWindows(eventName, windows);
+}
+
+std::vector<SampledAggregate> TelemetryProcessor::calculateSampledAggregates(
+    const std::vector<std::string>& eventNames,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("processor.calculateSampledAggregates");
+
+    std::vector<SampledAggregate> aggregates;
+    aggregates.reserve(eventNames.size());
+    for (const auto& eventName : eventNames) {
+        aggregates.push_back(storage_.sampleAggregate(eventName, startTimestamp, endTimestamp));
+    }
+    return aggregates;
+}
+
+void TelemetryProcessor::readEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp,
+    EventCursor& cursor,
+    std::size_t maxEvents,
+    std::vector<EventData>& out) {
+    storage_.readEvents(eventName, startTimestamp, endTimestamp, cursor, maxEvents, out);
+}
+
+std::shared_ptr<IRollingMean> TelemetryProcessor::subscribeRollingMean(
+    const std::string& eventName,
+    uint64_t windowSeconds) {
+
+    return rollingMeans_.subscribe(eventName, windowSeconds, [&](uint64_t fromTimestamp) {
+        return storage_.getFilteredEvents(eventName, fromTimestamp);
+    });
+}
+
+void TelemetryProcessor::registerStandingQuery(
+    const std::string& name,
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("processor.registerStandingQuery");
+
+    standingQueries_.define(name, eventName, startTimestamp, endTimestamp,
+        [&](const std::string& event, std::optional<uint64_t> start, std::optional<uint64_t> end) {
+            return storage_.aggregateEvents(event, start, end);
+        });
+}
+
+std::optional<PathAggregate> TelemetryProcessor::readStandingQuery(const std::string& name) {
+    return standingQueries_.read(name);
+}
+
+bool TelemetryProcessor::removeStandingQuery(const std::string& name) {
+    return standingQueries_.remove(name);
+}
+
+void TelemetryProcessor::reseedStandingQueries() {
+    standingQueries_.reseed(
+        [&](const std::string& event, std::optional<uint64_t> start, std::optional<uint64_t> end) {
+            return storage_.aggregateEvents(event, start, end);
+        });
+}
+
+std::optional<uint64_t> TelemetryProcessor::eventsVersion(const std::vector<std::string>& eventNames) {
+    uint64_t combined = 0;
+    for (const auto& eventName : eventNames) {
+        auto version = storage_.eventVersion(eventName);
+        if (!version) {
+            return std::nullopt;
+        }
+        combined += *version;
     }
-        
-    return totalSum / filteredEvents.size();
+    return combined;
 }
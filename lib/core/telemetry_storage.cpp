@@ -1,46 +1,1033 @@
 #include "telemetry/telemetry_storage.h"
+#include "telemetry/query_context.h"
+#include "telemetry/tracing.h"
 #include <algorithm>
-#include <mutex>       // For std::unique_lock
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <utility>
 #include <shared_mutex> // For std::shared_mutex
-#include <ranges>
+
+namespace {
+
+bool inRange(uint64_t timestamp, std::optional<uint64_t> startTimestamp, std::optional<uint64_t> endTimestamp) {
+    const bool afterStart = !startTimestamp || timestamp >= *startTimestamp;
+    const bool beforeEnd = !endTimestamp || timestamp <= *endTimestamp;
+    return afterStart && beforeEnd;
+}
+
+// Sealed blocks store whole milliseconds as integers, which compress far better than decimals
+double blockScale(ValuePrecision precision) {
+    return precision == ValuePrecision::Milliseconds ? 1000.0 : 1.0;
+}
+
+// Aggregates events into several possibly overlapping windows at once. The window edges cut the
+// time line into segments, each lying in a fixed set of windows; an event is added to its
+// segment only, and every window sums its segments at the end. The current segment is cached,
+// so a time-ordered sweep looks each segment up once.
+class WindowAccumulator {
+public:
+    explicit WindowAccumulator(const std::vector<TimeWindow>& windows) {
+        // Segment k covers [edges_[k], edges_[k + 1]); the last one runs to the end of time
+        for (const auto& window : windows) {
+            edges_.push_back(window.start);
+            if (window.end < std::numeric_limits<uint64_t>::max()) {
+                edges_.push_back(window.end + 1);
+            }
+        }
+        std::sort(edges_.begin(), edges_.end());
+        edges_.erase(std::unique(edges_.begin(), edges_.end()), edges_.end());
+
+        const std::size_t segments = edges_.size();
+        sums_.resize(segments);
+        spans_.reserve(windows.size());
+        std::vector<bool> covered(segments, false);
+        for (const auto& window : windows) {
+            const std::size_t first = segmentIndex(window.start);
+            const std::size_t last = window.end < std::numeric_limits<uint64_t>::max()
+                ? segmentIndex(window.end + 1) : segments;
+            spans_.emplace_back(first, last);
+            std::fill(covered.begin() + first, covered.begin() + last, true);
+        }
+
+        // Lets range checks skip the gaps between windows in one step
+        nextCovered_.resize(segments + 1, segments);
+        for (std::size_t k = segments; k-- > 0;) {
+            nextCovered_[k] = covered[k] ? k : nextCovered_[k + 1];
+        }
+    }
+
+    // Segment holding timestamp, or nullopt if no window does
+    std::optional<std::size_t> segmentOf(uint64_t timestamp) {
+        if (current_ < edges_.size() && edges_[current_] <= timestamp &&
+            (current_ + 1 == edges_.size() || timestamp < edges_[current_ + 1])) {
+            return current_;
+        }
+        if (edges_.empty() || timestamp < edges_.front()) {
+            return std::nullopt;
+        }
+        const std::size_t k = segmentContaining(timestamp);
+        if (nextCovered_[k] != k) {
+            return std::nullopt;
+        }
+        current_ = k;
+        return k;
+    }
+
+    // Whether any window holds a timestamp in [first, last]
+    bool overlaps(uint64_t first, uint64_t last) const {
+        if (edges_.empty() || last < edges_.front()) {
+            return false;
+        }
+        const std::size_t from = first < edges_.front() ? 0 : segmentContaining(first);
+        const std::size_t k = nextCovered_[from];
+        return k < edges_.size() && (k == from || edges_[k] <= last);
+    }
+
+    void add(std::size_t segment, const PathAggregate& part) {
+        sums_[segment].sum += part.sum;
+        sums_[segment].count += part.count;
+    }
+
+    // Aggregates of the windows, in the order they were given
+    std::vector<PathAggregate> results() const {
+        std::vector<PathAggregate> results;
+        results.reserve(spans_.size());
+        for (const auto& [first, last] : spans_) {
+            PathAggregate aggregate;
+            for (std::size_t k = first; k < last; ++k) {
+                aggregate.sum += sums_[k].sum;
+                aggregate.count += sums_[k].count;
+            }
+            results.push_back(aggregate);
+        }
+        return results;
+    }
+
+private:
+    // Segment starting at edge, which must be one of the edges
+    std::size_t segmentIndex(uint64_t edge) const {
+        return static_cast<std::size_t>(std::lower_bound(edges_.begin(), edges_.end(), edge) - edges_.begin());
+    }
+
+    // Segment holding timestamp, which must not precede the first edge
+    std::size_t segmentContaining(uint64_t timestamp) const {
+        return static_cast<std::size_t>(std::upper_bound(edges_.begin(), edges_.end(), timestamp) - edges_.begin()) - 1;
+    }
+
+    std::vector<uint64_t> edges_;
+    std::vector<PathAggregate> sums_;
+    std::vector<std::pair<std::size_t, std::size_t>> spans_; // Segments [first, last) of each window
+    std::vector<std::size_t> nextCovered_;                   // First covered segment at or after k
+    std::size_t current_ = std::numeric_limits<std::size_t>::max();
+};
+
+// Call sites of the storage lock, reported separately when lock statistics are compiled in
+lockstats::LockSite saveEventSite("TelemetryStorage", "saveEvent");
+lockstats::LockSite saveEventsSite("TelemetryStorage", "saveEvents");
+lockstats::LockSite getFilteredEventsSite("TelemetryStorage", "getFilteredEvents");
+lockstats::LockSite aggregateEventsSite("TelemetryStorage", "aggregateEvents");
+lockstats::LockSite aggregateSeriesSite("TelemetryStorage", "aggregateSeries");
+lockstats::LockSite aggregateWindowsSite("TelemetryStorage", "aggregateWindows");
+lockstats::LockSite sampleAggregateSite("TelemetryStorage", "sampleAggregate");
+lockstats::LockSite readEventsSite("TelemetryStorage", "readEvents");
+lockstats::LockSite eventVersionSite("TelemetryStorage", "eventVersion");
+lockstats::LockSite freezeSite("TelemetryStorage", "freeze");
+lockstats::LockSite clearSite("TelemetryStorage", "clear");
+lockstats::LockSite tierStatsSite("TelemetryStorage", "tierStats");
+lockstats::LockSite compactReadSite("TelemetryStorage", "compact.read");
+lockstats::LockSite compactInstallSite("TelemetryStorage", "compact.install");
+lockstats::LockSite spillReadSite("TelemetryStorage", "spill.read");
+lockstats::LockSite spillInstallSite("TelemetryStorage", "spill.install");
+
+} // namespace
+
+lockstats::InstrumentedSharedMutex::SharedLock TelemetryStorage::readLock(lockstats::LockSite& site) {
+    tracing::Span span("storage.lockWait");
+    return mutex_.lockShared(site);
+}
+
+lockstats::InstrumentedSharedMutex::ExclusiveLock TelemetryStorage::writeLock(lockstats::LockSite& site) {
+    tracing::Span span("storage.lockWait");
+    return mutex_.lock(site);
+}
+
+void TelemetryStorage::headEvent(const EventSeries& series, std::size_t i, EventData& data) {
+    const auto& head = series.head;
+    data.timestamp = head.timestamps[i];
+    data.values.clear();
+    for (uint32_t v = head.offsets[i]; v < head.offsets[i + 1]; ++v) {
+        switch (series.precision) {
+        case ValuePrecision::Double:
+            data.values.push_back(head.doubles[v]);
+            break;
+        case ValuePrecision::Float32:
+            data.values.push_back(head.floats[v]);
+            break;
+        case ValuePrecision::Milliseconds:
+            data.values.push_back(head.milliseconds[v] / 1000.0);
+            break;
+        }
+    }
+}
+
+template <typename Visitor>
+void TelemetryStorage::scanHead(const EventSeries& series,
+                                std::optional<uint64_t> startTimestamp,
+                                std::optional<uint64_t> endTimestamp,
+                                Visitor&& visitor) {
+    // Head events are widened back to doubles one at a time
+    const auto& head = series.head;
+    EventData data;
+    for (std::size_t i = 0; i < head.timestamps.size(); ++i) {
+        if (!inRange(head.timestamps[i], startTimestamp, endTimestamp)) {
+            continue;
+        }
+        headEvent(series, i, data);
+        visitor(data);
+    }
+}
+
+class TelemetryStorage::RunReader {
+public:
+    // Reads a sealed block, which is sorted already
+    RunReader(const CompressedBlock& block, std::size_t run) : decoder_(std::in_place, block), run_(run) {}
+
+    // Reads the head of series through its events sorted by timestamp
+    RunReader(const EventSeries& series, std::size_t run) : series_(&series), run_(run) {
+        const auto& timestamps = series.head.timestamps;
+        order_.resize(timestamps.size());
+        std::iota(order_.begin(), order_.end(), std::size_t{0});
+        if (!std::is_sorted(timestamps.begin(), timestamps.end())) {
+            std::stable_sort(order_.begin(), order_.end(),
+                [&](std::size_t a, std::size_t b) { return timestamps[a] < timestamps[b]; });
+        }
+    }
+
+    // Moves to the next event; false at the end of the run
+    bool next() {
+        if (decoder_) {
+            return decoder_->next(event_);
+        }
+        if (position_ == order_.size()) {
+            return false;
+        }
+        headEvent(*series_, order_[position_++], event_);
+        return true;
+    }
+
+    const EventData& event() const { return event_; }
+
+    // Whether the current event comes after the other reader's; equal timestamps go by run
+    bool after(const RunReader& other) const {
+        if (event_.timestamp != other.event_.timestamp) {
+            return event_.timestamp > other.event_.timestamp;
+        }
+        return run_ > other.run_;
+    }
+
+private:
+    std::optional<CompressedBlock::Decoder> decoder_;
+    const EventSeries* series_ = nullptr;
+    std::vector<std::size_t> order_;
+    std::size_t position_ = 0;
+    std::size_t run_;
+    EventData event_;
+};
+
+template <typename Visitor>
+void TelemetryStorage::scan(const EventSeries& series,
+                            std::optional<uint64_t> startTimestamp,
+                            std::optional<uint64_t> endTimestamp,
+                            Visitor&& visitor) {
+    // Runs overlapping the range by their first timestamp; the head is the newest run
+    std::vector<std::pair<uint64_t, std::size_t>> pending;
+    for (std::size_t run = 0; run < series.sealed.size(); ++run) {
+        const auto& block = series.sealed[run];
+        if ((!startTimestamp || block.maxTimestamp() >= *startTimestamp) &&
+            (!endTimestamp || block.minTimestamp() <= *endTimestamp)) {
+            pending.emplace_back(block.minTimestamp(), run);
+        }
+    }
+    const auto& head = series.head;
+    if (!head.timestamps.empty() && (!startTimestamp || head.maxTimestamp >= *startTimestamp) &&
+        (!endTimestamp || head.minTimestamp <= *endTimestamp)) {
+        pending.emplace_back(head.minTimestamp, series.sealed.size());
+    }
+    std::sort(pending.begin(), pending.end());
+
+    // Min-heap of the open runs by their current event
+    std::deque<RunReader> readers;
+    std::vector<RunReader*> open;
+    auto later = [](const RunReader* a, const RunReader* b) { return a->after(*b); };
+    auto advance = [&](RunReader& reader) {
+        while (reader.next()) {
+            const auto timestamp = reader.event().timestamp;
+            if (endTimestamp && timestamp > *endTimestamp) {
+                return;
+            }
+            if (!startTimestamp || timestamp >= *startTimestamp) {
+                open.push_back(&reader);
+                std::push_heap(open.begin(), open.end(), later);
+                return;
+            }
+        }
+    };
+
+    std::size_t nextPending = 0;
+    while (true) {
+        // Open every run that may hold the next event; runs are opened lazily so that disjoint
+        // runs are decoded one after the other
+        while (nextPending < pending.size() &&
+               (open.empty() || pending[nextPending].first <= open.front()->event().timestamp)) {
+            // Runs are the chunks at which a query's deadline is checked
+            if (QueryContext::deadlineReached()) {
+                return;
+            }
+            const auto run = pending[nextPending++].second;
+            if (run < series.sealed.size()) {
+                readers.emplace_back(series.sealed[run], run);
+            } else {
+                readers.emplace_back(series, run);
+            }
+            advance(readers.back());
+        }
+        if (open.empty()) {
+            return;
+        }
+
+        std::pop_heap(open.begin(), open.end(), later);
+        RunReader* reader = open.back();
+        open.pop_back();
+        if constexpr (std::is_void_v<std::invoke_result_t<Visitor&, const EventData&>>) {
+            visitor(reader->event());
+        } else if (!visitor(reader->event())) {
+            return;
+        }
+        advance(*reader);
+    }
+}
+
+void TelemetryStorage::seal(EventSeries& series) {
+    // A stable sort keeps late events with equal timestamps in arrival order
+    std::vector<EventData> events;
+    events.reserve(series.head.timestamps.size());
+    scanHead(series, std::nullopt, std::nullopt, [&](const EventData& data) {
+        events.push_back(data);
+    });
+    std::stable_sort(events.begin(), events.end(),
+        [](const EventData& a, const EventData& b) { return a.timestamp < b.timestamp; });
+    series.sealed.push_back(CompressedBlock::encode(events, blockScale(series.precision)));
+    series.head = Head{};
+}
+
+PathAggregate TelemetryStorage::sumHead(const EventSeries& series, std::size_t first, std::size_t last) {
+    const auto& head = series.head;
+    const auto begin = head.offsets[first];
+    const auto end = head.offsets[last];
+
+    PathAggregate aggregate{0.0, last - first};
+    switch (series.precision) {
+    case ValuePrecision::Double:
+        aggregate.sum = std::accumulate(head.doubles.begin() + begin, head.doubles.begin() + end, 0.0);
+        break;
+    case ValuePrecision::Float32:
+        aggregate.sum = std::accumulate(head.floats.begin() + begin, head.floats.begin() + end, 0.0);
+        break;
+    case ValuePrecision::Milliseconds:
+        // Integer milliseconds add up exactly
+        aggregate.sum = static_cast<double>(std::accumulate(
+            head.milliseconds.begin() + begin, head.milliseconds.begin() + end, uint64_t{0})) / 1000.0;
+        break;
+    }
+    return aggregate;
+}
 
 bool TelemetryStorage::saveEvent(const std::string& eventName, 
                                 const std::vector<double>& values, 
                                 uint64_t timestamp) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    events_[eventName].push_back(EventData{values, timestamp});
+    const auto precision = precision_.precisionOf(eventName);
+    if (!std::all_of(values.begin(), values.end(),
+                     [precision](double value) { return isRepresentable(value, precision); })) {
+        return false;
+    }
+
+    tracing::Span span("storage.saveEvent");
+    auto lock = writeLock(saveEventSite);
+    append(eventName, seriesOf(eventName, precision), values, timestamp);
     return true;
 }
 
+std::size_t TelemetryStorage::saveEvents(const std::string& eventName, const std::vector<EventData>& events) {
+    const auto precision = precision_.precisionOf(eventName);
+
+    tracing::Span span("storage.saveEvents");
+    auto lock = writeLock(saveEventsSite);
+    auto& series = seriesOf(eventName, precision);
+    std::size_t saved = 0;
+    for (const auto& event : events) {
+        if (std::all_of(event.values.begin(), event.values.end(),
+                        [precision](double value) { return isRepresentable(value, precision); })) {
+            append(eventName, series, event.values, event.timestamp);
+            ++saved;
+        }
+    }
+    return saved;
+}
+
+TelemetryStorage::EventSeries& TelemetryStorage::seriesOf(const std::string& eventName, ValuePrecision precision) {
+    auto [it, inserted] = events_.try_emplace(eventName);
+    if (inserted) {
+        it->second.precision = precision;
+    }
+    return it->second;
+}
+
+void TelemetryStorage::append(const std::string& eventName, EventSeries& series,
+                              const std::vector<double>& values, uint64_t timestamp) {
+    const auto precision = series.precision;
+    auto& head = series.head;
+    series.version = ++lastVersion_;
+    series.newestTimestamp = std::max(series.newestTimestamp, timestamp);
+    head.timestamps.push_back(timestamp);
+    head.minTimestamp = std::min(head.minTimestamp, timestamp);
+    head.maxTimestamp = std::max(head.maxTimestamp, timestamp);
+    double length = 0.0; // As stored, so that samples agree with exact sums
+    for (double value : values) {
+        switch (precision) {
+        case ValuePrecision::Double:
+            head.doubles.push_back(value);
+            length += value;
+            break;
+        case ValuePrecision::Float32:
+            head.floats.push_back(static_cast<float>(value));
+            length += head.floats.back();
+            break;
+        case ValuePrecision::Milliseconds:
+            head.milliseconds.push_back(static_cast<uint32_t>(std::round(value * 1000.0)));
+            length += head.milliseconds.back() / 1000.0;
+            break;
+        }
+    }
+    head.offsets.push_back(head.offsets.back() + static_cast<uint32_t>(values.size()));
+    sample(series, timestamp, length);
+
+    // Seal a full head into a compressed block; a run overlapping older ones needs compacting
+    if (head.timestamps.size() >= kBlockSize) {
+        const bool overlaps = !series.sealed.empty() && head.minTimestamp < series.sealedMaxTimestamp;
+        series.sealedMaxTimestamp = std::max(series.sealedMaxTimestamp, head.maxTimestamp);
+        seal(series);
+        if (overlaps) {
+            scheduleCompaction(eventName);
+        }
+        if (tiering_.enabled() && coldRunEnd(series) > series.coldBlocks) {
+            scheduleSpill(eventName);
+        }
+    }
+}
+
+std::size_t TelemetryStorage::coldRunEnd(const EventSeries& series) const {
+    // Cold blocks form a prefix of the sealed ones; a block holding a late event keeps the
+    // blocks after it hot until it turns cold as well
+    const uint64_t cutoff = series.newestTimestamp - std::min(series.newestTimestamp, tiering_.hotSeconds);
+    const std::size_t segmentBlocks = std::max<std::size_t>(1, tiering_.segmentBlocks);
+    const std::size_t first = series.coldBlocks;
+    std::size_t last = first;
+    while (last < series.sealed.size() && last - first < segmentBlocks &&
+           series.sealed[last].maxTimestamp() < cutoff) {
+        ++last;
+    }
+    return last - first < segmentBlocks ? first : last;
+}
+
 std::vector<EventData> TelemetryStorage::getFilteredEvents(
     const std::string& eventName, 
     std::optional<uint64_t> startTimestamp, 
     std::optional<uint64_t> endTimestamp) {
     
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    tracing::Span span("storage.getFilteredEvents");
+    auto lock = readLock(getFilteredEventsSite);
     
     auto it = events_.find(eventName);
     if (it == events_.end()) {
         return {};
     }
 
-    const auto& eventList = it->second;
-    
-    // Return early if no events or no filtering needed
-    if (eventList.empty()) {
+    std::vector<EventData> events;
+    scan(it->second, startTimestamp, endTimestamp, [&](const EventData& data) {
+        events.push_back(data);
+    });
+    return events;
+}
+
+PathAggregate TelemetryStorage::aggregateEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("storage.aggregateEvents");
+    auto lock = readLock(aggregateEventsSite);
+
+    auto it = events_.find(eventName);
+    if (it == events_.end()) {
         return {};
     }
-    
-    if (!startTimestamp && !endTimestamp) {
-        return eventList;
+    const auto& series = it->second;
+
+    PathAggregate aggregate;
+    auto add = [&](const PathAggregate& part) {
+        aggregate.sum += part.sum;
+        aggregate.count += part.count;
+    };
+
+    // Reduce the head in place: in one pass over the value column when it lies inside the
+    // range, otherwise over each run of consecutive matching events
+    const auto& head = series.head;
+    const std::size_t events = head.timestamps.size();
+    if (events > 0 && inRange(head.minTimestamp, startTimestamp, endTimestamp) &&
+        inRange(head.maxTimestamp, startTimestamp, endTimestamp)) {
+        add(sumHead(series, 0, events));
+    } else {
+        std::size_t runStart = 0;
+        for (std::size_t i = 0; i <= events; ++i) {
+            if (i == events || !inRange(head.timestamps[i], startTimestamp, endTimestamp)) {
+                if (runStart < i) {
+                    add(sumHead(series, runStart, i));
+                }
+                runStart = i + 1;
+            }
+        }
     }
-    
-    // Filter events by timestamp range
-    auto filteredView = eventList | std::views::filter([&](const EventData& data) {
-        const bool afterStart = !startTimestamp || data.timestamp >= *startTimestamp;
-        const bool beforeEnd = !endTimestamp || data.timestamp <= *endTimestamp;
-        return afterStart && beforeEnd;
+
+    // Sealed blocks from newest to oldest, so that a query cut short by its deadline
+    // still covers the most recent events
+    for (auto block = series.sealed.rbegin(); block != series.sealed.rend(); ++block) {
+        if (QueryContext::deadlineReached()) {
+            return aggregate;
+        }
+        if ((startTimestamp && block->maxTimestamp() < *startTimestamp) ||
+            (endTimestamp && block->minTimestamp() > *endTimestamp)) {
+            continue;
+        }
+
+        // Blocks entirely inside the range contribute their totals without decoding
+        const bool startsInside = !startTimestamp || block->minTimestamp() >= *startTimestamp;
+        const bool endsInside = !endTimestamp || block->maxTimestamp() <= *endTimestamp;
+        if (startsInside && endsInside) {
+            add(block->aggregate());
+            continue;
+        }
+
+        block->forEach([&](const EventData& data) {
+            if (inRange(data.timestamp, startTimestamp, endTimestamp)) {
+                add(PathAggregate{std::accumulate(data.values.begin(), data.values.end(), 0.0), 1});
+            }
+        });
+    }
+    return aggregate;
+}
+
+std::vector<SeriesBucket> TelemetryStorage::aggregateSeries(
+    const std::string& eventName,
+    uint64_t bucketWidth,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    SeriesAccumulator buckets(startTimestamp.value_or(0), bucketWidth);
+
+    tracing::Span span("storage.aggregateSeries");
+    auto lock = readLock(aggregateSeriesSite);
+
+    auto it = events_.find(eventName);
+    if (it == events_.end()) {
+        return {};
+    }
+    const auto& series = it->second;
+
+    // Sweep the head, summing each run of consecutive events that share a bucket in one go
+    const auto& head = series.head;
+    const std::size_t events = head.timestamps.size();
+    std::optional<std::size_t> runStart;
+    for (std::size_t i = 0; i < events; ++i) {
+        const bool inside = inRange(head.timestamps[i], startTimestamp, endTimestamp);
+        if (runStart && (!inside || buckets.bucketStartOf(head.timestamps[i]) !=
+                                    buckets.bucketStartOf(head.timestamps[*runStart]))) {
+            buckets.add(head.timestamps[*runStart], sumHead(series, *runStart, i));
+            runStart.reset();
+        }
+        if (inside && !runStart) {
+            runStart = i;
+        }
+    }
+    if (runStart) {
+        buckets.add(head.timestamps[*runStart], sumHead(series, *runStart, events));
+    }
+
+    // Sealed blocks from newest to oldest, so that a query cut short by its deadline
+    // still covers the most recent events
+    for (auto block = series.sealed.rbegin(); block != series.sealed.rend(); ++block) {
+        if (QueryContext::deadlineReached()) {
+            return buckets.buckets();
+        }
+        if ((startTimestamp && block->maxTimestamp() < *startTimestamp) ||
+            (endTimestamp && block->minTimestamp() > *endTimestamp)) {
+            continue;
+        }
+
+        // A block inside the range that falls into a single bucket is added from its totals
+        const bool startsInside = !startTimestamp || block->minTimestamp() >= *startTimestamp;
+        const bool endsInside = !endTimestamp || block->maxTimestamp() <= *endTimestamp;
+        if (startsInside && endsInside &&
+            buckets.bucketStartOf(block->minTimestamp()) == buckets.bucketStartOf(block->maxTimestamp())) {
+            buckets.add(block->minTimestamp(), block->aggregate());
+            continue;
+        }
+
+        block->forEach([&](const EventData& data) {
+            if (inRange(data.timestamp, startTimestamp, endTimestamp)) {
+                buckets.add(data.timestamp,
+                            PathAggregate{std::accumulate(data.values.begin(), data.values.end(), 0.0), 1});
+            }
+        });
+    }
+    return buckets.buckets();
+}
+
+std::vector<PathAggregate> TelemetryStorage::aggregateWindows(
+    const std::string& eventName,
+    const std::vector<TimeWindow>& windows) {
+
+    WindowAccumulator accumulator(windows);
+
+    tracing::Span span("storage.aggregateWindows");
+    auto lock = readLock(aggregateWindowsSite);
+
+    auto it = events_.find(eventName);
+    if (it == events_.end()) {
+        return accumulator.results();
+    }
+    const auto& series = it->second;
+
+    // Sweep the head, summing each run of consecutive events that share a segment in one go
+    const auto& head = series.head;
+    const std::size_t events = head.timestamps.size();
+    std::optional<std::size_t> runStart;
+    std::optional<std::size_t> runSegment;
+    for (std::size_t i = 0; i < events; ++i) {
+        const auto segment = accumulator.segmentOf(head.timestamps[i]);
+        if (runStart && segment != runSegment) {
+            accumulator.add(*runSegment, sumHead(series, *runStart, i));
+            runStart.reset();
+        }
+        if (segment && !runStart) {
+            runStart = i;
+            runSegment = segment;
+        }
+    }
+    if (runStart) {
+        accumulator.add(*runSegment, sumHead(series, *runStart, events));
+    }
+
+    // Sealed blocks from newest to oldest, so that a query cut short by its deadline
+    // still covers the most recent events
+    for (auto block = series.sealed.rbegin(); block != series.sealed.rend(); ++block) {
+        if (QueryContext::deadlineReached()) {
+            return accumulator.results();
+        }
+        if (!accumulator.overlaps(block->minTimestamp(), block->maxTimestamp())) {
+            continue;
+        }
+
+        // A block that falls into a single segment is added from its totals
+        const auto first = accumulator.segmentOf(block->minTimestamp());
+        if (first && first == accumulator.segmentOf(block->maxTimestamp())) {
+            accumulator.add(*first, block->aggregate());
+            continue;
+        }
+
+        block->forEach([&](const EventData& data) {
+            if (auto segment = accumulator.segmentOf(data.timestamp)) {
+                accumulator.add(*segment,
+                                PathAggregate{std::accumulate(data.values.begin(), data.values.end(), 0.0), 1});
+            }
+        });
+    }
+    return accumulator.results();
+}
+
+void TelemetryStorage::readEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp,
+    EventCursor& cursor,
+    std::size_t maxEvents,
+    std::vector<EventData>& out) {
+
+    tracing::Span span("storage.readEvents");
+    auto lock = readLock(readEventsSite);
+
+    auto it = events_.find(eventName);
+    if (it == events_.end()) {
+        cursor.done = true;
+        return;
+    }
+    const auto& series = it->second;
+
+    // Skip the events of the resume timestamp read by earlier chunks, then fill the chunk
+    const uint64_t resumeAt = cursor.block;
+    uint64_t skip = cursor.offset;
+    std::size_t taken = 0;
+    bool full = false;
+    scan(series, std::max(startTimestamp.value_or(0), resumeAt), endTimestamp, [&](const EventData& data) {
+        if (data.timestamp == resumeAt && skip > 0) {
+            --skip;
+            return true;
+        }
+        if (taken == maxEvents) {
+            full = true;
+            return false;
+        }
+        out.push_back(data);
+        ++taken;
+        if (data.timestamp == cursor.block) {
+            ++cursor.offset;
+        } else {
+            cursor.block = data.timestamp;
+            cursor.offset = 1;
+        }
+        return true;
     });
-    
-    return std::vector<EventData>(filteredView.begin(), filteredView.end());
+    cursor.done = !full;
+}
+
+void TelemetryStorage::sample(EventSeries& series, uint64_t timestamp, double length) {
+    auto& segment = series.segments[timestamp / kSampleSegmentSeconds * kSampleSegmentSeconds];
+    segment.total.sum += length;
+    ++segment.total.count;
+    segment.minTimestamp = std::min(segment.minTimestamp, timestamp);
+    segment.maxTimestamp = std::max(segment.maxTimestamp, timestamp);
+
+    // The i-th event replaces a random slot with probability k / i, keeping the sample uniform
+    if (segment.reservoir.size() < kReservoirSize) {
+        segment.reservoir.push_back(Sample{timestamp, length});
+    } else {
+        auto slot = std::uniform_int_distribution<uint64_t>(0, segment.total.count - 1)(sampler_);
+        if (slot < kReservoirSize) {
+            segment.reservoir[slot] = Sample{timestamp, length};
+        }
+    }
+}
+
+SampledAggregate TelemetryStorage::sampleAggregate(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("storage.sampleAggregate");
+    auto lock = readLock(sampleAggregateSite);
+
+    SampledAggregate result;
+    auto it = events_.find(eventName);
+    if (it == events_.end()) {
+        return result;
+    }
+    const auto& segments = it->second.segments;
+
+    // Segments starting after the range cannot hold matching events
+    auto first = startTimestamp
+        ? segments.lower_bound(*startTimestamp / kSampleSegmentSeconds * kSampleSegmentSeconds)
+        : segments.begin();
+    auto last = endTimestamp ? segments.upper_bound(*endTimestamp) : segments.end();
+
+    for (auto segment = first; segment != last; ++segment) {
+        const auto& part = segment->second;
+        if (inRange(part.minTimestamp, startTimestamp, endTimestamp) &&
+            inRange(part.maxTimestamp, startTimestamp, endTimestamp)) {
+            result.sum += part.total.sum;
+            result.count += static_cast<double>(part.total.count);
+            continue;
+        }
+
+        // The range cuts this segment: estimate its matching share from the sample.
+        // A, B and C are the in-range sample count, sum and sum of squares.
+        const double population = static_cast<double>(part.total.count);
+        const double n = static_cast<double>(part.reservoir.size());
+        double a = 0.0;
+        double b = 0.0;
+        double c = 0.0;
+        for (const auto& sample : part.reservoir) {
+            if (inRange(sample.timestamp, startTimestamp, endTimestamp)) {
+                a += 1.0;
+                b += sample.length;
+                c += sample.length * sample.length;
+            }
+        }
+
+        // A reservoir holding every event of its segment is exact
+        if (n == population) {
+            result.sum += b;
+            result.count += a;
+            continue;
+        }
+
+        result.sum += population * b / n;
+        result.count += population * a / n;
+        result.sampleSize += part.reservoir.size();
+
+        // Linearized variance of the ratio estimator with finite population correction,
+        // expanded as a polynomial in the mean
+        const double weight = population * population * (1.0 - n / population) / (n * (n - 1.0));
+        result.variance[0] += weight * (c - b * b / n);
+        result.variance[1] += weight * (2.0 * a * b / n - 2.0 * b);
+        result.variance[2] += weight * (a - a * a / n);
+    }
+    return result;
+}
+
+std::optional<uint64_t> TelemetryStorage::eventVersion(const std::string& eventName) {
+    auto lock = readLock(eventVersionSite);
+    auto it = events_.find(eventName);
+    return it == events_.end() ? clearedVersion_ : it->second.version;
+}
+
+TelemetryStorage::Frozen TelemetryStorage::freeze() {
+    Frozen frozen;
+    auto lock = readLock(freezeSite);
+    frozen.series_.reserve(events_.size());
+    for (const auto& [eventName, series] : events_) {
+        auto& copy = frozen.series_.emplace_back(eventName, EventSeries{}).second;
+        copy.precision = series.precision;
+        copy.sealed = series.sealed;
+        copy.head = series.head;
+    }
+    return frozen;
+}
+
+bool TelemetryStorage::Frozen::forEachEvent(
+    const std::function<bool(const std::string&, const EventData&)>& visitor) const {
+
+    for (const auto& [eventName, series] : series_) {
+        bool complete = true;
+        scan(series, std::nullopt, std::nullopt, [&](const EventData& data) {
+            complete = visitor(eventName, data);
+            return complete;
+        });
+        if (!complete) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TelemetryStorage::clear() {
+    auto lock = writeLock(clearSite);
+    events_.clear();
+    ++generation_;
+    clearedVersion_ = ++lastVersion_;
+}
+
+TierStats TelemetryStorage::tierStats() {
+    auto lock = readLock(tierStatsSite);
+    TierStats stats;
+    stats.spillFailures = spillFailures_;
+    for (const auto& [eventName, series] : events_) {
+        for (const auto& block : series.sealed) {
+            if (block.isRelocated()) {
+                ++stats.coldBlocks;
+                stats.coldBytes += block.compressedBytes();
+            } else {
+                ++stats.hotBlocks;
+                stats.hotBytes += block.compressedBytes();
+            }
+        }
+    }
+    return stats;
+}
+
+void TelemetryStorage::scheduleCompaction(const std::string& eventName) {
+    std::lock_guard<std::mutex> lock(compactionMutex_);
+    compactionQueue_.insert(eventName);
+    if (!compactor_.joinable()) {
+        compactor_ = std::jthread([this](std::stop_token stop) { runCompactions(stop); });
+    }
+    compactionWake_.notify_one();
+}
+
+void TelemetryStorage::scheduleSpill(const std::string& eventName) {
+    std::lock_guard<std::mutex> lock(compactionMutex_);
+    spillQueue_.insert(eventName);
+    if (!compactor_.joinable()) {
+        compactor_ = std::jthread([this](std::stop_token stop) { runCompactions(stop); });
+    }
+    compactionWake_.notify_one();
+}
+
+void TelemetryStorage::runCompactions(std::stop_token stop) {
+    std::unique_lock<std::mutex> lock(compactionMutex_);
+    while (compactionWake_.wait(lock, stop, [this] { return !compactionQueue_.empty() || !spillQueue_.empty(); })) {
+        const bool merge = !compactionQueue_.empty();
+        auto& queue = merge ? compactionQueue_ : spillQueue_;
+        auto eventName = std::move(queue.extract(queue.begin()).value());
+        compacting_ = true;
+        lock.unlock();
+        if (merge) {
+            compact(eventName);
+        } else {
+            spill(eventName);
+        }
+        lock.lock();
+        compacting_ = false;
+        if (merge) {
+            ++compactions_;
+        }
+        compactionIdle_.notify_all();
+    }
+}
+
+void TelemetryStorage::compact(const std::string& eventName) {
+    tracing::Span span("storage.compact");
+
+    std::vector<CompressedBlock> runs;
+    std::size_t first = 0;
+    std::size_t last = 0;
+    uint64_t generation = 0;
+    ValuePrecision precision = ValuePrecision::Double;
+    {
+        auto lock = readLock(compactReadSite);
+        auto it = events_.find(eventName);
+        if (it == events_.end()) {
+            return;
+        }
+        const auto& series = it->second;
+        const auto& sealed = series.sealed;
+        generation = generation_;
+        precision = series.precision;
+        last = sealed.size();
+
+        // Within the window of recent hot runs, find the first run starting before the end of
+        // an earlier one; every run from there on may hold late events
+        const std::size_t window = std::max(series.coldBlocks, last - std::min(last, kCompactionRuns));
+        std::size_t late = last;
+        uint64_t newest = 0;
+        for (std::size_t run = window; run < last; ++run) {
+            if (run > window && sealed[run].minTimestamp() < newest) {
+                late = run;
+                break;
+            }
+            newest = std::max(newest, sealed[run].maxTimestamp());
+        }
+        if (late == last) {
+            return;
+        }
+
+        // The merge starts at the first run reaching past the oldest late event
+        uint64_t oldestLate = UINT64_MAX;
+        for (std::size_t run = late; run < last; ++run) {
+            oldestLate = std::min(oldestLate, sealed[run].minTimestamp());
+        }
+        first = window;
+        while (sealed[first].maxTimestamp() <= oldestLate) {
+            ++first;
+        }
+        runs.assign(sealed.begin() + first, sealed.begin() + last);
+    }
+
+    // Runs are concatenated oldest first, so a stable sort keeps equal timestamps in run order
+    std::vector<EventData> events;
+    for (const auto& run : runs) {
+        run.forEach([&](const EventData& data) { events.push_back(data); });
+    }
+    std::stable_sort(events.begin(), events.end(),
+        [](const EventData& a, const EventData& b) { return a.timestamp < b.timestamp; });
+
+    std::vector<CompressedBlock> merged;
+    std::vector<EventData> chunk;
+    for (std::size_t begin = 0; begin < events.size(); begin += kBlockSize) {
+        const auto end = std::min(events.size(), begin + kBlockSize);
+        chunk.assign(events.begin() + begin, events.begin() + end);
+        merged.push_back(CompressedBlock::encode(chunk, blockScale(precision)));
+    }
+
+    // Install unless the store was cleared or the runs were spilled meanwhile; runs sealed
+    // since the copy schedule a compaction of their own
+    auto lock = writeLock(compactInstallSite);
+    auto it = events_.find(eventName);
+    if (generation != generation_ || it == events_.end()) {
+        return;
+    }
+    auto& sealed = it->second.sealed;
+    if (it->second.coldBlocks > first || sealed.size() < last) {
+        return;
+    }
+    sealed.erase(sealed.begin() + first, sealed.begin() + last);
+    sealed.insert(sealed.begin() + first,
+                  std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.end()));
+    ++it->second.rewrites;
+}
+
+void TelemetryStorage::spill(const std::string& eventName) {
+    tracing::Span span("storage.spill");
+
+    for (;;) {
+        std::vector<CompressedBlock> run;
+        std::size_t first = 0;
+        std::size_t last = 0;
+        uint64_t generation = 0;
+        uint64_t rewrites = 0;
+        {
+            auto lock = readLock(spillReadSite);
+            auto it = events_.find(eventName);
+            if (it == events_.end()) {
+                return;
+            }
+            const auto& series = it->second;
+            first = series.coldBlocks;
+            last = coldRunEnd(series);
+            if (last == first) {
+                return;
+            }
+            generation = generation_;
+            rewrites = series.rewrites;
+            run.assign(series.sealed.begin() + first, series.sealed.begin() + last);
+        }
+
+        // On failure the blocks stay in memory and are retried after the next seal
+        std::optional<ColdSegment> segment;
+        try {
+            segment.emplace(tiering_.directory, run);
+        } catch (const std::runtime_error&) {
+            auto lock = writeLock(spillInstallSite);
+            ++spillFailures_;
+            return;
+        }
+
+        // Relocate unless the store was cleared or the blocks were rewritten meanwhile; a segment
+        // that is not used is unmapped again once the lock is released
+        auto lock = writeLock(spillInstallSite);
+        auto it = events_.find(eventName);
+        if (generation != generation_ || it == events_.end()) {
+            return;
+        }
+        auto& series = it->second;
+        if (series.rewrites != rewrites || series.coldBlocks != first || series.sealed.size() < last) {
+            return;
+        }
+        segment->relocate(std::span<CompressedBlock>(series.sealed.data() + first, last - first));
+        series.coldBlocks = last;
+    }
+}
+
+void TelemetryStorage::waitForCompactions() {
+    std::unique_lock<std::mutex> lock(compactionMutex_);
+    compactionIdle_.wait(lock, [this] {
+        return compactionQueue_.empty() && spillQueue_.empty() && !compacting_;
+    });
+}
+
+std::size_t TelemetryStorage::compactions() {
+    std::lock_guard<std::mutex> lock(compactionMutex_);
+    return compactions_;
 }
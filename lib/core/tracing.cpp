@@ -0,0 +1,147 @@
+#include "telemetry/tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace tracing {
+
+namespace {
+
+struct SpanRecord {
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+// Spans of one thread; the mutex is only contended while a trace is being written
+struct ThreadBuffer {
+    uint32_t threadId = 0;
+    std::mutex mutex;
+    std::vector<SpanRecord> spans;
+    std::size_t next = 0; // Slot of the next span once the ring is full
+};
+
+std::atomic<uint32_t> sampleEvery{0};
+std::atomic<std::size_t> spansPerThread{16384};
+std::atomic<uint64_t> requestCounter{0};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+uint32_t nextThreadId = 1;
+
+const auto epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        created->threadId = nextThreadId++;
+        registry.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+} // namespace
+
+namespace detail {
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void record(const char* name, uint64_t startNs, uint64_t endNs) {
+    auto& buffer = threadBuffer();
+    const auto capacity = spansPerThread.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.spans.size() < capacity) {
+        buffer.spans.push_back(SpanRecord{name, startNs, endNs});
+    } else if (capacity > 0) {
+        buffer.spans[buffer.next] = SpanRecord{name, startNs, endNs};
+        buffer.next = (buffer.next + 1) % capacity;
+    }
+}
+
+} // namespace detail
+
+void configure(uint32_t every, std::size_t perThread) {
+    sampleEvery.store(every, std::memory_order_relaxed);
+    spansPerThread.store(perThread, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& buffer : registry) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->spans.clear();
+        buffer->next = 0;
+    }
+}
+
+bool enabled() {
+    return sampleEvery.load(std::memory_order_relaxed) != 0;
+}
+
+RequestScope::RequestScope(const char* name) {
+    const auto every = sampleEvery.load(std::memory_order_relaxed);
+    if (every == 0 || detail::threadSampled ||
+        requestCounter.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+        return;
+    }
+    detail::threadSampled = true;
+    name_ = name;
+    startNs_ = detail::nowNs();
+}
+
+RequestScope::~RequestScope() {
+    if (name_ != nullptr) {
+        detail::record(name_, startNs_, detail::nowNs());
+        detail::threadSampled = false;
+    }
+}
+
+std::size_t writeChromeTrace(const std::string& path) {
+    // Copy the spans first so that recording threads are held up as briefly as possible
+    std::vector<std::pair<uint32_t, SpanRecord>> spans;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& buffer : registry) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            for (const auto& span : buffer->spans) {
+                spans.emplace_back(buffer->threadId, span);
+            }
+        }
+    }
+    std::sort(spans.begin(), spans.end(), [](const auto& a, const auto& b) {
+        return a.second.startNs < b.second.startNs;
+    });
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Cannot write trace file " + path);
+    }
+
+    // Complete ("X") events with microsecond timestamps; span names are literals without escapes
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (std::size_t i = 0; i < spans.size(); ++i) {
+        const auto& [threadId, span] = spans[i];
+        file << (i == 0 ? "\n" : ",\n")
+             << "{\"name\":\"" << span.name << "\",\"cat\":\"telemetry\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+             << ",\"ts\":" << static_cast<double>(span.startNs) / 1000.0
+             << ",\"dur\":" << static_cast<double>(span.endNs - span.startNs) / 1000.0 << "}";
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        throw std::runtime_error("Cannot write trace file " + path);
+    }
+    return spans.size();
+}
+
+} // namespace tracing
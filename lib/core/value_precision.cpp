@@ -0,0 +1,58 @@
+#include "telemetry/value_precision.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+ValuePrecision parseValuePrecision(const std::string& name) {
+    if (name == "double") {
+        return ValuePrecision::Double;
+    }
+    if (name == "float32") {
+        return ValuePrecision::Float32;
+    }
+    if (name == "ms") {
+        return ValuePrecision::Milliseconds;
+    }
+    throw std::invalid_argument("Unknown value precision: " + name);
+}
+
+bool isRepresentable(double value, ValuePrecision precision) {
+    switch (precision) {
+    case ValuePrecision::Double:
+        return true;
+
+    case ValuePrecision::Float32:
+        return std::isfinite(value) && std::fabs(value) <= std::numeric_limits<float>::max();
+
+    case ValuePrecision::Milliseconds: {
+        if (!std::isfinite(value) || value < 0.0) {
+            return false;
+        }
+        double milliseconds = value * 1000.0;
+        double whole = std::round(milliseconds);
+        // Allow for the binary rounding of decimal inputs such as 1.234
+        return whole <= static_cast<double>(std::numeric_limits<uint32_t>::max()) &&
+               std::fabs(milliseconds - whole) <= 1e-6;
+    }
+    }
+    return false;
+}
+
+double storedLength(const std::vector<double>& values, ValuePrecision precision) {
+    double length = 0.0;
+    for (double value : values) {
+        switch (precision) {
+        case ValuePrecision::Double:
+            length += value;
+            break;
+        case ValuePrecision::Float32:
+            length += static_cast<float>(value);
+            break;
+        case ValuePrecision::Milliseconds:
+            length += static_cast<uint32_t>(std::round(value * 1000.0)) / 1000.0;
+            break;
+        }
+    }
+    return length;
+}
@@ -0,0 +1,305 @@
+#include "telemetry/storage_stress.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/telemetry_storage.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <latch>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t kBaseTimestamp = 1617235200;
+constexpr std::size_t kValuesPerEvent = 10;
+constexpr std::size_t kFailuresKept = 10;
+constexpr std::size_t kExportChunkEvents = 257; // Odd, so that chunks end mid-block
+
+using Clock = std::chrono::steady_clock;
+
+// Values exact at every storage precision: quarters from 0 to 100
+std::vector<double> randomValues(std::mt19937_64& generator) {
+    std::uniform_int_distribution<int> quarters(0, 400);
+    std::vector<double> values(kValuesPerEvent);
+    for (auto& value : values) {
+        value = quarters(generator) * 0.25;
+    }
+    return values;
+}
+
+double sumOf(const std::vector<double>& values) {
+    return std::accumulate(values.begin(), values.end(), 0.0);
+}
+
+bool eventLess(const EventData& a, const EventData& b) {
+    return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.values < b.values;
+}
+
+bool eventEqual(const EventData& a, const EventData& b) {
+    return a.timestamp == b.timestamp && a.values == b.values;
+}
+
+double micros(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double percentile(std::vector<double>& samples, double quantile) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    auto rank = static_cast<std::size_t>(quantile * static_cast<double>(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+// Sums of quarters are exact, but aggregates may add them in any order
+bool sameSum(double actual, double expected) {
+    return std::abs(actual - expected) <= 1e-9 * std::max(1.0, std::abs(expected));
+}
+
+// Violations found by one thread or by the final check
+struct Findings {
+    std::size_t violations = 0;
+    std::vector<std::string> failures;
+
+    void add(std::string failure) {
+        if (failures.size() < kFailuresKept) {
+            failures.push_back(std::move(failure));
+        }
+        ++violations;
+    }
+
+    void merge(Findings&& other) {
+        violations += other.violations;
+        for (auto& failure : other.failures) {
+            if (failures.size() < kFailuresKept) {
+                failures.push_back(std::move(failure));
+            }
+        }
+    }
+};
+
+// What one worker did: its saves form its part of the reference model
+struct WorkerLog {
+    std::vector<std::pair<std::size_t, EventData>> saved; // By event name index
+    std::vector<double> writeMicros;
+    std::vector<double> readMicros;
+    Clock::time_point started;
+    Clock::time_point finished;
+    Findings findings;
+};
+
+void runWorker(ITelemetryStorage& storage, const StressScenario& scenario,
+               const std::vector<std::string>& names, uint64_t seed, std::latch& start, WorkerLog& log) {
+    std::mt19937_64 generator(seed);
+    ZipfDistribution pickName(names.size(), scenario.zipfExponent);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<uint64_t> ownSaves(names.size(), 0);
+    uint64_t now = kBaseTimestamp;
+
+    log.saved.reserve(static_cast<std::size_t>(scenario.operationsPerThread * scenario.writeRatio * 1.1));
+    log.writeMicros.reserve(log.saved.capacity());
+    log.readMicros.reserve(scenario.operationsPerThread - std::min(scenario.operationsPerThread, log.saved.capacity()));
+
+    start.arrive_and_wait();
+    log.started = Clock::now();
+    for (std::size_t operation = 0; operation < scenario.operationsPerThread; ++operation) {
+        const auto name = pickName(generator);
+
+        if (unit(generator) < scenario.writeRatio) {
+            // Every thread's clock advances with its saves, so threads stay roughly in step
+            uint64_t timestamp = ++now;
+            if (unit(generator) < scenario.lateFraction) {
+                const uint64_t lateness = std::min(now - kBaseTimestamp, scenario.maxLatenessSeconds);
+                timestamp -= std::uniform_int_distribution<uint64_t>(0, lateness)(generator);
+            }
+            auto values = randomValues(generator);
+
+            const auto started = Clock::now();
+            const bool saved = storage.saveEvent(names[name], values, timestamp);
+            log.writeMicros.push_back(micros(Clock::now() - started));
+
+            if (!saved) {
+                log.findings.add("Save of " + names[name] + " at " + std::to_string(timestamp) + " was rejected");
+                continue;
+            }
+            log.saved.emplace_back(name, EventData{std::move(values), timestamp});
+            ++ownSaves[name];
+            continue;
+        }
+
+        // A quarter of the queries cover the whole history and check that this thread's own
+        // saves are all visible; the rest cover a recent window
+        const bool wholeRange = operation % 4 == 0;
+        std::optional<uint64_t> from;
+        std::optional<uint64_t> to;
+        if (!wholeRange) {
+            from = now - std::min<uint64_t>(now - kBaseTimestamp, 600);
+            to = now;
+        }
+
+        const auto started = Clock::now();
+        const auto aggregate = storage.aggregateEvents(names[name], from, to);
+        log.readMicros.push_back(micros(Clock::now() - started));
+
+        if (wholeRange && aggregate.count < ownSaves[name]) {
+            log.findings.add("A thread saw " + std::to_string(aggregate.count) + " events of " + names[name] +
+                             " after saving " + std::to_string(ownSaves[name]) + " itself");
+        }
+    }
+    log.finished = Clock::now();
+}
+
+// Compares what the storage holds for one event name with the model
+void checkSeries(ITelemetryStorage& storage, const std::string& name, std::vector<EventData>& expected,
+                 std::mt19937_64& generator, Findings& findings) {
+    std::sort(expected.begin(), expected.end(), eventLess);
+
+    auto compare = [&](std::vector<EventData> actual, const char* through) {
+        std::sort(actual.begin(), actual.end(), eventLess);
+        if (actual.size() != expected.size()) {
+            findings.add(std::string(through) + " of " + name + " returned " + std::to_string(actual.size()) +
+                         " events, the model holds " + std::to_string(expected.size()));
+        } else if (!std::equal(actual.begin(), actual.end(), expected.begin(), eventEqual)) {
+            findings.add(std::string(through) + " of " + name + " returned events the model does not hold");
+        }
+    };
+    compare(storage.getFilteredEvents(name), "getFilteredEvents");
+
+    std::vector<EventData> exported;
+    EventCursor cursor;
+    while (!cursor.done) {
+        storage.readEvents(name, std::nullopt, std::nullopt, cursor, kExportChunkEvents, exported);
+    }
+    compare(std::move(exported), "readEvents");
+
+    // The whole range, then random ranges cutting through the history
+    auto checkRange = [&](std::optional<uint64_t> from, std::optional<uint64_t> to) {
+        PathAggregate model;
+        for (const auto& event : expected) {
+            if ((!from || event.timestamp >= *from) && (!to || event.timestamp <= *to)) {
+                model.sum += sumOf(event.values);
+                ++model.count;
+            }
+        }
+        auto actual = storage.aggregateEvents(name, from, to);
+        if (actual.count != model.count || !sameSum(actual.sum, model.sum)) {
+            findings.add("aggregateEvents of " + name + " in [" + std::to_string(from.value_or(0)) + ", " +
+                         std::to_string(to.value_or(UINT64_MAX)) + "] returned " + std::to_string(actual.count) +
+                         " events summing to " + std::to_string(actual.sum) + ", the model has " +
+                         std::to_string(model.count) + " summing to " + std::to_string(model.sum));
+        }
+    };
+    checkRange(std::nullopt, std::nullopt);
+    if (!expected.empty()) {
+        std::uniform_int_distribution<uint64_t> anywhere(expected.front().timestamp, expected.back().timestamp);
+        for (int i = 0; i < 3; ++i) {
+            const uint64_t a = anywhere(generator);
+            const uint64_t b = anywhere(generator);
+            checkRange(std::min(a, b), std::max(a, b));
+        }
+    }
+}
+
+} // namespace
+
+StorageRegistry builtinStorages() {
+    StorageRegistry storages;
+    storages["memory"] = [] {
+        return std::make_unique<TelemetryStorage>();
+    };
+    storages["memory-float32"] = [] {
+        return std::make_unique<TelemetryStorage>(PrecisionPolicy{ValuePrecision::Float32, {}});
+    };
+    storages["memory-ms"] = [] {
+        return std::make_unique<TelemetryStorage>(PrecisionPolicy{ValuePrecision::Milliseconds, {}});
+    };
+    storages["sharded"] = [] {
+        return std::make_unique<ShardedStorage>(std::max(1u, std::thread::hardware_concurrency()), false);
+    };
+    storages["tiered"] = [] {
+        // Cold segments are unlinked once mapped, so the directory stays empty
+        auto directory = std::filesystem::temp_directory_path() / ("telemetry-stress-" + std::to_string(::getpid()));
+        std::filesystem::create_directories(directory);
+        return std::make_unique<TelemetryStorage>(PrecisionPolicy{}, TieringPolicy{directory.string(), 600, 4});
+    };
+    return storages;
+}
+
+std::vector<StressScenario> builtinScenarios() {
+    return {
+        {"ingest", 1.0, 0.0, 0.0, 3600, 64, 20000},
+        {"mixed", 0.5, 1.0, 0.01, 3600, 64, 20000},
+        {"read-heavy", 0.1, 1.0, 0.0, 3600, 64, 20000},
+        {"late", 0.9, 0.8, 0.2, 3600, 64, 20000},
+        {"hot-key", 0.5, 1.5, 0.05, 600, 1024, 20000},
+    };
+}
+
+StressResult runStress(const StorageFactory& factory, const StressScenario& scenario,
+                       std::size_t threads, uint64_t seed) {
+    if (threads == 0) {
+        throw std::invalid_argument("A stress run needs at least one thread");
+    }
+    auto storage = factory();
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < scenario.eventNames; ++i) {
+        names.push_back("stress_" + std::to_string(i));
+    }
+
+    // Workers start together once all of them are ready
+    std::vector<WorkerLog> logs(threads);
+    std::latch start(static_cast<std::ptrdiff_t>(threads + 1));
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(runWorker, std::ref(*storage), std::cref(scenario), std::cref(names),
+                             seed * 1000003 + i, std::ref(start), std::ref(logs[i]));
+    }
+    start.arrive_and_wait();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // From the first worker starting to the last one finishing
+    auto started = logs.front().started;
+    auto finished = logs.front().finished;
+    for (const auto& log : logs) {
+        started = std::min(started, log.started);
+        finished = std::max(finished, log.finished);
+    }
+    const auto elapsed = finished - started;
+
+    StressResult result;
+    result.threads = threads;
+    result.operations = static_cast<uint64_t>(threads * scenario.operationsPerThread);
+    result.seconds = std::chrono::duration<double>(elapsed).count();
+    result.operationsPerSecond = result.seconds > 0.0 ? static_cast<double>(result.operations) / result.seconds : 0.0;
+
+    // The workers' logs together are the reference model
+    Findings findings;
+    std::vector<std::vector<EventData>> model(names.size());
+    std::vector<double> writeMicros;
+    std::vector<double> readMicros;
+    for (auto& log : logs) {
+        for (auto& [name, event] : log.saved) {
+            model[name].push_back(std::move(event));
+        }
+        writeMicros.insert(writeMicros.end(), log.writeMicros.begin(), log.writeMicros.end());
+        readMicros.insert(readMicros.end(), log.readMicros.begin(), log.readMicros.end());
+        findings.merge(std::move(log.findings));
+    }
+    result.writeP50Micros = percentile(writeMicros, 0.5);
+    result.writeP99Micros = percentile(writeMicros, 0.99);
+    result.readP50Micros = percentile(readMicros, 0.5);
+    result.readP99Micros = percentile(readMicros, 0.99);
+
+    std::mt19937_64 generator(seed);
+    for (std::size_t name = 0; name < names.size(); ++name) {
+        checkSeries(*storage, names[name], model[name], generator, findings);
+    }
+    result.violations = findings.violations;
+    result.failures = std::move(findings.failures);
+    return result;
+}
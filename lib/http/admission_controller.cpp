@@ -0,0 +1,131 @@
+#include "telemetry/admission_controller.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// Token buckets kept before refilled ones are dropped; a full bucket is the same as none
+constexpr std::size_t kMaxTrackedEvents = 1 << 16;
+
+} // namespace
+
+AdmissionController::Ticket::Ticket(Ticket&& other) noexcept
+    : inFlight_(std::exchange(other.inFlight_, nullptr)),
+      retryAfterSeconds_(other.retryAfterSeconds_) {
+}
+
+AdmissionController::Ticket& AdmissionController::Ticket::operator=(Ticket&& other) noexcept {
+    if (this != &other) {
+        if (inFlight_ != nullptr) {
+            inFlight_->fetch_sub(1, std::memory_order_relaxed);
+        }
+        inFlight_ = std::exchange(other.inFlight_, nullptr);
+        retryAfterSeconds_ = other.retryAfterSeconds_;
+    }
+    return *this;
+}
+
+AdmissionController::Ticket::~Ticket() {
+    if (inFlight_ != nullptr) {
+        inFlight_->fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+AdmissionController::AdmissionController(const ServerConfig& config)
+    : maxInFlightIngest_(config.maxInFlightIngest),
+      maxInFlightQueries_(config.maxInFlightQueries),
+      maxInFlightExports_(config.maxInFlightExports),
+      maxInFlightStreams_(config.maxInFlightStreams),
+      eventRate_(config.eventRateLimit),
+      eventBurst_(std::max(1.0, config.eventRateBurst)) {
+}
+
+bool AdmissionController::enabled() const {
+    return maxInFlightIngest_ > 0 || maxInFlightQueries_ > 0 || maxInFlightExports_ > 0 ||
+           maxInFlightStreams_ > 0 || eventRate_ > 0.0;
+}
+
+AdmissionController::Ticket AdmissionController::admit(AdmissionClass admissionClass, std::string_view eventName) {
+    const bool ingest = admissionClass == AdmissionClass::Ingest;
+    std::atomic<int>* inFlightOfClass = &inFlightQueries_;
+    int limit = maxInFlightQueries_;
+    if (ingest) {
+        inFlightOfClass = &inFlightIngest_;
+        limit = maxInFlightIngest_;
+    } else if (admissionClass == AdmissionClass::Export) {
+        inFlightOfClass = &inFlightExports_;
+        limit = maxInFlightExports_;
+    } else if (admissionClass == AdmissionClass::Stream) {
+        inFlightOfClass = &inFlightStreams_;
+        limit = maxInFlightStreams_;
+    }
+    auto& inFlight = *inFlightOfClass;
+
+    Ticket ticket;
+    if (!acquireSlot(inFlight, limit)) {
+        shedInFlight_.fetch_add(1, std::memory_order_relaxed);
+        ticket.retryAfterSeconds_ = 1;
+        return ticket;
+    }
+    ticket.inFlight_ = &inFlight;
+
+    int retryAfterSeconds = 0;
+    if (ingest && eventRate_ > 0.0 && !takeToken(eventName, retryAfterSeconds)) {
+        shedRate_.fetch_add(1, std::memory_order_relaxed);
+        ticket = Ticket{}; // Gives the slot back
+        ticket.retryAfterSeconds_ = retryAfterSeconds;
+        return ticket;
+    }
+
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    return ticket;
+}
+
+bool AdmissionController::acquireSlot(std::atomic<int>& inFlight, int limit) {
+    // Unlimited classes are still counted for the status report
+    int current = inFlight.load(std::memory_order_relaxed);
+    do {
+        if (limit > 0 && current >= limit) {
+            return false;
+        }
+    } while (!inFlight.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+    return true;
+}
+
+bool AdmissionController::takeToken(std::string_view eventName, int& retryAfterSeconds) {
+    const auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(bucketsMutex_);
+    if (buckets_.size() >= kMaxTrackedEvents) {
+        std::erase_if(buckets_, [&](const auto& entry) {
+            std::chrono::duration<double> idle = now - entry.second.refilledAt;
+            return entry.second.tokens + idle.count() * eventRate_ >= eventBurst_;
+        });
+    }
+
+    auto [it, inserted] = buckets_.try_emplace(std::string(eventName), TokenBucket{eventBurst_, now});
+    auto& bucket = it->second;
+    std::chrono::duration<double> elapsed = now - bucket.refilledAt;
+    bucket.tokens = std::min(eventBurst_, bucket.tokens + elapsed.count() * eventRate_);
+    bucket.refilledAt = now;
+
+    if (bucket.tokens < 1.0) {
+        retryAfterSeconds = std::max(1, static_cast<int>(std::ceil((1.0 - bucket.tokens) / eventRate_)));
+        return false;
+    }
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+std::map<std::string, double> AdmissionController::statusFields() const {
+    return {
+        {"admitted", static_cast<double>(admitted_.load(std::memory_order_relaxed))},
+        {"shedInFlight", static_cast<double>(shedInFlight_.load(std::memory_order_relaxed))},
+        {"shedRateLimited", static_cast<double>(shedRate_.load(std::memory_order_relaxed))},
+        {"inFlightIngest", static_cast<double>(inFlightIngest_.load(std::memory_order_relaxed))},
+        {"inFlightQueries", static_cast<double>(inFlightQueries_.load(std::memory_order_relaxed))},
+        {"inFlightExports", static_cast<double>(inFlightExports_.load(std::memory_order_relaxed))},
+        {"inFlightStreams", static_cast<double>(inFlightStreams_.load(std::memory_order_relaxed))},
+    };
+}
@@ -1,13 +1,107 @@
 #include "telemetry/http_server.h"
+#include "telemetry/server_config.h"
+#include "telemetry/admission_controller.h"
+#include "telemetry/query_context.h"
+#include "telemetry/tracing.h"
+#include "telemetry/instrumented_mutex.h"
+#include "telemetry/binary_codec.h"
+#include "telemetry/json_body.h"
 #include <pistache/endpoint.h>
 #include <pistache/router.h>
 #include <pistache/http.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <charconv>
+#include <chrono>
 
 using json = nlohmann::json;
 
+namespace {
+
+// Body of shed requests, prepared once since it is sent when the server can least afford work
+constexpr std::string_view kOverloadedBody = R"({"error":"Server is overloaded, retry later"})";
+
+// Content type of every JSON response, parsed once instead of per response
+const Pistache::Http::Mime::MediaType& jsonMediaType() {
+    static const auto mediaType = Pistache::Http::Mime::MediaType::fromString("application/json");
+    return mediaType;
+}
+
+// Windows of one batch query; combining them costs up to windows x segments additions
+constexpr std::size_t kMaxWindows = 1024;
+
+// FNV-1a hash of text, continuing from hash
+uint64_t fnv1a(std::string_view text, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Whether an If-None-Match header value lists tag; weak tags compare by their opaque part
+bool matchesEntityTag(std::string_view header, std::string_view tag) {
+    while (!header.empty()) {
+        auto comma = header.find(',');
+        auto candidate = header.substr(0, comma);
+        header = comma == std::string_view::npos ? std::string_view() : header.substr(comma + 1);
+
+        while (!candidate.empty() && candidate.front() == ' ') {
+            candidate.remove_prefix(1);
+        }
+        while (!candidate.empty() && candidate.back() == ' ') {
+            candidate.remove_suffix(1);
+        }
+        if (candidate.starts_with("W/")) {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == "*" || candidate == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Events read from storage per chunk of an export; the storage lock is held for one chunk
+constexpr std::size_t kExportChunkEvents = 1024;
+
+// Appends an event as one line of NDJSON: {"timestamp":...,"values":[...]}
+void appendNdjson(const EventData& event, std::string& out) {
+    char number[32];
+    out += R"({"timestamp":)";
+    out.append(number, std::to_chars(number, number + sizeof(number), event.timestamp).ptr);
+    out += R"(,"values":[)";
+    for (std::size_t i = 0; i < event.values.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out.append(number, std::to_chars(number, number + sizeof(number), event.values[i]).ptr);
+    }
+    out += "]}\n";
+}
+
+// Appends an event as u64 timestamp, u16 value count and f64 values, all little-endian
+void appendBinary(const EventData& event, std::string& out) {
+    ByteWriter writer(out);
+    writer.putU64(event.timestamp);
+    writer.putU16(static_cast<uint16_t>(event.values.size()));
+    for (double value : event.values) {
+        writer.putDouble(value);
+    }
+}
+
+} // namespace
+
 // Private implementation of the HTTP server class
 class TelemetryHttpServer::Impl {
 public:
@@ -15,42 +109,140 @@ public:
         : config_(config), 
           processor_(processor),
           router_(),
-          httpEndpoint_(std::make_shared<Pistache::Http::Endpoint>(Pistache::Address(config_.address, config_.port))) {
-        
-        // Configure the HTTP endpoint
+          admission_(config_),
+          instance_(std::random_device{}()) {
+        validateServerConfig(config_);
+        if (config_.traceSampleEvery > 0) {
+            tracing::configure(static_cast<uint32_t>(config_.traceSampleEvery));
+        }
+        if (admission_.enabled()) {
+            statusProviders_.push_back(&admission_);
+        }
+
+        // Configure the HTTP endpoints; with several listeners each one gets its own socket on the
+        // shared port and its own workers, and the kernel spreads new connections across them
         auto options = Pistache::Http::Endpoint::options()
             .threads(config_.threadCount)
-            .flags(Pistache::Tcp::Options::ReuseAddr);
-        
-        httpEndpoint_->init(options);
+            .backlog(config_.backlog)
+            .maxRequestSize(config_.maxRequestSize);
+        if (config_.listenerCount > 1) {
+            options.flags(Pistache::Tcp::Options::ReuseAddr | Pistache::Tcp::Options::ReusePort);
+        } else {
+            options.flags(Pistache::Tcp::Options::ReuseAddr);
+        }
+        if (config_.headerTimeoutMs > 0) {
+            options.headerTimeout(std::chrono::milliseconds(config_.headerTimeoutMs));
+        }
+        if (config_.bodyTimeoutMs > 0) {
+            options.bodyTimeout(std::chrono::milliseconds(config_.bodyTimeoutMs));
+        }
+        if (config_.keepAliveTimeoutMs > 0) {
+            options.keepaliveTimeout(std::chrono::milliseconds(config_.keepAliveTimeoutMs));
+        }
+
+        for (int i = 0; i < config_.listenerCount; ++i) {
+            auto endpoint = std::make_shared<Pistache::Http::Endpoint>(Pistache::Address(config_.address, config_.port));
+            endpoint->init(options);
+            endpoints_.push_back(std::move(endpoint));
+        }
         setupRoutes();
     }
 
+    // Response coroutines write through this object from the processor's threads, so it outlives
+    // them even when stop() was never called
+    ~Impl() {
+        waitForAsyncResponses();
+    }
+
     bool run() {
+        // Start pushing rolling means to stream subscribers
+        publisher_ = std::jthread([this](std::stop_token stopToken) {
+            publishRollingMeans(stopToken);
+        });
+        exporter_ = std::jthread([this](std::stop_token stopToken) {
+            runExports(stopToken);
+        });
+
         std::cout << "Starting server on " << config_.address << ":" << config_.port 
-                  << " with " << config_.threadCount << " threads" << std::endl;
+                  << " with " << config_.listenerCount << " listener(s) of "
+                  << config_.threadCount << " threads" << std::endl;
         
+        std::size_t started = 0;
         try {
-            // Start the server
-            httpEndpoint_->serve();
+            // Extra listeners accept on their own threads; the first one blocks this thread
+            for (started = 1; started < endpoints_.size(); ++started) {
+                endpoints_[started]->serveThreaded();
+            }
+            endpoints_.front()->serve();
             return true;
         } catch (const std::exception& e) {
             std::cerr << "Error starting server: " << e.what() << std::endl;
+            for (std::size_t i = 1; i < started; ++i) {
+                endpoints_[i]->shutdown();
+            }
             return false;
         }
     }
 
     void stop() {
-        httpEndpoint_->shutdown();
+        stopPublisher();
+        stopExporter();
+
+        // Pending responses write through the endpoint's transport, which shutdown() destroys
+        waitForAsyncResponses();
+        for (auto& endpoint : endpoints_) {
+            endpoint->shutdown();
+        }
+    }
+
+    void addStatusProvider(IStatusProvider& provider) {
+        statusProviders_.push_back(&provider);
     }
 
 private:
+    // Open server-sent event stream of one rolling window
+    struct MeanSubscriber {
+        std::shared_ptr<IRollingMean> window;
+        double unitScale;
+        Pistache::Http::ResponseStream stream;
+        AdmissionController::Ticket ticket; // A stream occupies a stream slot until it is dropped
+    };
+
+    // Raw event export in progress, written one chunk at a time by the exporter thread
+    struct EventExport {
+        std::string eventName;
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        bool binary;
+        EventCursor cursor;
+        std::weak_ptr<Pistache::Tcp::Peer> peer; // Expires with the connection, unlike its fd number
+        std::shared_ptr<std::atomic<std::size_t>> queued; // Sent bytes the transport has not yet written
+        Pistache::Http::ResponseStream stream;
+        AdmissionController::Ticket ticket; // An export occupies an export slot until it ends
+    };
+
+    // Serializes a structured body; flat bodies on hot paths are built with JsonBody instead
     void sendJsonResponse(Pistache::Http::ResponseWriter& response, 
                           Pistache::Http::Code code, 
                           const json& body) {
-        response.headers().add<Pistache::Http::Header::ContentType>(
-            Pistache::Http::Mime::MediaType::fromString("application/json"));
-        response.send(code, body.dump());
+        tracing::Span span("http.serialize");
+        auto text = body.dump();
+        response.send(code, text.data(), text.size(), jsonMediaType());
+    }
+
+    // Sends a preformatted JSON body without copying it
+    static void sendBody(Pistache::Http::ResponseWriter& response,
+                         Pistache::Http::Code code,
+                         std::string_view body) {
+        tracing::Span span("http.serialize");
+        response.send(code, body.data(), body.size(), jsonMediaType());
+    }
+
+    // Sends {"error":message}, formatted in the thread's response buffer
+    static void sendError(Pistache::Http::ResponseWriter& response,
+                          Pistache::Http::Code code,
+                          std::string_view message) {
+        sendBody(response, code, JsonBody::error(message));
     }
 
     void setupRoutes() {
@@ -59,39 +251,58 @@ private:
         // Set up the routes - use router_ directly, not a shared_ptr
         Routes::Post(router_, "/paths/:event", Routes::bind(&Impl::saveEvent, this));
         Routes::Get(router_, "/paths/:event/meanLength", Routes::bind(&Impl::getMeanLength, this));
+        Routes::Get(router_, "/paths/:event/meanLength/stream", Routes::bind(&Impl::streamMeanLength, this));
+        Routes::Get(router_, "/paths/:event/series", Routes::bind(&Impl::getSeries, this));
+        Routes::Get(router_, "/paths/:event/windows", Routes::bind(&Impl::getWindows, this));
+        Routes::Get(router_, "/paths/:event/events", Routes::bind(&Impl::exportEvents, this));
+        Routes::Get(router_, "/meanLength", Routes::bind(&Impl::getMeanLengthAcrossEvents, this));
+        Routes::Get(router_, "/aggregates", Routes::bind(&Impl::getAggregates, this));
+        Routes::Put(router_, "/standing/:name", Routes::bind(&Impl::putStandingQuery, this));
+        Routes::Get(router_, "/standing/:name", Routes::bind(&Impl::getStandingQuery, this));
+        Routes::Delete(router_, "/standing/:name", Routes::bind(&Impl::deleteStandingQuery, this));
+        Routes::Get(router_, "/status", Routes::bind(&Impl::getStatus, this));
+        Routes::Post(router_, "/trace/dump", Routes::bind(&Impl::dumpTrace, this));
+        Routes::Get(router_, "/stats/locks", Routes::bind(&Impl::getLockStats, this));
+        Routes::Delete(router_, "/stats/locks", Routes::bind(&Impl::resetLockStats, this));
 
         // Set up a catch-all 404 handler
         router_.addNotFoundHandler(Routes::bind(&Impl::notFoundHandler, this));
 
-        // Install the router
-        httpEndpoint_->setHandler(router_.handler());
+        // Install the router on every listener
+        for (auto& endpoint : endpoints_) {
+            endpoint->setHandler(router_.handler());
+        }
     }
 
     void saveEvent(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("POST /paths/:event");
+
         // Get event name from route parameter
         auto eventName = request.param(":event").as<std::string>();
+
+        // Shed load before spending anything on the body
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Ingest, eventName, response, ticket)) {
+            return;
+        }
         
         // Parse JSON body from request
         json requestBody;
-        try {
-            requestBody = json::parse(request.body());
-        } catch (const json::exception& e) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", std::string("Invalid JSON: ") + e.what()}});
+        if (!parseRequestBody(request, response, requestBody)) {
             return;
         }
 
         // Validate request body
         if (!requestBody.contains("values") || !requestBody.contains("date")) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", "Missing required fields: values, date"}});
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "Missing required fields: values, date");
             return;
         }
 
         // Extract and validate values
         if (!requestBody["values"].is_array()) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", "Values must be an array"}});
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "Values must be an array");
             return;
         }
 
@@ -100,15 +311,15 @@ private:
             values.reserve(10);  // Preallocate capacity for exactly 10 elements
             for (const auto& val : requestBody["values"]) {
                 if (!val.is_number()) {
-                    sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                        json{{"error", "All values must be numeric"}});
+                    sendError(response, Pistache::Http::Code::Bad_Request,
+                        "All values must be numeric");
                     return;
                 }
                 values.push_back(val.get<double>());
             }
         } catch (const json::exception& e) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                json{{"error", std::string("Invalid values array: ") + e.what()}});
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                std::string("Invalid values array: ") + e.what());
             return;
         }
         
@@ -116,131 +327,1245 @@ private:
         uint64_t timestamp;
         try {
             if (!requestBody["date"].is_number_integer()) {
-                sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                    json{{"error", "Date must be an integer timestamp"}});
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "Date must be an integer timestamp");
                 return;
             }
             timestamp = requestBody["date"].get<uint64_t>();
         } catch (const json::exception& e) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                json{{"error", std::string("Invalid date format: ") + e.what()}});
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                std::string("Invalid date format: ") + e.what());
             return;
         }
 
-        // Process the event
-        if (!processor_.saveEvent(eventName, values, timestamp)) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", "Values array must contain exactly 10 elements"}});
-            return;
+        // Process the event; the answer is sent once the processor's task completes
+        startResponse([&] {
+            return respondToSave(std::move(response), std::move(ticket), std::move(eventName),
+                                 std::move(values), timestamp);
+        });
+    }
+
+    // Answers an ingest once the processor has saved the event. With persistence enabled it
+    // resumes on the completion thread once the event is durable, keeping the worker free;
+    // the admission slot is held until then.
+    DetachedTask respondToSave(Pistache::Http::ResponseWriter response,
+                               AdmissionController::Ticket ticket,
+                               std::string eventName,
+                               std::vector<double> values,
+                               uint64_t timestamp) {
+        std::optional<SaveStatus> status;
+        std::exception_ptr failure;
+        try {
+            status = co_await processor_.saveEventTask(std::move(eventName), std::move(values), timestamp);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+
+        if (!status) {
+            sendProcessorFailure(response, failure);
+        } else {
+            switch (*status) {
+            case SaveStatus::Saved:
+                sendBody(response, Pistache::Http::Code::Ok, kEmptyJsonBody);
+                break;
+            case SaveStatus::Rejected:
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "Values array must contain exactly 10 values representable at the configured precision");
+                break;
+            case SaveStatus::Failed:
+                sendError(response, Pistache::Http::Code::Internal_Server_Error,
+                    "Event could not be persisted");
+                break;
+            }
+        }
+        ticket = {};
+        endAsyncResponse();
+    }
+
+    // Starts a response coroutine, which must end with endAsyncResponse() after giving back its
+    // admission slot, since the server may be gone once that returns. It runs on this worker
+    // until it first suspends and is then resumed, and answers, on whichever thread completes
+    // what it awaits. Query contexts in its frame leave the worker with it.
+    void startResponse(const std::function<DetachedTask()>& coroutine) {
+        auto* outer = QueryContext::current();
+        beginAsyncResponse();
+        coroutine();
+        QueryContext::detachAbove(outer);
+    }
+
+    // Admits a request or answers 503 with a Retry-After hint; ticket holds the admitted slot
+    bool admit(AdmissionClass admissionClass,
+               std::string_view eventName,
+               Pistache::Http::ResponseWriter& response,
+               AdmissionController::Ticket& ticket) {
+        ticket = admission_.admit(admissionClass, eventName);
+        if (ticket) {
+            return true;
         }
 
-        // Return success response
-        sendJsonResponse(response, Pistache::Http::Code::Ok, json::object());
+        response.headers().addRaw(Pistache::Http::Header::Raw("Retry-After", std::to_string(ticket.retryAfterSeconds())));
+        sendBody(response, Pistache::Http::Code::Service_Unavailable, kOverloadedBody);
+        return false;
+    }
+
+    // Tracks responses completed off the request thread so that stop() can wait for them
+    void beginAsyncResponse() {
+        std::lock_guard<std::mutex> lock(asyncResponsesMutex_);
+        ++asyncResponses_;
+    }
+
+    void endAsyncResponse() {
+        std::lock_guard<std::mutex> lock(asyncResponsesMutex_);
+        if (--asyncResponses_ == 0) {
+            asyncResponsesDone_.notify_all();
+        }
+    }
+
+    // Waits without a timeout: a response resumed after the server is gone would write through a
+    // destroyed object. Every awaited task ends on its own, at the latest when the cluster
+    // client's request timeout or the write-ahead log's flush completes it.
+    void waitForAsyncResponses() {
+        std::unique_lock<std::mutex> lock(asyncResponsesMutex_);
+        asyncResponsesDone_.wait(lock, [this] { return asyncResponses_ == 0; });
+    }
+
+    // Parses the JSON request body, answering 400 when it is malformed
+    bool parseRequestBody(const Pistache::Rest::Request& request,
+                          Pistache::Http::ResponseWriter& response,
+                          json& requestBody) {
+        try {
+            tracing::Span span("http.parse");
+            requestBody = json::parse(request.body());
+            return true;
+        } catch (const json::exception& e) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                std::string("Invalid JSON: ") + e.what());
+            return false;
+        }
+    }
+
+    // Extracts the mandatory resultUnit field, answering 400 when it is invalid
+    bool parseResultUnit(const json& requestBody,
+                         Pistache::Http::ResponseWriter& response,
+                         std::string& resultUnit) {
+        if (!requestBody.contains("resultUnit")) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "Missing required field: resultUnit");
+            return false;
+        }
+
+        if (!requestBody["resultUnit"].is_string()) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "resultUnit must be a string");
+            return false;
+        }
+
+        try {
+            resultUnit = requestBody["resultUnit"].get<std::string>();
+        } catch (const json::exception& e) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                std::string("Invalid resultUnit format: ") + e.what());
+            return false;
+        }
+
+        if (resultUnit != "seconds" && resultUnit != "milliseconds") {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "resultUnit must be 'seconds' or 'milliseconds'");
+            return false;
+        }
+        return true;
+    }
+
+    // Extracts one optional integer timestamp field, answering 400 when it is invalid
+    bool parseTimestamp(const json& requestBody,
+                        Pistache::Http::ResponseWriter& response,
+                        const char* field,
+                        std::optional<uint64_t>& timestamp) {
+        if (!requestBody.contains(field)) {
+            return true;
+        }
+
+        try {
+            if (!requestBody[field].is_number_integer()) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    std::string(field) + " must be an integer");
+                return false;
+            }
+            timestamp = requestBody[field].get<uint64_t>();
+            return true;
+        } catch (const json::exception& e) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                std::string("Invalid ") + field + " format: " + e.what());
+            return false;
+        }
+    }
+
+    // Extracts the optional startTimestamp/endTimestamp filters, answering 400 when they are invalid
+    bool parseTimeRange(const json& requestBody,
+                        Pistache::Http::ResponseWriter& response,
+                        std::optional<uint64_t>& startTimestamp,
+                        std::optional<uint64_t>& endTimestamp) {
+        if (!parseTimestamp(requestBody, response, "startTimestamp", startTimestamp) ||
+            !parseTimestamp(requestBody, response, "endTimestamp", endTimestamp)) {
+            return false;
+        }
+
+        if (startTimestamp && endTimestamp && *startTimestamp > *endTimestamp) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "startTimestamp must be less than or equal to endTimestamp");
+            return false;
+        }
+        return true;
+    }
+
+    // Extracts the mandatory positive bucketSeconds field, answering 400 when it is invalid
+    bool parseBucketSeconds(const json& requestBody,
+                            Pistache::Http::ResponseWriter& response,
+                            uint64_t& bucketSeconds) {
+        if (!requestBody.contains("bucketSeconds") || !requestBody["bucketSeconds"].is_number_integer() ||
+            requestBody["bucketSeconds"].get<int64_t>() <= 0) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "bucketSeconds must be a positive integer");
+            return false;
+        }
+        bucketSeconds = requestBody["bucketSeconds"].get<uint64_t>();
+        return true;
+    }
+
+    // Extracts the mandatory windows array of {startTimestamp, endTimestamp} objects, answering 400
+    // when it is invalid
+    bool parseWindows(const json& requestBody,
+                      Pistache::Http::ResponseWriter& response,
+                      std::vector<TimeWindow>& windows) {
+        if (!requestBody.contains("windows") || !requestBody["windows"].is_array() ||
+            requestBody["windows"].empty() || requestBody["windows"].size() > kMaxWindows) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "windows must be an array of 1 to " + std::to_string(kMaxWindows) + " time windows");
+            return false;
+        }
+
+        for (const auto& window : requestBody["windows"]) {
+            if (!window.is_object() ||
+                !window.contains("startTimestamp") || !window["startTimestamp"].is_number_unsigned() ||
+                !window.contains("endTimestamp") || !window["endTimestamp"].is_number_unsigned()) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "Every window needs integer startTimestamp and endTimestamp fields");
+                return false;
+            }
+            TimeWindow parsed{window["startTimestamp"].get<uint64_t>(), window["endTimestamp"].get<uint64_t>()};
+            if (parsed.start > parsed.end) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "startTimestamp must be less than or equal to endTimestamp");
+                return false;
+            }
+            windows.push_back(parsed);
+        }
+        return true;
+    }
+
+    // Installs the query deadline: the server's queryTimeoutMs, shortened by an optional timeoutMs
+    // of the request. allowPartial asks for the data covered by the deadline instead of a 504.
+    bool parseDeadline(const json& requestBody,
+                       Pistache::Http::ResponseWriter& response,
+                       std::optional<QueryContext>& context) {
+        uint64_t timeoutMs = config_.queryTimeoutMs > 0 ? static_cast<uint64_t>(config_.queryTimeoutMs) : 0;
+        if (requestBody.contains("timeoutMs")) {
+            if (!requestBody["timeoutMs"].is_number_integer() || requestBody["timeoutMs"].get<int64_t>() <= 0) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "timeoutMs must be a positive integer");
+                return false;
+            }
+            auto requested = requestBody["timeoutMs"].get<uint64_t>();
+            timeoutMs = timeoutMs == 0 ? requested : std::min(timeoutMs, requested);
+        }
+
+        bool allowPartial = false;
+        if (requestBody.contains("allowPartial")) {
+            if (!requestBody["allowPartial"].is_boolean()) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "allowPartial must be a boolean");
+                return false;
+            }
+            allowPartial = requestBody["allowPartial"].get<bool>();
+        }
+
+        if (timeoutMs > 0) {
+            context.emplace(QueryContext::Clock::now() + std::chrono::milliseconds(timeoutMs), allowPartial);
+        }
+        return true;
+    }
+
+    // Marks a result that the deadline cut short
+    static void flagPartial(const std::optional<QueryContext>& context, json& result) {
+        if (context && context->partial()) {
+            result["partial"] = true;
+        }
+    }
+
+    // Extracts the optional approximate flag and its maxRelativeError budget, answering 400 when
+    // they are invalid. An estimate whose confidence interval exceeds the budget is not returned.
+    bool parseApproximation(const json& requestBody,
+                            Pistache::Http::ResponseWriter& response,
+                            bool& approximate,
+                            std::optional<double>& maxRelativeError) {
+        if (requestBody.contains("approximate")) {
+            if (!requestBody["approximate"].is_boolean()) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "approximate must be a boolean");
+                return false;
+            }
+            approximate = requestBody["approximate"].get<bool>();
+        }
+
+        if (requestBody.contains("maxRelativeError")) {
+            if (!requestBody["maxRelativeError"].is_number() || requestBody["maxRelativeError"].get<double>() <= 0.0) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "maxRelativeError must be a positive number");
+                return false;
+            }
+            maxRelativeError = requestBody["maxRelativeError"].get<double>();
+        }
+        return true;
+    }
+
+    // Whether the 95% confidence interval of an estimate is within the relative error budget
+    static bool withinErrorBudget(const SampledAggregate& estimate, const std::optional<double>& maxRelativeError) {
+        const double margin = estimate.marginOfError();
+        return !maxRelativeError || margin == 0.0 || margin <= *maxRelativeError * std::abs(estimate.mean());
+    }
+
+    // Adds the confidence interval and sample size of an estimate to a result
+    static void describeEstimate(const SampledAggregate& estimate, double scale, json& result) {
+        const double mean = estimate.mean() * scale;
+        const double margin = estimate.marginOfError() * scale;
+        result["approximate"] = true;
+        result["confidenceInterval"] = json::array({mean - margin, mean + margin});
+        result["confidenceLevel"] = 0.95;
+        result["sampleSize"] = estimate.sampleSize;
+    }
+
+    // Extracts the mandatory non-empty events array, answering 400 when it is invalid
+    bool parseEventNames(const json& requestBody,
+                         Pistache::Http::ResponseWriter& response,
+                         std::vector<std::string>& eventNames) {
+        if (!requestBody.contains("events") || !requestBody["events"].is_array() ||
+            requestBody["events"].empty()) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "events must be a non-empty array of event names");
+            return false;
+        }
+
+        for (const auto& name : requestBody["events"]) {
+            if (!name.is_string()) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "events must contain only strings");
+                return false;
+            }
+            eventNames.push_back(name.get<std::string>());
+        }
+        return true;
+    }
+
+    // Runs a processor call, answering with an error status when its backend cannot serve it
+    template <typename Call>
+    bool invokeProcessor(Pistache::Http::ResponseWriter& response, Call&& call) {
+        try {
+            call();
+            return true;
+        } catch (const UnsupportedOperationError& e) {
+            sendError(response, Pistache::Http::Code::Not_Implemented, e.what());
+        } catch (const BackendUnavailableError& e) {
+            sendError(response, Pistache::Http::Code::Service_Unavailable, e.what());
+        } catch (const QueryTimeoutError& e) {
+            sendError(response, Pistache::Http::Code::Gateway_Timeout, e.what());
+        }
+        return false;
+    }
+
+    // Answers a failure caught in a response coroutine as invokeProcessor would; nothing may
+    // escape a coroutine that nobody awaits, so anything else is answered with 500
+    void sendProcessorFailure(Pistache::Http::ResponseWriter& response, std::exception_ptr failure) {
+        try {
+            invokeProcessor(response, [&] { std::rethrow_exception(failure); });
+        } catch (const std::exception& e) {
+            sendError(response, Pistache::Http::Code::Internal_Server_Error, e.what());
+        } catch (...) {
+            sendError(response, Pistache::Http::Code::Internal_Server_Error, "Unknown error");
+        }
+    }
+
+    // Entity tag of the response to a query over eventNames: the version of their events, with a
+    // hash of the request and of this server instance, so that a tag only matches the same
+    // request over unchanged data. nullopt if the processor cannot version the events.
+    std::optional<std::string> entityTag(const Pistache::Rest::Request& request,
+                                         const std::vector<std::string>& eventNames) {
+        auto version = processor_.eventsVersion(eventNames);
+        if (!version) {
+            return std::nullopt;
+        }
+
+        const uint64_t hash = fnv1a(request.body(), fnv1a(request.resource(), instance_));
+        char tag[2 * 16 + 4] = {'"'};
+        auto end = std::to_chars(tag + 1, tag + sizeof(tag), *version, 16).ptr;
+        *end++ = '-';
+        end = std::to_chars(end, tag + sizeof(tag), hash, 16).ptr;
+        *end++ = '"';
+        return std::string(tag, end);
+    }
+
+    // Answers 304 Not Modified, without running the query, when If-None-Match lists etag
+    bool notModified(const Pistache::Rest::Request& request,
+                     Pistache::Http::ResponseWriter& response,
+                     const std::optional<std::string>& etag) {
+        if (!etag) {
+            return false;
+        }
+        auto header = request.headers().tryGetRaw("If-None-Match");
+        if (!header || !matchesEntityTag(header->value(), *etag)) {
+            return false;
+        }
+
+        addCacheHeaders(response, etag, std::nullopt);
+        response.send(Pistache::Http::Code::Not_Modified);
+        return true;
+    }
+
+    // Lets a client keep a complete result under its entity tag, revalidating it on every use.
+    // Queries are parameterised by the request body, which caches do not key on, so the result
+    // is private and never reused unchecked. Results the deadline cut short are not stored at all.
+    void addCacheHeaders(Pistache::Http::ResponseWriter& response,
+                         const std::optional<std::string>& etag,
+                         const std::optional<QueryContext>& context) {
+        if (context && context->partial()) {
+            response.headers().addRaw(Pistache::Http::Header::Raw("Cache-Control", "no-store"));
+        } else if (etag) {
+            response.headers()
+                .addRaw(Pistache::Http::Header::Raw("ETag", *etag))
+                .addRaw(Pistache::Http::Header::Raw("Cache-Control", "private, no-cache"));
+        }
     }
 
     void getMeanLength(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /paths/:event/meanLength");
+
         // Get event name from route parameter
         auto eventName = request.param(":event").as<std::string>();
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, eventName, response, ticket)) {
+            return;
+        }
         
-        // Parse JSON body from request
+        // Parse and validate the request body
         json requestBody;
+        std::string resultUnit;
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        std::optional<QueryContext> context;
+        bool approximate = false;
+        std::optional<double> maxRelativeError;
+        if (!parseRequestBody(request, response, requestBody) ||
+            !parseResultUnit(requestBody, response, resultUnit) ||
+            !parseTimeRange(requestBody, response, startTimestamp, endTimestamp) ||
+            !parseDeadline(requestBody, response, context) ||
+            !parseApproximation(requestBody, response, approximate, maxRelativeError)) {
+            return;
+        }
+
+        auto etag = entityTag(request, {eventName});
+        if (notModified(request, response, etag)) {
+            return;
+        }
+
+        // Answer from samples unless the estimate misses the error budget
+        if (approximate) {
+            SampledAggregate estimate;
+            if (!invokeProcessor(response, [&] {
+                    estimate = processor_.calculateSampledAggregates({eventName}, startTimestamp, endTimestamp).front();
+                })) {
+                return;
+            }
+            if (withinErrorBudget(estimate, maxRelativeError)) {
+                const double scale = resultUnit == "milliseconds" ? 1000.0 : 1.0;
+                json result{{"mean", estimate.mean() * scale}};
+                describeEstimate(estimate, scale, result);
+                flagPartial(context, result);
+                addCacheHeaders(response, etag, context);
+                sendJsonResponse(response, Pistache::Http::Code::Ok, result);
+                return;
+            }
+        }
+        
+        // Calculate the mean; the answer is sent once the processor's task completes
+        std::optional<std::pair<QueryContext::Clock::time_point, bool>> deadline;
+        if (context) {
+            deadline.emplace(context->deadline(), context->allowPartial());
+        }
+        startResponse([&] {
+            return respondWithMean(std::move(response), std::move(ticket), std::move(eventName),
+                                   startTimestamp, endTimestamp, deadline,
+                                   resultUnit == "milliseconds" ? 1000.0 : 1.0, approximate, std::move(etag));
+        });
+    }
+
+    // Answers an exact mean query once the processor's task completes. The deadline goes into a
+    // context of the coroutine's own, which the task picks up before it first suspends.
+    DetachedTask respondWithMean(Pistache::Http::ResponseWriter response,
+                                 AdmissionController::Ticket ticket,
+                                 std::string eventName,
+                                 std::optional<uint64_t> startTimestamp,
+                                 std::optional<uint64_t> endTimestamp,
+                                 std::optional<std::pair<QueryContext::Clock::time_point, bool>> deadline,
+                                 double scale,
+                                 bool approximate,
+                                 std::optional<std::string> etag) {
+        std::optional<QueryContext> context;
+        if (deadline) {
+            context.emplace(deadline->first, deadline->second);
+        }
+
+        std::optional<double> mean;
+        std::exception_ptr failure;
         try {
-            requestBody = json::parse(request.body());
-        } catch (const json::exception& e) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", std::string("Invalid JSON: ") + e.what()}});
+            mean = co_await processor_.calculateMeanLengthTask(std::move(eventName), startTimestamp, endTimestamp);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        if (!mean) {
+            sendProcessorFailure(response, failure);
+            ticket = {};
+            endAsyncResponse();
+            co_return;
+        }
+
+        JsonBody result;
+        result.add("mean", *mean * scale);
+        if (approximate) {
+            result.add("approximate", false);
+        }
+        if (context && context->partial()) {
+            result.add("partial", true);
+        }
+        addCacheHeaders(response, etag, context);
+        sendBody(response, Pistache::Http::Code::Ok, result.finish());
+        ticket = {};
+        endAsyncResponse();
+    }
+
+    void getSeries(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /paths/:event/series");
+
+        // Get event name from route parameter
+        auto eventName = request.param(":event").as<std::string>();
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, eventName, response, ticket)) {
             return;
         }
 
-        // Validate request body
-        if (!requestBody.contains("resultUnit")) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", "Missing required field: resultUnit"}});
+        // Parse and validate the request body
+        json requestBody;
+        std::string resultUnit;
+        uint64_t bucketSeconds = 0;
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        std::optional<QueryContext> context;
+        if (!parseRequestBody(request, response, requestBody) ||
+            !parseResultUnit(requestBody, response, resultUnit) ||
+            !parseBucketSeconds(requestBody, response, bucketSeconds) ||
+            !parseTimeRange(requestBody, response, startTimestamp, endTimestamp) ||
+            !parseDeadline(requestBody, response, context)) {
             return;
         }
 
-        // Validate result unit
-        if (!requestBody["resultUnit"].is_string()) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                json{{"error", "resultUnit must be a string"}});
+        auto etag = entityTag(request, {eventName});
+        if (notModified(request, response, etag)) {
+            return;
+        }
+
+        std::vector<SeriesBucket> buckets;
+        if (!invokeProcessor(response, [&] {
+                buckets = processor_.calculateSeries(eventName, bucketSeconds, startTimestamp, endTimestamp);
+            })) {
             return;
         }
 
+        // One point per non-empty bucket, in time order
+        const double scale = resultUnit == "milliseconds" ? 1000.0 : 1.0;
+        json points = json::array();
+        for (const auto& bucket : buckets) {
+            points.push_back(json{
+                {"bucketStart", bucket.bucketStart},
+                {"mean", bucket.aggregate.count == 0 ? 0.0 : bucket.aggregate.sum / bucket.aggregate.count * scale},
+                {"count", bucket.aggregate.count}});
+        }
+        json result{{"buckets", points}};
+        flagPartial(context, result);
+        addCacheHeaders(response, etag, context);
+        sendJsonResponse(response, Pistache::Http::Code::Ok, result);
+    }
+
+    void getWindows(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /paths/:event/windows");
+
+        // Get event name from route parameter
+        auto eventName = request.param(":event").as<std::string>();
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, eventName, response, ticket)) {
+            return;
+        }
+
+        // Parse and validate the request body
+        json requestBody;
         std::string resultUnit;
-        try {
-            resultUnit = requestBody["resultUnit"].get<std::string>();
-        } catch (const json::exception& e) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                json{{"error", std::string("Invalid resultUnit format: ") + e.what()}});
+        std::vector<TimeWindow> windows;
+        std::optional<QueryContext> context;
+        if (!parseRequestBody(request, response, requestBody) ||
+            !parseResultUnit(requestBody, response, resultUnit) ||
+            !parseWindows(requestBody, response, windows) ||
+            !parseDeadline(requestBody, response, context)) {
             return;
         }
 
-        if (resultUnit != "seconds" && resultUnit != "milliseconds") {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", "resultUnit must be 'seconds' or 'milliseconds'"}});
+        auto etag = entityTag(request, {eventName});
+        if (notModified(request, response, etag)) {
             return;
         }
 
-        // Extract optional timestamp filters
+        std::vector<PathAggregate> aggregates;
+        if (!invokeProcessor(response, [&] { aggregates = processor_.calculateWindows(eventName, windows); })) {
+            return;
+        }
+
+        // One result per window, in request order
+        const double scale = resultUnit == "milliseconds" ? 1000.0 : 1.0;
+        json results = json::array();
+        for (const auto& aggregate : aggregates) {
+            results.push_back(json{
+                {"mean", aggregate.count == 0 ? 0.0 : aggregate.sum / aggregate.count * scale},
+                {"count", aggregate.count}});
+        }
+        json result{{"windows", results}};
+        flagPartial(context, result);
+        addCacheHeaders(response, etag, context);
+        sendJsonResponse(response, Pistache::Http::Code::Ok, result);
+    }
+
+    void getMeanLengthAcrossEvents(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /meanLength");
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, {}, response, ticket)) {
+            return;
+        }
+
+        // Parse and validate the request body
+        json requestBody;
+        std::string resultUnit;
+        std::vector<std::string> eventNames;
         std::optional<uint64_t> startTimestamp;
         std::optional<uint64_t> endTimestamp;
+        std::optional<QueryContext> context;
+        bool approximate = false;
+        std::optional<double> maxRelativeError;
+        if (!parseRequestBody(request, response, requestBody) ||
+            !parseEventNames(requestBody, response, eventNames) ||
+            !parseResultUnit(requestBody, response, resultUnit) ||
+            !parseTimeRange(requestBody, response, startTimestamp, endTimestamp) ||
+            !parseDeadline(requestBody, response, context) ||
+            !parseApproximation(requestBody, response, approximate, maxRelativeError)) {
+            return;
+        }
 
-        if (requestBody.contains("startTimestamp")) {
-            try {
-                if (!requestBody["startTimestamp"].is_number_integer()) {
-                    sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                        json{{"error", "startTimestamp must be an integer"}});
-                    return;
-                }
-                startTimestamp = requestBody["startTimestamp"].get<uint64_t>();
-            } catch (const json::exception& e) {
-                sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                    json{{"error", std::string("Invalid startTimestamp format: ") + e.what()}});
+        auto etag = entityTag(request, eventNames);
+        if (notModified(request, response, etag)) {
+            return;
+        }
+        const double scale = resultUnit == "milliseconds" ? 1000.0 : 1.0;
+
+        // Answer from samples unless the overall estimate misses the error budget
+        if (approximate) {
+            std::vector<SampledAggregate> estimates;
+            if (!invokeProcessor(response, [&] {
+                    estimates = processor_.calculateSampledAggregates(eventNames, startTimestamp, endTimestamp);
+                })) {
+                return;
+            }
+
+            SampledAggregate total;
+            json perEvent = json::object();
+            for (std::size_t i = 0; i < eventNames.size(); ++i) {
+                perEvent[eventNames[i]] = json{{"mean", estimates[i].mean() * scale},
+                                               {"count", std::llround(estimates[i].count)}};
+                total.merge(estimates[i]);
+            }
+            if (withinErrorBudget(total, maxRelativeError)) {
+                json result{{"mean", total.mean() * scale}, {"count", std::llround(total.count)}, {"events", perEvent}};
+                describeEstimate(total, scale, result);
+                flagPartial(context, result);
+                addCacheHeaders(response, etag, context);
+                sendJsonResponse(response, Pistache::Http::Code::Ok, result);
                 return;
             }
         }
 
-        if (requestBody.contains("endTimestamp")) {
-            try {
-                if (!requestBody["endTimestamp"].is_number_integer()) {
-                    sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                        json{{"error", "endTimestamp must be an integer"}});
-                    return;
-                }
-                endTimestamp = requestBody["endTimestamp"].get<uint64_t>();
-            } catch (const json::exception& e) {
-                sendJsonResponse(response, Pistache::Http::Code::Bad_Request,
-                    json{{"error", std::string("Invalid endTimestamp format: ") + e.what()}});
+        std::vector<PathAggregate> aggregates;
+        if (!invokeProcessor(response, [&] {
+                aggregates = processor_.calculateAggregates(eventNames, startTimestamp, endTimestamp);
+            })) {
+            return;
+        }
+
+        // Report every event and the mean over all of them
+        auto meanOf = [scale](const PathAggregate& aggregate) {
+            return aggregate.count == 0 ? 0.0 : aggregate.sum / aggregate.count * scale;
+        };
+
+        PathAggregate total;
+        json perEvent = json::object();
+        for (std::size_t i = 0; i < eventNames.size(); ++i) {
+            perEvent[eventNames[i]] = json{{"mean", meanOf(aggregates[i])}, {"count", aggregates[i].count}};
+            total.sum += aggregates[i].sum;
+            total.count += aggregates[i].count;
+        }
+
+        json result{{"mean", meanOf(total)}, {"count", total.count}, {"events", perEvent}};
+        if (approximate) {
+            result["approximate"] = false;
+        }
+        flagPartial(context, result);
+        addCacheHeaders(response, etag, context);
+        sendJsonResponse(response, Pistache::Http::Code::Ok, result);
+    }
+
+    void getAggregates(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /aggregates");
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, {}, response, ticket)) {
+            return;
+        }
+
+        // Parse and validate the request body
+        json requestBody;
+        std::vector<std::string> eventNames;
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        std::optional<QueryContext> context;
+        bool approximate = false;
+        std::optional<double> maxRelativeError;
+        if (!parseRequestBody(request, response, requestBody) ||
+            !parseEventNames(requestBody, response, eventNames) ||
+            !parseTimeRange(requestBody, response, startTimestamp, endTimestamp) ||
+            !parseDeadline(requestBody, response, context) ||
+            !parseApproximation(requestBody, response, approximate, maxRelativeError)) {
+            return;
+        }
+
+        auto etag = entityTag(request, eventNames);
+        if (notModified(request, response, etag)) {
+            return;
+        }
+
+        // Raw estimates with their variance terms, which routers merge before taking the mean
+        if (approximate) {
+            std::vector<SampledAggregate> estimates;
+            if (!invokeProcessor(response, [&] {
+                    estimates = processor_.calculateSampledAggregates(eventNames, startTimestamp, endTimestamp);
+                })) {
+                return;
+            }
+
+            json partials = json::array();
+            for (const auto& estimate : estimates) {
+                partials.push_back(json{{"sum", estimate.sum},
+                                        {"count", estimate.count},
+                                        {"sampleSize", estimate.sampleSize},
+                                        {"variance", estimate.variance}});
+            }
+            json result{{"aggregates", partials}, {"approximate", true}};
+            flagPartial(context, result);
+            addCacheHeaders(response, etag, context);
+            sendJsonResponse(response, Pistache::Http::Code::Ok, result);
+            return;
+        }
+
+        std::vector<PathAggregate> aggregates;
+        if (!invokeProcessor(response, [&] {
+                aggregates = processor_.calculateAggregates(eventNames, startTimestamp, endTimestamp);
+            })) {
+            return;
+        }
+
+        // Raw partial results in request order, for routers to merge
+        json partials = json::array();
+        for (const auto& aggregate : aggregates) {
+            partials.push_back(json{{"sum", aggregate.sum}, {"count", aggregate.count}});
+        }
+        json result{{"aggregates", partials}};
+        flagPartial(context, result);
+        addCacheHeaders(response, etag, context);
+        sendJsonResponse(response, Pistache::Http::Code::Ok, result);
+    }
+
+    void streamMeanLength(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        // Get event name from route parameter
+        auto eventName = request.param(":event").as<std::string>();
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Stream, eventName, response, ticket)) {
+            return;
+        }
+
+        // Stream parameters come from the query string so that EventSource clients can subscribe
+        uint64_t windowSeconds = 300;
+        if (auto window = request.query().get("window")) {
+            auto [end, ec] = std::from_chars(window->data(), window->data() + window->size(), windowSeconds);
+            if (ec != std::errc() || end != window->data() + window->size() || windowSeconds == 0) {
+                sendError(response, Pistache::Http::Code::Bad_Request,
+                    "window must be a positive integer number of seconds");
                 return;
             }
         }
 
+        std::string resultUnit = request.query().get("resultUnit").value_or("seconds");
+        if (resultUnit != "seconds" && resultUnit != "milliseconds") {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "resultUnit must be 'seconds' or 'milliseconds'");
+            return;
+        }
+
+        std::shared_ptr<IRollingMean> window;
+        if (!invokeProcessor(response, [&] { window = processor_.subscribeRollingMean(eventName, windowSeconds); })) {
+            return;
+        }
+
+        // Open the event stream and push the current state right away
+        response.headers()
+            .add<Pistache::Http::Header::ContentType>(
+                Pistache::Http::Mime::MediaType::fromString("text/event-stream"))
+            .addRaw(Pistache::Http::Header::Raw("Cache-Control", "no-cache"));
+
+        MeanSubscriber subscriber{window, resultUnit == "milliseconds" ? 1000.0 : 1.0,
+                                  response.stream(Pistache::Http::Code::Ok), std::move(ticket)};
+        if (!pushRollingMean(subscriber, window->snapshot())) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        subscribers_.push_back(std::move(subscriber));
+    }
+
+    static bool pushRollingMean(MeanSubscriber& subscriber, const RollingMeanSnapshot& snapshot) {
+        auto event = JsonBody().add("mean", snapshot.mean * subscriber.unitScale).add("count", snapshot.count).finish();
+        try {
+            subscriber.stream.write("data: ", 6);
+            subscriber.stream.write(event.data(), static_cast<std::streamsize>(event.size()));
+            subscriber.stream.write("\n\n", 2);
+            subscriber.stream.flush();
+            return true;
+        } catch (const std::exception&) {
+            // The peer went away
+            return false;
+        }
+    }
+
+    void publishRollingMeans(std::stop_token stopToken) {
+        const auto interval = std::chrono::milliseconds(config_.streamIntervalMs);
+
+        std::unique_lock<std::mutex> lock(subscribersMutex_);
+        while (!publisherWake_.wait_for(lock, stopToken, interval,
+                                        [&stopToken] { return stopToken.stop_requested(); })) {
+            // Subscribers of the same window share a single snapshot per tick
+            std::unordered_map<IRollingMean*, RollingMeanSnapshot> snapshots;
+            std::erase_if(subscribers_, [&](MeanSubscriber& subscriber) {
+                auto [it, inserted] = snapshots.try_emplace(subscriber.window.get());
+                if (inserted) {
+                    it->second = subscriber.window->snapshot();
+                }
+                return !pushRollingMean(subscriber, it->second);
+            });
+        }
+    }
+
+    void stopPublisher() {
+        if (publisher_.joinable()) {
+            publisher_.request_stop();
+            publisher_.join();
+        }
+
+        // Terminate open streams so clients see a clean end of response
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        for (auto& subscriber : subscribers_) {
+            try {
+                subscriber.stream.ends();
+            } catch (const std::exception&) {
+            }
+        }
+        subscribers_.clear();
+    }
+
+    // Parses an optional integer timestamp from the query string, answering 400 when it is invalid
+    bool parseQueryTimestamp(const Pistache::Rest::Request& request,
+                             Pistache::Http::ResponseWriter& response,
+                             const char* field,
+                             std::optional<uint64_t>& timestamp) {
+        auto text = request.query().get(field);
+        if (!text) {
+            return true;
+        }
+        uint64_t value = 0;
+        auto [end, ec] = std::from_chars(text->data(), text->data() + text->size(), value);
+        if (ec != std::errc() || end != text->data() + text->size()) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                std::string(field) + " must be an integer");
+            return false;
+        }
+        timestamp = value;
+        return true;
+    }
+
+    void exportEvents(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /paths/:event/events");
+
+        auto eventName = request.param(":event").as<std::string>();
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Export, eventName, response, ticket)) {
+            return;
+        }
+
+        // Export parameters come from the query string so that plain downloads work
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        if (!parseQueryTimestamp(request, response, "startTimestamp", startTimestamp) ||
+            !parseQueryTimestamp(request, response, "endTimestamp", endTimestamp)) {
+            return;
+        }
         if (startTimestamp && endTimestamp && *startTimestamp > *endTimestamp) {
-            sendJsonResponse(response, Pistache::Http::Code::Bad_Request, 
-                json{{"error", "startTimestamp must be less than or equal to endTimestamp"}});
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "startTimestamp must be less than or equal to endTimestamp");
+            return;
+        }
+        std::string format = request.query().get("format").value_or("ndjson");
+        if (format != "ndjson" && format != "binary") {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "format must be 'ndjson' or 'binary'");
             return;
         }
-        
-        // Calculate the mean
-        double mean = processor_.calculateMeanLength(eventName, startTimestamp, endTimestamp);
 
-        // Convert to milliseconds if requested
-        if (resultUnit == "milliseconds") {
-            mean *= 1000;
+        // The first chunk is read here so that unsupported roles fail with a proper status
+        EventCursor cursor;
+        std::vector<EventData> events;
+        if (!invokeProcessor(response, [&] {
+                processor_.readEvents(eventName, startTimestamp, endTimestamp, cursor, kExportChunkEvents, events);
+            })) {
+            return;
         }
 
-        // Return result
-        sendJsonResponse(response, Pistache::Http::Code::Ok, json{{"mean", mean}});
+        response.headers().add<Pistache::Http::Header::ContentType>(
+            Pistache::Http::Mime::MediaType::fromString(
+                format == "binary" ? "application/octet-stream" : "application/x-ndjson"));
+        EventExport job{eventName, startTimestamp, endTimestamp, format == "binary", cursor, response.peer(),
+                        std::make_shared<std::atomic<std::size_t>>(0),
+                        response.stream(Pistache::Http::Code::Ok), std::move(ticket)};
+        try {
+            job.stream.flush(); // Headers; the chunks follow through the peer
+        } catch (const std::exception&) {
+            return;
+        }
+        if (!writeExportChunk(job, events) || job.cursor.done) {
+            return;
+        }
+
+        // Larger exports continue on the exporter thread, paced by the reader
+        {
+            std::lock_guard<std::mutex> lock(exportsMutex_);
+            pendingExports_.push_back(std::move(job));
+        }
+        exporterWake_.notify_one();
+    }
+
+    // Writes one chunk of events, ending the response after the last one. The chunk is framed
+    // here and sent through the peer, whose promise tells when the transport has written it to
+    // the socket; until then it counts as queued.
+    // Returns false once the export is over, because it is complete or the peer went away.
+    static bool writeExportChunk(EventExport& job, const std::vector<EventData>& events) {
+        std::string chunk;
+        chunk.reserve(events.size() * 128);
+        for (const auto& event : events) {
+            if (job.binary) {
+                appendBinary(event, chunk);
+            } else {
+                appendNdjson(event, chunk);
+            }
+        }
+
+        try {
+            auto peer = job.peer.lock();
+            if (!peer) {
+                return false;
+            }
+            if (!chunk.empty()) {
+                char size[2 * sizeof(std::size_t) + 2];
+                auto end = std::to_chars(size, size + sizeof(size), chunk.size(), 16).ptr;
+                *end++ = '\r';
+                *end++ = '\n';
+                chunk.insert(0, size, static_cast<std::size_t>(end - size));
+                chunk += "\r\n";
+
+                const std::size_t bytes = chunk.size();
+                auto queued = job.queued;
+                queued->fetch_add(bytes, std::memory_order_relaxed);
+                peer->send(Pistache::RawBuffer(std::move(chunk), bytes))
+                    .then([queued, bytes](ssize_t) { queued->fetch_sub(bytes, std::memory_order_relaxed); },
+                          [queued, bytes](std::exception_ptr) { queued->fetch_sub(bytes, std::memory_order_relaxed); });
+            }
+            if (job.cursor.done) {
+                job.stream.ends();
+                return false;
+            }
+            return true;
+        } catch (const std::exception&) {
+            // The peer went away
+            return false;
+        }
+    }
+
+    // Advances every open export by one chunk per round. An export whose previous chunk is still
+    // queued in the transport is skipped, so a stalled reader pins at most one chunk besides the
+    // socket's own send buffer.
+    void runExports(std::stop_token stopToken) {
+        std::vector<EventExport> active;
+        std::vector<EventData> events;
+        events.reserve(kExportChunkEvents);
+
+        while (!stopToken.stop_requested()) {
+            {
+                std::unique_lock<std::mutex> lock(exportsMutex_);
+                if (active.empty()) {
+                    exporterWake_.wait(lock, stopToken, [this] { return !pendingExports_.empty(); });
+                }
+                std::move(pendingExports_.begin(), pendingExports_.end(), std::back_inserter(active));
+                pendingExports_.clear();
+            }
+
+            bool progressed = false;
+            std::erase_if(active, [&](EventExport& job) {
+                if (job.peer.expired()) {
+                    return true;
+                }
+                if (job.queued->load(std::memory_order_relaxed) > 0) {
+                    return false;
+                }
+                progressed = true;
+                events.clear();
+                try {
+                    processor_.readEvents(job.eventName, job.startTimestamp, job.endTimestamp,
+                                          job.cursor, kExportChunkEvents, events);
+                } catch (const std::exception&) {
+                    // Headers are gone already; cutting the stream short tells the client
+                    return true;
+                }
+                return !writeExportChunk(job, events);
+            });
+
+            // Every reader is behind; give the sockets time to drain
+            if (!progressed && !active.empty()) {
+                std::unique_lock<std::mutex> lock(exportsMutex_);
+                exporterWake_.wait_for(lock, stopToken, std::chrono::milliseconds(5),
+                                       [this] { return !pendingExports_.empty(); });
+            }
+        }
+
+        // Exports cut short by shutdown end their responses so that clients see the stream close
+        for (auto& job : active) {
+            try {
+                job.stream.ends();
+            } catch (const std::exception&) {
+            }
+        }
+    }
+
+    void stopExporter() {
+        if (exporter_.joinable()) {
+            exporter_.request_stop();
+            exporter_.join();
+        }
+
+        std::lock_guard<std::mutex> lock(exportsMutex_);
+        for (auto& job : pendingExports_) {
+            try {
+                job.stream.ends();
+            } catch (const std::exception&) {
+            }
+        }
+        pendingExports_.clear();
+    }
+
+    void putStandingQuery(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("PUT /standing/:name");
+
+        auto name = request.param(":name").as<std::string>();
+
+        // Defining a query scans the event's history once, so it is admitted as a query
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, {}, response, ticket)) {
+            return;
+        }
+
+        json requestBody;
+        std::optional<uint64_t> startTimestamp;
+        std::optional<uint64_t> endTimestamp;
+        if (!parseRequestBody(request, response, requestBody) ||
+            !parseTimeRange(requestBody, response, startTimestamp, endTimestamp)) {
+            return;
+        }
+        if (!requestBody.contains("event") || !requestBody["event"].is_string()) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "event must be a string");
+            return;
+        }
+        auto eventName = requestBody["event"].get<std::string>();
+
+        std::optional<PathAggregate> aggregate;
+        if (!invokeProcessor(response, [&] {
+                processor_.registerStandingQuery(name, eventName, startTimestamp, endTimestamp);
+                aggregate = processor_.readStandingQuery(name);
+            })) {
+            return;
+        }
+        sendStandingQuery(response, aggregate.value_or(PathAggregate{}), 1.0);
+    }
+
+    void getStandingQuery(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("GET /standing/:name");
+
+        auto name = request.param(":name").as<std::string>();
+
+        AdmissionController::Ticket ticket;
+        if (!admit(AdmissionClass::Query, {}, response, ticket)) {
+            return;
+        }
+
+        // Dashboards poll this, so it takes the query string like the rolling mean stream
+        std::string resultUnit = request.query().get("resultUnit").value_or("seconds");
+        if (resultUnit != "seconds" && resultUnit != "milliseconds") {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                "resultUnit must be 'seconds' or 'milliseconds'");
+            return;
+        }
+
+        std::optional<PathAggregate> aggregate;
+        if (!invokeProcessor(response, [&] { aggregate = processor_.readStandingQuery(name); })) {
+            return;
+        }
+        if (!aggregate) {
+            sendError(response, Pistache::Http::Code::Not_Found, "No standing query with this name");
+            return;
+        }
+        sendStandingQuery(response, *aggregate, resultUnit == "milliseconds" ? 1000.0 : 1.0);
+    }
+
+    void deleteStandingQuery(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        tracing::RequestScope trace("DELETE /standing/:name");
+
+        auto name = request.param(":name").as<std::string>();
+
+        bool removed = false;
+        if (!invokeProcessor(response, [&] { removed = processor_.removeStandingQuery(name); })) {
+            return;
+        }
+        if (!removed) {
+            sendError(response, Pistache::Http::Code::Not_Found, "No standing query with this name");
+            return;
+        }
+        sendBody(response, Pistache::Http::Code::Ok, JsonBody().add("removed", true).finish());
+    }
+
+    static void sendStandingQuery(Pistache::Http::ResponseWriter& response, const PathAggregate& aggregate, double scale) {
+        const double mean = aggregate.count > 0 ? aggregate.sum / static_cast<double>(aggregate.count) : 0.0;
+        sendBody(response, Pistache::Http::Code::Ok,
+                 JsonBody().add("mean", mean * scale).add("count", aggregate.count).finish());
+    }
+
+    void getStatus(const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+        json status = json::object();
+        for (const auto* provider : statusProviders_) {
+            status[provider->statusName()] = provider->statusFields();
+        }
+        sendJsonResponse(response, Pistache::Http::Code::Ok, status);
+    }
+
+    void dumpTrace(const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+        if (!tracing::enabled()) {
+            sendError(response, Pistache::Http::Code::Bad_Request,
+                             "Tracing is disabled; start the server with --trace-sample");
+            return;
+        }
+        try {
+            auto spans = tracing::writeChromeTrace(config_.traceFile);
+            sendJsonResponse(response, Pistache::Http::Code::Ok,
+                             json{{"path", config_.traceFile}, {"spans", spans}});
+        } catch (const std::exception& e) {
+            sendError(response, Pistache::Http::Code::Internal_Server_Error, e.what());
+        }
+    }
+
+    static json lockModeJson(const lockstats::ModeStats& stats) {
+        return json{{"acquisitions", stats.acquisitions},
+                    {"contended", stats.contended},
+                    {"totalWaitNs", stats.totalWaitNs},
+                    {"maxWaitNs", stats.maxWaitNs},
+                    {"totalHoldNs", stats.totalHoldNs},
+                    {"maxHoldNs", stats.maxHoldNs},
+                    {"waitHistogram", stats.waitHistogram},
+                    {"holdHistogram", stats.holdHistogram}};
+    }
+
+    void getLockStats(const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+        json sites = json::array();
+        for (const auto& site : lockstats::snapshot()) {
+            sites.push_back(json{{"lock", site.lockName},
+                                 {"site", site.siteName},
+                                 {"shared", lockModeJson(site.shared)},
+                                 {"exclusive", lockModeJson(site.exclusive)}});
+        }
+        sendJsonResponse(response, Pistache::Http::Code::Ok,
+                         json{{"enabled", lockstats::enabled()}, {"sites", sites}});
+    }
+
+    void resetLockStats(const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+        lockstats::reset();
+        sendJsonResponse(response, Pistache::Http::Code::Ok, json{{"reset", true}});
     }
 
     void notFoundHandler(const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
-        sendJsonResponse(response, Pistache::Http::Code::Not_Found, json{{"error", "Resource not found"}});
+        sendError(response, Pistache::Http::Code::Not_Found, "Resource not found");
     }
 
     ServerConfig config_;
     ITelemetryProcessor& processor_;
     Pistache::Rest::Router router_;
-    std::shared_ptr<Pistache::Http::Endpoint> httpEndpoint_;
+    AdmissionController admission_;
+    const uint64_t instance_;        // Keeps entity tags from matching across restarts
+    std::vector<std::shared_ptr<Pistache::Http::Endpoint>> endpoints_;
+    std::vector<IStatusProvider*> statusProviders_;
+
+    std::mutex asyncResponsesMutex_;
+    std::condition_variable asyncResponsesDone_;
+    std::size_t asyncResponses_ = 0;
+
+    std::mutex subscribersMutex_;
+    std::condition_variable_any publisherWake_;
+    std::vector<MeanSubscriber> subscribers_;
+    std::jthread publisher_;
+
+    std::mutex exportsMutex_;
+    std::condition_variable_any exporterWake_;
+    std::vector<EventExport> pendingExports_; // Handed over to the exporter thread
+    std::jthread exporter_;
 };
 
 // Implementation of the public interface
@@ -257,3 +1582,7 @@ bool TelemetryHttpServer::run() {
 void TelemetryHttpServer::stop() {
     pImpl->stop();
 }
+
+void TelemetryHttpServer::addStatusProvider(IStatusProvider& provider) {
+    pImpl->addStatusProvider(provider);
+}
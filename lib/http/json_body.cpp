@@ -0,0 +1,111 @@
+#include "telemetry/json_body.h"
+#include <charconv>
+#include <cmath>
+
+namespace {
+
+// Grows to the largest body this thread has built and is then reused
+std::string& threadBuffer() {
+    thread_local std::string buffer = [] {
+        std::string initial;
+        initial.reserve(256);
+        return initial;
+    }();
+    return buffer;
+}
+
+} // namespace
+
+JsonBody::JsonBody() : buffer_(threadBuffer()) {
+    buffer_.clear();
+    buffer_.push_back('{');
+}
+
+JsonBody& JsonBody::add(std::string_view name, double value) {
+    key(name);
+    appendNumber(buffer_, value);
+    return *this;
+}
+
+JsonBody& JsonBody::add(std::string_view name, uint64_t value) {
+    key(name);
+    char digits[24];
+    buffer_.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+    return *this;
+}
+
+JsonBody& JsonBody::add(std::string_view name, bool value) {
+    key(name);
+    buffer_.append(value ? "true" : "false");
+    return *this;
+}
+
+JsonBody& JsonBody::add(std::string_view name, std::string_view value) {
+    key(name);
+    appendString(buffer_, value);
+    return *this;
+}
+
+std::string_view JsonBody::finish() {
+    buffer_.push_back('}');
+    return buffer_;
+}
+
+std::string_view JsonBody::error(std::string_view message) {
+    return JsonBody().add("error", message).finish();
+}
+
+void JsonBody::appendNumber(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        out.append("null");
+        return;
+    }
+    char digits[32];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+    if (std::string_view(digits, static_cast<std::size_t>(end - digits)).find_first_of(".e") == std::string_view::npos) {
+        out.append(".0");
+    }
+}
+
+void JsonBody::appendString(std::string& out, std::string_view text) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out.append("\\u00");
+                out.push_back(kHex[(c >> 4) & 0xf]);
+                out.push_back(kHex[c & 0xf]);
+            } else {
+                out.push_back(c);
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+void JsonBody::key(std::string_view name) {
+    if (!first_) {
+        buffer_.push_back(',');
+    }
+    first_ = false;
+    appendString(buffer_, name);
+    buffer_.push_back(':');
+}
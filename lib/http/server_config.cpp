@@ -0,0 +1,113 @@
+#include "telemetry/server_config.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Reads a non-negative number setting into target when the key is present
+template <typename T>
+void readSetting(const json& settings, const char* key, T& target) {
+    if (!settings.contains(key)) {
+        return;
+    }
+    const auto& value = settings[key];
+    if constexpr (std::is_floating_point_v<T>) {
+        if (!value.is_number() || value.get<double>() < 0.0) {
+            throw std::runtime_error(std::string("Config setting ") + key + " must be a non-negative number");
+        }
+    } else if (!value.is_number_integer() || value.get<int64_t>() < 0) {
+        throw std::runtime_error(std::string("Config setting ") + key + " must be a non-negative integer");
+    }
+    target = value.get<T>();
+}
+
+} // namespace
+
+void applyConfigFile(const std::string& path, ServerConfig& config) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open config file " + path);
+    }
+
+    json settings;
+    try {
+        settings = json::parse(file);
+    } catch (const json::exception& e) {
+        throw std::runtime_error("Invalid config file " + path + ": " + e.what());
+    }
+    if (!settings.is_object()) {
+        throw std::runtime_error("Config file " + path + " must contain a JSON object");
+    }
+
+    static const char* const knownKeys[] = {
+        "threads", "listeners", "backlog", "maxRequestSize",
+        "headerTimeoutMs", "bodyTimeoutMs", "keepAliveTimeoutMs", "streamIntervalMs",
+        "maxInFlightIngest", "maxInFlightQueries", "maxInFlightExports", "maxInFlightStreams",
+        "eventRateLimit", "eventRateBurst", "queryTimeoutMs",
+        "traceSampleEvery", "traceFile"};
+    for (const auto& [key, value] : settings.items()) {
+        if (std::find(std::begin(knownKeys), std::end(knownKeys), key) == std::end(knownKeys)) {
+            throw std::runtime_error("Unknown config setting: " + key);
+        }
+    }
+
+    readSetting(settings, "threads", config.threadCount);
+    readSetting(settings, "listeners", config.listenerCount);
+    readSetting(settings, "backlog", config.backlog);
+    readSetting(settings, "maxRequestSize", config.maxRequestSize);
+    readSetting(settings, "headerTimeoutMs", config.headerTimeoutMs);
+    readSetting(settings, "bodyTimeoutMs", config.bodyTimeoutMs);
+    readSetting(settings, "keepAliveTimeoutMs", config.keepAliveTimeoutMs);
+    readSetting(settings, "streamIntervalMs", config.streamIntervalMs);
+    readSetting(settings, "maxInFlightIngest", config.maxInFlightIngest);
+    readSetting(settings, "maxInFlightQueries", config.maxInFlightQueries);
+    readSetting(settings, "maxInFlightExports", config.maxInFlightExports);
+    readSetting(settings, "maxInFlightStreams", config.maxInFlightStreams);
+    readSetting(settings, "eventRateLimit", config.eventRateLimit);
+    readSetting(settings, "eventRateBurst", config.eventRateBurst);
+    readSetting(settings, "queryTimeoutMs", config.queryTimeoutMs);
+    readSetting(settings, "traceSampleEvery", config.traceSampleEvery);
+    if (settings.contains("traceFile")) {
+        if (!settings["traceFile"].is_string() || settings["traceFile"].get<std::string>().empty()) {
+            throw std::runtime_error("Config setting traceFile must be a non-empty string");
+        }
+        config.traceFile = settings["traceFile"].get<std::string>();
+    }
+}
+
+void validateServerConfig(const ServerConfig& config) {
+    if (config.port <= 0 || config.port > 65535) {
+        throw std::invalid_argument("Port must be between 1 and 65535");
+    }
+    if (config.threadCount < 1) {
+        throw std::invalid_argument("Each listener needs at least one worker thread");
+    }
+    if (config.listenerCount < 1) {
+        throw std::invalid_argument("At least one listener is required");
+    }
+    if (config.backlog < 1) {
+        throw std::invalid_argument("Backlog must be positive");
+    }
+    if (config.maxRequestSize < 256) {
+        throw std::invalid_argument("Max request size must be at least 256 bytes");
+    }
+    if (config.streamIntervalMs < 1) {
+        throw std::invalid_argument("Stream interval must be positive");
+    }
+    if (config.maxInFlightIngest < 0 || config.maxInFlightQueries < 0 || config.maxInFlightExports < 0 ||
+        config.maxInFlightStreams < 0 || config.eventRateLimit < 0.0 || config.eventRateBurst < 0.0) {
+        throw std::invalid_argument("Admission limits must not be negative");
+    }
+    if (config.queryTimeoutMs < 0) {
+        throw std::invalid_argument("Query timeout must not be negative");
+    }
+    if (config.traceSampleEvery < 0) {
+        throw std::invalid_argument("Trace sampling interval must not be negative");
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "telemetry/persistence.h"
+
+struct io_uring_cqe;
+
+// A record waiting to be written
+struct PendingAppend {
+    std::string record;
+    IDurableAppender::Completion done;
+};
+
+// Group commit with pwrite and fdatasync on a dedicated flusher thread. Portable fallback
+// for kernels without io_uring; one thread per file keeps the writes in append order.
+class ThreadedAppender : public IDurableAppender {
+public:
+    // Takes ownership of fd and appends at its current end
+    explicit ThreadedAppender(int fd);
+    ~ThreadedAppender() override;
+
+    void append(std::string record, Completion done) override;
+    void flush() override;
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    void run();
+
+    const int fd_;
+    uint64_t offset_;
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable drained_;
+    std::vector<PendingAppend> pending_;
+    bool writing_ = false;
+    bool stopping_ = false;
+    bool failed_ = false;
+    std::atomic<uint64_t> bytesWritten_{0};
+    std::atomic<uint64_t> syncs_{0};
+    std::thread thread_;
+};
+
+// Group commit through io_uring. Batches are copied into registered buffers and submitted
+// as a linked WRITE_FIXED + FSYNC pair, so several batches can be in flight while the
+// submitting thread goes on batching; a completion thread acknowledges them in order.
+class IoUringAppender : public IDurableAppender {
+public:
+    // Returns nullptr when io_uring is unavailable (old kernel, seccomp filter, sysctl)
+    static std::unique_ptr<IoUringAppender> create(int fd);
+    ~IoUringAppender() override;
+
+    void append(std::string record, Completion done) override;
+    void flush() override;
+    std::map<std::string, double> statusFields() const override;
+
+private:
+    class Ring;
+
+    // One submitted batch, alive until both of its completions arrived
+    struct Batch {
+        std::size_t buffer;
+        uint32_t size;
+        int outstanding = 2; // WRITE_FIXED and FSYNC
+        bool ok = true;
+        std::vector<Completion> completions;
+    };
+
+    IoUringAppender(int fd, std::unique_ptr<Ring> ring);
+    void submitLoop();
+    void completeLoop();
+    // Records one completion and moves batches that became acknowledgeable into ready
+    void onCompletion(const io_uring_cqe& cqe, std::vector<std::pair<std::vector<Completion>, bool>>& ready);
+    // Runs the completions collected by onCompletion outside the lock
+    void acknowledge(std::vector<std::pair<std::vector<Completion>, bool>>& ready);
+
+    const int fd_;
+    uint64_t offset_;
+    std::unique_ptr<Ring> ring_;
+    std::vector<std::unique_ptr<char[]>> buffers_;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable drained_;
+    std::vector<PendingAppend> pending_;
+    std::vector<std::size_t> freeBuffers_;
+    std::map<uint64_t, Batch> inflight_; // By batch number, acknowledged in that order
+    uint64_t nextBatch_ = 0;
+    int acknowledging_ = 0; // onCompletion calls whose completions are still running
+    bool stopping_ = false;
+    bool failed_ = false;
+    std::atomic<uint64_t> bytesWritten_{0};
+    std::atomic<uint64_t> syncs_{0};
+    std::thread submitter_;
+    std::thread completer_;
+};
@@ -0,0 +1,242 @@
+#include "telemetry/bulk_import.h"
+#include "telemetry/interfaces.h"
+#include "telemetry/snapshot.h"
+#include "mapped_file.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Smallest range of a file handed to one thread
+constexpr std::size_t kMinRangeBytes = 64 * 1024;
+
+// Ranges per thread and file, so that threads finishing early can pick up more work
+constexpr std::size_t kRangesPerThread = 4;
+
+// Line-aligned byte range of one input file
+struct ImportRange {
+    std::size_t file;
+    std::size_t begin;
+    std::size_t end;
+};
+
+// Events and counts parsed by one thread
+struct ImportTable {
+    std::unordered_map<std::string, std::vector<EventData>> series;
+    std::size_t events = 0;
+    std::size_t rejected = 0;
+};
+
+// Splits text into ranges of about rangeBytes that end just after a newline
+void splitLines(std::size_t file, std::string_view text, std::size_t rangeBytes, std::vector<ImportRange>& ranges) {
+    std::size_t begin = 0;
+    while (begin < text.size()) {
+        std::size_t end = std::min(text.size(), begin + rangeBytes);
+        if (end < text.size()) {
+            auto newline = text.find('\n', end - 1);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        ranges.push_back(ImportRange{file, begin, end});
+        begin = end;
+    }
+}
+
+template <typename Number>
+bool parseNumber(std::string_view field, Number& value) {
+    auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+    return error == std::errc() && end == field.data() + field.size();
+}
+
+// Parses `event,timestamp,v1,...` into eventName and event
+bool parseCsvLine(std::string_view line, std::string_view& eventName, EventData& event) {
+    auto comma = line.find(',');
+    if (comma == std::string_view::npos || comma == 0) {
+        return false;
+    }
+    eventName = line.substr(0, comma);
+    line.remove_prefix(comma + 1);
+
+    comma = line.find(',');
+    if (!parseNumber(line.substr(0, comma), event.timestamp)) {
+        return false;
+    }
+    event.values.clear();
+    while (comma != std::string_view::npos) {
+        line.remove_prefix(comma + 1);
+        comma = line.find(',');
+        double value;
+        if (!parseNumber(line.substr(0, comma), value)) {
+            return false;
+        }
+        event.values.push_back(value);
+    }
+    return true;
+}
+
+// Parses {"event": ..., "date": ..., "values": [...]} into eventName and event
+bool parseNdjsonLine(std::string_view line, std::string& eventName, EventData& event) {
+    auto object = nlohmann::json::parse(line, nullptr, false);
+    if (!object.is_object() || !object.contains("event") || !object.contains("values")) {
+        return false;
+    }
+    const auto& timestamp = object.contains("date") ? object["date"] : object.value("timestamp", nlohmann::json());
+    if (!object["event"].is_string() || !timestamp.is_number_unsigned() || !object["values"].is_array()) {
+        return false;
+    }
+    eventName = object["event"].get<std::string>();
+    event.timestamp = timestamp.get<uint64_t>();
+    event.values.clear();
+    for (const auto& value : object["values"]) {
+        if (!value.is_number()) {
+            return false;
+        }
+        event.values.push_back(value.get<double>());
+    }
+    return true;
+}
+
+// Parses the lines of one range into table
+void parseRange(std::string_view text, const ImportRange& range, ImportFormat format, ImportTable& table) {
+    std::string ndjsonName;
+    EventData event;
+    bool firstLine = range.begin == 0;
+    for (std::size_t position = range.begin; position < range.end;) {
+        auto newline = text.find('\n', position);
+        auto end = std::min(range.end, newline == std::string_view::npos ? text.size() : newline);
+        auto line = text.substr(position, end - position);
+        position = end + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        bool parsed;
+        std::string_view eventName;
+        if (format == ImportFormat::Csv) {
+            parsed = parseCsvLine(line, eventName, event);
+            // A header is any unparsable first line whose second field is not a number
+            if (!parsed && firstLine) {
+                auto fields = line.substr(line.find(',') + 1);
+                if (fields.empty() || fields.front() < '0' || fields.front() > '9') {
+                    firstLine = false;
+                    continue;
+                }
+            }
+        } else {
+            parsed = parseNdjsonLine(line, ndjsonName, event);
+            eventName = ndjsonName;
+        }
+        firstLine = false;
+
+        // Same validation as the ingest path
+        if (!parsed || event.values.size() != 10) {
+            ++table.rejected;
+            continue;
+        }
+        auto it = table.series.find(std::string(eventName));
+        if (it == table.series.end()) {
+            it = table.series.emplace(std::string(eventName), std::vector<EventData>()).first;
+        }
+        it->second.push_back(event);
+        ++table.events;
+    }
+}
+
+// Runs work(index) for every index below count on up to threads threads
+template <typename Work>
+void runParallel(std::size_t count, std::size_t threads, Work&& work) {
+    std::atomic<std::size_t> next{0};
+    auto worker = [&] {
+        for (auto index = next++; index < count; index = next++) {
+            work(index);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < std::min(threads, count); ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+ImportFormat importFormatOf(const std::string& path) {
+    auto extension = path.substr(std::min(path.size(), path.rfind('.')));
+    if (extension == ".csv") {
+        return ImportFormat::Csv;
+    }
+    if (extension == ".ndjson" || extension == ".jsonl") {
+        return ImportFormat::Ndjson;
+    }
+    throw std::invalid_argument("Unknown input format of " + path + "; expected .csv, .ndjson or .jsonl");
+}
+
+ImportStats importToSnapshot(const std::vector<std::string>& inputs, const std::string& snapshotPath,
+                             std::size_t threads) {
+    threads = std::max<std::size_t>(1, threads);
+
+    std::vector<ImportFormat> formats;
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<ImportRange> ranges;
+    for (const auto& input : inputs) {
+        formats.push_back(importFormatOf(input));
+        files.push_back(std::make_unique<MappedFile>(input));
+        auto text = files.back()->contents();
+        splitLines(files.size() - 1, text,
+                   std::max(kMinRangeBytes, text.size() / (threads * kRangesPerThread) + 1), ranges);
+    }
+
+    // Parse: every thread fills its own table
+    std::vector<ImportTable> tables(threads);
+    std::atomic<std::size_t> nextRange{0};
+    runParallel(threads, threads, [&](std::size_t thread) {
+        for (auto index = nextRange++; index < ranges.size(); index = nextRange++) {
+            const auto& range = ranges[index];
+            parseRange(files[range.file]->contents(), range, formats[range.file], tables[thread]);
+        }
+    });
+
+    ImportStats stats;
+    stats.files = inputs.size();
+    std::map<std::string, std::vector<EventData>> series;
+    for (auto& table : tables) {
+        stats.events += table.events;
+        stats.rejected += table.rejected;
+        for (auto& [eventName, events] : table.series) {
+            auto& merged = series[eventName];
+            if (merged.empty()) {
+                merged = std::move(events);
+            } else {
+                merged.insert(merged.end(), std::make_move_iterator(events.begin()),
+                              std::make_move_iterator(events.end()));
+            }
+        }
+        table.series.clear();
+    }
+    stats.series = series.size();
+
+    // Sort: one series per task, so that loaded blocks cover disjoint time ranges
+    std::vector<std::vector<EventData>*> pending;
+    for (auto& [eventName, events] : series) {
+        pending.push_back(&events);
+    }
+    runParallel(pending.size(), threads, [&](std::size_t index) {
+        std::stable_sort(pending[index]->begin(), pending[index]->end(),
+                         [](const EventData& a, const EventData& b) { return a.timestamp < b.timestamp; });
+    });
+
+    writeSnapshot(snapshotPath, series);
+    return stats;
+}
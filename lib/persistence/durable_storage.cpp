@@ -0,0 +1,137 @@
+#include "telemetry/persistence.h"
+#include "telemetry/binary_codec.h"
+#include "appenders.h"
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+
+namespace {
+
+// Log records are [u32 payload length][u32 CRC-32 of payload][payload]
+constexpr std::size_t kRecordHeaderSize = 8;
+
+std::string encodeRecord(const std::string& eventName, const std::vector<double>& values, uint64_t timestamp) {
+    std::string payload;
+    ByteWriter(payload).putEvent(eventName, values, timestamp);
+
+    std::string record;
+    record.reserve(kRecordHeaderSize + payload.size());
+    ByteWriter writer(record);
+    writer.putU32(static_cast<uint32_t>(payload.size()));
+    writer.putU32(crc32(payload));
+    record.append(payload);
+    return record;
+}
+
+} // namespace
+
+PersistenceBackend parsePersistenceBackend(const std::string& name) {
+    if (name == "auto") {
+        return PersistenceBackend::Auto;
+    }
+    if (name == "io_uring") {
+        return PersistenceBackend::IoUring;
+    }
+    if (name == "threads") {
+        return PersistenceBackend::Threads;
+    }
+    throw std::invalid_argument("Unknown persistence backend: " + name);
+}
+
+std::unique_ptr<IDurableAppender> openDurableAppender(const std::string& path, PersistenceBackend backend) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+
+    if (backend != PersistenceBackend::Threads) {
+        if (auto appender = IoUringAppender::create(fd)) {
+            return appender;
+        }
+        if (backend == PersistenceBackend::IoUring) {
+            ::close(fd);
+            throw std::runtime_error("io_uring is not available on this system");
+        }
+    }
+    return std::make_unique<ThreadedAppender>(fd);
+}
+
+DurableStorage::DurableStorage(ITelemetryStorage& inner, IDurableAppender& log)
+    : ForwardingStorage(inner), log_(log) {
+}
+
+bool DurableStorage::saveEvent(const std::string& eventName,
+                               const std::vector<double>& values,
+                               uint64_t timestamp) {
+    auto durable = std::make_shared<std::promise<bool>>();
+    auto result = durable->get_future();
+    if (!saveEventAsync(eventName, values, timestamp, [durable](bool ok) { durable->set_value(ok); })) {
+        return false;
+    }
+    return result.get();
+}
+
+bool DurableStorage::saveEventAsync(const std::string& eventName,
+                                    const std::vector<double>& values,
+                                    uint64_t timestamp,
+                                    const std::function<void(bool durable)>& onDurable) {
+    if (failed_.load(std::memory_order_acquire)) {
+        throw BackendUnavailableError("The write-ahead log has failed; saves are refused until the server restarts");
+    }
+    if (!inner_.saveEvent(eventName, values, timestamp)) {
+        return false;
+    }
+    log_.append(encodeRecord(eventName, values, timestamp), [this, onDurable](bool durable) {
+        if (!durable) {
+            failed_.store(true, std::memory_order_release);
+        }
+        onDurable(durable);
+    });
+    return true;
+}
+
+std::size_t DurableStorage::recover(const std::string& path, ITelemetryStorage& storage) {
+    if (::access(path.c_str(), F_OK) != 0) {
+        return 0; // No log yet
+    }
+    // Replayed straight from the page cache, so memory does not grow with the log
+    MappedFile log(path);
+    const std::string_view data = log.contents();
+
+    std::size_t recovered = 0;
+    std::size_t valid = 0;
+    while (data.size() - valid >= kRecordHeaderSize) {
+        ByteReader header(data.substr(valid, kRecordHeaderSize));
+        uint32_t size = header.getU32();
+        uint32_t checksum = header.getU32();
+        if (data.size() - valid - kRecordHeaderSize < size) {
+            break; // Torn write
+        }
+
+        std::string_view payload(data.data() + valid + kRecordHeaderSize, size);
+        if (crc32(payload) != checksum) {
+            break; // Corrupt or never completely written
+        }
+        try {
+            std::string eventName;
+            ByteReader reader(payload);
+            auto event = reader.getEvent(eventName);
+            if (storage.saveEvent(eventName, event.values, event.timestamp)) {
+                ++recovered;
+            }
+        } catch (const std::out_of_range&) {
+            break;
+        }
+
+        valid += kRecordHeaderSize + size;
+    }
+
+    if (valid < data.size() && ::truncate(path.c_str(), static_cast<off_t>(valid)) != 0) {
+        throw std::runtime_error("Cannot truncate the damaged tail of " + path + ": " + std::strerror(errno));
+    }
+    return recovered;
+}
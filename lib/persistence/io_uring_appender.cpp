@@ -0,0 +1,400 @@
+#include "appenders.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned kRingEntries = 64;
+constexpr std::size_t kBufferCount = 4;            // Batches in flight at once
+constexpr std::size_t kBufferSize = 1024 * 1024;   // Upper bound of one batch
+constexpr uint64_t kShutdownTag = ~0ULL;           // user_data of the final NOP
+
+} // namespace
+
+// Minimal io_uring wrapper over the raw system calls: one submitting thread, one reaping thread
+class IoUringAppender::Ring {
+public:
+    static std::unique_ptr<Ring> create(unsigned entries) {
+        io_uring_params params{};
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return nullptr;
+        }
+        std::unique_ptr<Ring> ring(new Ring(fd));
+        return ring->map(params) ? std::move(ring) : nullptr;
+    }
+
+    ~Ring() {
+        if (sqes_ != MAP_FAILED) {
+            ::munmap(sqes_, sqesSize_);
+        }
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+            ::munmap(cqRing_, cqRingSize_);
+        }
+        if (sqRing_ != MAP_FAILED) {
+            ::munmap(sqRing_, sqRingSize_);
+        }
+        ::close(fd_);
+    }
+
+    bool registerBuffers(const std::vector<iovec>& buffers) {
+        return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                         buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+    }
+
+    // Number of submission entries that can be prepared right now
+    unsigned available() const {
+        return sqEntries_ - (sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE));
+    }
+
+    // Returns a cleared submission entry, or nullptr while the queue is full
+    io_uring_sqe* nextSqe() {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqTail_ - head >= sqEntries_) {
+            return nullptr;
+        }
+        unsigned index = sqTail_ & *sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        ++sqTail_;
+        return sqe;
+    }
+
+    // Publishes the prepared entries to the kernel and submits them
+    bool submit() {
+        unsigned published = *sqKernelTail_;
+        unsigned count = sqTail_ - published;
+        __atomic_store_n(sqKernelTail_, sqTail_, __ATOMIC_RELEASE);
+        while (count > 0) {
+            long submitted = ::syscall(__NR_io_uring_enter, fd_, count, 0, 0, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                return false;
+            }
+            count -= static_cast<unsigned>(submitted);
+        }
+        return true;
+    }
+
+    // Blocks until a completion is available and consumes it
+    bool waitCompletion(io_uring_cqe& completion) {
+        for (;;) {
+            unsigned head = *cqHead_;
+            if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+                completion = cqes_[head & *cqMask_];
+                __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            long result = ::syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+private:
+    explicit Ring(int fd) : fd_(fd) {}
+
+    bool map(const io_uring_params& params) {
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+
+        sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            return false;
+        }
+        cqRing_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing_ :
+            ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            return false;
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            return false;
+        }
+
+        auto* sq = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqKernelTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqEntries_ = params.sq_entries;
+        sqTail_ = *sqKernelTail_;
+
+        auto* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    int fd_;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    std::size_t sqRingSize_ = 0;
+    std::size_t cqRingSize_ = 0;
+    std::size_t sqesSize_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqKernelTail_ = nullptr;
+    unsigned* sqMask_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqEntries_ = 0;
+    unsigned sqTail_ = 0; // Local tail, published by submit()
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned* cqMask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+std::unique_ptr<IoUringAppender> IoUringAppender::create(int fd) {
+    auto ring = Ring::create(kRingEntries);
+    if (!ring) {
+        return nullptr;
+    }
+    std::unique_ptr<IoUringAppender> appender(new IoUringAppender(fd, std::move(ring)));
+
+    std::vector<iovec> buffers;
+    for (auto& buffer : appender->buffers_) {
+        buffers.push_back(iovec{buffer.get(), kBufferSize});
+    }
+    if (!appender->ring_->registerBuffers(buffers)) {
+        // Leave fd open for the caller's fallback
+        appender->ring_.reset();
+        return nullptr;
+    }
+
+    appender->submitter_ = std::thread(&IoUringAppender::submitLoop, appender.get());
+    appender->completer_ = std::thread(&IoUringAppender::completeLoop, appender.get());
+    return appender;
+}
+
+IoUringAppender::IoUringAppender(int fd, std::unique_ptr<Ring> ring)
+    : fd_(fd), ring_(std::move(ring)) {
+    struct stat info{};
+    offset_ = ::fstat(fd_, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+    for (std::size_t i = 0; i < kBufferCount; ++i) {
+        buffers_.push_back(std::make_unique<char[]>(kBufferSize));
+        freeBuffers_.push_back(i);
+    }
+}
+
+IoUringAppender::~IoUringAppender() {
+    if (ring_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        queued_.notify_all();
+        submitter_.join();
+        completer_.join();
+        ::close(fd_);
+    }
+}
+
+void IoUringAppender::append(std::string record, Completion done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(PendingAppend{std::move(record), std::move(done)});
+    }
+    queued_.notify_one();
+}
+
+void IoUringAppender::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this] { return pending_.empty() && inflight_.empty() && acknowledging_ == 0; });
+}
+
+std::map<std::string, double> IoUringAppender::statusFields() const {
+    return {
+        {"ioUring", 1.0},
+        {"bytesWritten", static_cast<double>(bytesWritten_.load())},
+        {"syncs", static_cast<double>(syncs_.load())},
+    };
+}
+
+void IoUringAppender::submitLoop() {
+    std::vector<Completion> rejected;
+    for (;;) {
+        uint64_t batchNumber;
+        uint64_t offset;
+        std::size_t bufferIndex;
+        uint32_t size = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this] {
+                return (stopping_ && pending_.empty()) || (!pending_.empty() && !freeBuffers_.empty());
+            });
+            if (pending_.empty()) {
+                break;
+            }
+
+            // Fill one registered buffer with as many queued records as fit
+            bufferIndex = freeBuffers_.back();
+            freeBuffers_.pop_back();
+            Batch batch;
+            batch.buffer = bufferIndex;
+            char* buffer = buffers_[bufferIndex].get();
+            std::size_t taken = 0;
+            for (auto& append : pending_) {
+                if (append.record.size() > kBufferSize) {
+                    rejected.push_back(std::move(append.done));
+                } else if (size + append.record.size() <= kBufferSize) {
+                    std::memcpy(buffer + size, append.record.data(), append.record.size());
+                    size += static_cast<uint32_t>(append.record.size());
+                    batch.completions.push_back(std::move(append.done));
+                } else {
+                    break;
+                }
+                ++taken;
+            }
+            pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(taken));
+
+            batch.size = size;
+            batchNumber = nextBatch_++;
+            offset = offset_;
+            offset_ += size;
+            inflight_.emplace(batchNumber, std::move(batch));
+        }
+
+        for (auto& done : rejected) {
+            done(false);
+        }
+        rejected.clear();
+
+        // Write and fsync as one linked pair: the fsync only starts once the write succeeded
+        bool submitted = false;
+        if (ring_->available() >= 2) {
+            io_uring_sqe* write = ring_->nextSqe();
+            io_uring_sqe* sync = ring_->nextSqe();
+            write->opcode = IORING_OP_WRITE_FIXED;
+            write->fd = fd_;
+            write->addr = reinterpret_cast<uint64_t>(buffers_[bufferIndex].get());
+            write->len = size;
+            write->off = offset;
+            write->buf_index = static_cast<uint16_t>(bufferIndex);
+            write->flags = IOSQE_IO_LINK;
+            write->user_data = batchNumber * 2;
+
+            sync->opcode = IORING_OP_FSYNC;
+            sync->fd = fd_;
+            sync->fsync_flags = IORING_FSYNC_DATASYNC;
+            sync->user_data = batchNumber * 2 + 1;
+            submitted = ring_->submit();
+        }
+
+        if (!submitted) {
+            // Complete the batch as failed ourselves; no completions will arrive for it
+            std::vector<std::pair<std::vector<Completion>, bool>> ready;
+            io_uring_cqe failure{};
+            failure.res = -EIO;
+            for (uint64_t tag : {batchNumber * 2, batchNumber * 2 + 1}) {
+                failure.user_data = tag;
+                onCompletion(failure, ready);
+                acknowledge(ready);
+            }
+        }
+    }
+
+    // Wake the completion thread so it can exit once the last batches are acknowledged
+    io_uring_sqe* nop = ring_->nextSqe();
+    while (nop == nullptr) {
+        std::this_thread::yield();
+        nop = ring_->nextSqe();
+    }
+    nop->opcode = IORING_OP_NOP;
+    nop->user_data = kShutdownTag;
+    ring_->submit();
+}
+
+void IoUringAppender::completeLoop() {
+    bool shutdownSeen = false;
+    std::vector<std::pair<std::vector<Completion>, bool>> ready;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (shutdownSeen && inflight_.empty()) {
+                return;
+            }
+        }
+
+        io_uring_cqe completion{};
+        if (!ring_->waitCompletion(completion)) {
+            return;
+        }
+        if (completion.user_data == kShutdownTag) {
+            shutdownSeen = true;
+            continue;
+        }
+
+        onCompletion(completion, ready);
+        acknowledge(ready);
+    }
+}
+
+void IoUringAppender::onCompletion(const io_uring_cqe& completion,
+                                   std::vector<std::pair<std::vector<Completion>, bool>>& ready) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = inflight_.find(completion.user_data / 2);
+    if (it == inflight_.end()) {
+        return;
+    }
+
+    auto& batch = it->second;
+    const bool isWrite = completion.user_data % 2 == 0;
+    if (isWrite ? completion.res != static_cast<int32_t>(batch.size) : completion.res < 0) {
+        batch.ok = false;
+    }
+    --batch.outstanding;
+
+    // Acknowledge in append order: a batch is durable only once all earlier ones are
+    while (!inflight_.empty() && inflight_.begin()->second.outstanding == 0) {
+        auto& done = inflight_.begin()->second;
+        failed_ = failed_ || !done.ok;
+        if (!failed_) {
+            bytesWritten_ += done.size;
+            syncs_++;
+        }
+        freeBuffers_.push_back(done.buffer);
+        ready.emplace_back(std::move(done.completions), !failed_);
+        inflight_.erase(inflight_.begin());
+    }
+
+    ++acknowledging_;
+    queued_.notify_one();
+}
+
+void IoUringAppender::acknowledge(std::vector<std::pair<std::vector<Completion>, bool>>& ready) {
+    for (auto& [completions, ok] : ready) {
+        for (auto& done : completions) {
+            done(ok);
+        }
+    }
+    ready.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--acknowledging_ == 0 && inflight_.empty() && pending_.empty()) {
+        drained_.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file, read front to back
+class MappedFile {
+public:
+    // Throws std::runtime_error if the file cannot be opened or mapped
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(error));
+        }
+        size_ = static_cast<std::size_t>(status.st_size);
+        if (size_ > 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::runtime_error("Cannot map " + path + ": " + std::strerror(error));
+            }
+            ::madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd); // The mapping keeps the file open
+    }
+
+    ~MappedFile() {
+        if (size_ > 0) {
+            ::munmap(data_, size_);
+        }
+    }
+
+    // Prevent copying or moving
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    std::string_view contents() const { return {static_cast<const char*>(data_), size_}; }
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
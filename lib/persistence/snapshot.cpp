@@ -0,0 +1,145 @@
+#include "telemetry/snapshot.h"
+#include "telemetry/binary_codec.h"
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+constexpr std::string_view kSnapshotMagic = "TLMSNAP1";
+
+// Same framing as the durable log
+constexpr std::size_t kRecordHeaderSize = 8;
+
+// Writes all of data to fd; throws std::runtime_error on failure
+void writeAll(int fd, std::string_view data, const std::string& path) {
+    while (!data.empty()) {
+        ssize_t written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+}
+
+// Encodes events [first, last) of one series as a framed record
+std::string encodeChunk(const std::string& eventName, std::vector<EventData>::const_iterator first,
+                        std::vector<EventData>::const_iterator last) {
+    std::string payload;
+    ByteWriter writer(payload);
+    writer.putString(eventName);
+    writer.putU32(static_cast<uint32_t>(last - first));
+    for (auto it = first; it != last; ++it) {
+        writer.putU64(it->timestamp);
+        writer.putU16(static_cast<uint16_t>(it->values.size()));
+        for (double value : it->values) {
+            writer.putDouble(value);
+        }
+    }
+
+    std::string record;
+    record.reserve(kRecordHeaderSize + payload.size());
+    ByteWriter header(record);
+    header.putU32(static_cast<uint32_t>(payload.size()));
+    header.putU32(crc32(payload));
+    record.append(payload);
+    return record;
+}
+
+} // namespace
+
+void writeSnapshot(const std::string& path, const std::map<std::string, std::vector<EventData>>& series) {
+    const std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create " + temporary + ": " + std::strerror(errno));
+    }
+
+    try {
+        writeAll(fd, kSnapshotMagic, temporary);
+        for (const auto& [eventName, events] : series) {
+            for (auto first = events.begin(); first != events.end();) {
+                auto last = first + static_cast<std::ptrdiff_t>(
+                    std::min<std::size_t>(kSnapshotChunkEvents, static_cast<std::size_t>(events.end() - first)));
+                writeAll(fd, encodeChunk(eventName, first, last), temporary);
+                first = last;
+            }
+        }
+        if (::fdatasync(fd) != 0) {
+            throw std::runtime_error("Cannot sync " + temporary + ": " + std::strerror(errno));
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    ::close(fd);
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot rename " + temporary + " to " + path + ": " + std::strerror(errno));
+    }
+}
+
+SnapshotStats loadSnapshot(const std::string& path, ITelemetryStorage& storage) {
+    MappedFile file(path);
+    auto data = file.contents();
+    if (data.substr(0, kSnapshotMagic.size()) != kSnapshotMagic) {
+        throw std::runtime_error(path + " is not a telemetry snapshot");
+    }
+
+    SnapshotStats stats;
+    std::unordered_set<std::string> names;
+    std::vector<EventData> events;
+    std::size_t position = kSnapshotMagic.size();
+    while (position < data.size()) {
+        auto damaged = [&] {
+            return std::runtime_error("Snapshot " + path + " is damaged at offset " + std::to_string(position));
+        };
+        if (data.size() - position < kRecordHeaderSize) {
+            throw damaged();
+        }
+        ByteReader header(data.substr(position, kRecordHeaderSize));
+        uint32_t size = header.getU32();
+        uint32_t checksum = header.getU32();
+        if (data.size() - position - kRecordHeaderSize < size) {
+            throw damaged();
+        }
+        auto payload = data.substr(position + kRecordHeaderSize, size);
+        if (crc32(payload) != checksum) {
+            throw damaged();
+        }
+
+        std::string eventName;
+        try {
+            ByteReader reader(payload);
+            eventName = reader.getString();
+            events.resize(reader.getU32());
+            for (auto& event : events) {
+                event.timestamp = reader.getU64();
+                event.values.resize(reader.getU16());
+                for (double& value : event.values) {
+                    value = reader.getDouble();
+                }
+            }
+        } catch (const std::out_of_range&) {
+            throw damaged();
+        }
+
+        auto saved = storage.saveEvents(eventName, events);
+        stats.events += saved;
+        stats.rejected += events.size() - saved;
+        names.insert(std::move(eventName));
+        position += kRecordHeaderSize + size;
+    }
+    stats.series = names.size();
+    return stats;
+}
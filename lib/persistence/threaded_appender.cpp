@@ -0,0 +1,91 @@
+#include "appenders.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+ThreadedAppender::ThreadedAppender(int fd)
+    : fd_(fd) {
+    struct stat info{};
+    offset_ = ::fstat(fd_, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+    thread_ = std::thread(&ThreadedAppender::run, this);
+}
+
+ThreadedAppender::~ThreadedAppender() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    thread_.join();
+    ::close(fd_);
+}
+
+void ThreadedAppender::append(std::string record, Completion done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(PendingAppend{std::move(record), std::move(done)});
+    }
+    queued_.notify_one();
+}
+
+void ThreadedAppender::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this] { return pending_.empty() && !writing_; });
+}
+
+std::map<std::string, double> ThreadedAppender::statusFields() const {
+    return {
+        {"ioUring", 0.0},
+        {"bytesWritten", static_cast<double>(bytesWritten_.load())},
+        {"syncs", static_cast<double>(syncs_.load())},
+    };
+}
+
+void ThreadedAppender::run() {
+    std::vector<PendingAppend> batch;
+    std::string buffer;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            writing_ = false;
+            drained_.notify_all();
+            queued_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;
+            }
+            // Everything that queued up during the previous fsync shares the next one
+            batch.swap(pending_);
+            writing_ = true;
+        }
+
+        buffer.clear();
+        for (const auto& append : batch) {
+            buffer.append(append.record);
+        }
+
+        bool ok = !failed_;
+        for (std::size_t written = 0; ok && written < buffer.size();) {
+            ssize_t result = ::pwrite(fd_, buffer.data() + written, buffer.size() - written,
+                                      static_cast<off_t>(offset_ + written));
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = result > 0;
+            written += ok ? static_cast<std::size_t>(result) : 0;
+        }
+        ok = ok && ::fdatasync(fd_) == 0;
+
+        if (ok) {
+            offset_ += buffer.size();
+            bytesWritten_ += buffer.size();
+            syncs_++;
+        } else {
+            failed_ = true;
+        }
+
+        for (auto& append : batch) {
+            append.done(ok);
+        }
+        batch.clear();
+    }
+}
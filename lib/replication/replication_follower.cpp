@@ -0,0 +1,206 @@
+#include "telemetry/replication.h"
+#include "telemetry/binary_codec.h"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+using replication::FrameType;
+
+namespace {
+
+constexpr auto kReconnectDelay = std::chrono::seconds(1);
+
+// The leader sends a heartbeat every second; silence for this long means it is gone
+constexpr int kReceiveTimeoutSeconds = 5;
+
+} // namespace
+
+ReplicationFollower::ReplicationFollower(std::string leaderHost, int leaderPort,
+                                         TelemetryStorage& storage, ITelemetryProcessor& applier)
+    : leaderHost_(std::move(leaderHost)), leaderPort_(leaderPort), storage_(storage), applier_(applier) {
+}
+
+ReplicationFollower::~ReplicationFollower() {
+    stop();
+}
+
+void ReplicationFollower::start() {
+    running_ = true;
+    thread_ = std::thread(&ReplicationFollower::run, this);
+}
+
+void ReplicationFollower::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        if (!running_.exchange(false)) {
+            return;
+        }
+        if (fd_ >= 0) {
+            ::shutdown(fd_, SHUT_RDWR);
+        }
+    }
+    stopped_.notify_all();
+    thread_.join();
+}
+
+std::map<std::string, double> ReplicationFollower::statusFields() const {
+    const uint64_t applied = appliedSequence_;
+    const uint64_t leader = std::max<uint64_t>(leaderSequence_, applied);
+    const uint64_t now = replication::nowMs();
+    const uint64_t heartbeat = lastHeartbeatMs_;
+
+    // Time lag is the age of the oldest record not yet applied, approximated by the
+    // age of the last applied one; it is zero whenever the replica is caught up
+    const uint64_t appliedAt = appliedAppendedAtMs_;
+    const double lagMs = applied < leader && now > appliedAt ? static_cast<double>(now - appliedAt) : 0.0;
+
+    return {
+        {"connected", connected_ ? 1.0 : 0.0},
+        {"synchronized", synchronized_ ? 1.0 : 0.0},
+        {"appliedSequence", static_cast<double>(applied)},
+        {"leaderSequence", static_cast<double>(leader)},
+        {"lagRecords", static_cast<double>(leader - applied)},
+        {"lagMs", lagMs},
+        {"heartbeatAgeMs", heartbeat == 0 || now < heartbeat ? 0.0 : static_cast<double>(now - heartbeat)},
+    };
+}
+
+void ReplicationFollower::run() {
+    while (running_) {
+        int fd = connectToLeader();
+        if (fd >= 0) {
+            {
+                std::lock_guard<std::mutex> lock(stopMutex_);
+                fd_ = fd;
+            }
+            connected_ = true;
+            follow(fd);
+            connected_ = false;
+            {
+                std::lock_guard<std::mutex> lock(stopMutex_);
+                fd_ = -1;
+                ::close(fd);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(stopMutex_);
+        stopped_.wait_for(lock, kReconnectDelay, [this] { return !running_; });
+    }
+}
+
+void ReplicationFollower::follow(int fd) {
+    // Resume right after the last applied record, or ask for a snapshot; the leader sends one
+    // anyway if its epoch is not the one the applied sequence counts in
+    std::string hello;
+    const uint64_t applied = appliedSequence_;
+    ByteWriter writer(hello);
+    writer.putU64(applied == 0 ? 0 : applied + 1);
+    writer.putU64(leaderEpoch_);
+    if (!replication::sendFrame(fd, FrameType::Hello, hello)) {
+        return;
+    }
+
+    FrameType type;
+    std::string payload;
+    uint64_t snapshotSequence = 0;
+    uint64_t snapshotEpoch = 0;
+    try {
+        while (running_ && replication::receiveFrame(fd, type, payload)) {
+            ByteReader reader(payload);
+            switch (type) {
+            case FrameType::SnapshotBegin:
+                snapshotSequence = reader.getU64();
+                snapshotEpoch = reader.getU64();
+                synchronized_ = false;
+                storage_.clear();
+                break;
+
+            case FrameType::SnapshotEvent: {
+                std::string eventName;
+                auto event = reader.getEvent(eventName);
+                storage_.saveEvent(eventName, event.values, event.timestamp);
+                break;
+            }
+
+            case FrameType::SnapshotEnd:
+                // Standing queries saw neither the clear nor the snapshot's events
+                applier_.reseedStandingQueries();
+                appliedSequence_ = snapshotSequence;
+                leaderEpoch_ = snapshotEpoch;
+                appliedAppendedAtMs_ = replication::nowMs();
+                synchronized_ = true;
+                break;
+
+            case FrameType::Record: {
+                uint64_t sequence = reader.getU64();
+                uint64_t appendedAtMs = reader.getU64();
+                std::string eventName;
+                auto event = reader.getEvent(eventName);
+
+                if (sequence <= appliedSequence_) {
+                    break; // Already applied before a reconnect
+                }
+                if (sequence != appliedSequence_ + 1) {
+                    return; // Gap: reconnect and resynchronise
+                }
+                applier_.saveEvent(eventName, event.values, event.timestamp);
+                appliedAppendedAtMs_ = appendedAtMs;
+                appliedSequence_ = sequence;
+                break;
+            }
+
+            case FrameType::Heartbeat: {
+                const uint64_t headSequence = reader.getU64();
+                reader.getU64(); // Leader wall clock
+                if (reader.getU64() != leaderEpoch_) {
+                    leaderEpoch_ = 0;
+                    return; // A different log: reconnect and load a snapshot
+                }
+                leaderSequence_ = headSequence;
+                lastHeartbeatMs_ = replication::nowMs();
+                break;
+            }
+
+            default:
+                return; // Unknown frame: the stream cannot be trusted
+            }
+        }
+    } catch (const std::out_of_range&) {
+        // Truncated frame; reconnect
+    }
+}
+
+int ReplicationFollower::connectToLeader() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addresses = nullptr;
+    if (::getaddrinfo(leaderHost_.c_str(), std::to_string(leaderPort_).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    timeval timeout{};
+    timeout.tv_sec = kReceiveTimeoutSeconds;
+
+    int fd = -1;
+    for (auto* address = addresses; address != nullptr; address = address->ai_next) {
+        fd = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(addresses);
+    return fd;
+}
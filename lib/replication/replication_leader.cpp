@@ -0,0 +1,226 @@
+#include "telemetry/replication.h"
+#include "telemetry/binary_codec.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using replication::FrameType;
+
+namespace {
+
+// Records shipped per batch before the session checks for shutdown again
+constexpr std::size_t kBatchSize = 1024;
+constexpr auto kHeartbeatInterval = std::chrono::seconds(1);
+
+bool sendHeartbeat(int fd, uint64_t headSequence, uint64_t epoch) {
+    std::string payload;
+    ByteWriter writer(payload);
+    writer.putU64(headSequence);
+    writer.putU64(replication::nowMs());
+    writer.putU64(epoch);
+    return replication::sendFrame(fd, FrameType::Heartbeat, payload);
+}
+
+} // namespace
+
+ReplicationLeader::ReplicationLeader(ReplicatedStorage& storage, ReplicationLog& log,
+                                     std::string address, int port)
+    : storage_(storage), log_(log), address_(std::move(address)), port_(port) {
+}
+
+ReplicationLeader::~ReplicationLeader() {
+    stop();
+}
+
+void ReplicationLeader::start() {
+    sockaddr_in endpoint{};
+    endpoint.sin_family = AF_INET;
+    endpoint.sin_port = htons(static_cast<uint16_t>(port_));
+    if (::inet_pton(AF_INET, address_.c_str(), &endpoint.sin_addr) != 1) {
+        throw std::runtime_error("Invalid replication address: " + address_);
+    }
+
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&endpoint), sizeof(endpoint)) != 0 ||
+        ::listen(listenFd_, 16) != 0) {
+        std::string reason = std::strerror(errno);
+        ::close(listenFd_);
+        listenFd_ = -1;
+        throw std::runtime_error("Cannot listen for followers on port " + std::to_string(port_) + ": " + reason);
+    }
+
+    running_ = true;
+    acceptThread_ = std::thread(&ReplicationLeader::acceptLoop, this);
+}
+
+void ReplicationLeader::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    // Unblock accept() and every session blocked in send() or waiting on the log
+    ::shutdown(listenFd_, SHUT_RDWR);
+    acceptThread_.join();
+    ::close(listenFd_);
+    listenFd_ = -1;
+
+    std::lock_guard<std::mutex> lock(sessionsMutex_);
+    for (auto& session : sessions_) {
+        ::shutdown(session.fd, SHUT_RDWR);
+    }
+    log_.notifyAll();
+    for (auto& session : sessions_) {
+        session.thread.join();
+        ::close(session.fd);
+    }
+    sessions_.clear();
+}
+
+std::map<std::string, double> ReplicationLeader::statusFields() const {
+    return {
+        {"headSequence", static_cast<double>(log_.headSequence())},
+        {"firstSequence", static_cast<double>(log_.firstSequence())},
+        {"followers", static_cast<double>(followers_.load())},
+    };
+}
+
+void ReplicationLeader::acceptLoop() {
+    while (running_) {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        reapFinishedSessions();
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        auto& session = sessions_.emplace_back();
+        session.fd = fd;
+        session.thread = std::thread(&ReplicationLeader::serveFollower, this, std::ref(session));
+    }
+}
+
+void ReplicationLeader::reapFinishedSessions() {
+    std::lock_guard<std::mutex> lock(sessionsMutex_);
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+        if (it->finished) {
+            it->thread.join();
+            ::close(it->fd);
+            it = sessions_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ReplicationLeader::serveFollower(Session& session) {
+    const int fd = session.fd;
+    followers_++;
+
+    uint64_t nextSequence = 0;
+    bool greeted = false;
+    try {
+        FrameType type;
+        std::string payload;
+        if (replication::receiveFrame(fd, type, payload) && type == FrameType::Hello) {
+            ByteReader reader(payload);
+            nextSequence = reader.getU64();
+
+            // Sequences of another epoch, such as the log before this leader restarted, name
+            // different records, so such a follower starts over from a snapshot
+            if (reader.getU64() != log_.epoch()) {
+                nextSequence = 0;
+            }
+            greeted = true;
+        }
+    } catch (const std::out_of_range&) {
+        // Truncated HELLO
+    }
+
+    std::vector<ReplicationRecord> batch;
+    std::string frame;
+    auto lastSent = std::chrono::steady_clock::now();
+    while (greeted && running_) {
+        // Followers that are new or fell behind the retained tail start from a snapshot
+        batch.clear();
+        if (nextSequence == 0 || !log_.read(nextSequence, kBatchSize, batch)) {
+            if (!sendSnapshot(fd, nextSequence)) {
+                break;
+            }
+            continue;
+        }
+
+        if (batch.empty()) {
+            log_.waitFor(nextSequence, kHeartbeatInterval);
+            if (std::chrono::steady_clock::now() - lastSent >= kHeartbeatInterval) {
+                if (!sendHeartbeat(fd, log_.headSequence(), log_.epoch())) {
+                    break;
+                }
+                lastSent = std::chrono::steady_clock::now();
+            }
+            continue;
+        }
+
+        bool sent = true;
+        for (const auto& record : batch) {
+            frame.clear();
+            ByteWriter writer(frame);
+            writer.putU64(record.sequence);
+            writer.putU64(record.appendedAtMs);
+            writer.putEvent(record.eventName, record.event.values, record.event.timestamp);
+            if (!replication::sendFrame(fd, FrameType::Record, frame)) {
+                sent = false;
+                break;
+            }
+        }
+        if (!sent || !sendHeartbeat(fd, log_.headSequence(), log_.epoch())) {
+            break;
+        }
+        nextSequence = batch.back().sequence + 1;
+        lastSent = std::chrono::steady_clock::now();
+    }
+
+    followers_--;
+    session.finished = true;
+}
+
+bool ReplicationLeader::sendSnapshot(int fd, uint64_t& nextSequence) {
+    TelemetryStorage::Frozen events;
+    uint64_t sequence = storage_.snapshot(events);
+
+    std::string payload;
+    ByteWriter writer(payload);
+    writer.putU64(sequence);
+    writer.putU64(log_.epoch());
+    if (!replication::sendFrame(fd, FrameType::SnapshotBegin, payload)) {
+        return false;
+    }
+
+    // Events are decoded as they are sent, without holding up the leader's writers
+    const bool sent = events.forEachEvent([&](const std::string& eventName, const EventData& event) {
+        payload.clear();
+        ByteWriter(payload).putEvent(eventName, event.values, event.timestamp);
+        return replication::sendFrame(fd, FrameType::SnapshotEvent, payload);
+    });
+    if (!sent) {
+        return false;
+    }
+
+    if (!replication::sendFrame(fd, FrameType::SnapshotEnd, {})) {
+        return false;
+    }
+    nextSequence = sequence + 1;
+    return true;
+}
@@ -0,0 +1,186 @@
+#include "telemetry/replication.h"
+#include <random>
+
+namespace {
+
+uint64_t newEpoch() {
+    std::random_device device;
+    uint64_t epoch = 0;
+    while (epoch == 0) {
+        epoch = (static_cast<uint64_t>(device()) << 32) ^ device() ^ replication::nowMs();
+    }
+    return epoch;
+}
+
+} // namespace
+
+ReplicationLog::ReplicationLog(std::size_t capacity)
+    : capacity_(capacity), epoch_(newEpoch()) {
+}
+
+uint64_t ReplicationLog::append(const std::string& eventName,
+                                const std::vector<double>& values,
+                                uint64_t timestamp) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        records_.push_back(ReplicationRecord{++headSequence_, replication::nowMs(),
+                                             eventName, EventData{values, timestamp}});
+        if (records_.size() > capacity_) {
+            records_.pop_front();
+        }
+    }
+    appended_.notify_all();
+    return headSequence_;
+}
+
+bool ReplicationLog::read(uint64_t from, std::size_t maxRecords, std::vector<ReplicationRecord>& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Reading exactly one past the head is valid and simply yields nothing yet
+    const uint64_t first = records_.empty() ? headSequence_ + 1 : records_.front().sequence;
+    if (from < first || from > headSequence_ + 1) {
+        return false;
+    }
+
+    auto begin = records_.begin() + static_cast<std::ptrdiff_t>(from - first);
+    auto count = std::min<std::size_t>(maxRecords, static_cast<std::size_t>(records_.end() - begin));
+    out.insert(out.end(), begin, begin + static_cast<std::ptrdiff_t>(count));
+    return true;
+}
+
+void ReplicationLog::waitFor(uint64_t from, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    appended_.wait_for(lock, timeout, [&] { return headSequence_ >= from; });
+}
+
+uint64_t ReplicationLog::headSequence() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return headSequence_;
+}
+
+uint64_t ReplicationLog::firstSequence() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_.empty() ? headSequence_ + 1 : records_.front().sequence;
+}
+
+void ReplicationLog::notifyAll() const {
+    appended_.notify_all();
+}
+
+ReplicatedStorage::ReplicatedStorage(TelemetryStorage& storage, ReplicationLog& log)
+    : ForwardingStorage(storage), storage_(storage), log_(log) {
+}
+
+bool ReplicatedStorage::saveEvent(const std::string& eventName,
+                                  const std::vector<double>& values,
+                                  uint64_t timestamp) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (!storage_.saveEvent(eventName, values, timestamp)) {
+        return false;
+    }
+    log_.append(eventName, values, timestamp);
+    return true;
+}
+
+uint64_t ReplicatedStorage::snapshot(TelemetryStorage::Frozen& events) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    events = storage_.freeze();
+    return log_.headSequence();
+}
+
+void ReadOnlyProcessor::requireSynchronized() const {
+    if (follower_ && !follower_->synchronized()) {
+        throw BackendUnavailableError("This replica is loading a snapshot from the leader; retry shortly");
+    }
+}
+
+bool ReadOnlyProcessor::saveEvent(const std::string&, const std::vector<double>&, uint64_t) {
+    throw UnsupportedOperationError("This server is a read replica; send writes to the leader");
+}
+
+double ReadOnlyProcessor::calculateMeanLength(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+    requireSynchronized();
+    return inner_.calculateMeanLength(eventName, startTimestamp, endTimestamp);
+}
+
+std::vector<PathAggregate> ReadOnlyProcessor::calculateAggregates(
+    const std::vector<std::string>& eventNames,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+    requireSynchronized();
+    return inner_.calculateAggregates(eventNames, startTimestamp, endTimestamp);
+}
+
+std::vector<SeriesBucket> ReadOnlyProcessor::calculateSeries(
+    const std::string& eventName,
+    uint64_t bucketSeconds,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+    requireSynchronized();
+    return inner_.calculateSeries(eventName, bucketSeconds, startTimestamp, endTimestamp);
+}
+
+std::vector<PathAggregate> ReadOnlyProcessor::calculateWindows(
+    const std::string& eventName,
+    const std::vector<TimeWindow>& windows) {
+    requireSynchronized();
+    return inner_.calculateWindows(eventName, windows);
+}
+
+std::vector<SampledAggregate> ReadOnlyProcessor::calculateSampledAggregates(
+    const std::vector<std::string>& eventNames,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+    requireSynchronized();
+    return inner_.calculateSampledAggregates(eventNames, startTimestamp, endTimestamp);
+}
+
+void ReadOnlyProcessor::readEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp,
+    EventCursor& cursor,
+    std::size_t maxEvents,
+    std::vector<EventData>& out) {
+    requireSynchronized();
+    inner_.readEvents(eventName, startTimestamp, endTimestamp, cursor, maxEvents, out);
+}
+
+std::shared_ptr<IRollingMean> ReadOnlyProcessor::subscribeRollingMean(
+    const std::string& eventName,
+    uint64_t windowSeconds) {
+    requireSynchronized();
+    return inner_.subscribeRollingMean(eventName, windowSeconds);
+}
+
+void ReadOnlyProcessor::registerStandingQuery(
+    const std::string& name,
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+    requireSynchronized();
+    inner_.registerStandingQuery(name, eventName, startTimestamp, endTimestamp);
+}
+
+std::optional<PathAggregate> ReadOnlyProcessor::readStandingQuery(const std::string& name) {
+    requireSynchronized();
+    return inner_.readStandingQuery(name);
+}
+
+bool ReadOnlyProcessor::removeStandingQuery(const std::string& name) {
+    return inner_.removeStandingQuery(name);
+}
+
+void ReadOnlyProcessor::reseedStandingQueries() {
+    inner_.reseedStandingQueries();
+}
+
+std::optional<uint64_t> ReadOnlyProcessor::eventsVersion(const std::vector<std::string>& eventNames) {
+    if (follower_ && !follower_->synchronized()) {
+        return std::nullopt;
+    }
+    return inner_.eventsVersion(eventNames);
+}
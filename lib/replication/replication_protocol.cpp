@@ -0,0 +1,77 @@
+#include "telemetry/replication.h"
+#include "telemetry/binary_codec.h"
+#include <sys/socket.h>
+#include <cerrno>
+
+namespace replication {
+
+namespace {
+
+// Frames larger than this are treated as a corrupt stream
+constexpr uint32_t kMaxFrameSize = 64 * 1024 * 1024;
+
+bool sendAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+bool receiveAll(int fd, char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t received = ::recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= static_cast<std::size_t>(received);
+    }
+    return true;
+}
+
+} // namespace
+
+bool sendFrame(int fd, FrameType type, const std::string& payload) {
+    std::string frame;
+    frame.reserve(5 + payload.size());
+    ByteWriter writer(frame);
+    writer.putU8(static_cast<uint8_t>(type));
+    writer.putU32(static_cast<uint32_t>(payload.size()));
+    frame.append(payload);
+    return sendAll(fd, frame.data(), frame.size());
+}
+
+bool receiveFrame(int fd, FrameType& type, std::string& payload) {
+    char header[5];
+    if (!receiveAll(fd, header, sizeof(header))) {
+        return false;
+    }
+
+    ByteReader reader(std::string_view(header, sizeof(header)));
+    type = static_cast<FrameType>(reader.getU8());
+    uint32_t size = reader.getU32();
+    if (size > kMaxFrameSize) {
+        return false;
+    }
+
+    payload.resize(size);
+    return receiveAll(fd, payload.data(), size);
+}
+
+uint64_t nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace replication
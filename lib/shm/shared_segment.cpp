@@ -0,0 +1,551 @@
+#include "telemetry/shared_segment.h"
+#include "telemetry/query_context.h"
+#include "telemetry/tracing.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr uint64_t kMagic = 0x4745534d484d4c54; // "TLMHMSEG"
+constexpr uint64_t kLayoutVersion = 1;
+
+// Longest event name the segment holds, plus the terminating NUL
+constexpr std::size_t kNameBytes = 64;
+
+// Events covered by one block summary
+constexpr std::size_t kSummaryEvents = 4096;
+
+// Event counts stay below this, so that a version can carry the reset count above it
+constexpr uint64_t kVersionStride = uint64_t{1} << 40;
+
+// Reads retried while the writer resets the segment before a query gives up
+constexpr int kResetRetries = 10000;
+
+// Start of the segment. Geometry and magic are written once, before the segment is published.
+struct Header {
+    uint64_t magic;
+    uint64_t layoutVersion;
+    uint64_t maxSeries;
+    uint64_t eventsPerSeries;
+    std::atomic<uint64_t> sequence;      // Seqlock: odd while the writer resets the segment
+    std::atomic<uint64_t> resets;        // Completed resets, one per writer that reused the segment
+    std::atomic<uint64_t> retired;       // Set once a writer replaced the segment by another one
+    std::atomic<uint64_t> seriesCount;   // Directory entries in use, released after their name
+    std::atomic<uint64_t> droppedSeries; // Names that did not fit the directory
+};
+
+// Directory entry of one event name
+struct SeriesEntry {
+    char name[kNameBytes];
+    std::atomic<uint64_t> count;   // Events published, released after their columns and summary
+    std::atomic<uint64_t> dropped; // Events that did not fit the columns
+};
+
+// Time range and total of kSummaryEvents consecutive events; final once count passes the block
+struct BlockSummary {
+    uint64_t minTimestamp;
+    uint64_t maxTimestamp;
+    double sum;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Segment atomics must work across processes");
+
+constexpr std::size_t align64(std::size_t bytes) {
+    return (bytes + 63) / 64 * 64;
+}
+
+std::size_t summariesPerSeries(uint64_t eventsPerSeries) {
+    return (eventsPerSeries + kSummaryEvents - 1) / kSummaryEvents;
+}
+
+std::size_t seriesBytes(uint64_t eventsPerSeries) {
+    return 2 * align64(eventsPerSeries * sizeof(uint64_t)) +
+           align64(summariesPerSeries(eventsPerSeries) * sizeof(BlockSummary));
+}
+
+std::size_t segmentBytes(uint64_t maxSeries, uint64_t eventsPerSeries) {
+    return align64(sizeof(Header)) + align64(maxSeries * sizeof(SeriesEntry)) +
+           maxSeries * seriesBytes(eventsPerSeries);
+}
+
+std::string shmName(const std::string& name) {
+    return !name.empty() && name.front() == '/' ? name : "/" + name;
+}
+
+[[noreturn]] void fail(const std::string& what, const std::string& name) {
+    throw std::runtime_error(what + " shared segment " + name + ": " + std::strerror(errno));
+}
+
+bool inRange(uint64_t timestamp, std::optional<uint64_t> startTimestamp, std::optional<uint64_t> endTimestamp) {
+    return (!startTimestamp || timestamp >= *startTimestamp) && (!endTimestamp || timestamp <= *endTimestamp);
+}
+
+} // namespace
+
+// Mapping of one segment, read-write for the writer and read-only for query processes
+class SharedSegment {
+public:
+    // Creates the segment, or resets it in place when it exists with the same geometry, and
+    // takes the writer lock on it
+    static std::unique_ptr<SharedSegment> create(const SegmentOptions& options) {
+        if (options.maxSeries == 0 || options.eventsPerSeries == 0 || options.eventsPerSeries >= kVersionStride) {
+            throw std::invalid_argument("Shared segment needs at least one series of 1 to 2^40 events");
+        }
+        const auto name = shmName(options.name);
+        const auto size = segmentBytes(options.maxSeries, options.eventsPerSeries);
+
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            fail("Cannot create", name);
+        }
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Shared segment " + name + " already has a writer");
+        }
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            fail("Cannot stat", name);
+        }
+
+        // Reuse a segment of the same geometry, so attached readers see a reset; retire any
+        // other one, whose readers may have mapped a different size, and start a new one
+        if (status.st_size != 0) {
+            auto existing = std::unique_ptr<SharedSegment>(
+                new SharedSegment(name, fd, static_cast<std::size_t>(status.st_size), true));
+            if (existing->valid() && existing->header().maxSeries == options.maxSeries &&
+                existing->header().eventsPerSeries == options.eventsPerSeries) {
+                existing->reset();
+                return existing;
+            }
+            if (existing->valid()) {
+                existing->header().retired.store(1, std::memory_order_release);
+            }
+            ::shm_unlink(name.c_str());
+            existing.reset();
+
+            fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                fail("Cannot recreate", name);
+            }
+            if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Shared segment " + name + " already has a writer");
+            }
+        }
+
+        // A new segment reads as zeros, so only the geometry and magic need writing
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            fail("Cannot size", name);
+        }
+        auto segment = std::unique_ptr<SharedSegment>(new SharedSegment(name, fd, size, true));
+        auto& header = segment->header();
+        header.layoutVersion = kLayoutVersion;
+        header.maxSeries = options.maxSeries;
+        header.eventsPerSeries = options.eventsPerSeries;
+        std::atomic_thread_fence(std::memory_order_release);
+        header.magic = kMagic;
+        return segment;
+    }
+
+    // Maps an existing segment read-only
+    static std::unique_ptr<SharedSegment> attach(const std::string& segmentName) {
+        const auto name = shmName(segmentName);
+        int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            fail("Cannot open", name);
+        }
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            fail("Cannot stat", name);
+        }
+        auto segment = std::unique_ptr<SharedSegment>(
+            new SharedSegment(name, fd, static_cast<std::size_t>(status.st_size), false));
+        if (!segment->valid()) {
+            throw std::runtime_error("Shared segment " + name + " has an unknown layout");
+        }
+        return segment;
+    }
+
+    ~SharedSegment() {
+        ::munmap(data_, size_);
+        ::close(fd_); // Releases the writer lock
+    }
+
+    // Prevent copying or moving
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+    SharedSegment(SharedSegment&&) = delete;
+    SharedSegment& operator=(SharedSegment&&) = delete;
+
+    const std::string& name() const { return name_; }
+
+    Header& header() const { return *static_cast<Header*>(data_); }
+
+    SeriesEntry& entry(std::size_t series) const {
+        return reinterpret_cast<SeriesEntry*>(bytes() + align64(sizeof(Header)))[series];
+    }
+
+    uint64_t* timestamps(std::size_t series) const {
+        return reinterpret_cast<uint64_t*>(seriesStart(series));
+    }
+
+    double* lengths(std::size_t series) const {
+        return reinterpret_cast<double*>(seriesStart(series) + align64(header().eventsPerSeries * sizeof(uint64_t)));
+    }
+
+    BlockSummary* summaries(std::size_t series) const {
+        return reinterpret_cast<BlockSummary*>(seriesStart(series) + 2 * align64(header().eventsPerSeries * sizeof(uint64_t)));
+    }
+
+    // Empties every series. Readers that overlap the reset see the sequence move and retry.
+    void reset() {
+        auto& header = this->header();
+        const auto sequence = header.sequence.load(std::memory_order_relaxed);
+        header.sequence.store(sequence | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < header.maxSeries; ++i) {
+            entry(i).count.store(0, std::memory_order_relaxed);
+            entry(i).dropped.store(0, std::memory_order_relaxed);
+        }
+        header.seriesCount.store(0, std::memory_order_relaxed);
+        header.droppedSeries.store(0, std::memory_order_relaxed);
+        header.resets.fetch_add(1, std::memory_order_relaxed);
+        header.sequence.store((sequence | 1) + 1, std::memory_order_release);
+    }
+
+    // Runs read until no reset overlapped it, at most kResetRetries times
+    template <typename Read>
+    auto consistentRead(Read&& read) const {
+        const auto& header = this->header();
+        for (int attempt = 0; attempt < kResetRetries; ++attempt) {
+            if (header.retired.load(std::memory_order_acquire) != 0) {
+                throw BackendUnavailableError("Shared segment " + name_ + " was replaced by its writer; restart this query process");
+            }
+            const auto before = header.sequence.load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto result = read();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header.sequence.load(std::memory_order_relaxed) == before) {
+                return result;
+            }
+        }
+        throw BackendUnavailableError("Shared segment " + name_ + " is being reset by its writer");
+    }
+
+    // Directory entry of eventName among the published ones
+    std::optional<std::size_t> find(const std::string& eventName) const {
+        if (eventName.size() >= kNameBytes) {
+            return std::nullopt;
+        }
+        const auto published = std::min<uint64_t>(header().seriesCount.load(std::memory_order_acquire), header().maxSeries);
+        for (std::size_t i = 0; i < published; ++i) {
+            if (std::strncmp(entry(i).name, eventName.c_str(), kNameBytes) == 0) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Published events of series, or BackendUnavailableError if some were dropped
+    uint64_t publishedEvents(const std::string& eventName, std::optional<std::size_t> series) const {
+        if (!series) {
+            if (header().droppedSeries.load(std::memory_order_relaxed) > 0) {
+                throw BackendUnavailableError("Event " + eventName + " may not fit shared segment " + name_);
+            }
+            return 0;
+        }
+        if (entry(*series).dropped.load(std::memory_order_relaxed) > 0) {
+            throw BackendUnavailableError("Event " + eventName + " overflowed shared segment " + name_);
+        }
+        return std::min<uint64_t>(entry(*series).count.load(std::memory_order_acquire), header().eventsPerSeries);
+    }
+
+    std::map<std::string, double> statusFields() const {
+        const auto& header = this->header();
+        const auto published = std::min<uint64_t>(header.seriesCount.load(std::memory_order_acquire), header.maxSeries);
+        double events = 0.0;
+        double droppedEvents = 0.0;
+        for (std::size_t i = 0; i < published; ++i) {
+            events += static_cast<double>(entry(i).count.load(std::memory_order_relaxed));
+            droppedEvents += static_cast<double>(entry(i).dropped.load(std::memory_order_relaxed));
+        }
+        return {{"series", static_cast<double>(published)},
+                {"events", events},
+                {"droppedEvents", droppedEvents},
+                {"droppedSeries", static_cast<double>(header.droppedSeries.load(std::memory_order_relaxed))},
+                {"resets", static_cast<double>(header.resets.load(std::memory_order_relaxed))}};
+    }
+
+private:
+    SharedSegment(std::string name, int fd, std::size_t size, bool writable)
+        : name_(std::move(name)), fd_(fd), size_(size) {
+        data_ = ::mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+        if (data_ == MAP_FAILED) {
+            int error = errno;
+            ::close(fd_);
+            errno = error;
+            fail("Cannot map", name_);
+        }
+    }
+
+    // Whether the mapping holds a complete segment of this layout
+    bool valid() const {
+        if (size_ < sizeof(Header)) {
+            return false;
+        }
+        const auto& header = this->header();
+        return header.magic == kMagic && header.layoutVersion == kLayoutVersion && header.maxSeries > 0 &&
+               header.eventsPerSeries > 0 && header.eventsPerSeries < kVersionStride &&
+               header.maxSeries < (uint64_t{1} << 32) &&
+               segmentBytes(header.maxSeries, header.eventsPerSeries) == size_;
+    }
+
+    char* bytes() const { return static_cast<char*>(data_); }
+
+    char* seriesStart(std::size_t series) const {
+        return bytes() + align64(sizeof(Header)) + align64(header().maxSeries * sizeof(SeriesEntry)) +
+               series * seriesBytes(header().eventsPerSeries);
+    }
+
+    const std::string name_;
+    int fd_;
+    void* data_ = nullptr;
+    std::size_t size_;
+};
+
+SharedSegmentWriter::SharedSegmentWriter(ITelemetryStorage& inner, const SegmentOptions& options)
+    : ForwardingStorage(inner),
+      segment_(SharedSegment::create(options)) {
+}
+
+SharedSegmentWriter::~SharedSegmentWriter() = default;
+
+bool SharedSegmentWriter::saveEvent(const std::string& eventName,
+                                    const std::vector<double>& values,
+                                    uint64_t timestamp) {
+    if (!ForwardingStorage::saveEvent(eventName, values, timestamp)) {
+        return false;
+    }
+    const double length = inner_.storedLength(eventName, values);
+
+    tracing::Span span("shm.publish");
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    auto& header = segment_->header();
+
+    // Claim a directory entry on a name's first event; the name is visible before the count
+    auto [it, inserted] = seriesIndex_.try_emplace(eventName, kDroppedSeries);
+    if (inserted) {
+        const auto next = header.seriesCount.load(std::memory_order_relaxed);
+        if (eventName.size() < kNameBytes && next < header.maxSeries) {
+            auto& entry = segment_->entry(next);
+            std::memset(entry.name, 0, kNameBytes);
+            std::memcpy(entry.name, eventName.data(), eventName.size());
+            header.seriesCount.store(next + 1, std::memory_order_release);
+            it->second = next;
+        } else {
+            header.droppedSeries.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (it->second == kDroppedSeries) {
+        return true;
+    }
+
+    const auto series = it->second;
+    auto& entry = segment_->entry(series);
+    const auto index = entry.count.load(std::memory_order_relaxed);
+    if (index >= header.eventsPerSeries) {
+        entry.dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Columns and the block summary first, then the count that publishes them
+    segment_->timestamps(series)[index] = timestamp;
+    segment_->lengths(series)[index] = length;
+    auto& summary = segment_->summaries(series)[index / kSummaryEvents];
+    if (index % kSummaryEvents == 0) {
+        summary = BlockSummary{timestamp, timestamp, length};
+    } else {
+        summary.minTimestamp = std::min(summary.minTimestamp, timestamp);
+        summary.maxTimestamp = std::max(summary.maxTimestamp, timestamp);
+        summary.sum += length;
+    }
+    entry.count.store(index + 1, std::memory_order_release);
+    return true;
+}
+
+std::map<std::string, double> SharedSegmentWriter::statusFields() const {
+    return segment_->statusFields();
+}
+
+SharedSegmentReader::SharedSegmentReader(const std::string& name)
+    : segment_(SharedSegment::attach(name)) {
+}
+
+SharedSegmentReader::~SharedSegmentReader() = default;
+
+bool SharedSegmentReader::saveEvent(const std::string&, const std::vector<double>&, uint64_t) {
+    throw UnsupportedOperationError("Shared segment " + segment_->name() + " is written by the ingest process only");
+}
+
+std::vector<EventData> SharedSegmentReader::getFilteredEvents(
+    const std::string&, std::optional<uint64_t>, std::optional<uint64_t>) {
+    throw UnsupportedOperationError("Shared segments hold path lengths only; read raw events from the ingest process");
+}
+
+void SharedSegmentReader::readEvents(
+    const std::string&, std::optional<uint64_t>, std::optional<uint64_t>,
+    EventCursor&, std::size_t, std::vector<EventData>&) {
+    throw UnsupportedOperationError("Shared segments hold path lengths only; export events from the ingest process");
+}
+
+PathAggregate SharedSegmentReader::aggregateEvents(
+    const std::string& eventName,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("shm.aggregateEvents");
+    return segment_->consistentRead([&] {
+        const auto series = segment_->find(eventName);
+        const auto count = segment_->publishedEvents(eventName, series);
+        PathAggregate aggregate;
+        if (count == 0) {
+            return aggregate;
+        }
+        const auto* timestamps = segment_->timestamps(*series);
+        const auto* lengths = segment_->lengths(*series);
+        const auto* summaries = segment_->summaries(*series);
+        const uint64_t lo = startTimestamp.value_or(0);
+        const uint64_t hi = endTimestamp.value_or(std::numeric_limits<uint64_t>::max());
+
+        // Events [first, last) straight from the columns
+        auto scan = [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                const bool match = timestamps[i] >= lo && timestamps[i] <= hi;
+                aggregate.sum += match ? lengths[i] : 0.0;
+                aggregate.count += match ? 1 : 0;
+            }
+        };
+
+        // The unsummarized tail, then whole blocks from newest to oldest, so that a query cut
+        // short by its deadline still covers the most recent events
+        const std::size_t blocks = count / kSummaryEvents;
+        scan(blocks * kSummaryEvents, count);
+        for (std::size_t block = blocks; block-- > 0;) {
+            if (QueryContext::deadlineReached()) {
+                break;
+            }
+            const auto& summary = summaries[block];
+            if (summary.maxTimestamp < lo || summary.minTimestamp > hi) {
+                continue;
+            }
+            if (summary.minTimestamp >= lo && summary.maxTimestamp <= hi) {
+                aggregate.sum += summary.sum;
+                aggregate.count += kSummaryEvents;
+                continue;
+            }
+            scan(block * kSummaryEvents, (block + 1) * kSummaryEvents);
+        }
+        return aggregate;
+    });
+}
+
+std::vector<SeriesBucket> SharedSegmentReader::aggregateSeries(
+    const std::string& eventName,
+    uint64_t bucketWidth,
+    std::optional<uint64_t> startTimestamp,
+    std::optional<uint64_t> endTimestamp) {
+
+    tracing::Span span("shm.aggregateSeries");
+    return segment_->consistentRead([&] {
+        SeriesAccumulator accumulator(startTimestamp.value_or(0), bucketWidth);
+        const auto series = segment_->find(eventName);
+        const auto count = segment_->publishedEvents(eventName, series);
+        if (count == 0) {
+            return accumulator.buckets();
+        }
+        const auto* timestamps = segment_->timestamps(*series);
+        const auto* lengths = segment_->lengths(*series);
+        const auto* summaries = segment_->summaries(*series);
+
+        auto scan = [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i) {
+                if (inRange(timestamps[i], startTimestamp, endTimestamp)) {
+                    accumulator.add(timestamps[i], PathAggregate{lengths[i], 1});
+                }
+            }
+        };
+
+        // Blocks inside the range and inside one bucket contribute their summary
+        const std::size_t blocks = count / kSummaryEvents;
+        scan(blocks * kSummaryEvents, count);
+        for (std::size_t block = blocks; block-- > 0;) {
+            if (QueryContext::deadlineReached()) {
+                break;
+            }
+            const auto& summary = summaries[block];
+            const bool startsInside = inRange(summary.minTimestamp, startTimestamp, endTimestamp);
+            const bool endsInside = inRange(summary.maxTimestamp, startTimestamp, endTimestamp);
+            if (startsInside && endsInside &&
+                accumulator.bucketStartOf(summary.minTimestamp) == accumulator.bucketStartOf(summary.maxTimestamp)) {
+                accumulator.add(summary.minTimestamp, PathAggregate{summary.sum, kSummaryEvents});
+                continue;
+            }
+            if ((startTimestamp && summary.maxTimestamp < *startTimestamp) ||
+                (endTimestamp && summary.minTimestamp > *endTimestamp)) {
+                continue;
+            }
+            scan(block * kSummaryEvents, (block + 1) * kSummaryEvents);
+        }
+        return accumulator.buckets();
+    });
+}
+
+std::optional<uint64_t> SharedSegmentReader::eventVersion(const std::string& eventName) {
+    try {
+        return segment_->consistentRead([&] {
+            const auto resets = segment_->header().resets.load(std::memory_order_relaxed);
+            return resets * kVersionStride + segment_->publishedEvents(eventName, segment_->find(eventName));
+        });
+    } catch (const BackendUnavailableError&) {
+        return std::nullopt; // Not versioned, so the query itself reports the problem
+    }
+}
+
+std::map<std::string, double> SharedSegmentReader::statusFields() const {
+    return segment_->statusFields();
+}
+
+bool SegmentQueryProcessor::saveEvent(const std::string&, const std::vector<double>&, uint64_t) {
+    throw UnsupportedOperationError("This server queries a shared segment; send writes to the ingest process");
+}
+
+void SegmentQueryProcessor::registerStandingQuery(const std::string&, const std::string&,
+                                                  std::optional<uint64_t>, std::optional<uint64_t>) {
+    throw UnsupportedOperationError("Standing queries are served by the ingest process");
+}
+
+std::optional<PathAggregate> SegmentQueryProcessor::readStandingQuery(const std::string&) {
+    throw UnsupportedOperationError("Standing queries are served by the ingest process");
+}
+
+bool SegmentQueryProcessor::removeStandingQuery(const std::string&) {
+    throw UnsupportedOperationError("Standing queries are served by the ingest process");
+}
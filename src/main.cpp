@@ -1,17 +1,81 @@
 #include <iostream>
 #include <thread>
 #include <algorithm>
+#include <sstream>
+#include <memory>
+#include <optional>
+#include <vector>
 #include "telemetry/interfaces.h"
 #include "telemetry/telemetry_storage.h"
+#include "telemetry/value_precision.h"
 #include "telemetry/telemetry_processor.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/tiering.h"
+#include "telemetry/cluster_processor.h"
+#include "telemetry/replication.h"
+#include "telemetry/persistence.h"
+#include "telemetry/snapshot.h"
+#include "telemetry/shared_segment.h"
 #include "telemetry/http_server.h"
+#include "telemetry/server_config.h"
+
+namespace {
+
+void printUsage() {
+    std::cerr << "Usage: telemetry-server <address> <port> [--cluster-nodes <host:port,...>]\n"
+              << "                        [--replication-port <port> | --follow <host:port>]\n"
+              << "                        [--thread-per-core] [--wal <file> [--persistence auto|io_uring|threads]]\n"
+              << "                        [--snapshot <file>] [--tier-dir <dir> [--hot-seconds <s>]]\n"
+              << "                        [--precision double|float32|ms] [--event-precision <event=precision,...>]\n"
+              << "                        [--config <file.json>] [--threads <n>] [--listeners <n>] [--backlog <n>]\n"
+              << "                        [--max-request-size <bytes>] [--header-timeout-ms <ms>]\n"
+              << "                        [--body-timeout-ms <ms>] [--keepalive-timeout-ms <ms>]\n"
+              << "                        [--max-inflight-ingest <n>] [--max-inflight-queries <n>]\n"
+              << "                        [--max-inflight-exports <n>] [--max-inflight-streams <n>]\n"
+              << "                        [--event-rate <per second> [--event-burst <n>]] [--query-timeout-ms <ms>]\n"
+              << "                        [--shm-publish <name> [--shm-series <n>] [--shm-events <n>] | --shm-attach <name>]\n"
+              << "                        [--trace-sample <n> [--trace-file <path>]]\n"
+              << "Example: telemetry-server 0.0.0.0 8080\n"
+              << "Router:  telemetry-server 0.0.0.0 8080 --cluster-nodes 127.0.0.1:8081,127.0.0.1:8082\n"
+              << "Leader:  telemetry-server 0.0.0.0 8080 --replication-port 9080\n"
+              << "Replica: telemetry-server 0.0.0.0 8081 --follow 127.0.0.1:9080\n"
+              << "Durable: telemetry-server 0.0.0.0 8080 --wal /var/lib/telemetry/events.wal\n"
+              << "Backfill: telemetry-server 0.0.0.0 8080 --snapshot /var/lib/telemetry/history.snap\n"
+              << "Compact: telemetry-server 0.0.0.0 8080 --precision ms --event-precision gps_fix=double\n"
+              << "Tiered:  telemetry-server 0.0.0.0 8080 --tier-dir /var/lib/telemetry/cold --hot-seconds 604800\n"
+              << "Storms:  telemetry-server 0.0.0.0 8080 --listeners 4 --backlog 4096 --keepalive-timeout-ms 5000\n"
+              << "Shared:  telemetry-server 0.0.0.0 8080 --shm-publish telemetry\n"
+              << "Query:   telemetry-server 127.0.0.1 8090 --shm-attach telemetry\n";
+}
+
+// Splits a comma-separated list
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Runs the server until it stops
+int runServer(IHttpServer& server) {
+    if (!server.run()) {
+        std::cerr << "Failed to start server!" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
     try {
         // Check command line arguments
-        if (argc != 3) {
-            std::cerr << "Usage: telemetry-server <address> <port>\n"
-                      << "Example: telemetry-server 0.0.0.0 8080\n";
+        if (argc < 3) {
+            printUsage();
             return EXIT_FAILURE;
         }
 
@@ -20,24 +84,260 @@ int main(int argc, char* argv[]) {
         auto portStr = std::string(argv[2]);
         auto port = static_cast<int>(std::stoi(portStr));
 
+        // Worker threads per listener; 0 shares the CPUs among the listeners
+        ServerConfig config{address, port, 0};
+
+        // Settings from a config file come first so that command line options override them
+        for (int i = 3; i + 1 < argc; ++i) {
+            if (std::string(argv[i]) == "--config") {
+                applyConfigFile(argv[i + 1], config);
+            }
+        }
+
+        std::vector<std::string> clusterNodes;
+        int replicationPort = 0;
+        std::string leader;
+        bool threadPerCore = false;
+        std::string walPath;
+        std::string snapshotPath;
+        auto persistenceBackend = PersistenceBackend::Auto;
+        PrecisionPolicy precision;
+        TieringPolicy tiering;
+        SegmentOptions segment;
+        std::string segmentToAttach;
+        for (int i = 3; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--cluster-nodes" && i + 1 < argc) {
+                clusterNodes = splitList(argv[++i]);
+            } else if (option == "--replication-port" && i + 1 < argc) {
+                replicationPort = std::stoi(argv[++i]);
+            } else if (option == "--follow" && i + 1 < argc) {
+                leader = argv[++i];
+            } else if (option == "--config" && i + 1 < argc) {
+                ++i; // Already applied
+            } else if (option == "--threads" && i + 1 < argc) {
+                config.threadCount = std::stoi(argv[++i]);
+            } else if (option == "--listeners" && i + 1 < argc) {
+                config.listenerCount = std::stoi(argv[++i]);
+            } else if (option == "--backlog" && i + 1 < argc) {
+                config.backlog = std::stoi(argv[++i]);
+            } else if (option == "--max-request-size" && i + 1 < argc) {
+                config.maxRequestSize = std::stoul(argv[++i]);
+            } else if (option == "--header-timeout-ms" && i + 1 < argc) {
+                config.headerTimeoutMs = std::stoi(argv[++i]);
+            } else if (option == "--body-timeout-ms" && i + 1 < argc) {
+                config.bodyTimeoutMs = std::stoi(argv[++i]);
+            } else if (option == "--keepalive-timeout-ms" && i + 1 < argc) {
+                config.keepAliveTimeoutMs = std::stoi(argv[++i]);
+            } else if (option == "--max-inflight-ingest" && i + 1 < argc) {
+                config.maxInFlightIngest = std::stoi(argv[++i]);
+            } else if (option == "--max-inflight-queries" && i + 1 < argc) {
+                config.maxInFlightQueries = std::stoi(argv[++i]);
+            } else if (option == "--max-inflight-exports" && i + 1 < argc) {
+                config.maxInFlightExports = std::stoi(argv[++i]);
+            } else if (option == "--max-inflight-streams" && i + 1 < argc) {
+                config.maxInFlightStreams = std::stoi(argv[++i]);
+            } else if (option == "--event-rate" && i + 1 < argc) {
+                config.eventRateLimit = std::stod(argv[++i]);
+            } else if (option == "--event-burst" && i + 1 < argc) {
+                config.eventRateBurst = std::stod(argv[++i]);
+            } else if (option == "--query-timeout-ms" && i + 1 < argc) {
+                config.queryTimeoutMs = std::stoi(argv[++i]);
+            } else if (option == "--trace-sample" && i + 1 < argc) {
+                config.traceSampleEvery = std::stoi(argv[++i]);
+            } else if (option == "--trace-file" && i + 1 < argc) {
+                config.traceFile = argv[++i];
+            } else if (option == "--thread-per-core") {
+                threadPerCore = true;
+            } else if (option == "--wal" && i + 1 < argc) {
+                walPath = argv[++i];
+            } else if (option == "--tier-dir" && i + 1 < argc) {
+                tiering.directory = argv[++i];
+            } else if (option == "--hot-seconds" && i + 1 < argc) {
+                tiering.hotSeconds = std::stoull(argv[++i]);
+            } else if (option == "--snapshot" && i + 1 < argc) {
+                snapshotPath = argv[++i];
+            } else if (option == "--persistence" && i + 1 < argc) {
+                persistenceBackend = parsePersistenceBackend(argv[++i]);
+            } else if (option == "--shm-publish" && i + 1 < argc) {
+                segment.name = argv[++i];
+            } else if (option == "--shm-series" && i + 1 < argc) {
+                segment.maxSeries = std::stoul(argv[++i]);
+            } else if (option == "--shm-events" && i + 1 < argc) {
+                segment.eventsPerSeries = std::stoul(argv[++i]);
+            } else if (option == "--shm-attach" && i + 1 < argc) {
+                segmentToAttach = argv[++i];
+            } else if (option == "--precision" && i + 1 < argc) {
+                precision.defaultPrecision = parseValuePrecision(argv[++i]);
+            } else if (option == "--event-precision" && i + 1 < argc) {
+                for (const auto& item : splitList(argv[++i])) {
+                    auto equals = item.find('=');
+                    if (equals == std::string::npos) {
+                        printUsage();
+                        return EXIT_FAILURE;
+                    }
+                    precision.perEvent[item.substr(0, equals)] = parseValuePrecision(item.substr(equals + 1));
+                }
+            } else {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+        }
+
         // Get optimal thread count for the system
-        auto threadCount = std::max<int>(1, std::thread::hardware_concurrency());
+        if (config.threadCount == 0) {
+            auto cpus = std::max<int>(1, std::thread::hardware_concurrency());
+            config.threadCount = std::max(1, cpus / std::max(1, config.listenerCount));
+        }
+        validateServerConfig(config);
+        // Worker threads across all listeners
+        const auto workerThreads = config.threadCount * config.listenerCount;
 
-        // Configure the server
-        ServerConfig config{address, port, threadCount};
+        // Query process: answer from the segment an ingest process on this host publishes
+        if (!segmentToAttach.empty()) {
+            if (!clusterNodes.empty() || !leader.empty() || replicationPort != 0 || threadPerCore ||
+                !walPath.empty() || !snapshotPath.empty() || tiering.enabled() || !segment.name.empty()) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
 
-        // Initialize server components with stack allocation
-        TelemetryStorage storage;
-        TelemetryProcessor processor(storage);
-        TelemetryHttpServer server(config, processor);
-        
-        // Run the server (this blocks until the server stops)
-        if (!server.run()) {
-            std::cerr << "Failed to start server!" << std::endl;
+            SharedSegmentReader storage(segmentToAttach);
+            TelemetryProcessor reader(storage);
+            SegmentQueryProcessor processor(reader);
+            TelemetryHttpServer server(config, processor);
+            server.addStatusProvider(storage);
+            return runServer(server);
+        }
+
+        // Router role: own no data and forward every event to the node that owns it, so none of
+        // the storage, durability or replication options apply
+        if (!clusterNodes.empty()) {
+            const bool customPrecision =
+                precision.defaultPrecision != ValuePrecision::Double || !precision.perEvent.empty();
+            if (!leader.empty() || replicationPort != 0 || threadPerCore || !walPath.empty() ||
+                !snapshotPath.empty() || tiering.enabled() || customPrecision || !segment.name.empty()) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+
+            ClusterProcessor processor(clusterNodes);
+            TelemetryHttpServer server(config, processor);
+            return runServer(server);
+        }
+
+        // Read replica: apply the leader's log locally and reject writes
+        if (!leader.empty()) {
+            auto colon = leader.rfind(':');
+            if (colon == std::string::npos || replicationPort != 0 || threadPerCore || !walPath.empty() ||
+                !snapshotPath.empty() || !segment.name.empty()) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+
+            // A replica must use the leader's precision or it may refuse replicated events
+            TelemetryStorage storage(precision, tiering);
+            TelemetryProcessor applier(storage);
+            ReplicationFollower follower(leader.substr(0, colon), std::stoi(leader.substr(colon + 1)),
+                                         storage, applier);
+            ReadOnlyProcessor processor(applier, follower);
+            TierStatusProvider tierStatus([&storage] { return storage.tierStats(); });
+            TelemetryHttpServer server(config, processor);
+            server.addStatusProvider(follower);
+            if (tiering.enabled()) {
+                server.addStatusProvider(tierStatus);
+            }
+            follower.start();
+            return runServer(server);
+        }
+
+        // The leader logs below the published layer, so the two cannot be combined yet
+        if ((threadPerCore || !segment.name.empty()) && replicationPort != 0) {
+            printUsage();
             return EXIT_FAILURE;
         }
 
-        return EXIT_SUCCESS;
+        // Data node: the storage chain is built bottom-up from the optional layers
+        TelemetryStorage storage(precision, tiering);
+        ITelemetryStorage* top = &storage;
+
+        // Thread-per-core: one pinned worker thread and one private storage shard per CPU
+        std::unique_ptr<ShardedStorage> sharded;
+        if (threadPerCore) {
+            sharded = std::make_unique<ShardedStorage>(static_cast<std::size_t>(workerThreads), true, precision, tiering);
+            top = sharded.get();
+        }
+
+        // Publish every event, including those loaded and recovered below, to query processes
+        std::unique_ptr<SharedSegmentWriter> published;
+        if (!segment.name.empty()) {
+            published = std::make_unique<SharedSegmentWriter>(*top, segment);
+            top = published.get();
+        }
+
+        // Loading must not pin this thread to a shard's CPU: every thread started later, the
+        // server's included, would inherit that single-CPU affinity
+        std::optional<ShardedStorage::BulkLoad> bulkLoad;
+        if (sharded) {
+            bulkLoad.emplace(*sharded);
+        }
+
+        // Load a backfill snapshot first; the durable log only holds events accepted later
+        if (!snapshotPath.empty()) {
+            auto loaded = loadSnapshot(snapshotPath, *top);
+            std::cout << "Loaded " << loaded.events << " events of " << loaded.series << " series from "
+                      << snapshotPath << std::endl;
+            if (loaded.rejected > 0) {
+                std::cerr << "Rejected " << loaded.rejected << " events not representable at the configured precision"
+                          << std::endl;
+            }
+        }
+
+        // Replay the durable log before anything new is accepted
+        if (!walPath.empty()) {
+            auto recovered = DurableStorage::recover(walPath, *top);
+            std::cout << "Recovered " << recovered << " events from " << walPath << std::endl;
+        }
+        bulkLoad.reset();
+
+        // Leader: record every saved event in a log that followers tail
+        std::unique_ptr<ReplicationLog> replicationLog;
+        std::unique_ptr<ReplicatedStorage> replicated;
+        std::unique_ptr<ReplicationLeader> replication;
+        if (replicationPort != 0) {
+            replicationLog = std::make_unique<ReplicationLog>();
+            replicated = std::make_unique<ReplicatedStorage>(storage, *replicationLog);
+            replication = std::make_unique<ReplicationLeader>(*replicated, *replicationLog, address, replicationPort);
+            top = replicated.get();
+        }
+
+        // Durable ingest: acknowledge events once their log record is on disk
+        std::unique_ptr<IDurableAppender> wal;
+        std::unique_ptr<DurableStorage> durable;
+        if (!walPath.empty()) {
+            wal = openDurableAppender(walPath, persistenceBackend);
+            durable = std::make_unique<DurableStorage>(*top, *wal);
+            top = durable.get();
+        }
+
+        TelemetryProcessor processor(*top);
+        TelemetryHttpServer server(config, processor);
+        if (replication) {
+            server.addStatusProvider(*replication);
+            replication->start();
+        }
+        if (wal) {
+            server.addStatusProvider(*wal);
+        }
+        if (published) {
+            server.addStatusProvider(*published);
+        }
+        TierStatusProvider tierStatus([&] { return sharded ? sharded->tierStats() : storage.tierStats(); });
+        if (tiering.enabled()) {
+            server.addStatusProvider(tierStatus);
+        }
+        
+        // Run the server (this blocks until the server stops)
+        return runServer(server);
     } 
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
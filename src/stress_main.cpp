@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "telemetry/storage_stress.h"
+
+namespace {
+
+void printUsage() {
+    std::cerr << "Usage: telemetry-stress [--storage <name>|all] [--scenario <name>|all]\n"
+              << "                        [--threads <n,n,...>] [--operations <per thread>] [--seed <n>]\n"
+              << "Storages: memory, memory-float32, memory-ms, sharded, tiered\n"
+              << "Scenarios: ingest, mixed, read-heavy, late, hot-key\n"
+              << "Prints one CSV line per run and fails if any run disagrees with the reference model.\n"
+              << "Example: telemetry-stress --storage sharded --scenario hot-key --threads 1,8,64\n";
+}
+
+std::vector<std::size_t> parseThreadCounts(const std::string& list) {
+    std::vector<std::size_t> counts;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        counts.push_back(std::stoul(item));
+        if (counts.back() == 0) {
+            throw std::invalid_argument("Thread counts must be positive");
+        }
+    }
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string storageName = "all";
+        std::string scenarioName = "all";
+        std::vector<std::size_t> threadCounts = {1, 2, 4, 8, 16, 32, 64};
+        std::size_t operations = 0;
+        uint64_t seed = 1;
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--storage" && i + 1 < argc) {
+                storageName = argv[++i];
+            } else if (option == "--scenario" && i + 1 < argc) {
+                scenarioName = argv[++i];
+            } else if (option == "--threads" && i + 1 < argc) {
+                threadCounts = parseThreadCounts(argv[++i]);
+            } else if (option == "--operations" && i + 1 < argc) {
+                operations = std::stoul(argv[++i]);
+            } else if (option == "--seed" && i + 1 < argc) {
+                seed = std::stoull(argv[++i]);
+            } else {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto storages = builtinStorages();
+        if (storageName != "all" && !storages.count(storageName)) {
+            std::cerr << "Unknown storage: " << storageName << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::vector<StressScenario> scenarios;
+        for (auto& scenario : builtinScenarios()) {
+            if (scenarioName == "all" || scenario.name == scenarioName) {
+                if (operations > 0) {
+                    scenario.operationsPerThread = operations;
+                }
+                scenarios.push_back(scenario);
+            }
+        }
+        if (scenarios.empty()) {
+            std::cerr << "Unknown scenario: " << scenarioName << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::size_t violations = 0;
+        std::cout << "storage,scenario,threads,ops_per_second,write_p50_us,write_p99_us,"
+                     "read_p50_us,read_p99_us,violations" << std::endl;
+        for (const auto& [name, factory] : storages) {
+            if (storageName != "all" && name != storageName) {
+                continue;
+            }
+            for (const auto& scenario : scenarios) {
+                for (auto threads : threadCounts) {
+                    auto result = runStress(factory, scenario, threads, seed);
+                    char line[256];
+                    std::snprintf(line, sizeof(line), "%s,%s,%zu,%.0f,%.2f,%.2f,%.2f,%.2f,%zu",
+                                  name.c_str(), scenario.name.c_str(), threads, result.operationsPerSecond,
+                                  result.writeP50Micros, result.writeP99Micros,
+                                  result.readP50Micros, result.readP99Micros, result.violations);
+                    std::cout << line << std::endl;
+                    for (const auto& failure : result.failures) {
+                        std::cerr << name << "/" << scenario.name << "/" << threads << ": " << failure << std::endl;
+                    }
+                    violations += result.violations;
+                }
+            }
+        }
+        return violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,144 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/admission_controller.h"
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+ServerConfig limitedConfig() {
+    ServerConfig config;
+    config.address = "127.0.0.1";
+    config.port = 8080;
+    config.threadCount = 1;
+    return config;
+}
+
+} // namespace
+
+SCENARIO("Admission control bounds requests in flight", "[admission]") {
+    GIVEN("A controller that allows two saves and one query at a time") {
+        auto config = limitedConfig();
+        config.maxInFlightIngest = 2;
+        config.maxInFlightQueries = 1;
+        AdmissionController admission(config);
+
+        WHEN("More requests arrive than the limits allow") {
+            auto first = admission.admit(AdmissionClass::Ingest, "trip");
+            auto second = admission.admit(AdmissionClass::Ingest, "trip");
+            auto third = admission.admit(AdmissionClass::Ingest, "trip");
+            auto query = admission.admit(AdmissionClass::Query);
+            auto secondQuery = admission.admit(AdmissionClass::Query);
+
+            THEN("Requests beyond each class limit are shed with a retry hint") {
+                REQUIRE(first);
+                REQUIRE(second);
+                REQUIRE_FALSE(third);
+                REQUIRE(third.retryAfterSeconds() >= 1);
+                REQUIRE(query);
+                REQUIRE_FALSE(secondQuery);
+                REQUIRE(admission.statusFields().at("shedInFlight") == 2.0);
+                REQUIRE(admission.statusFields().at("inFlightIngest") == 2.0);
+            }
+
+            THEN("A released slot can be taken again") {
+                { auto released = std::move(first); }
+                auto again = admission.admit(AdmissionClass::Ingest, "trip");
+                REQUIRE(again);
+                REQUIRE(admission.statusFields().at("inFlightIngest") == 2.0);
+            }
+        }
+    }
+
+    GIVEN("A controller that allows one query and one export at a time") {
+        auto config = limitedConfig();
+        config.maxInFlightQueries = 1;
+        config.maxInFlightExports = 1;
+        AdmissionController admission(config);
+
+        WHEN("An export is streaming") {
+            auto download = admission.admit(AdmissionClass::Export, "trip");
+
+            THEN("Queries still have their slot and further exports are shed") {
+                REQUIRE(download);
+                REQUIRE(admission.admit(AdmissionClass::Query));
+                REQUIRE_FALSE(admission.admit(AdmissionClass::Export, "trip"));
+                REQUIRE(admission.statusFields().at("inFlightExports") == 1.0);
+                REQUIRE(admission.statusFields().at("inFlightQueries") == 0.0);
+            }
+        }
+    }
+
+    GIVEN("A controller that allows one query and one rolling-mean stream at a time") {
+        auto config = limitedConfig();
+        config.maxInFlightQueries = 1;
+        config.maxInFlightStreams = 1;
+        AdmissionController admission(config);
+        REQUIRE(admission.enabled());
+
+        WHEN("A stream is open") {
+            auto stream = admission.admit(AdmissionClass::Stream, "trip");
+
+            THEN("Queries still have their slot and further streams are shed") {
+                REQUIRE(stream);
+                REQUIRE(admission.admit(AdmissionClass::Query));
+                REQUIRE_FALSE(admission.admit(AdmissionClass::Stream, "trip"));
+                REQUIRE(admission.statusFields().at("inFlightStreams") == 1.0);
+                REQUIRE(admission.statusFields().at("inFlightQueries") == 0.0);
+            }
+
+            THEN("Closing the stream frees its slot") {
+                { auto closed = std::move(stream); }
+                REQUIRE(admission.admit(AdmissionClass::Stream, "trip"));
+            }
+        }
+    }
+}
+
+SCENARIO("Admission control limits the save rate of each event name", "[admission]") {
+    GIVEN("A controller with a burst of three saves and a refill of 200 per second") {
+        auto config = limitedConfig();
+        config.eventRateLimit = 200.0;
+        config.eventRateBurst = 3.0;
+        AdmissionController admission(config);
+        REQUIRE(admission.enabled());
+
+        WHEN("One event name saves faster than its rate") {
+            std::vector<bool> admitted;
+            for (int i = 0; i < 4; ++i) {
+                admitted.push_back(static_cast<bool>(admission.admit(AdmissionClass::Ingest, "hot")));
+            }
+
+            THEN("Only the burst is admitted") {
+                REQUIRE(admitted == std::vector<bool>{true, true, true, false});
+                REQUIRE(admission.statusFields().at("shedRateLimited") == 1.0);
+            }
+
+            THEN("Other event names and queries are not affected") {
+                REQUIRE(admission.admit(AdmissionClass::Ingest, "cold"));
+                REQUIRE(admission.admit(AdmissionClass::Query));
+            }
+
+            THEN("Tokens are refilled over time") {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                REQUIRE(admission.admit(AdmissionClass::Ingest, "hot"));
+            }
+
+            THEN("A rate-limited request does not keep its in-flight slot") {
+                REQUIRE(admission.statusFields().at("inFlightIngest") == 0.0);
+            }
+        }
+    }
+
+    GIVEN("A controller without limits") {
+        AdmissionController admission(limitedConfig());
+
+        THEN("Everything is admitted") {
+            REQUIRE_FALSE(admission.enabled());
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(admission.admit(AdmissionClass::Ingest, "trip"));
+            }
+        }
+    }
+}
@@ -0,0 +1,302 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/hash_ring.h"
+#include "telemetry/cluster_processor.h"
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/telemetry_processor.h"
+#include "telemetry/http_server.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A complete data node (storage, processor and HTTP server) running on a background thread
+class ClusterNodeFixture {
+public:
+    explicit ClusterNodeFixture(int port) : processor(storage) {
+        ServerConfig config;
+        config.address = "127.0.0.1";
+        config.port = port;
+        config.threadCount = 1;
+
+        server = std::make_unique<TelemetryHttpServer>(config, processor);
+        serverThread = std::thread([this] { server->run(); });
+
+        // Allow server to start
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    ~ClusterNodeFixture() {
+        server->stop();
+        serverThread.join();
+    }
+
+    TelemetryStorage storage;
+    TelemetryProcessor processor;
+
+private:
+    std::unique_ptr<TelemetryHttpServer> server;
+    std::thread serverThread;
+};
+
+// Bare HTTP peer that answers every request with the same JSON body after a delay. All
+// connections are served from one poll loop, so many requests can wait at once.
+class DelayedPeer {
+public:
+    DelayedPeer(int port, std::chrono::milliseconds delay, std::string body)
+        : delay_(delay), body_(std::move(body)) {
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int reuse = 1;
+        ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        REQUIRE(::listen(listenFd_, 4096) == 0);
+        thread_ = std::thread([this] { serve(); });
+    }
+
+    ~DelayedPeer() {
+        running_ = false;
+        thread_.join();
+        for (auto& connection : connections_) {
+            ::close(connection.fd);
+        }
+        ::close(listenFd_);
+    }
+
+    // Most requests that were waiting for their answer at the same time
+    std::size_t peakWaiting() const { return peakWaiting_; }
+
+private:
+    struct Connection {
+        int fd;
+        std::string received;
+        std::optional<std::chrono::steady_clock::time_point> answerAt;
+    };
+
+    void serve() {
+        while (running_) {
+            std::vector<pollfd> fds{{listenFd_, POLLIN, 0}};
+            for (const auto& connection : connections_) {
+                fds.push_back({connection.fd, POLLIN, 0});
+            }
+            ::poll(fds.data(), fds.size(), 5);
+
+            int fd;
+            while ((fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                connections_.push_back(Connection{fd, {}, std::nullopt});
+            }
+
+            std::size_t waiting = 0;
+            const auto now = std::chrono::steady_clock::now();
+            for (auto& connection : connections_) {
+                char chunk[4096];
+                ssize_t size;
+                while ((size = ::recv(connection.fd, chunk, sizeof(chunk), 0)) > 0) {
+                    connection.received.append(chunk, static_cast<std::size_t>(size));
+                }
+
+                // Requests from HttpClient carry a Content-Length
+                auto headerEnd = connection.received.find("\r\n\r\n");
+                if (!connection.answerAt && headerEnd != std::string::npos) {
+                    auto length = connection.received.find("Content-Length: ");
+                    auto bodySize = std::stoul(connection.received.substr(length + 16));
+                    if (connection.received.size() >= headerEnd + 4 + bodySize) {
+                        connection.received.erase(0, headerEnd + 4 + bodySize);
+                        connection.answerAt = now + delay_;
+                    }
+                }
+
+                if (connection.answerAt && *connection.answerAt <= now) {
+                    std::string answer = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                        "Content-Length: " + std::to_string(body_.size()) + "\r\n\r\n" + body_;
+                    ::send(connection.fd, answer.data(), answer.size(), MSG_NOSIGNAL);
+                    connection.answerAt.reset();
+                }
+                waiting += connection.answerAt ? 1 : 0;
+            }
+            peakWaiting_ = std::max<std::size_t>(peakWaiting_, waiting);
+        }
+    }
+
+    std::chrono::milliseconds delay_;
+    std::string body_;
+    int listenFd_ = -1;
+    std::atomic<bool> running_{true};
+    std::atomic<std::size_t> peakWaiting_{0};
+    std::vector<Connection> connections_;
+    std::thread thread_;
+};
+
+// Awaits one save through the router and records the outcome and the resuming thread
+DetachedTask saveThroughRouter(ClusterProcessor& router, uint64_t timestamp, std::atomic<int>& saved,
+                               std::mutex& threadsMutex, std::set<std::thread::id>& threads) {
+    auto status = co_await router.saveEventTask("flow_0", std::vector<double>(10, 1.0), timestamp);
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threads.insert(std::this_thread::get_id());
+    }
+    if (status == SaveStatus::Saved) {
+        saved.fetch_add(1);
+    }
+}
+
+SCENARIO("Consistent-hash ring assigns event names to members", "[cluster]") {
+    GIVEN("A ring of three members") {
+        ConsistentHashRing ring({"node-a:1", "node-b:2", "node-c:3"});
+
+        WHEN("Many event names are placed on the ring") {
+            std::map<std::size_t, int> owned;
+            for (int i = 0; i < 3000; ++i) {
+                owned[ring.ownerOf("event_" + std::to_string(i))]++;
+            }
+
+            THEN("Every member owns a fair share") {
+                REQUIRE(owned.size() == 3);
+                for (const auto& [member, count] : owned) {
+                    REQUIRE(count > 600);
+                }
+            }
+        }
+
+        WHEN("A member is added") {
+            ConsistentHashRing grown({"node-a:1", "node-b:2", "node-c:3", "node-d:4"});
+
+            THEN("Only keys moving to the new member change owner") {
+                for (int i = 0; i < 1000; ++i) {
+                    auto key = "event_" + std::to_string(i);
+                    auto before = ring.ownerOf(key);
+                    auto after = grown.ownerOf(key);
+                    REQUIRE((after == before || after == 3));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Cluster router scatters events and gathers partial aggregates", "[cluster][http]") {
+    GIVEN("Two data nodes behind a cluster processor") {
+        ClusterNodeFixture first(8103);
+        ClusterNodeFixture second(8104);
+        ClusterProcessor router({"127.0.0.1:8103", "127.0.0.1:8104"});
+
+        std::vector<std::string> eventNames;
+        for (int i = 0; i < 8; ++i) {
+            eventNames.push_back("flow_" + std::to_string(i));
+        }
+
+        WHEN("Events are saved through the router") {
+            for (std::size_t i = 0; i < eventNames.size(); ++i) {
+                REQUIRE(router.saveEvent(eventNames[i], std::vector<double>(10, 1.0 + i), 1617235200));
+            }
+
+            THEN("Each event is stored only on its owning node") {
+                for (const auto& eventName : eventNames) {
+                    auto& owner = router.ownerOf(eventName) == 0 ? first.storage : second.storage;
+                    auto& other = router.ownerOf(eventName) == 0 ? second.storage : first.storage;
+                    REQUIRE(owner.getFilteredEvents(eventName).size() == 1);
+                    REQUIRE(other.getFilteredEvents(eventName).empty());
+                }
+            }
+
+            THEN("A multi-event query merges the partial results of both nodes") {
+                auto aggregates = router.calculateAggregates(eventNames);
+                REQUIRE(aggregates.size() == eventNames.size());
+                for (std::size_t i = 0; i < eventNames.size(); ++i) {
+                    REQUIRE(aggregates[i].count == 1);
+                    REQUIRE_THAT(aggregates[i].sum, Catch::Matchers::WithinRel(10.0 * (1.0 + i), 0.0001));
+                }
+                REQUIRE_THAT(router.calculateMeanLength("flow_3"), Catch::Matchers::WithinRel(40.0, 0.0001));
+            }
+
+            THEN("Approximate aggregates are gathered from the owning nodes") {
+                auto estimates = router.calculateSampledAggregates(eventNames);
+                REQUIRE(estimates.size() == eventNames.size());
+                for (std::size_t i = 0; i < eventNames.size(); ++i) {
+                    REQUIRE(estimates[i].count == 1.0);
+                    REQUIRE_THAT(estimates[i].sum, Catch::Matchers::WithinRel(10.0 * (1.0 + i), 0.0001));
+                }
+            }
+
+            THEN("A series query is answered by the owning node") {
+                REQUIRE(router.saveEvent("flow_3", std::vector<double>(10, 2.0), 1617235200 + 90));
+                auto buckets = router.calculateSeries("flow_3", 60, 1617235200);
+                REQUIRE(buckets.size() == 2);
+                REQUIRE(buckets[0].bucketStart == 1617235200);
+                REQUIRE(buckets[1].bucketStart == 1617235260);
+                REQUIRE(buckets[1].aggregate.count == 1);
+                REQUIRE_THAT(buckets[1].aggregate.sum, Catch::Matchers::WithinRel(20.0, 0.0001));
+            }
+
+            THEN("A window query is answered by the owning node") {
+                REQUIRE(router.saveEvent("flow_3", std::vector<double>(10, 2.0), 1617235200 + 90));
+                auto windows = router.calculateWindows("flow_3", {{1617235200, 1617235299}, {1617235260, 1617235299}});
+                REQUIRE(windows.size() == 2);
+                REQUIRE(windows[0].count == 2);
+                REQUIRE_THAT(windows[0].sum, Catch::Matchers::WithinRel(60.0, 0.0001));
+                REQUIRE(windows[1].count == 1);
+                REQUIRE_THAT(windows[1].sum, Catch::Matchers::WithinRel(20.0, 0.0001));
+            }
+        }
+
+        WHEN("An event with a wrong number of values is saved") {
+            THEN("The router rejects it without forwarding") {
+                REQUIRE_FALSE(router.saveEvent("flow_0", std::vector<double>(3, 1.0), 1617235200));
+            }
+        }
+    }
+}
+
+SCENARIO("Cluster router keeps many slow requests in flight without blocking threads", "[cluster][task]") {
+    GIVEN("A router in front of a node that answers after half a second") {
+        DelayedPeer node(8117, std::chrono::milliseconds(500), R"({"aggregates":[{"sum":20.0,"count":4}]})");
+        ClusterProcessor router({"127.0.0.1:8117"});
+
+        WHEN("Hundreds of saves are started from one thread") {
+            constexpr int kSaves = 400;
+            std::atomic<int> saved{0};
+            std::mutex threadsMutex;
+            std::set<std::thread::id> threads;
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kSaves; ++i) {
+                saveThroughRouter(router, 1617235200 + i, saved, threadsMutex, threads);
+            }
+            const auto started = std::chrono::steady_clock::now() - start;
+            while (saved < kSaves && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            const auto finished = std::chrono::steady_clock::now() - start;
+
+            THEN("Starting them does not wait for the node") {
+                REQUIRE(started < std::chrono::milliseconds(500));
+            }
+
+            THEN("They wait concurrently and complete on the client's own thread") {
+                REQUIRE(saved == kSaves);
+                REQUIRE(node.peakWaiting() == kSaves);
+                REQUIRE(finished < std::chrono::seconds(5));
+                REQUIRE(threads.size() == 1);
+                REQUIRE(threads.count(std::this_thread::get_id()) == 0);
+            }
+        }
+
+        WHEN("A mean is calculated through the synchronous interface") {
+            THEN("It waits for the coroutine") {
+                REQUIRE_THAT(router.calculateMeanLength("flow_0"), Catch::Matchers::WithinRel(5.0, 0.0001));
+            }
+        }
+    }
+}
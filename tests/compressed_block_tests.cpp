@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/compressed_block.h"
+#include "telemetry/telemetry_storage.h"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Millisecond-precision durations with a few repeating values, one event per second
+std::vector<EventData> typicalEvents(std::size_t count) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> duration(0, 7);
+    std::vector<EventData> events;
+    for (std::size_t i = 0; i < count; ++i) {
+        EventData event{{}, 1617235200 + i};
+        for (int v = 0; v < 10; ++v) {
+            event.values.push_back(0.25 * duration(random));
+        }
+        events.push_back(event);
+    }
+    return events;
+}
+
+std::vector<EventData> decodeAll(const CompressedBlock& block) {
+    std::vector<EventData> events;
+    block.forEach([&](const EventData& event) { events.push_back(event); });
+    return events;
+}
+
+} // namespace
+
+SCENARIO("Compressed blocks round-trip events exactly", "[storage][compression]") {
+    GIVEN("Events with irregular timestamps, value counts and special values") {
+        std::vector<EventData> events = {
+            {{1.5, 1.5, 2.0}, 1000},
+            {{1.5, -0.0, 1e300}, 1000},
+            {{}, 999},
+            {{std::numeric_limits<double>::infinity(), 3.25}, 5000000000ULL},
+            {{0.1, 0.2, 0.3, 0.4}, 7},
+            {{std::numeric_limits<double>::denorm_min()}, std::numeric_limits<uint64_t>::max()},
+            {{42.0}, 0},
+        };
+
+        WHEN("They are compressed and decoded") {
+            auto block = CompressedBlock::encode(events);
+            auto decoded = decodeAll(block);
+
+            THEN("Every timestamp and value comes back bit for bit") {
+                REQUIRE(decoded.size() == events.size());
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(decoded[i].timestamp == events[i].timestamp);
+                    REQUIRE(decoded[i].values.size() == events[i].values.size());
+                    for (std::size_t v = 0; v < events[i].values.size(); ++v) {
+                        REQUIRE(std::signbit(decoded[i].values[v]) == std::signbit(events[i].values[v]));
+                        REQUIRE(decoded[i].values[v] == events[i].values[v]);
+                    }
+                }
+                REQUIRE(block.minTimestamp() == 0);
+                REQUIRE(block.maxTimestamp() == std::numeric_limits<uint64_t>::max());
+            }
+        }
+    }
+
+    GIVEN("Typical telemetry with nearly regular timestamps and repetitive durations") {
+        auto events = typicalEvents(TelemetryStorage::kBlockSize);
+
+        WHEN("They are compressed") {
+            auto block = CompressedBlock::encode(events);
+
+            THEN("They take a fraction of their raw size") {
+                std::size_t raw = events.size() * (10 * sizeof(double) + sizeof(uint64_t));
+                REQUIRE(block.compressedBytes() * 4 < raw);
+                REQUIRE(decodeAll(block).back().values == events.back().values);
+            }
+        }
+    }
+}
+
+SCENARIO("Storage seals full heads into compressed blocks transparently", "[storage][compression]") {
+    GIVEN("A storage holding several blocks and a partial head") {
+        TelemetryStorage storage;
+        auto events = typicalEvents(TelemetryStorage::kBlockSize * 3 + 17);
+        double expectedSum = 0.0;
+        for (const auto& event : events) {
+            storage.saveEvent("flow", event.values, event.timestamp);
+            for (double value : event.values) {
+                expectedSum += value;
+            }
+        }
+
+        THEN("All events are returned in insertion order") {
+            auto stored = storage.getFilteredEvents("flow");
+            REQUIRE(stored.size() == events.size());
+            for (std::size_t i = 0; i < events.size(); ++i) {
+                REQUIRE(stored[i].timestamp == events[i].timestamp);
+                REQUIRE(stored[i].values == events[i].values);
+            }
+        }
+
+        THEN("Aggregates over all and over ranges crossing block borders match a plain scan") {
+            auto total = storage.aggregateEvents("flow");
+            REQUIRE(total.count == events.size());
+            REQUIRE_THAT(total.sum, Catch::Matchers::WithinRel(expectedSum, 1e-9));
+
+            uint64_t start = events[500].timestamp;
+            uint64_t end = events[1100].timestamp;
+            double rangeSum = 0.0;
+            for (std::size_t i = 500; i <= 1100; ++i) {
+                for (double value : events[i].values) {
+                    rangeSum += value;
+                }
+            }
+            auto range = storage.aggregateEvents("flow", start, end);
+            REQUIRE(range.count == 601);
+            REQUIRE_THAT(range.sum, Catch::Matchers::WithinRel(rangeSum, 1e-9));
+            REQUIRE(storage.getFilteredEvents("flow", start, end).size() == 601);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/sharded_storage.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Reads every chunk of an export and checks that no chunk exceeds the limit
+std::vector<EventData> readAll(ITelemetryStorage& storage, const std::string& eventName,
+                               std::optional<uint64_t> startTimestamp, std::optional<uint64_t> endTimestamp,
+                               std::size_t chunkEvents) {
+    std::vector<EventData> events;
+    EventCursor cursor;
+    while (!cursor.done) {
+        std::vector<EventData> chunk;
+        storage.readEvents(eventName, startTimestamp, endTimestamp, cursor, chunkEvents, chunk);
+        REQUIRE(chunk.size() <= chunkEvents);
+        events.insert(events.end(), chunk.begin(), chunk.end());
+    }
+    return events;
+}
+
+std::vector<uint64_t> timestampsOf(const std::vector<EventData>& events) {
+    std::vector<uint64_t> timestamps;
+    for (const auto& event : events) {
+        timestamps.push_back(event.timestamp);
+    }
+    return timestamps;
+}
+
+} // namespace
+
+SCENARIO("Storage reads events in bounded chunks with a resumable cursor", "[export][storage]") {
+    const uint64_t base = 1617235200;
+
+    GIVEN("A storage with sealed blocks and a partial head") {
+        TelemetryStorage storage;
+        for (uint64_t i = 0; i < 1300; ++i) {
+            storage.saveEvent("trip", std::vector<double>(10, 0.25 * static_cast<double>(i % 9)), base + i);
+        }
+
+        WHEN("The whole series is read in chunks") {
+            auto events = readAll(storage, "trip", std::nullopt, std::nullopt, 100);
+
+            THEN("Every event comes back once with its values, in storage order") {
+                auto expected = storage.getFilteredEvents("trip");
+                REQUIRE(events.size() == 1300);
+                REQUIRE(timestampsOf(events) == timestampsOf(expected));
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(events[i].values == expected[i].values);
+                }
+            }
+        }
+
+        WHEN("A time range cutting through blocks is read") {
+            auto events = readAll(storage, "trip", base + 300, base + 1100, 64);
+
+            THEN("Only the events in the range are returned") {
+                REQUIRE(timestampsOf(events) == timestampsOf(storage.getFilteredEvents("trip", base + 300, base + 1100)));
+            }
+        }
+
+        WHEN("Events are saved between chunks and the head is sealed") {
+            EventCursor cursor;
+            std::vector<EventData> events;
+            // 1024 sealed events and 276 in the head; stop inside the head
+            storage.readEvents("trip", std::nullopt, std::nullopt, cursor, 1200, events);
+            for (uint64_t i = 1300; i < 1600; ++i) {
+                storage.saveEvent("trip", std::vector<double>(10, 1.0), base + i);
+            }
+            while (!cursor.done) {
+                storage.readEvents("trip", std::nullopt, std::nullopt, cursor, 100, events);
+            }
+
+            THEN("The cursor continues where it stopped without skipping or repeating events") {
+                REQUIRE(events.size() == 1600);
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(events[i].timestamp == base + i);
+                }
+            }
+        }
+
+        WHEN("An unknown event is read") {
+            EventCursor cursor;
+            std::vector<EventData> events;
+            storage.readEvents("missing", std::nullopt, std::nullopt, cursor, 100, events);
+
+            THEN("The read is complete at once") {
+                REQUIRE(cursor.done);
+                REQUIRE(events.empty());
+            }
+        }
+    }
+
+    GIVEN("A sharded storage written by three threads") {
+        ShardedStorage storage(3, false);
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < 3; ++t) {
+            threads.emplace_back([&, t] {
+                for (uint64_t i = 0; i < 700; ++i) {
+                    storage.saveEvent("trip", std::vector<double>(10, 1.0), base + i * 3 + t);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        WHEN("The series is read in chunks") {
+            auto events = readAll(storage, "trip", std::nullopt, std::nullopt, 250);
+
+            THEN("Every shard is read once") {
+                auto timestamps = timestampsOf(events);
+                std::sort(timestamps.begin(), timestamps.end());
+                REQUIRE(timestamps.size() == 2100);
+                REQUIRE(std::adjacent_find(timestamps.begin(), timestamps.end()) == timestamps.end());
+            }
+        }
+    }
+}
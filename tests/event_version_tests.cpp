@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/forwarding_storage.h"
+#include "telemetry/telemetry_processor.h"
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kBase = 1617235200;
+
+// Storage that only has the interface's default versioning
+struct UnversionedStorage : ForwardingStorage {
+    using ForwardingStorage::ForwardingStorage;
+    std::optional<uint64_t> eventVersion(const std::string& eventName) override {
+        return ITelemetryStorage::eventVersion(eventName);
+    }
+};
+
+} // namespace
+
+SCENARIO("Event versions change exactly when the data does", "[version][storage]") {
+    GIVEN("A storage with events of two names") {
+        TelemetryStorage storage;
+        REQUIRE(storage.saveEvent("trip", std::vector<double>(10, 1.0), kBase));
+        REQUIRE(storage.saveEvent("ride", std::vector<double>(10, 1.0), kBase));
+        auto trip = storage.eventVersion("trip");
+        auto ride = storage.eventVersion("ride");
+        REQUIRE(trip);
+        REQUIRE(ride);
+
+        WHEN("Queries run and overlapping runs are compacted") {
+            for (uint64_t i = 0; i < 3 * TelemetryStorage::kBlockSize; ++i) {
+                storage.saveEvent("trip", std::vector<double>(10, 1.0), kBase + (i * 7919) % 5000);
+            }
+            auto filled = storage.eventVersion("trip");
+            storage.waitForCompactions();
+            storage.aggregateEvents("trip");
+            storage.aggregateSeries("trip", 60);
+
+            THEN("The version stays where the last save left it") {
+                REQUIRE(storage.compactions() > 0);
+                REQUIRE(storage.eventVersion("trip") == filled);
+            }
+        }
+
+        WHEN("An event of one name is saved") {
+            REQUIRE(storage.saveEvent("trip", std::vector<double>(10, 1.0), kBase - 100));
+
+            THEN("Only that name's version grows") {
+                REQUIRE(*storage.eventVersion("trip") > *trip);
+                REQUIRE(storage.eventVersion("ride") == ride);
+            }
+        }
+
+        WHEN("A save is rejected") {
+            TelemetryStorage precise(PrecisionPolicy{ValuePrecision::Milliseconds, {}});
+            REQUIRE(precise.saveEvent("trip", std::vector<double>(10, 1.0), kBase));
+            auto before = precise.eventVersion("trip");
+            REQUIRE_FALSE(precise.saveEvent("trip", std::vector<double>(10, -1.0), kBase));
+
+            THEN("The version is unchanged") {
+                REQUIRE(precise.eventVersion("trip") == before);
+            }
+        }
+
+        WHEN("The storage is cleared and refilled") {
+            storage.clear();
+            auto cleared = storage.eventVersion("trip");
+            REQUIRE(storage.saveEvent("trip", std::vector<double>(10, 1.0), kBase));
+
+            THEN("Versions never return to a value seen before the clear") {
+                REQUIRE(*cleared > *trip);
+                REQUIRE(*cleared > *ride);
+                REQUIRE(*storage.eventVersion("trip") > *cleared);
+                REQUIRE(storage.eventVersion("unknown") == cleared);
+            }
+        }
+    }
+
+    GIVEN("A sharded storage, a processor and a storage without versions") {
+        ShardedStorage sharded(2, false);
+        sharded.saveEvent("trip", std::vector<double>(10, 1.0), kBase);
+        auto before = sharded.eventVersion("trip");
+        std::thread([&] { sharded.saveEvent("trip", std::vector<double>(10, 1.0), kBase + 1); }).join();
+
+        TelemetryStorage storage;
+        TelemetryProcessor processor(storage);
+        UnversionedStorage unversioned(storage);
+        TelemetryProcessor unversionedProcessor(unversioned);
+        processor.saveEvent("trip", std::vector<double>(10, 1.0), kBase);
+        auto both = processor.eventsVersion({"trip", "ride"});
+        processor.saveEvent("ride", std::vector<double>(10, 1.0), kBase);
+
+        THEN("Saves on any shard or to any of the names change the combined version") {
+            REQUIRE(*sharded.eventVersion("trip") > *before);
+            REQUIRE(both);
+            REQUIRE(*processor.eventsVersion({"trip", "ride"}) > *both);
+            REQUIRE(processor.eventsVersion({"trip"}) == storage.eventVersion("trip"));
+        }
+
+        THEN("Without storage versions the processor cannot tell") {
+            REQUIRE_FALSE(unversioned.eventVersion("trip"));
+            REQUIRE_FALSE(unversionedProcessor.eventsVersion({"trip"}));
+        }
+    }
+}
@@ -4,7 +4,17 @@
 #include "catch2/trompeloeil.hpp"
 #include "telemetry/interfaces.h"
 #include "telemetry/http_server.h"
+#include "telemetry/query_context.h"
+#include "telemetry/tracing.h"
+#include "telemetry/instrumented_mutex.h"
 #include <nlohmann/json.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <thread>
 #include <future>
 #include <chrono>
@@ -25,6 +35,29 @@ class MockTelemetryProcessor : public ITelemetryProcessor {
 public:
     MAKE_MOCK3(saveEvent, bool(const std::string&, const std::vector<double>&, uint64_t));
     MAKE_MOCK3(calculateMeanLength, double(const std::string&, std::optional<uint64_t>, std::optional<uint64_t>));
+    MAKE_MOCK3(calculateAggregates, std::vector<PathAggregate>(const std::vector<std::string>&, std::optional<uint64_t>, std::optional<uint64_t>));
+    MAKE_MOCK4(calculateSeries, std::vector<SeriesBucket>(const std::string&, uint64_t, std::optional<uint64_t>, std::optional<uint64_t>));
+    MAKE_MOCK2(calculateWindows, std::vector<PathAggregate>(const std::string&, const std::vector<TimeWindow>&));
+    MAKE_MOCK3(calculateSampledAggregates, std::vector<SampledAggregate>(const std::vector<std::string>&, std::optional<uint64_t>, std::optional<uint64_t>));
+    MAKE_MOCK6(readEvents, void(const std::string&, std::optional<uint64_t>, std::optional<uint64_t>, EventCursor&, std::size_t, std::vector<EventData>&));
+    MAKE_MOCK2(subscribeRollingMean, std::shared_ptr<IRollingMean>(const std::string&, uint64_t));
+    MAKE_MOCK4(registerStandingQuery, void(const std::string&, const std::string&, std::optional<uint64_t>, std::optional<uint64_t>));
+    MAKE_MOCK1(readStandingQuery, std::optional<PathAggregate>(const std::string&));
+    MAKE_MOCK1(removeStandingQuery, bool(const std::string&));
+    MAKE_MOCK1(eventsVersion, std::optional<uint64_t>(const std::vector<std::string>&));
+};
+
+// Rolling window that always reports the same state
+class FixedRollingMean : public IRollingMean {
+public:
+    RollingMeanSnapshot snapshot() override { return {2.5, 4}; }
+};
+
+// Status provider with fixed fields
+class FixedStatusProvider : public IStatusProvider {
+public:
+    std::string statusName() const override { return "replication"; }
+    std::map<std::string, double> statusFields() const override { return {{"lagRecords", 3.0}}; }
 };
 
 // Test Fixture class for HTTP server tests
@@ -34,11 +67,15 @@ public:
         mockProcessor(new MockTelemetryProcessor()),
         port(port),
         isServerRunning(false) {
+        // Unversioned data unless a test says otherwise, so responses carry no entity tag
+        unversioned = NAMED_ALLOW_CALL(*mockProcessor, eventsVersion(ANY(std::vector<std::string>)))
+            .RETURN(std::optional<uint64_t>());
         DEBUG_LOG("Created test fixture for port " + std::to_string(port));
     }
     
     ~HttpServerTestFixture() {
         stopServer();
+        unversioned.reset();
         delete mockProcessor;
         DEBUG_LOG("Destroyed test fixture for port " + std::to_string(port));
     }
@@ -53,9 +90,18 @@ public:
         config.address = "127.0.0.1";
         config.port = port;
         config.threadCount = 1;
+        config.streamIntervalMs = 100;
+        config.listenerCount = listenerCount;
+        config.eventRateLimit = eventRateLimit;
+        config.maxInFlightStreams = maxInFlightStreams;
+        config.traceSampleEvery = traceSampleEvery;
+        config.traceFile = "http_server_tests_trace.json";
         
         // Create server
         server = std::make_unique<TelemetryHttpServer>(config, *mockProcessor);
+        if (statusProvider) {
+            server->addStatusProvider(*statusProvider);
+        }
         
         // Start server in a thread
         serverThread = std::make_unique<std::thread>([this]() {
@@ -87,11 +133,17 @@ public:
     }
     
     MockTelemetryProcessor* mockProcessor;
+    IStatusProvider* statusProvider = nullptr;
+    int listenerCount = 1;
+    double eventRateLimit = 0.0;
+    int maxInFlightStreams = 0;
+    int traceSampleEvery = 0;
     int port;
     
 private:
     std::unique_ptr<TelemetryHttpServer> server;
     std::unique_ptr<std::thread> serverThread;
+    std::unique_ptr<trompeloeil::expectation> unversioned;
     bool isServerRunning;
 };
 
@@ -101,7 +153,8 @@ struct HttpResponse {
     json body;
 };
 
-HttpResponse sendCurlRequest(const std::string& method, const std::string& url, const json& body) {
+HttpResponse sendCurlRequest(const std::string& method, const std::string& url, const json& body,
+                             const std::vector<std::string>& extraHeaders = {}) {
     // Get curl path from CMake-defined macro
     const char* curlPath = CURL_EXECUTABLE;
     if (!curlPath || strlen(curlPath) == 0) {
@@ -115,7 +168,11 @@ HttpResponse sendCurlRequest(const std::string& method, const std::string& url,
     
     // Build curl command to capture response body, status code, and headers
     std::string command = std::string(curlPath) + " -s -X " + method + 
-                          " -H \"Content-Type: application/json\" " +
+                          " -H \"Content-Type: application/json\" ";
+    for (const auto& header : extraHeaders) {
+        command += "-H '" + header + "' ";
+    }
+    command = command +
                           "-d '" + body.dump() + "' " +
                           "-D " + headersFile + " " +  // Dump headers to file
                           "-w '%{http_code}' " +
@@ -695,3 +752,812 @@ SCENARIO("HTTP server handles malformed JSON correctly", "[http][validation][bdd
         // Server is automatically stopped and cleaned up in fixture destructor
     }
 }
+
+SCENARIO("HTTP server streams rolling means as server-sent events", "[http][stream][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8102);
+        fixture.startServer();
+
+        WHEN("A client subscribes to the rolling mean of an event") {
+            std::string eventName = "test_event";
+            auto window = std::make_shared<FixedRollingMean>();
+
+            REQUIRE_CALL(*fixture.mockProcessor, subscribeRollingMean(eventName, 60u))
+                .TIMES(1)
+                .RETURN(window);
+
+            // Keep the stream open for a few push intervals, then disconnect
+            std::string streamFile = "/tmp/stream_" + std::to_string(rand()) + ".txt";
+            std::string command = std::string(CURL_EXECUTABLE) + " -s -N --max-time 1 '" +
+                                  fixture.getBaseUrl() + "/paths/" + eventName +
+                                  "/meanLength/stream?window=60&resultUnit=milliseconds' > " + streamFile;
+            DEBUG_LOG("Executing: " + command);
+            std::system(command.c_str());
+
+            std::ifstream streamStream(streamFile);
+            std::vector<json> events;
+            std::string line;
+            while (std::getline(streamStream, line)) {
+                if (line.rfind("data: ", 0) == 0) {
+                    events.push_back(json::parse(line.substr(6)));
+                }
+            }
+            streamStream.close();
+            std::remove(streamFile.c_str());
+
+            THEN("The server pushes the window state repeatedly") {
+                REQUIRE(events.size() >= 2);
+                REQUIRE_THAT(events.front()["mean"].get<double>(),
+                           Catch::Matchers::WithinRel(2500.0, 0.0001));
+                REQUIRE(events.front()["count"] == 4);
+            }
+        }
+
+        WHEN("A client subscribes with an invalid window") {
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength/stream?window=abc",
+                json::object()
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+                REQUIRE(response.body["error"].get<std::string>().find("window") != std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server answers multi-event and partial aggregate queries", "[http][cluster][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8105);
+        fixture.startServer();
+
+        std::vector<std::string> eventNames{"flow_a", "flow_b"};
+        std::vector<PathAggregate> aggregates{{30.0, 2}, {10.0, 2}};
+
+        WHEN("A GET request is sent to /meanLength for several events") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateAggregates(eventNames, std::optional<uint64_t>(1617235200), std::optional<uint64_t>()))
+                .TIMES(1)
+                .RETURN(aggregates);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/meanLength",
+                json{{"events", eventNames}, {"resultUnit", "seconds"}, {"startTimestamp", 1617235200}}
+            );
+
+            THEN("The server returns the combined and per-event means") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE_THAT(response.body["mean"].get<double>(), Catch::Matchers::WithinRel(10.0, 0.0001));
+                REQUIRE(response.body["count"] == 4);
+                REQUIRE_THAT(response.body["events"]["flow_a"]["mean"].get<double>(),
+                           Catch::Matchers::WithinRel(15.0, 0.0001));
+            }
+        }
+
+        WHEN("A GET request is sent to /aggregates") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateAggregates(eventNames, std::optional<uint64_t>(), std::optional<uint64_t>()))
+                .TIMES(1)
+                .RETURN(aggregates);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/aggregates",
+                json{{"events", eventNames}}
+            );
+
+            THEN("The server returns the raw partial sums in request order") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["aggregates"].size() == 2);
+                REQUIRE_THAT(response.body["aggregates"][1]["sum"].get<double>(),
+                           Catch::Matchers::WithinRel(10.0, 0.0001));
+                REQUIRE(response.body["aggregates"][1]["count"] == 2);
+            }
+        }
+
+        WHEN("A multi-event query has no events") {
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/meanLength",
+                json{{"events", json::array()}, {"resultUnit", "seconds"}}
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+                REQUIRE(response.body["error"].get<std::string>().find("events") != std::string::npos);
+            }
+        }
+
+        WHEN("The processor cannot reach its backend") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength(ANY(std::string), ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .THROW(BackendUnavailableError("node down"));
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                json{{"resultUnit", "seconds"}}
+            );
+
+            THEN("The server returns a 503 Service Unavailable status") {
+                REQUIRE(response.statusCode == 503);
+                REQUIRE(response.body["error"] == "node down");
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server answers time-bucketed series queries", "[http][series][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8108);
+        fixture.startServer();
+
+        WHEN("A GET request is sent to /paths/{event}/series") {
+            std::vector<SeriesBucket> buckets{{1617235200, {30.0, 3}}, {1617235500, {8.0, 2}}};
+            REQUIRE_CALL(*fixture.mockProcessor, calculateSeries("test_event", 300, std::optional<uint64_t>(1617235200), std::optional<uint64_t>(1617321599)))
+                .TIMES(1)
+                .RETURN(buckets);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/series",
+                json{{"resultUnit", "milliseconds"}, {"bucketSeconds", 300},
+                     {"startTimestamp", 1617235200}, {"endTimestamp", 1617321599}}
+            );
+
+            THEN("The server returns the mean and count of every bucket") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["buckets"].size() == 2);
+                REQUIRE(response.body["buckets"][0]["bucketStart"] == 1617235200);
+                REQUIRE_THAT(response.body["buckets"][0]["mean"].get<double>(),
+                           Catch::Matchers::WithinRel(10000.0, 0.0001));
+                REQUIRE(response.body["buckets"][1]["count"] == 2);
+            }
+        }
+
+        WHEN("The bucket width is missing or not positive") {
+            HttpResponse missing = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/series",
+                json{{"resultUnit", "seconds"}}
+            );
+            HttpResponse zero = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/series",
+                json{{"resultUnit", "seconds"}, {"bucketSeconds", 0}}
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(missing.statusCode == 400);
+                REQUIRE(zero.statusCode == 400);
+                REQUIRE(zero.body["error"].get<std::string>().find("bucketSeconds") != std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server accepts connections on several SO_REUSEPORT listeners", "[http][config][bdd]") {
+    GIVEN("A running HTTP server with three listeners on one port") {
+        HttpServerTestFixture fixture(8109);
+        fixture.listenerCount = 3;
+        fixture.startServer();
+
+        WHEN("Many separate connections send requests") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(12)
+                .RETURN(1.5);
+
+            std::vector<int> statusCodes;
+            for (int i = 0; i < 12; ++i) {
+                statusCodes.push_back(sendCurlRequest(
+                    "GET",
+                    fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                    json{{"resultUnit", "seconds"}}
+                ).statusCode);
+            }
+
+            THEN("Every request is answered, whichever listener accepted it") {
+                for (int statusCode : statusCodes) {
+                    REQUIRE(statusCode == 200);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server sheds saves beyond the event rate limit", "[http][admission][bdd]") {
+    GIVEN("A running HTTP server that allows one save of an event name every 100 seconds") {
+        HttpServerTestFixture fixture(8110);
+        fixture.eventRateLimit = 0.01;
+        fixture.startServer();
+
+        WHEN("The same event is saved twice in a row") {
+            REQUIRE_CALL(*fixture.mockProcessor, saveEvent("test_event", ANY(std::vector<double>), ANY(uint64_t)))
+                .TIMES(1)
+                .RETURN(true);
+
+            json event{{"values", std::vector<double>(10, 1.0)}, {"date", 1617235200}};
+            HttpResponse first = sendCurlRequest("POST", fixture.getBaseUrl() + "/paths/test_event", event);
+            HttpResponse second = sendCurlRequest("POST", fixture.getBaseUrl() + "/paths/test_event", event);
+            HttpResponse status = sendCurlRequest("GET", fixture.getBaseUrl() + "/status", json::object());
+
+            THEN("The second save is answered with 503 and Retry-After without reaching the processor") {
+                REQUIRE(first.statusCode == 200);
+                REQUIRE(second.statusCode == 503);
+                REQUIRE(std::stoi(second.headers["Retry-After"]) >= 1);
+                REQUIRE(status.body["admission"]["shedRateLimited"] == 1.0);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server sheds rolling-mean streams beyond their in-flight limit", "[http][admission][stream][bdd]") {
+    GIVEN("A running HTTP server that allows one open stream") {
+        HttpServerTestFixture fixture(8122);
+        fixture.maxInFlightStreams = 1;
+        fixture.startServer();
+
+        WHEN("A second client subscribes while the first stream is open") {
+            auto window = std::make_shared<FixedRollingMean>();
+            REQUIRE_CALL(*fixture.mockProcessor, subscribeRollingMean("test_event", 60u))
+                .TIMES(1)
+                .RETURN(window);
+
+            std::string command = std::string(CURL_EXECUTABLE) + " -s -N --max-time 2 -o /dev/null '" +
+                                  fixture.getBaseUrl() + "/paths/test_event/meanLength/stream?window=60'";
+            std::thread first([&] { std::system(command.c_str()); });
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            HttpResponse second = sendCurlRequest(
+                "GET", fixture.getBaseUrl() + "/paths/test_event/meanLength/stream?window=60", json::object());
+            HttpResponse status = sendCurlRequest("GET", fixture.getBaseUrl() + "/status", json::object());
+            first.join();
+
+            THEN("It is answered with 503 and Retry-After without subscribing, and the open stream holds the slot") {
+                REQUIRE(second.statusCode == 503);
+                REQUIRE(std::stoi(second.headers["Retry-After"]) >= 1);
+                REQUIRE(status.body["admission"]["inFlightStreams"] == 1.0);
+                REQUIRE(status.body["admission"]["shedInFlight"] == 1.0);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server enforces query deadlines", "[http][deadline][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8111);
+        fixture.startServer();
+
+        WHEN("A query with a deadline is cut short and partial results are allowed") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .SIDE_EFFECT(QueryContext::current()->markPartial())
+                .RETURN(2.0);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                json{{"resultUnit", "seconds"}, {"timeoutMs", 50}, {"allowPartial", true}}
+            );
+
+            THEN("The result is returned and flagged as partial") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["mean"] == 2.0);
+                REQUIRE(response.body["partial"] == true);
+            }
+        }
+
+        WHEN("A query runs past its deadline") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateAggregates(ANY(std::vector<std::string>), ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .THROW(QueryTimeoutError("Query exceeded its deadline"));
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/aggregates",
+                json{{"events", {"test_event"}}, {"timeoutMs", 50}}
+            );
+
+            THEN("The server returns a 504 Gateway Timeout status") {
+                REQUIRE(response.statusCode == 504);
+            }
+        }
+
+        WHEN("The requested timeout is not a positive integer") {
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                json{{"resultUnit", "seconds"}, {"timeoutMs", 0}}
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+                REQUIRE(response.body["error"].get<std::string>().find("timeoutMs") != std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server answers approximate queries from samples", "[http][sampling][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8115);
+        fixture.startServer();
+
+        // Mean 2.0 over an estimated 100 paths with a 95% margin of 1.96 * sqrt(400) / 100 = 0.392
+        SampledAggregate estimate;
+        estimate.sum = 200.0;
+        estimate.count = 100.0;
+        estimate.sampleSize = 64;
+        estimate.variance = {400.0, 0.0, 0.0};
+
+        WHEN("An approximate mean is requested") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateSampledAggregates(std::vector<std::string>{"test_event"}, ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .RETURN(std::vector<SampledAggregate>{estimate});
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                json{{"resultUnit", "milliseconds"}, {"approximate", true}}
+            );
+
+            THEN("The estimate is returned with its confidence interval and sample size") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE_THAT(response.body["mean"].get<double>(), Catch::Matchers::WithinRel(2000.0, 1e-9));
+                REQUIRE(response.body["approximate"] == true);
+                REQUIRE(response.body["sampleSize"] == 64);
+                REQUIRE_THAT(response.body["confidenceInterval"][0].get<double>(), Catch::Matchers::WithinRel(1608.0, 1e-9));
+                REQUIRE_THAT(response.body["confidenceInterval"][1].get<double>(), Catch::Matchers::WithinRel(2392.0, 1e-9));
+            }
+        }
+
+        WHEN("The estimate misses the requested error budget") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateSampledAggregates(std::vector<std::string>{"test_event"}, ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .RETURN(std::vector<SampledAggregate>{estimate});
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .RETURN(2.1);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                json{{"resultUnit", "seconds"}, {"approximate", true}, {"maxRelativeError", 0.05}}
+            );
+
+            THEN("The exact mean is computed instead") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["mean"] == 2.1);
+                REQUIRE(response.body["approximate"] == false);
+            }
+        }
+
+        WHEN("Approximate partial aggregates are requested") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateSampledAggregates(std::vector<std::string>{"test_event"}, ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .RETURN(std::vector<SampledAggregate>{estimate});
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/aggregates",
+                json{{"events", {"test_event"}}, {"approximate", true}}
+            );
+
+            THEN("The raw estimate and its variance terms are returned for merging") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["aggregates"][0]["sum"] == 200.0);
+                REQUIRE(response.body["aggregates"][0]["sampleSize"] == 64);
+                REQUIRE(response.body["aggregates"][0]["variance"] == json::array({400.0, 0.0, 0.0}));
+            }
+        }
+
+        WHEN("The error budget is not a positive number") {
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/meanLength",
+                json{{"resultUnit", "seconds"}, {"approximate", true}, {"maxRelativeError", -1}}
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server streams raw events in chunks", "[http][export][bdd]") {
+    GIVEN("A running HTTP server") {
+        HttpServerTestFixture fixture(8116);
+        fixture.startServer();
+
+        WHEN("The events of a path are exported as NDJSON") {
+            REQUIRE_CALL(*fixture.mockProcessor, readEvents("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>), ANY(EventCursor&), ANY(std::size_t), ANY(std::vector<EventData>&)))
+                .TIMES(1)
+                .SIDE_EFFECT(_6.push_back(EventData{std::vector<double>(10, 1.5), 1617235200}); _4.done = true);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/events?format=ndjson",
+                json::object()
+            );
+
+            THEN("Each event is returned as one JSON line") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.headers["Content-Type"] == "application/x-ndjson");
+                REQUIRE(response.body["timestamp"] == 1617235200);
+                REQUIRE(response.body["values"] == std::vector<double>(10, 1.5));
+            }
+        }
+
+        WHEN("An export spans several chunks") {
+            REQUIRE_CALL(*fixture.mockProcessor, readEvents("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>), ANY(EventCursor&), ANY(std::size_t), ANY(std::vector<EventData>&)))
+                .TIMES(3)
+                .SIDE_EFFECT(_6.push_back(EventData{std::vector<double>(10, 1.0), 1617235200 + _4.offset++}); _4.done = _4.offset == 3);
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/events?format=binary",
+                json::object()
+            );
+
+            THEN("The remaining chunks are streamed until the cursor is done") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.headers["Content-Type"] == "application/octet-stream");
+            }
+        }
+
+        WHEN("The client stops reading an endless export") {
+            std::atomic<int> chunks{0};
+            ALLOW_CALL(*fixture.mockProcessor, readEvents("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>), ANY(EventCursor&), ANY(std::size_t), ANY(std::vector<EventData>&)))
+                .SIDE_EFFECT(++chunks; _6.assign(_5, EventData{std::vector<double>(10, 1.0), 1617235200}));
+
+            // A small receive buffer, and nothing is ever read from it
+            int client = ::socket(AF_INET, SOCK_STREAM, 0);
+            int receiveBuffer = 4096;
+            ::setsockopt(client, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(fixture.port));
+            ::inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+            REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+            const std::string request = "GET /paths/test_event/events?format=binary HTTP/1.1\r\nHost: localhost\r\n\r\n";
+            REQUIRE(::send(client, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            const int stalled = chunks.load();
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            const int later = chunks.load();
+            ::close(client);
+            fixture.stopServer();
+
+            THEN("The server stops reading events once the socket is full instead of queueing them") {
+                REQUIRE(stalled > 0);
+                REQUIRE(later == stalled);
+                // Each chunk is about 90 KiB; the socket buffers hold a few MiB at most
+                REQUIRE(stalled < 64);
+            }
+        }
+
+        WHEN("An unknown format is requested") {
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/events?format=csv",
+                json::object()
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server exports sampled request traces", "[http][tracing][bdd]") {
+    GIVEN("A running HTTP server that traces every request") {
+        HttpServerTestFixture fixture(8112);
+        fixture.traceSampleEvery = 1;
+        fixture.startServer();
+
+        WHEN("A request is served and the trace is dumped") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .RETURN(2.0);
+
+            sendCurlRequest("GET", fixture.getBaseUrl() + "/paths/test_event/meanLength", json{{"resultUnit", "seconds"}});
+            HttpResponse response = sendCurlRequest("POST", fixture.getBaseUrl() + "/trace/dump", json::object());
+
+            THEN("The trace file holds the request and its phases") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["spans"].get<int>() >= 3);
+
+                std::ifstream file(response.body["path"].get<std::string>());
+                auto trace = json::parse(file);
+                std::vector<std::string> names;
+                for (const auto& event : trace["traceEvents"]) {
+                    names.push_back(event["name"].get<std::string>());
+                }
+                REQUIRE(std::find(names.begin(), names.end(), "GET /paths/:event/meanLength") != names.end());
+                REQUIRE(std::find(names.begin(), names.end(), "http.parse") != names.end());
+                REQUIRE(std::find(names.begin(), names.end(), "http.serialize") != names.end());
+            }
+        }
+
+        fixture.stopServer();
+        tracing::configure(0);
+        std::remove("http_server_tests_trace.json");
+    }
+
+    GIVEN("A running HTTP server without tracing") {
+        HttpServerTestFixture fixture(8113);
+        fixture.startServer();
+
+        WHEN("A trace dump is requested") {
+            HttpResponse response = sendCurlRequest("POST", fixture.getBaseUrl() + "/trace/dump", json::object());
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server reports lock statistics", "[http][lockstats][bdd]") {
+    GIVEN("A running HTTP server") {
+        HttpServerTestFixture fixture(8114);
+        fixture.startServer();
+
+        WHEN("Lock statistics are requested and reset") {
+            HttpResponse stats = sendCurlRequest("GET", fixture.getBaseUrl() + "/stats/locks", json::object());
+            HttpResponse reset = sendCurlRequest("DELETE", fixture.getBaseUrl() + "/stats/locks", json::object());
+
+            THEN("The report says whether profiling is compiled in") {
+                REQUIRE(stats.statusCode == 200);
+                REQUIRE(stats.body["enabled"] == lockstats::enabled());
+                REQUIRE(stats.body["sites"].is_array());
+                REQUIRE(reset.statusCode == 200);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server reports status and rejects writes on read replicas", "[http][bdd]") {
+    GIVEN("A running HTTP server with a status provider") {
+        FixedStatusProvider replication;
+        HttpServerTestFixture fixture(8107);
+        fixture.statusProvider = &replication;
+        fixture.startServer();
+
+        WHEN("A GET request is sent to /status") {
+            HttpResponse response = sendCurlRequest("GET", fixture.getBaseUrl() + "/status", json::object());
+
+            THEN("The server returns the fields of every provider") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["replication"]["lagRecords"] == 3.0);
+            }
+        }
+
+        WHEN("The processor does not accept writes") {
+            REQUIRE_CALL(*fixture.mockProcessor, saveEvent(ANY(std::string), ANY(std::vector<double>), ANY(uint64_t)))
+                .TIMES(1)
+                .THROW(UnsupportedOperationError("read replica"));
+
+            HttpResponse response = sendCurlRequest(
+                "POST",
+                fixture.getBaseUrl() + "/paths/test_event",
+                json{{"values", std::vector<double>(10, 1.0)}, {"date", 1617235200}}
+            );
+
+            THEN("The server returns a 501 Not Implemented status") {
+                REQUIRE(response.statusCode == 501);
+                REQUIRE(response.body["error"] == "read replica");
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server defines, reads and removes standing queries", "[http][standing][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8118);
+        fixture.startServer();
+
+        WHEN("A PUT request defines a standing query") {
+            REQUIRE_CALL(*fixture.mockProcessor, registerStandingQuery("today", "test_event", std::optional<uint64_t>(1617235200), std::optional<uint64_t>()))
+                .TIMES(1);
+            REQUIRE_CALL(*fixture.mockProcessor, readStandingQuery("today"))
+                .TIMES(1)
+                .RETURN(std::optional<PathAggregate>(PathAggregate{30.0, 3}));
+
+            HttpResponse response = sendCurlRequest(
+                "PUT",
+                fixture.getBaseUrl() + "/standing/today",
+                json{{"event", "test_event"}, {"startTimestamp", 1617235200}}
+            );
+
+            THEN("The server returns its current mean and count") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE_THAT(response.body["mean"].get<double>(), Catch::Matchers::WithinRel(10.0, 0.0001));
+                REQUIRE(response.body["count"] == 3);
+            }
+        }
+
+        WHEN("The definition has no event name") {
+            HttpResponse response = sendCurlRequest(
+                "PUT",
+                fixture.getBaseUrl() + "/standing/today",
+                json{{"startTimestamp", 1617235200}}
+            );
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(response.statusCode == 400);
+            }
+        }
+
+        WHEN("A standing query is read in milliseconds") {
+            REQUIRE_CALL(*fixture.mockProcessor, readStandingQuery("today"))
+                .TIMES(1)
+                .RETURN(std::optional<PathAggregate>(PathAggregate{30.0, 3}));
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/standing/today?resultUnit=milliseconds",
+                json::object()
+            );
+
+            THEN("The server returns the scaled mean") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE_THAT(response.body["mean"].get<double>(), Catch::Matchers::WithinRel(10000.0, 0.0001));
+            }
+        }
+
+        WHEN("An unknown standing query is read or removed") {
+            REQUIRE_CALL(*fixture.mockProcessor, readStandingQuery("missing"))
+                .TIMES(1)
+                .RETURN(std::optional<PathAggregate>());
+            REQUIRE_CALL(*fixture.mockProcessor, removeStandingQuery("missing"))
+                .TIMES(1)
+                .RETURN(false);
+
+            HttpResponse read = sendCurlRequest("GET", fixture.getBaseUrl() + "/standing/missing", json::object());
+            HttpResponse removed = sendCurlRequest("DELETE", fixture.getBaseUrl() + "/standing/missing", json::object());
+
+            THEN("The server returns a 404 Not Found status") {
+                REQUIRE(read.statusCode == 404);
+                REQUIRE(removed.statusCode == 404);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server answers several time windows in one request", "[http][windows][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8119);
+        fixture.startServer();
+
+        WHEN("A GET request asks for two windows") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateWindows("test_event", ANY(std::vector<TimeWindow>)))
+                .WITH(_2.size() == 2 && _2[0].start == 1617235200 && _2[0].end == 1617238799 &&
+                      _2[1].start == 1617238800 && _2[1].end == 1617242399)
+                .TIMES(1)
+                .RETURN(std::vector<PathAggregate>{PathAggregate{30.0, 3}, PathAggregate{}});
+
+            HttpResponse response = sendCurlRequest(
+                "GET",
+                fixture.getBaseUrl() + "/paths/test_event/windows",
+                json{{"resultUnit", "seconds"},
+                     {"windows", json::array({
+                         {{"startTimestamp", 1617235200}, {"endTimestamp", 1617238799}},
+                         {{"startTimestamp", 1617238800}, {"endTimestamp", 1617242399}}})}}
+            );
+
+            THEN("The server returns the mean and count of each window in request order") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.body["windows"].size() == 2);
+                REQUIRE_THAT(response.body["windows"][0]["mean"].get<double>(), Catch::Matchers::WithinRel(10.0, 0.0001));
+                REQUIRE(response.body["windows"][0]["count"] == 3);
+                REQUIRE(response.body["windows"][1]["mean"] == 0.0);
+                REQUIRE(response.body["windows"][1]["count"] == 0);
+            }
+        }
+
+        WHEN("The windows are missing, empty or inverted") {
+            HttpResponse missing = sendCurlRequest(
+                "GET", fixture.getBaseUrl() + "/paths/test_event/windows", json{{"resultUnit", "seconds"}});
+            HttpResponse empty = sendCurlRequest(
+                "GET", fixture.getBaseUrl() + "/paths/test_event/windows",
+                json{{"resultUnit", "seconds"}, {"windows", json::array()}});
+            HttpResponse inverted = sendCurlRequest(
+                "GET", fixture.getBaseUrl() + "/paths/test_event/windows",
+                json{{"resultUnit", "seconds"},
+                     {"windows", json::array({{{"startTimestamp", 20}, {"endTimestamp", 10}}})}});
+
+            THEN("The server returns a 400 Bad Request status") {
+                REQUIRE(missing.statusCode == 400);
+                REQUIRE(empty.statusCode == 400);
+                REQUIRE(inverted.statusCode == 400);
+            }
+        }
+    }
+}
+
+SCENARIO("HTTP server validates query results with entity tags", "[http][etag][bdd]") {
+    GIVEN("A running HTTP server with mock processor") {
+        HttpServerTestFixture fixture(8120);
+        fixture.startServer();
+        const json query{{"resultUnit", "seconds"}, {"startTimestamp", 1617235200}};
+        const std::string url = fixture.getBaseUrl() + "/paths/test_event/meanLength";
+
+        WHEN("A result is fetched and then revalidated while the data stays unchanged") {
+            REQUIRE_CALL(*fixture.mockProcessor, eventsVersion(std::vector<std::string>{"test_event"}))
+                .TIMES(2)
+                .RETURN(std::optional<uint64_t>(7));
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", std::optional<uint64_t>(1617235200), std::optional<uint64_t>()))
+                .TIMES(1)
+                .RETURN(12.5);
+
+            HttpResponse first = sendCurlRequest("GET", url, query);
+            HttpResponse second = sendCurlRequest("GET", url, query, {"If-None-Match: " + first.headers["ETag"]});
+
+            THEN("The first response carries a tag and the second is 304 Not Modified without a query") {
+                REQUIRE(first.statusCode == 200);
+                REQUIRE_FALSE(first.headers["ETag"].empty());
+                REQUIRE(first.headers["Cache-Control"] == "private, no-cache");
+                REQUIRE(second.statusCode == 304);
+                REQUIRE(second.headers["ETag"] == first.headers["ETag"]);
+            }
+        }
+
+        WHEN("The data changes between the two requests") {
+            // The newest expectation is matched first
+            REQUIRE_CALL(*fixture.mockProcessor, eventsVersion(std::vector<std::string>{"test_event"}))
+                .TIMES(1)
+                .RETURN(std::optional<uint64_t>(8));
+            REQUIRE_CALL(*fixture.mockProcessor, eventsVersion(std::vector<std::string>{"test_event"}))
+                .TIMES(1)
+                .RETURN(std::optional<uint64_t>(7));
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(2)
+                .RETURN(12.5);
+
+            HttpResponse first = sendCurlRequest("GET", url, query);
+            HttpResponse second = sendCurlRequest("GET", url, query, {"If-None-Match: " + first.headers["ETag"]});
+
+            THEN("The result is sent again under a new tag") {
+                REQUIRE(second.statusCode == 200);
+                REQUIRE_THAT(second.body["mean"].get<double>(), Catch::Matchers::WithinRel(12.5, 0.0001));
+                REQUIRE_FALSE(second.headers["ETag"].empty());
+                REQUIRE(second.headers["ETag"] != first.headers["ETag"]);
+            }
+        }
+
+        WHEN("The same tag is sent with a different query") {
+            REQUIRE_CALL(*fixture.mockProcessor, eventsVersion(std::vector<std::string>{"test_event"}))
+                .TIMES(2)
+                .RETURN(std::optional<uint64_t>(7));
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(2)
+                .RETURN(12.5);
+
+            HttpResponse first = sendCurlRequest("GET", url, query);
+            HttpResponse second = sendCurlRequest("GET", url, json{{"resultUnit", "milliseconds"}},
+                                                  {"If-None-Match: " + first.headers["ETag"]});
+
+            THEN("The tag does not match and the other result is sent") {
+                REQUIRE(second.statusCode == 200);
+                REQUIRE_THAT(second.body["mean"].get<double>(), Catch::Matchers::WithinRel(12500.0, 0.0001));
+            }
+        }
+
+        WHEN("The processor does not version its data") {
+            REQUIRE_CALL(*fixture.mockProcessor, calculateMeanLength("test_event", ANY(std::optional<uint64_t>), ANY(std::optional<uint64_t>)))
+                .TIMES(1)
+                .RETURN(12.5);
+
+            HttpResponse response = sendCurlRequest("GET", url, query, {"If-None-Match: *"});
+
+            THEN("The result is sent without a tag") {
+                REQUIRE(response.statusCode == 200);
+                REQUIRE(response.headers.count("ETag") == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/instrumented_mutex.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+
+using namespace lockstats;
+
+namespace {
+
+// Statistics of the registered site with the given name
+SiteStats statsOf(const std::string& siteName) {
+    auto sites = snapshot();
+    auto it = std::find_if(sites.begin(), sites.end(),
+                           [&](const SiteStats& site) { return site.siteName == siteName; });
+    REQUIRE(it != sites.end());
+    return *it;
+}
+
+} // namespace
+
+// A disabled build must not pay for the instrumentation
+static_assert(std::is_empty_v<BasicLockSite<false>>);
+static_assert(sizeof(BasicLockGuard<false, LockMode::Shared>) == sizeof(std::shared_mutex*));
+static_assert(sizeof(BasicInstrumentedSharedMutex<false>) == sizeof(std::shared_mutex));
+
+SCENARIO("Instrumented mutex records contention per call site and lock mode", "[lockstats]") {
+    GIVEN("A profiled mutex with a reader site and a writer site") {
+        BasicInstrumentedSharedMutex<true> mutex;
+        BasicLockSite<true> readSite("TestLock", "test.read");
+        BasicLockSite<true> writeSite("TestLock", "test.write");
+
+        WHEN("Readers and writers take the lock without contention") {
+            for (int i = 0; i < 5; ++i) {
+                auto lock = mutex.lockShared(readSite);
+            }
+            for (int i = 0; i < 3; ++i) {
+                auto lock = mutex.lock(writeSite);
+            }
+
+            THEN("Acquisitions are counted by site and mode with no waits") {
+                auto reads = statsOf("test.read");
+                auto writes = statsOf("test.write");
+                REQUIRE(reads.lockName == "TestLock");
+                REQUIRE(reads.shared.acquisitions == 5);
+                REQUIRE(reads.exclusive.acquisitions == 0);
+                REQUIRE(reads.shared.contended == 0);
+                REQUIRE(reads.shared.waitHistogram[0] == 5);
+                REQUIRE(writes.exclusive.acquisitions == 3);
+                REQUIRE(writes.shared.acquisitions == 0);
+                REQUIRE(std::accumulate(writes.exclusive.holdHistogram.begin(),
+                                        writes.exclusive.holdHistogram.end(), uint64_t{0}) == 3);
+            }
+        }
+
+        WHEN("A reader has to wait for a writer holding the lock") {
+            std::thread writer;
+            {
+                std::atomic<bool> locked{false};
+                writer = std::thread([&] {
+                    auto lock = mutex.lock(writeSite);
+                    locked = true;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                });
+                while (!locked) {
+                    std::this_thread::yield();
+                }
+                auto lock = mutex.lockShared(readSite);
+            }
+            writer.join();
+
+            THEN("The wait and the writer's hold time are recorded") {
+                auto reads = statsOf("test.read");
+                auto writes = statsOf("test.write");
+                REQUIRE(reads.shared.contended == 1);
+                REQUIRE(reads.shared.maxWaitNs >= 10'000'000);
+                REQUIRE(reads.shared.totalWaitNs == reads.shared.maxWaitNs);
+                REQUIRE(writes.exclusive.maxHoldNs >= 50'000'000);
+
+                // 10 ms and more land in the buckets from 2^13 us upwards
+                auto slowWaits = std::accumulate(reads.shared.waitHistogram.begin() + 14,
+                                                 reads.shared.waitHistogram.end(), uint64_t{0});
+                REQUIRE(slowWaits == 1);
+            }
+        }
+
+        WHEN("The statistics are reset") {
+            {
+                auto lock = mutex.lock(writeSite);
+            }
+            reset();
+
+            THEN("Every counter starts from zero") {
+                auto writes = statsOf("test.write");
+                REQUIRE(writes.exclusive.acquisitions == 0);
+                REQUIRE(writes.exclusive.maxHoldNs == 0);
+                REQUIRE(writes.exclusive.waitHistogram[0] == 0);
+            }
+        }
+    }
+
+    GIVEN("A site that has gone out of scope") {
+        {
+            BasicLockSite<true> site("TestLock", "test.expired");
+        }
+
+        THEN("It is no longer reported") {
+            auto sites = snapshot();
+            REQUIRE(std::none_of(sites.begin(), sites.end(),
+                                 [](const SiteStats& site) { return site.siteName == "test.expired"; }));
+        }
+    }
+}
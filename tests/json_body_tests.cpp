@@ -0,0 +1,70 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/json_body.h"
+#include <nlohmann/json.hpp>
+#include <limits>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+SCENARIO("Flat JSON bodies are formatted like nlohmann::json", "[http][json]") {
+    GIVEN("Numbers of every shape") {
+        std::vector<double> numbers{0.0, 2.0, -3.0, 0.1, 1.0 / 3.0, 1234.5678, 1e-7, 1e16, 1e300, 5e-324, -0.0};
+
+        WHEN("Each one is formatted") {
+            THEN("The text matches nlohmann's dump") {
+                for (double number : numbers) {
+                    std::string text;
+                    JsonBody::appendNumber(text, number);
+                    REQUIRE(text == json(number).dump());
+                }
+            }
+        }
+
+        WHEN("A number is not finite") {
+            std::string text;
+            JsonBody::appendNumber(text, std::numeric_limits<double>::infinity());
+
+            THEN("It is written as null") {
+                REQUIRE(text == "null");
+            }
+        }
+    }
+
+    GIVEN("An object with fields of every type") {
+        auto body = std::string(JsonBody()
+                                    .add("mean", 15.5)
+                                    .add("count", uint64_t{42})
+                                    .add("approximate", false)
+                                    .add("unit", "seconds")
+                                    .finish());
+
+        THEN("It parses to the same object") {
+            REQUIRE(json::parse(body) == json{{"mean", 15.5}, {"count", 42}, {"approximate", false}, {"unit", "seconds"}});
+            REQUIRE(body == R"({"mean":15.5,"count":42,"approximate":false,"unit":"seconds"})");
+        }
+    }
+
+    GIVEN("An error message with characters that need escaping") {
+        std::string message = "Invalid JSON: \"quote\" \\ tab\t newline\n bell\x07";
+        auto body = std::string(JsonBody::error(message));
+
+        THEN("The message round-trips") {
+            REQUIRE(json::parse(body)["error"] == message);
+        }
+    }
+
+    GIVEN("A thread that has built one body") {
+        JsonBody::error("warm-up message that is longer than the bodies that follow");
+
+        WHEN("More bodies are built") {
+            auto first = JsonBody().add("mean", 1.0).finish();
+            auto second = JsonBody().add("mean", 2.0).finish();
+
+            THEN("They reuse the same buffer") {
+                REQUIRE(first.data() == second.data());
+                REQUIRE(second == R"({"mean":2.0})");
+            }
+        }
+    }
+}
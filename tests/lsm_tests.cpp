@@ -0,0 +1,188 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/telemetry_storage.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kBase = 1617235200;
+
+// Timestamps 0..count-1 from kBase in a scrambled but deterministic order
+std::vector<uint64_t> scrambledTimestamps(uint64_t count) {
+    std::vector<uint64_t> timestamps;
+    for (uint64_t i = 0; i < count; ++i) {
+        timestamps.push_back(kBase + (i * 7919) % count); // 7919 is prime, so this is a permutation
+    }
+    return timestamps;
+}
+
+// Each event carries its own timestamp offset, so that events can be told apart
+std::vector<double> valuesFor(uint64_t timestamp) {
+    return {static_cast<double>(timestamp - kBase)};
+}
+
+bool timeOrdered(const std::vector<EventData>& events) {
+    return std::is_sorted(events.begin(), events.end(),
+        [](const EventData& a, const EventData& b) { return a.timestamp < b.timestamp; });
+}
+
+std::vector<EventData> readAll(TelemetryStorage& storage, const std::string& eventName, std::size_t chunk) {
+    std::vector<EventData> events;
+    EventCursor cursor;
+    while (!cursor.done) {
+        storage.readEvents(eventName, std::nullopt, std::nullopt, cursor, chunk, events);
+    }
+    return events;
+}
+
+} // namespace
+
+SCENARIO("Events saved in any order are read back in timestamp order", "[lsm][storage]") {
+    GIVEN("A storage receiving events with scrambled timestamps") {
+        TelemetryStorage storage;
+        const uint64_t count = TelemetryStorage::kBlockSize * 5 + 100;
+        for (auto timestamp : scrambledTimestamps(count)) {
+            REQUIRE(storage.saveEvent("late", valuesFor(timestamp), timestamp));
+        }
+
+        WHEN("All events are queried") {
+            auto events = storage.getFilteredEvents("late");
+
+            THEN("Every event comes back once, oldest first") {
+                REQUIRE(events.size() == count);
+                for (uint64_t i = 0; i < count; ++i) {
+                    REQUIRE(events[i].timestamp == kBase + i);
+                    REQUIRE(events[i].values == valuesFor(kBase + i));
+                }
+            }
+        }
+
+        WHEN("A time range is queried") {
+            auto events = storage.getFilteredEvents("late", kBase + 1000, kBase + 1999);
+
+            THEN("Exactly the events of the range come back in order") {
+                REQUIRE(events.size() == 1000);
+                REQUIRE(events.front().timestamp == kBase + 1000);
+                REQUIRE(events.back().timestamp == kBase + 1999);
+                REQUIRE(timeOrdered(events));
+            }
+
+            THEN("Aggregates agree with the events") {
+                auto aggregate = storage.aggregateEvents("late", kBase + 1000, kBase + 1999);
+                REQUIRE(aggregate.count == 1000);
+                REQUIRE_THAT(aggregate.sum, Catch::Matchers::WithinRel(1499500.0, 1e-9));
+            }
+        }
+
+        WHEN("Pending compactions have finished") {
+            storage.waitForCompactions();
+
+            THEN("The overlapping runs were merged and reads are unchanged") {
+                REQUIRE(storage.compactions() > 0);
+                auto events = storage.getFilteredEvents("late");
+                REQUIRE(events.size() == count);
+                for (uint64_t i = 0; i < count; ++i) {
+                    REQUIRE(events[i].timestamp == kBase + i);
+                    REQUIRE(events[i].values == valuesFor(kBase + i));
+                }
+            }
+        }
+    }
+
+    GIVEN("A storage receiving events in timestamp order") {
+        TelemetryStorage storage;
+        for (uint64_t i = 0; i < TelemetryStorage::kBlockSize * 4; ++i) {
+            REQUIRE(storage.saveEvent("ordered", valuesFor(kBase + i), kBase + i));
+        }
+
+        WHEN("The storage settles") {
+            storage.waitForCompactions();
+
+            THEN("No compaction was needed") {
+                REQUIRE(storage.compactions() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Events with equal timestamps keep their arrival order", "[lsm][storage]") {
+    GIVEN("Several events per timestamp arriving out of timestamp order") {
+        TelemetryStorage storage;
+        const uint64_t timestamps = 400;
+        std::vector<uint64_t> sequence(timestamps, 0);
+        for (int round = 0; round < 3; ++round) {
+            for (auto timestamp : scrambledTimestamps(timestamps)) {
+                // The value records how many events of this timestamp arrived before
+                auto& arrived = sequence[timestamp - kBase];
+                REQUIRE(storage.saveEvent("ties", {static_cast<double>(arrived++)}, timestamp));
+            }
+        }
+        storage.waitForCompactions();
+
+        WHEN("The events are read back") {
+            auto events = storage.getFilteredEvents("ties");
+
+            THEN("Events of one timestamp come in the order they were saved") {
+                REQUIRE(events.size() == timestamps * 3);
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(events[i].timestamp == kBase + i / 3);
+                    REQUIRE(events[i].values[0] == static_cast<double>(i % 3));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Export cursors survive compaction", "[lsm][export]") {
+    GIVEN("A storage with out-of-order events and an export in progress") {
+        TelemetryStorage storage;
+        const uint64_t count = TelemetryStorage::kBlockSize * 3;
+        for (auto timestamp : scrambledTimestamps(count)) {
+            REQUIRE(storage.saveEvent("export", valuesFor(timestamp), timestamp));
+        }
+        storage.waitForCompactions();
+
+        std::vector<EventData> exported;
+        EventCursor cursor;
+        storage.readEvents("export", std::nullopt, std::nullopt, cursor, 700, exported);
+        REQUIRE_FALSE(cursor.done);
+
+        WHEN("Late events are saved and compacted before the export resumes") {
+            // Late events both before and after the cursor, twice the block size to force a seal
+            for (uint64_t i = 0; i < TelemetryStorage::kBlockSize * 2; ++i) {
+                const uint64_t timestamp = kBase + (i * 3) % (count + 200);
+                REQUIRE(storage.saveEvent("export", {-1.0}, timestamp));
+            }
+            storage.waitForCompactions();
+            while (!cursor.done) {
+                storage.readEvents("export", std::nullopt, std::nullopt, cursor, 300, exported);
+            }
+
+            THEN("Every original event is exported exactly once, in timestamp order") {
+                REQUIRE(timeOrdered(exported));
+                std::vector<uint64_t> originals;
+                for (const auto& event : exported) {
+                    if (event.values[0] >= 0.0) {
+                        originals.push_back(event.timestamp);
+                    }
+                }
+                REQUIRE(originals.size() == count);
+                for (uint64_t i = 0; i < count; ++i) {
+                    REQUIRE(originals[i] == kBase + i);
+                }
+            }
+        }
+
+        WHEN("The export runs in chunks that split timestamps") {
+            auto events = readAll(storage, "export", 1);
+
+            THEN("It matches a single query") {
+                REQUIRE(events.size() == count);
+                REQUIRE(timeOrdered(events));
+            }
+        }
+    }
+}
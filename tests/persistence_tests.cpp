@@ -0,0 +1,166 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/persistence.h"
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/telemetry_processor.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fresh log file path that is removed again at the end of the test
+class TemporaryLog {
+public:
+    explicit TemporaryLog(const std::string& name)
+        : path_((std::filesystem::temp_directory_path() / ("telemetry-" + name + ".wal")).string()) {
+        std::filesystem::remove(path_);
+    }
+    ~TemporaryLog() { std::filesystem::remove(path_); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Log whose disk has failed: no append becomes durable
+class FailedAppender : public IDurableAppender {
+public:
+    void append(std::string, Completion done) override { done(false); }
+    void flush() override {}
+    std::map<std::string, double> statusFields() const override { return {}; }
+};
+
+SCENARIO("Durable appenders acknowledge appends in order once on disk", "[persistence]") {
+    for (auto backend : {PersistenceBackend::Auto, PersistenceBackend::Threads}) {
+        GIVEN("An appender using backend " + std::to_string(static_cast<int>(backend))) {
+            TemporaryLog log("appender");
+            auto appender = openDurableAppender(log.path(), backend);
+
+            WHEN("Several threads append concurrently") {
+                std::mutex mutex;
+                std::vector<int> acknowledged;
+                std::atomic<int> failures{0};
+                std::vector<std::thread> writers;
+                for (int t = 0; t < 4; ++t) {
+                    writers.emplace_back([&, t] {
+                        for (int i = 0; i < 250; ++i) {
+                            appender->append(std::string(16, static_cast<char>('a' + t)), [&, t](bool durable) {
+                                failures += durable ? 0 : 1;
+                                std::lock_guard<std::mutex> lock(mutex);
+                                acknowledged.push_back(t);
+                            });
+                        }
+                    });
+                }
+                for (auto& writer : writers) {
+                    writer.join();
+                }
+                appender->flush();
+
+                THEN("Every append is acknowledged as durable and written") {
+                    REQUIRE(failures == 0);
+                    REQUIRE(acknowledged.size() == 1000);
+                    REQUIRE(std::filesystem::file_size(log.path()) == 1000 * 16);
+                    REQUIRE(appender->statusFields()["bytesWritten"] == 1000.0 * 16);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Durable storage survives a restart", "[persistence]") {
+    GIVEN("A processor writing through a durable log") {
+        TemporaryLog log("storage");
+        {
+            TelemetryStorage storage;
+            auto appender = openDurableAppender(log.path());
+            DurableStorage durable(storage, *appender);
+            TelemetryProcessor processor(durable);
+
+            std::atomic<int> saved{0};
+            for (int i = 0; i < 100; ++i) {
+                processor.saveEventAsync("checkout", std::vector<double>(10, 1.0 + i % 2), 1617235200 + i,
+                    [&](SaveStatus status) { saved += status == SaveStatus::Saved ? 1 : 0; });
+            }
+            REQUIRE(durable.saveEvent("signup", std::vector<double>(10, 4.0), 1617235300));
+            appender->flush();
+            REQUIRE(saved == 100);
+        }
+
+        WHEN("A new storage is recovered from the log") {
+            TelemetryStorage storage;
+            auto recovered = DurableStorage::recover(log.path(), storage);
+
+            THEN("All acknowledged events are back") {
+                REQUIRE(recovered == 101);
+                REQUIRE(storage.getFilteredEvents("checkout").size() == 100);
+                TelemetryProcessor processor(storage);
+                REQUIRE_THAT(processor.calculateMeanLength("checkout"), Catch::Matchers::WithinRel(15.0, 0.0001));
+            }
+        }
+
+        WHEN("The log ends in a torn record") {
+            auto intact = std::filesystem::file_size(log.path());
+            {
+                std::ofstream file(log.path(), std::ios::binary | std::ios::app);
+                file.write("\x40\x00\x00\x00garbage", 11);
+            }
+
+            TelemetryStorage storage;
+            auto recovered = DurableStorage::recover(log.path(), storage);
+
+            THEN("The valid prefix is recovered and the tail is cut off") {
+                REQUIRE(recovered == 101);
+                REQUIRE(std::filesystem::file_size(log.path()) == intact);
+            }
+        }
+    }
+
+    GIVEN("A log with an event the recovering storage cannot represent") {
+        TemporaryLog log("rejected");
+        {
+            TelemetryStorage storage;
+            auto appender = openDurableAppender(log.path());
+            DurableStorage durable(storage, *appender);
+            REQUIRE(durable.saveEvent("checkout", std::vector<double>(10, -1.0), 1617235200));
+            REQUIRE(durable.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235201));
+        }
+
+        WHEN("It is recovered into a storage of whole milliseconds") {
+            TelemetryStorage storage(PrecisionPolicy{ValuePrecision::Milliseconds, {}});
+            auto recovered = DurableStorage::recover(log.path(), storage);
+
+            THEN("Only the accepted event is counted") {
+                REQUIRE(recovered == 1);
+                REQUIRE(storage.getFilteredEvents("checkout").size() == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Durable storage stops accepting events once its log has failed", "[persistence]") {
+    GIVEN("A durable storage over a log whose writes fail") {
+        TelemetryStorage storage;
+        FailedAppender appender;
+        DurableStorage durable(storage, appender);
+        TelemetryProcessor processor(durable);
+
+        WHEN("Events are saved after the first failure") {
+            REQUIRE_FALSE(durable.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235200));
+
+            THEN("They are refused before they reach memory") {
+                REQUIRE_THROWS_AS(durable.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235201),
+                                  BackendUnavailableError);
+                REQUIRE_THROWS_AS(processor.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235202),
+                                  BackendUnavailableError);
+                REQUIRE(storage.getFilteredEvents("checkout").size() == 1);
+                REQUIRE(processor.calculateMeanLength("checkout") == 10.0);
+            }
+        }
+    }
+}
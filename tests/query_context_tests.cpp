@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/query_context.h"
+#include "telemetry/telemetry_storage.h"
+#include <chrono>
+#include <vector>
+
+SCENARIO("Storage scans honour the deadline of the running query", "[deadline][storage]") {
+    GIVEN("A storage holding several sealed blocks and a partial head") {
+        TelemetryStorage storage;
+        const uint64_t base = 1617235200;
+        const uint64_t count = 3000;
+        for (uint64_t i = 0; i < count; ++i) {
+            storage.saveEvent("trip", std::vector<double>(10, 1.0), base + i);
+        }
+        const auto expired = QueryContext::Clock::now() - std::chrono::milliseconds(1);
+
+        WHEN("A query runs without a deadline or well within it") {
+            auto unbounded = storage.aggregateEvents("trip");
+            QueryContext context(QueryContext::Clock::now() + std::chrono::minutes(1), true);
+            auto bounded = storage.aggregateEvents("trip");
+
+            THEN("Every event is covered") {
+                REQUIRE(unbounded.count == count);
+                REQUIRE(bounded.count == count);
+                REQUIRE_FALSE(context.partial());
+            }
+        }
+
+        WHEN("The deadline has passed and partial results are allowed") {
+            QueryContext context(expired, true);
+            auto aggregate = storage.aggregateEvents("trip");
+            auto series = storage.aggregateSeries("trip", 3600, base);
+            auto events = storage.getFilteredEvents("trip");
+
+            THEN("The scans stop at the first chunk boundary and flag the result") {
+                REQUIRE(context.partial());
+                REQUIRE(aggregate.count > 0);
+                REQUIRE(aggregate.count < count);
+                REQUIRE(series.size() == 1);
+                REQUIRE(series[0].aggregate.count == aggregate.count);
+                REQUIRE(events.size() < count);
+            }
+
+            THEN("The most recent events are the ones covered") {
+                auto recent = storage.aggregateEvents("trip", base + count - 10);
+                REQUIRE(recent.count == 10);
+            }
+        }
+
+        WHEN("The deadline has passed and partial results are not allowed") {
+            QueryContext context(expired, false);
+
+            THEN("The scan is aborted with a timeout error") {
+                REQUIRE_THROWS_AS(storage.aggregateEvents("trip"), QueryTimeoutError);
+                REQUIRE_THROWS_AS(storage.getFilteredEvents("trip"), QueryTimeoutError);
+            }
+        }
+
+        WHEN("A context ends") {
+            {
+                QueryContext context(expired, false);
+                REQUIRE(QueryContext::current() == &context);
+            }
+
+            THEN("Later queries on the thread run without a deadline") {
+                REQUIRE(QueryContext::current() == nullptr);
+                REQUIRE(storage.aggregateEvents("trip").count == count);
+            }
+        }
+    }
+}
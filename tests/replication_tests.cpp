@@ -0,0 +1,214 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/replication.h"
+#include "telemetry/telemetry_processor.h"
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Polls until the condition holds or a few seconds have passed
+bool eventually(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return condition();
+}
+
+SCENARIO("Replication log retains a bounded, gap-free tail", "[replication]") {
+    GIVEN("A log with room for three records") {
+        ReplicationLog log(3);
+        for (int i = 0; i < 5; ++i) {
+            log.append("path", std::vector<double>(10, i), 1617235200 + i);
+        }
+
+        THEN("Only the newest records are retained") {
+            REQUIRE(log.headSequence() == 5);
+            REQUIRE(log.firstSequence() == 3);
+
+            std::vector<ReplicationRecord> records;
+            REQUIRE(log.read(3, 10, records));
+            REQUIRE(records.size() == 3);
+            REQUIRE(records.front().sequence == 3);
+            REQUIRE(records.back().event.timestamp == 1617235204);
+        }
+
+        THEN("Reading trimmed records fails while reading past the head yields nothing") {
+            std::vector<ReplicationRecord> records;
+            REQUIRE_FALSE(log.read(2, 10, records));
+            REQUIRE(log.read(6, 10, records));
+            REQUIRE(records.empty());
+            REQUIRE_FALSE(log.read(7, 10, records));
+        }
+    }
+}
+
+SCENARIO("Leader snapshots are frozen copies decoded after the lock is released", "[replication]") {
+    GIVEN("A storage with sealed blocks, late events and a partial head") {
+        TelemetryStorage storage;
+        for (uint64_t i = 0; i < 3 * TelemetryStorage::kBlockSize + 10; ++i) {
+            storage.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235200 + (i * 7919) % 4000);
+        }
+        storage.saveEvent("search", std::vector<double>(10, 2.0), 1617235200);
+
+        WHEN("It is frozen and then changed") {
+            auto frozen = storage.freeze();
+            storage.saveEvent("checkout", std::vector<double>(10, 5.0), 1617235100);
+            storage.clear();
+
+            THEN("The frozen copy holds exactly the earlier events, in timestamp order per name") {
+                std::map<std::string, std::vector<uint64_t>> timestamps;
+                REQUIRE(frozen.forEachEvent([&](const std::string& eventName, const EventData& event) {
+                    timestamps[eventName].push_back(event.timestamp);
+                    return true;
+                }));
+                REQUIRE(timestamps["checkout"].size() == 3 * TelemetryStorage::kBlockSize + 10);
+                REQUIRE(std::is_sorted(timestamps["checkout"].begin(), timestamps["checkout"].end()));
+                REQUIRE(timestamps["search"].size() == 1);
+            }
+
+            THEN("A visitor can stop the visit") {
+                std::size_t visited = 0;
+                REQUIRE_FALSE(frozen.forEachEvent([&](const std::string&, const EventData&) {
+                    return ++visited < 10;
+                }));
+                REQUIRE(visited == 10);
+            }
+        }
+    }
+}
+
+SCENARIO("Follower replicates the leader through snapshot and log tail", "[replication]") {
+    GIVEN("A leader that already holds data") {
+        TelemetryStorage leaderStorage;
+        ReplicationLog log;
+        ReplicatedStorage replicated(leaderStorage, log);
+        TelemetryProcessor leaderProcessor(replicated);
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(leaderProcessor.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235200 + i));
+        }
+
+        ReplicationLeader leader(replicated, log, "127.0.0.1", 8106);
+        leader.start();
+
+        TelemetryStorage replicaStorage;
+        TelemetryProcessor applier(replicaStorage);
+        ReplicationFollower follower("127.0.0.1", 8106, replicaStorage, applier);
+        ReadOnlyProcessor replica(applier, follower);
+
+        WHEN("The follower has not loaded a snapshot yet") {
+            THEN("The replica refuses queries instead of answering from an empty store") {
+                REQUIRE_THROWS_AS(replica.calculateMeanLength("checkout"), BackendUnavailableError);
+                REQUIRE_THROWS_AS(replica.calculateAggregates({"checkout"}), BackendUnavailableError);
+                REQUIRE_FALSE(replica.eventsVersion({"checkout"}));
+                REQUIRE(follower.statusFields()["synchronized"] == 0.0);
+            }
+        }
+
+        WHEN("A standing query is defined before the follower loads its snapshot") {
+            applier.registerStandingQuery("all", "checkout", std::nullopt, std::nullopt);
+            follower.start();
+
+            THEN("It counts the snapshot's events and then the log tail") {
+                REQUIRE(eventually([&] { return follower.appliedSequence() == 4; }));
+                REQUIRE(replica.readStandingQuery("all")->count == 4);
+                REQUIRE(leaderProcessor.saveEvent("checkout", std::vector<double>(10, 3.0), 1617235300));
+                REQUIRE(eventually([&] { return follower.appliedSequence() == 5; }));
+                auto aggregate = replica.readStandingQuery("all");
+                REQUIRE(aggregate->count == 5);
+                REQUIRE_THAT(aggregate->sum, Catch::Matchers::WithinRel(replica.calculateAggregates({"checkout"}).front().sum, 1e-12));
+            }
+
+            follower.stop();
+        }
+
+        WHEN("A follower connects") {
+            follower.start();
+
+            THEN("It loads the existing data from a snapshot") {
+                REQUIRE(eventually([&] { return follower.appliedSequence() == 4; }));
+                REQUIRE(replicaStorage.getFilteredEvents("checkout").size() == 4);
+                REQUIRE(follower.synchronized());
+                REQUIRE(replica.calculateAggregates({"checkout"}).front().count == 4);
+            }
+
+            AND_WHEN("The leader keeps ingesting") {
+                REQUIRE(eventually([&] { return follower.appliedSequence() == 4; }));
+                for (int i = 0; i < 4; ++i) {
+                    REQUIRE(leaderProcessor.saveEvent("checkout", std::vector<double>(10, 3.0), 1617235300 + i));
+                }
+
+                THEN("The replica answers queries like the leader once caught up") {
+                    REQUIRE(eventually([&] { return follower.appliedSequence() == 8; }));
+                    REQUIRE_THAT(replica.calculateMeanLength("checkout"),
+                                 Catch::Matchers::WithinRel(leaderProcessor.calculateMeanLength("checkout"), 0.0001));
+
+                    auto status = follower.statusFields();
+                    REQUIRE(status["connected"] == 1.0);
+                    REQUIRE(status["lagRecords"] == 0.0);
+                    REQUIRE(status["lagMs"] == 0.0);
+                }
+            }
+
+            THEN("The replica rejects writes") {
+                REQUIRE_THROWS_AS(replica.saveEvent("checkout", std::vector<double>(10, 1.0), 1617235200),
+                                  UnsupportedOperationError);
+            }
+
+            follower.stop();
+        }
+
+        leader.stop();
+    }
+}
+
+SCENARIO("Follower reloads from a snapshot when the leader restarts", "[replication]") {
+    GIVEN("A follower caught up with a leader") {
+        TelemetryStorage replicaStorage;
+        TelemetryProcessor applier(replicaStorage);
+        ReplicationFollower follower("127.0.0.1", 8121, replicaStorage, applier);
+
+        auto leaderStorage = std::make_unique<TelemetryStorage>();
+        auto log = std::make_unique<ReplicationLog>();
+        auto replicated = std::make_unique<ReplicatedStorage>(*leaderStorage, *log);
+        auto leader = std::make_unique<ReplicationLeader>(*replicated, *log, "127.0.0.1", 8121);
+        for (int i = 0; i < 2; ++i) {
+            REQUIRE(replicated->saveEvent("checkout", std::vector<double>(10, 1.0), 1617235200 + i));
+        }
+        leader->start();
+        follower.start();
+        REQUIRE(eventually([&] { return follower.appliedSequence() == 2; }));
+
+        WHEN("The leader restarts with a new log whose sequences pass the follower's") {
+            leader.reset();
+            replicated.reset();
+            log = std::make_unique<ReplicationLog>();
+            leaderStorage = std::make_unique<TelemetryStorage>();
+            replicated = std::make_unique<ReplicatedStorage>(*leaderStorage, *log);
+            for (int i = 0; i < 5; ++i) {
+                REQUIRE(replicated->saveEvent("refund", std::vector<double>(10, 2.0), 1617235300 + i));
+            }
+            leader = std::make_unique<ReplicationLeader>(*replicated, *log, "127.0.0.1", 8121);
+            leader->start();
+
+            THEN("The follower drops its old state instead of resuming at record 3") {
+                REQUIRE(eventually([&] {
+                    return follower.synchronized() && replicaStorage.getFilteredEvents("refund").size() == 5;
+                }));
+                REQUIRE(replicaStorage.getFilteredEvents("checkout").empty());
+                REQUIRE(follower.appliedSequence() == 5);
+            }
+        }
+
+        follower.stop();
+        leader.reset();
+    }
+}
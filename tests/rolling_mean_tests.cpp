@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/rolling_mean.h"
+#include "telemetry/value_precision.h"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+
+SCENARIO("Rolling means are maintained over a sliding window", "[rolling]") {
+    GIVEN("A tracker driven by a controllable clock") {
+        uint64_t now = 1000;
+        RollingMeanTracker tracker([&now] { return now; });
+        auto noHistory = [](uint64_t) { return std::vector<EventData>(); };
+        auto save = [] { return true; };
+
+        WHEN("Two subscribers ask for the same event and window") {
+            auto first = tracker.subscribe("user_flow", 60, noHistory);
+            auto second = tracker.subscribe("user_flow", 60, noHistory);
+            auto other = tracker.subscribe("user_flow", 120, noHistory);
+
+            THEN("They share one window while other widths get their own") {
+                REQUIRE(first == second);
+                REQUIRE(first != other);
+            }
+        }
+
+        WHEN("Events are ingested into a live window") {
+            auto window = tracker.subscribe("user_flow", 60, noHistory);
+            tracker.ingest("user_flow", std::vector<double>(10, 1.0), 990, save);
+            tracker.ingest("user_flow", std::vector<double>(10, 3.0), 1000, save);
+            tracker.ingest("other_flow", std::vector<double>(10, 9.0), 1000, save);
+
+            THEN("The mean covers only events of that event name") {
+                auto snapshot = window->snapshot();
+                REQUIRE(snapshot.count == 2);
+                REQUIRE_THAT(snapshot.mean, Catch::Matchers::WithinRel(20.0, 0.0001));
+            }
+
+            AND_WHEN("The clock moves past the oldest event") {
+                now = 1055;
+
+                THEN("The expired event drops out of the mean") {
+                    auto snapshot = window->snapshot();
+                    REQUIRE(snapshot.count == 1);
+                    REQUIRE_THAT(snapshot.mean, Catch::Matchers::WithinRel(30.0, 0.0001));
+                }
+            }
+        }
+
+        WHEN("A window is created for an event with history") {
+            uint64_t seededFrom = 0;
+            auto window = tracker.subscribe("user_flow", 60, [&](uint64_t from) {
+                seededFrom = from;
+                return std::vector<EventData>{{std::vector<double>(10, 2.0), 970}};
+            });
+
+            THEN("It is seeded from the start of the window") {
+                REQUIRE(seededFrom == 940);
+                REQUIRE(window->snapshot().count == 1);
+            }
+        }
+
+        WHEN("A failed save is ingested") {
+            auto window = tracker.subscribe("user_flow", 60, noHistory);
+            bool saved = tracker.ingest("user_flow", std::vector<double>(10, 1.0), 1000,
+                                        [] { return false; });
+
+            THEN("The window is left untouched") {
+                REQUIRE_FALSE(saved);
+                REQUIRE(window->snapshot().count == 0);
+            }
+        }
+    }
+
+    GIVEN("A tracker that adds lengths as a float32 storage keeps them") {
+        uint64_t now = 1000;
+        RollingMeanTracker tracker([&now] { return now; }, [](const std::string&, const std::vector<double>& values) {
+            return storedLength(values, ValuePrecision::Float32);
+        });
+        auto window = tracker.subscribe("user_flow", 60, [](uint64_t) {
+            return std::vector<EventData>{{std::vector<double>(10, static_cast<float>(0.1)), 990}};
+        });
+
+        WHEN("The value the history was stored from is ingested") {
+            tracker.ingest("user_flow", std::vector<double>(10, 0.1), 1000, [] { return true; });
+
+            THEN("Seeded and ingested events have the same length") {
+                auto snapshot = window->snapshot();
+                REQUIRE(snapshot.count == 2);
+                REQUIRE(snapshot.mean == storedLength(std::vector<double>(10, 0.1), ValuePrecision::Float32));
+            }
+        }
+    }
+
+    GIVEN("A tracker seeding a new window from a slow scan") {
+        RollingMeanTracker tracker([] { return uint64_t{1000}; });
+        std::promise<void> seeding;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        std::shared_ptr<IRollingMean> window;
+        std::thread subscriber([&] {
+            window = tracker.subscribe("hot", 3600, [&](uint64_t) {
+                seeding.set_value();
+                released.wait();
+                return std::vector<EventData>{};
+            });
+        });
+        seeding.get_future().wait();
+
+        WHEN("Events of that and another name are saved during the scan") {
+            auto save = [] { return true; };
+            auto other = std::async(std::launch::async, [&] {
+                return tracker.ingest("cold", std::vector<double>(10, 1.0), 1000, save);
+            });
+            const bool otherFinished = other.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+            auto same = std::async(std::launch::async, [&] {
+                return tracker.ingest("hot", std::vector<double>(10, 1.0), 1000, save);
+            });
+            const bool sameWaited = same.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout;
+            release.set_value();
+            subscriber.join();
+
+            THEN("Only the seeded event waits, and its save is counted once") {
+                REQUIRE(otherFinished);
+                REQUIRE(other.get());
+                REQUIRE(sameWaited);
+                REQUIRE(same.get());
+                REQUIRE(window->snapshot().count == 1);
+            }
+        }
+    }
+}
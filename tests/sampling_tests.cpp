@@ -0,0 +1,143 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/telemetry_processor.h"
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Saves events every `spacing` seconds from base with path lengths drawn from a skewed distribution
+void ingest(ITelemetryStorage& storage, const std::string& eventName, uint64_t base, uint64_t events,
+            uint64_t spacing, unsigned seed) {
+    std::mt19937 random(seed);
+    std::exponential_distribution<double> segmentLength(0.5);
+    for (uint64_t i = 0; i < events; ++i) {
+        storage.saveEvent(eventName, std::vector<double>(10, segmentLength(random)), base + i * spacing);
+    }
+}
+
+} // namespace
+
+SCENARIO("Storage estimates aggregates from per-segment reservoir samples", "[sampling][storage]") {
+    const uint64_t base = 1617235200; // Aligned to a segment
+    const uint64_t segment = TelemetryStorage::kSampleSegmentSeconds;
+
+    GIVEN("A storage with two dense segments") {
+        TelemetryStorage storage;
+        ingest(storage, "trip", base, 7200, 1, 7);
+
+        WHEN("The range covers whole segments") {
+            auto whole = storage.sampleAggregate("trip");
+            auto first = storage.sampleAggregate("trip", base, base + segment - 1);
+
+            THEN("The estimate is the exact aggregate") {
+                auto exact = storage.aggregateEvents("trip");
+                REQUIRE(whole.count == 7200.0);
+                REQUIRE_THAT(whole.sum, Catch::Matchers::WithinRel(exact.sum, 1e-9));
+                REQUIRE(whole.sampleSize == 0);
+                REQUIRE(whole.marginOfError() == 0.0);
+                REQUIRE(first.count == 3600.0);
+                REQUIRE_THAT(first.sum, Catch::Matchers::WithinRel(storage.aggregateEvents("trip", base, base + segment - 1).sum, 1e-9));
+            }
+        }
+
+        WHEN("The range cuts through both segments") {
+            const uint64_t start = base + segment / 2;
+            const uint64_t end = base + segment + segment / 2 - 1;
+            auto estimate = storage.sampleAggregate("trip", start, end);
+            auto exact = storage.aggregateEvents("trip", start, end);
+
+            THEN("The mean is estimated from both reservoirs with a confidence interval") {
+                REQUIRE(estimate.sampleSize == 2 * TelemetryStorage::kReservoirSize);
+                REQUIRE(estimate.marginOfError() > 0.0);
+                REQUIRE_THAT(estimate.count, Catch::Matchers::WithinRel(static_cast<double>(exact.count), 0.3));
+                const double exactMean = exact.sum / exact.count;
+                REQUIRE(std::abs(estimate.mean() - exactMean) < 3.0 * estimate.marginOfError());
+            }
+        }
+    }
+
+    GIVEN("Many independent storages queried over a range that cuts their segments") {
+        const int trials = 100;
+        int covered = 0;
+        for (int trial = 0; trial < trials; ++trial) {
+            TelemetryStorage storage;
+            ingest(storage, "trip", base, 2 * segment / 4, 4, 1000 + trial);
+            const uint64_t start = base + segment / 3;
+            const uint64_t end = base + segment + segment / 3;
+
+            auto estimate = storage.sampleAggregate("trip", start, end);
+            auto exact = storage.aggregateEvents("trip", start, end);
+            const double exactMean = exact.sum / exact.count;
+            if (std::abs(estimate.mean() - exactMean) <= estimate.marginOfError()) {
+                ++covered;
+            }
+        }
+
+        THEN("The 95% confidence interval covers the exact mean about as often as it should") {
+            REQUIRE(covered >= 85);
+        }
+    }
+
+    GIVEN("A segment with fewer events than the reservoir holds") {
+        TelemetryStorage storage;
+        ingest(storage, "sparse", base, 40, 60, 3);
+
+        WHEN("A range cuts through it") {
+            auto estimate = storage.sampleAggregate("sparse", base + 600, base + 1800);
+            auto exact = storage.aggregateEvents("sparse", base + 600, base + 1800);
+
+            THEN("The reservoir holds every event and the answer is exact") {
+                REQUIRE(estimate.count == static_cast<double>(exact.count));
+                REQUIRE_THAT(estimate.sum, Catch::Matchers::WithinRel(exact.sum, 1e-9));
+                REQUIRE(estimate.sampleSize == 0);
+                REQUIRE(estimate.marginOfError() == 0.0);
+            }
+        }
+    }
+
+    GIVEN("A sharded storage written by two threads") {
+        ShardedStorage storage(2, false);
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < 2; ++t) {
+            threads.emplace_back([&, t] { ingest(storage, "trip", base + t, 3600, 2, t); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        WHEN("Both shards are sampled") {
+            auto estimate = storage.sampleAggregate("trip", base + segment / 2, base + segment + segment / 2);
+
+            THEN("Their estimates and sample sizes are merged") {
+                REQUIRE(estimate.sampleSize == 4 * TelemetryStorage::kReservoirSize);
+                auto exact = storage.aggregateEvents("trip", base + segment / 2, base + segment + segment / 2);
+                REQUIRE(std::abs(estimate.mean() - exact.sum / exact.count) < 3.0 * estimate.marginOfError());
+            }
+        }
+    }
+}
+
+SCENARIO("Processor answers sampled aggregates per event", "[sampling][processor]") {
+    GIVEN("A processor over storage holding two events") {
+        TelemetryStorage storage;
+        TelemetryProcessor processor(storage);
+        processor.saveEvent("walk", std::vector<double>(10, 1.0), 1617235200);
+        processor.saveEvent("ride", std::vector<double>(10, 3.0), 1617235200);
+
+        WHEN("Sampled aggregates are requested") {
+            auto estimates = processor.calculateSampledAggregates({"ride", "walk", "missing"});
+
+            THEN("They come back in request order") {
+                REQUIRE(estimates.size() == 3);
+                REQUIRE(estimates[0].mean() == 30.0);
+                REQUIRE(estimates[1].mean() == 10.0);
+                REQUIRE(estimates[2].count == 0.0);
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/forwarding_storage.h"
+#include <map>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Expected buckets computed the slow way, one filtered scan per bucket
+std::map<uint64_t, PathAggregate> bucketsByScan(ITelemetryStorage& storage, const std::string& eventName,
+                                                uint64_t width, uint64_t start, uint64_t end) {
+    std::map<uint64_t, PathAggregate> buckets;
+    for (uint64_t bucketStart = start; bucketStart <= end; bucketStart += width) {
+        auto aggregate = storage.aggregateEvents(eventName, bucketStart, std::min(bucketStart + width - 1, end));
+        if (aggregate.count > 0) {
+            buckets[bucketStart] = aggregate;
+        }
+    }
+    return buckets;
+}
+
+void requireSameBuckets(const std::vector<SeriesBucket>& actual, const std::map<uint64_t, PathAggregate>& expected) {
+    REQUIRE(actual.size() == expected.size());
+    auto it = expected.begin();
+    for (const auto& bucket : actual) {
+        REQUIRE(bucket.bucketStart == it->first);
+        REQUIRE(bucket.aggregate.count == it->second.count);
+        REQUIRE_THAT(bucket.aggregate.sum, Catch::Matchers::WithinRel(it->second.sum, 1e-9));
+        ++it;
+    }
+}
+
+} // namespace
+
+SCENARIO("Storage computes a time-bucketed series in one sweep", "[series][storage]") {
+    GIVEN("A storage with sealed blocks, a partial head and some late events") {
+        TelemetryStorage storage;
+        const uint64_t base = 1617235200;
+        for (uint64_t i = 0; i < 1500; ++i) {
+            REQUIRE(storage.saveEvent("trip", std::vector<double>(10, 0.5 + static_cast<double>(i % 7)), base + i * 10));
+        }
+        // Late arrivals land in the head, out of time order
+        REQUIRE(storage.saveEvent("trip", std::vector<double>(10, 9.0), base + 35));
+        REQUIRE(storage.saveEvent("trip", std::vector<double>(10, 9.0), base + 12000));
+
+        WHEN("The series is requested for a range that cuts through blocks") {
+            auto buckets = storage.aggregateSeries("trip", 300, base + 1000, base + 14999);
+
+            THEN("Every bucket matches a separate range query") {
+                requireSameBuckets(buckets, bucketsByScan(storage, "trip", 300, base + 1000, base + 14999));
+            }
+        }
+
+        WHEN("Buckets are wider than a sealed block") {
+            auto buckets = storage.aggregateSeries("trip", 86400, base - base % 86400);
+
+            THEN("Whole blocks are summed into their bucket") {
+                REQUIRE(buckets.size() == 1);
+                REQUIRE(buckets[0].aggregate.count == 1502);
+                requireSameBuckets(buckets, bucketsByScan(storage, "trip", 86400, base - base % 86400, base + 15000));
+            }
+        }
+
+        WHEN("No start is given") {
+            auto buckets = storage.aggregateSeries("trip", 3600);
+
+            THEN("Buckets are aligned to multiples of the width") {
+                REQUIRE_FALSE(buckets.empty());
+                for (const auto& bucket : buckets) {
+                    REQUIRE(bucket.bucketStart % 3600 == 0);
+                }
+            }
+        }
+
+        WHEN("An unknown event is requested") {
+            THEN("The series is empty") {
+                REQUIRE(storage.aggregateSeries("unknown", 60).empty());
+            }
+        }
+    }
+
+    GIVEN("A sharded storage and a storage that only implements the default") {
+        ShardedStorage sharded(3, false);
+        const uint64_t base = 1617235200;
+        for (int t = 0; t < 3; ++t) {
+            std::thread([&, t] {
+                for (uint64_t i = 0; i < 200; ++i) {
+                    sharded.saveEvent("trip", std::vector<double>(10, 1.0 + t), base + i * 7);
+                }
+            }).join();
+        }
+
+        TelemetryStorage plain;
+        for (uint64_t i = 0; i < 200; ++i) {
+            plain.saveEvent("trip", std::vector<double>(10, 1.0), base + i * 7);
+        }
+        // Decorator that hides the storage's own override
+        struct DefaultSeries : ForwardingStorage {
+            using ForwardingStorage::ForwardingStorage;
+            std::vector<SeriesBucket> aggregateSeries(const std::string& eventName, uint64_t bucketWidth,
+                                                      std::optional<uint64_t> startTimestamp = std::nullopt,
+                                                      std::optional<uint64_t> endTimestamp = std::nullopt) override {
+                return ITelemetryStorage::aggregateSeries(eventName, bucketWidth, startTimestamp, endTimestamp);
+            }
+        } fallback(plain);
+
+        THEN("Shard results are merged per bucket") {
+            auto buckets = sharded.aggregateSeries("trip", 60, base);
+            requireSameBuckets(buckets, bucketsByScan(sharded, "trip", 60, base, base + 1400));
+        }
+
+        THEN("The default implementation agrees with the storage") {
+            requireSameBuckets(fallback.aggregateSeries("trip", 60, base),
+                               bucketsByScan(plain, "trip", 60, base, base + 1400));
+        }
+    }
+}
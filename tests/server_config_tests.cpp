@@ -0,0 +1,108 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/server_config.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Config file in the temporary directory, removed when the test ends
+class TempConfigFile {
+public:
+    explicit TempConfigFile(const std::string& content)
+        : path_("/tmp/telemetry_config_" + std::to_string(std::rand()) + ".json") {
+        std::ofstream(path_) << content;
+    }
+    ~TempConfigFile() { std::remove(path_.c_str()); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+ServerConfig defaultConfig() {
+    ServerConfig config;
+    config.address = "127.0.0.1";
+    config.port = 8080;
+    config.threadCount = 2;
+    return config;
+}
+
+} // namespace
+
+SCENARIO("Server runtime settings are read from a config file", "[config]") {
+    GIVEN("A config file with listener and connection settings") {
+        TempConfigFile file(R"({"threads": 4, "listeners": 3, "backlog": 2048,
+                                "maxRequestSize": 16384, "keepAliveTimeoutMs": 5000})");
+        auto config = defaultConfig();
+
+        WHEN("It is applied") {
+            applyConfigFile(file.path(), config);
+
+            THEN("The given settings change and the others keep their values") {
+                REQUIRE(config.threadCount == 4);
+                REQUIRE(config.listenerCount == 3);
+                REQUIRE(config.backlog == 2048);
+                REQUIRE(config.maxRequestSize == 16384);
+                REQUIRE(config.keepAliveTimeoutMs == 5000);
+                REQUIRE(config.headerTimeoutMs == 0);
+                REQUIRE(config.port == 8080);
+                REQUIRE_NOTHROW(validateServerConfig(config));
+            }
+        }
+    }
+
+    GIVEN("A config file with tracing settings") {
+        TempConfigFile file(R"({"traceSampleEvery": 100, "traceFile": "/tmp/trace.json"})");
+        auto config = defaultConfig();
+
+        WHEN("It is applied") {
+            applyConfigFile(file.path(), config);
+
+            THEN("One request in the given number is traced into the given file") {
+                REQUIRE(config.traceSampleEvery == 100);
+                REQUIRE(config.traceFile == "/tmp/trace.json");
+            }
+        }
+    }
+
+    GIVEN("Config files with mistakes") {
+        auto config = defaultConfig();
+
+        THEN("Unknown keys, invalid values and unreadable files are reported") {
+            TempConfigFile unknown(R"({"thread": 4})");
+            REQUIRE_THROWS_AS(applyConfigFile(unknown.path(), config), std::runtime_error);
+
+            TempConfigFile negative(R"({"backlog": -1})");
+            REQUIRE_THROWS_AS(applyConfigFile(negative.path(), config), std::runtime_error);
+
+            TempConfigFile malformed("{\"threads\": ");
+            REQUIRE_THROWS_AS(applyConfigFile(malformed.path(), config), std::runtime_error);
+
+            TempConfigFile traceFile(R"({"traceFile": 3})");
+            REQUIRE_THROWS_AS(applyConfigFile(traceFile.path(), config), std::runtime_error);
+
+            REQUIRE_THROWS_AS(applyConfigFile("/nonexistent/telemetry.json", config), std::runtime_error);
+        }
+    }
+
+    GIVEN("Settings that cannot be served") {
+        auto config = defaultConfig();
+
+        THEN("Validation rejects them") {
+            config.listenerCount = 0;
+            REQUIRE_THROWS_AS(validateServerConfig(config), std::invalid_argument);
+            config.listenerCount = 1;
+            config.maxRequestSize = 16;
+            REQUIRE_THROWS_AS(validateServerConfig(config), std::invalid_argument);
+            config.maxRequestSize = 4096;
+            config.maxInFlightExports = -1;
+            REQUIRE_THROWS_AS(validateServerConfig(config), std::invalid_argument);
+            config.maxInFlightExports = 0;
+            config.maxInFlightStreams = -1;
+            REQUIRE_THROWS_AS(validateServerConfig(config), std::invalid_argument);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/sharded_storage.h"
+#include "telemetry/telemetry_processor.h"
+#include <sched.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <string>
+
+SCENARIO("Sharded storage keeps one shard per thread and merges on query", "[storage][sharded]") {
+    GIVEN("A storage with four shards") {
+        ShardedStorage storage(4, false);
+
+        WHEN("Four threads ingest concurrently") {
+            std::vector<std::size_t> shards(4);
+            std::vector<std::thread> threads;
+            for (std::size_t t = 0; t < 4; ++t) {
+                threads.emplace_back([&, t] {
+                    shards[t] = storage.localShard();
+                    for (int i = 0; i < 100; ++i) {
+                        storage.saveEvent("ingest", std::vector<double>(10, 1.0 + t), 1000 + i * 4 + t);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            THEN("Every thread wrote to a shard of its own") {
+                std::sort(shards.begin(), shards.end());
+                REQUIRE(std::unique(shards.begin(), shards.end()) == shards.end());
+            }
+
+            THEN("Aggregates combine the partial results of all shards") {
+                auto aggregate = storage.aggregateEvents("ingest");
+                REQUIRE(aggregate.count == 400);
+                REQUIRE_THAT(aggregate.sum, Catch::Matchers::WithinRel(100.0 * 10 * (1 + 2 + 3 + 4), 0.0001));
+            }
+
+            THEN("Filtered events are merged in timestamp order") {
+                auto events = storage.getFilteredEvents("ingest", 1000, 1007);
+                REQUIRE(events.size() == 8);
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(events[i].timestamp == 1000 + i);
+                }
+            }
+        }
+
+        WHEN("The same thread saves again") {
+            auto shard = storage.localShard();
+            storage.saveEvent("ingest", std::vector<double>(10, 2.0), 1000);
+
+            THEN("It stays bound to its shard") {
+                REQUIRE(storage.localShard() == shard);
+            }
+        }
+
+        WHEN("A processor runs on top of it") {
+            TelemetryProcessor processor(storage);
+            std::thread writer([&] {
+                processor.saveEvent("flow", std::vector<double>(10, 1.0), 1000);
+            });
+            writer.join();
+            processor.saveEvent("flow", std::vector<double>(10, 3.0), 1001);
+
+            THEN("The mean covers every shard") {
+                REQUIRE_THAT(processor.calculateMeanLength("flow"), Catch::Matchers::WithinRel(20.0, 0.0001));
+            }
+        }
+    }
+
+    GIVEN("A storage that pins its writer threads") {
+        ShardedStorage storage(4, true);
+
+        WHEN("A thread bulk loads it") {
+            cpu_set_t before;
+            cpu_set_t after;
+            std::size_t firstWorkerShard = 0;
+            std::thread loader([&] {
+                ::sched_getaffinity(0, sizeof(before), &before);
+                {
+                    ShardedStorage::BulkLoad load(storage);
+                    for (int i = 0; i < 100; ++i) {
+                        storage.saveEvent("backfill", std::vector<double>(10, 1.0), 1000 + i);
+                    }
+                    storage.saveEvents("backfill", std::vector<EventData>(100, EventData{std::vector<double>(10, 1.0), 2000}));
+                }
+                ::sched_getaffinity(0, sizeof(after), &after);
+            });
+            loader.join();
+            std::thread([&] { firstWorkerShard = storage.localShard(); }).join();
+
+            THEN("The thread keeps its affinity and no shard is taken from the workers") {
+                REQUIRE(CPU_EQUAL(&before, &after));
+                REQUIRE(firstWorkerShard == 0);
+                REQUIRE(storage.aggregateEvents("backfill").count == 200);
+            }
+        }
+    }
+}
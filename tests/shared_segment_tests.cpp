@@ -0,0 +1,222 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/shared_segment.h"
+#include "telemetry/telemetry_processor.h"
+#include "telemetry/telemetry_storage.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kBase = 1617235200;
+
+// Segment name private to this test process, removed when the test ends
+class SegmentName {
+public:
+    explicit SegmentName(const std::string& suffix)
+        : name_("/telemetry-test-" + std::to_string(::getpid()) + "-" + suffix) {}
+    ~SegmentName() { ::shm_unlink(name_.c_str()); }
+
+    const std::string& str() const { return name_; }
+
+private:
+    std::string name_;
+};
+
+void requireSameAggregate(const PathAggregate& actual, const PathAggregate& expected) {
+    REQUIRE(actual.count == expected.count);
+    REQUIRE_THAT(actual.sum, Catch::Matchers::WithinRel(expected.sum, 1e-9));
+}
+
+} // namespace
+
+SCENARIO("Query processes read the ingest process's events from shared memory", "[shm]") {
+    GIVEN("A writer publishing over a storage, with late events across many summary blocks") {
+        SegmentName name("publish");
+        TelemetryStorage storage;
+        SharedSegmentWriter writer(storage, SegmentOptions{name.str(), 4, 1 << 16});
+        std::mt19937_64 generator(5);
+        std::uniform_int_distribution<uint64_t> lateness(0, 3000);
+        for (uint64_t i = 0; i < 20000; ++i) {
+            auto timestamp = kBase + i - (i % 50 == 0 ? std::min(i, lateness(generator)) : 0);
+            REQUIRE(writer.saveEvent("trip", std::vector<double>(10, 0.25 + static_cast<double>(i % 13)), timestamp));
+        }
+        SharedSegmentReader reader(name.str());
+
+        WHEN("Ranges, series and windows are queried from the segment") {
+            THEN("They match the ingest process's storage") {
+                requireSameAggregate(reader.aggregateEvents("trip"), storage.aggregateEvents("trip"));
+                requireSameAggregate(reader.aggregateEvents("trip", kBase + 4000, kBase + 16000),
+                                     storage.aggregateEvents("trip", kBase + 4000, kBase + 16000));
+                requireSameAggregate(reader.aggregateEvents("trip", kBase + 19990),
+                                     storage.aggregateEvents("trip", kBase + 19990));
+                REQUIRE(reader.aggregateEvents("unknown").count == 0);
+
+                auto published = reader.aggregateSeries("trip", 3600, kBase);
+                auto stored = storage.aggregateSeries("trip", 3600, kBase);
+                REQUIRE(published.size() == stored.size());
+                for (std::size_t i = 0; i < stored.size(); ++i) {
+                    REQUIRE(published[i].bucketStart == stored[i].bucketStart);
+                    requireSameAggregate(published[i].aggregate, stored[i].aggregate);
+                }
+
+                auto windows = reader.aggregateWindows("trip", {{kBase, kBase + 99}, {kBase + 5000, kBase + 9000}});
+                requireSameAggregate(windows[1], storage.aggregateEvents("trip", kBase + 5000, kBase + 9000));
+                REQUIRE(reader.statusFields()["events"] == 20000.0);
+            }
+        }
+
+        WHEN("Another process maps the segment and computes a mean") {
+            int results[2];
+            REQUIRE(::pipe(results) == 0);
+            pid_t child = ::fork();
+            if (child == 0) {
+                // Only async-signal-safe exits from here on; Catch2 belongs to the parent
+                double mean = -1.0;
+                try {
+                    SharedSegmentReader childReader(name.str());
+                    TelemetryProcessor processor(childReader);
+                    mean = processor.calculateMeanLength("trip", kBase + 1000, kBase + 2000);
+                } catch (...) {
+                }
+                auto written = ::write(results[1], &mean, sizeof(mean));
+                ::_exit(written == sizeof(mean) ? 0 : 1);
+            }
+            ::close(results[1]);
+            double mean = 0.0;
+            auto read = ::read(results[0], &mean, sizeof(mean));
+            ::close(results[0]);
+            int status = 0;
+            ::waitpid(child, &status, 0);
+
+            THEN("It sees the same data without a copy through the ingest process") {
+                REQUIRE(read == sizeof(mean));
+                REQUIRE(WIFEXITED(status));
+                REQUIRE(WEXITSTATUS(status) == 0);
+                auto expected = storage.aggregateEvents("trip", kBase + 1000, kBase + 2000);
+                REQUIRE_THAT(mean, Catch::Matchers::WithinRel(expected.sum / expected.count, 1e-9));
+            }
+        }
+
+        WHEN("A second writer opens the same segment") {
+            TelemetryStorage other;
+
+            THEN("It is refused") {
+                REQUIRE_THROWS_AS(SharedSegmentWriter(other, SegmentOptions{name.str(), 4, 1 << 16}), std::runtime_error);
+            }
+        }
+
+        WHEN("Raw events or writes are asked of a query process") {
+            TelemetryProcessor inner(reader);
+            SegmentQueryProcessor processor(inner);
+
+            THEN("They are not supported") {
+                EventCursor cursor;
+                std::vector<EventData> out;
+                REQUIRE_THROWS_AS(reader.getFilteredEvents("trip"), UnsupportedOperationError);
+                REQUIRE_THROWS_AS(reader.readEvents("trip", std::nullopt, std::nullopt, cursor, 10, out), UnsupportedOperationError);
+                REQUIRE_THROWS_AS(processor.saveEvent("trip", std::vector<double>(10, 1.0), kBase), UnsupportedOperationError);
+                REQUIRE_THROWS_AS(processor.registerStandingQuery("today", "trip", kBase, std::nullopt), UnsupportedOperationError);
+                REQUIRE(processor.calculateAggregates({"trip"}).front().count == 20000);
+            }
+        }
+    }
+
+    GIVEN("A reader attached to a segment whose writer restarts") {
+        SegmentName name("restart");
+        TelemetryStorage storage;
+        auto writer = std::make_unique<SharedSegmentWriter>(storage, SegmentOptions{name.str(), 4, 1024});
+        writer->saveEvent("trip", std::vector<double>(10, 1.0), kBase);
+        SharedSegmentReader reader(name.str());
+        auto before = reader.eventVersion("trip");
+
+        WHEN("The new writer uses the same geometry") {
+            writer.reset();
+            TelemetryStorage restarted;
+            SharedSegmentWriter again(restarted, SegmentOptions{name.str(), 4, 1024});
+
+            THEN("The reader sees the reset segment under a higher version") {
+                REQUIRE(reader.aggregateEvents("trip").count == 0);
+                REQUIRE(*reader.eventVersion("trip") > *before);
+                again.saveEvent("trip", std::vector<double>(10, 2.0), kBase);
+                REQUIRE(reader.aggregateEvents("trip").count == 1);
+                REQUIRE(reader.statusFields()["resets"] == 1.0);
+            }
+        }
+
+        WHEN("The new writer uses another geometry") {
+            writer.reset();
+            TelemetryStorage restarted;
+            SharedSegmentWriter again(restarted, SegmentOptions{name.str(), 8, 2048});
+            again.saveEvent("trip", std::vector<double>(10, 2.0), kBase);
+
+            THEN("The old mapping is reported unavailable and a new reader sees the new segment") {
+                REQUIRE_THROWS_AS(reader.aggregateEvents("trip"), BackendUnavailableError);
+                SharedSegmentReader fresh(name.str());
+                REQUIRE(fresh.aggregateEvents("trip").count == 1);
+            }
+        }
+    }
+
+    GIVEN("A segment too small for the published data") {
+        SegmentName name("overflow");
+        TelemetryStorage storage;
+        SharedSegmentWriter writer(storage, SegmentOptions{name.str(), 1, 10});
+        for (uint64_t i = 0; i < 11; ++i) {
+            writer.saveEvent("trip", std::vector<double>(10, 1.0), kBase + i);
+        }
+        writer.saveEvent("ride", std::vector<double>(10, 1.0), kBase);
+        SharedSegmentReader reader(name.str());
+
+        THEN("The storage keeps everything and readers refuse incomplete answers") {
+            REQUIRE(storage.aggregateEvents("trip").count == 11);
+            REQUIRE_THROWS_AS(reader.aggregateEvents("trip"), BackendUnavailableError);
+            REQUIRE_THROWS_AS(reader.aggregateEvents("ride"), BackendUnavailableError);
+            REQUIRE_FALSE(reader.eventVersion("trip"));
+            REQUIRE(writer.statusFields()["droppedEvents"] == 1.0);
+            REQUIRE(writer.statusFields()["droppedSeries"] == 1.0);
+        }
+    }
+
+    GIVEN("Readers querying while the writer publishes") {
+        SegmentName name("concurrent");
+        TelemetryStorage storage;
+        SharedSegmentWriter writer(storage, SegmentOptions{name.str(), 2, 1 << 16});
+        SharedSegmentReader reader(name.str());
+        std::atomic<bool> done{false};
+        std::atomic<bool> consistent{true};
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&] {
+                uint64_t last = 0;
+                while (!done) {
+                    auto aggregate = reader.aggregateEvents("trip");
+                    if (aggregate.count < last || aggregate.sum != 10.0 * static_cast<double>(aggregate.count)) {
+                        consistent = false;
+                    }
+                    last = aggregate.count;
+                }
+            });
+        }
+        for (uint64_t i = 0; i < 50000; ++i) {
+            writer.saveEvent("trip", std::vector<double>(10, 1.0), kBase + i);
+        }
+        done = true;
+        for (auto& thread : readers) {
+            thread.join();
+        }
+
+        THEN("Every read sees a prefix of the published events") {
+            REQUIRE(consistent);
+            REQUIRE(reader.aggregateEvents("trip").count == 50000);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/bulk_import.h"
+#include "telemetry/snapshot.h"
+#include "telemetry/telemetry_storage.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Fresh file path that is removed again at the end of the test
+class TemporaryFile {
+public:
+    explicit TemporaryFile(const std::string& name)
+        : path_((std::filesystem::temp_directory_path() / ("telemetry-" + name)).string()) {
+        std::filesystem::remove(path_);
+    }
+    ~TemporaryFile() { std::filesystem::remove(path_); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+SCENARIO("Bulk import builds a snapshot that the server loads", "[persistence][import]") {
+    const uint64_t base = 1617235200;
+
+    GIVEN("A CSV file written newest first and an NDJSON file") {
+        TemporaryFile csv("import.csv");
+        TemporaryFile ndjson("import.ndjson");
+        TemporaryFile snapshot("import.snap");
+        {
+            std::ofstream out(csv.path());
+            out << "event,timestamp,v1,v2,v3,v4,v5,v6,v7,v8,v9,v10\r\n";
+            for (uint64_t i = 20000; i-- > 0;) {
+                out << (i % 2 == 0 ? "trip" : "login") << ',' << base + i;
+                for (int v = 0; v < 10; ++v) {
+                    out << ',' << 0.5 * static_cast<double>(i % 7);
+                }
+                out << "\r\n";
+            }
+            out << "trip,not-a-time,1,2,3,4,5,6,7,8,9,10\n";
+            out << "trip," << base << ",1,2,3\n";
+        }
+        {
+            std::ofstream out(ndjson.path());
+            out << R"({"event":"trip","date":)" << base + 20000 << R"(,"values":[1,1,1,1,1,1,1,1,1,1.5]})" << "\n";
+            out << R"({"event":"signup","timestamp":)" << base << R"(,"values":[2,2,2,2,2,2,2,2,2,2]})" << "\n";
+            out << "{not json}\n";
+        }
+
+        WHEN("Both files are imported on four threads") {
+            auto stats = importToSnapshot({csv.path(), ndjson.path()}, snapshot.path(), 4);
+
+            THEN("Every valid line is imported and malformed lines are counted") {
+                REQUIRE(stats.files == 2);
+                REQUIRE(stats.series == 3);
+                REQUIRE(stats.events == 20002);
+                REQUIRE(stats.rejected == 3);
+            }
+
+            AND_WHEN("The snapshot is loaded into a storage") {
+                TelemetryStorage storage;
+                auto loaded = loadSnapshot(snapshot.path(), storage);
+
+                THEN("Every series is restored in time order") {
+                    REQUIRE(loaded.series == 3);
+                    REQUIRE(loaded.events == 20002);
+                    REQUIRE(loaded.rejected == 0);
+
+                    auto trips = storage.getFilteredEvents("trip");
+                    REQUIRE(trips.size() == 10001);
+                    for (std::size_t i = 0; i < 10000; ++i) {
+                        REQUIRE(trips[i].timestamp == base + 2 * i);
+                        REQUIRE(trips[i].values == std::vector<double>(10, 0.5 * static_cast<double>(2 * i % 7)));
+                    }
+                    REQUIRE(trips.back().values.back() == 1.5);
+                    REQUIRE(storage.aggregateEvents("login").count == 10000);
+                    REQUIRE(storage.aggregateEvents("signup").sum == 20.0);
+                }
+            }
+
+            AND_WHEN("The snapshot is damaged") {
+                std::filesystem::resize_file(snapshot.path(), std::filesystem::file_size(snapshot.path()) - 1);
+                TelemetryStorage storage;
+
+                THEN("Loading fails instead of serving a partial history") {
+                    REQUIRE_THROWS_AS(loadSnapshot(snapshot.path(), storage), std::runtime_error);
+                }
+            }
+        }
+    }
+
+    GIVEN("An input with an unknown extension") {
+        THEN("The format is rejected") {
+            REQUIRE_THROWS_AS(importFormatOf("events.xml"), std::invalid_argument);
+            REQUIRE(importFormatOf("events.jsonl") == ImportFormat::Ndjson);
+        }
+    }
+}
+
+SCENARIO("Storage saves batches of events under one lock", "[storage][import]") {
+    GIVEN("A storage keeping one event name at millisecond precision") {
+        PrecisionPolicy precision;
+        precision.perEvent["trip"] = ValuePrecision::Milliseconds;
+        TelemetryStorage storage(precision);
+
+        WHEN("A batch with an unrepresentable event is saved") {
+            std::vector<EventData> events;
+            for (uint64_t i = 0; i < 1000; ++i) {
+                events.push_back(EventData{std::vector<double>(10, 1.25), 1617235200 + i});
+            }
+            events[10].values[0] = -1.0;
+            auto saved = storage.saveEvents("trip", events);
+
+            THEN("Only that event is rejected") {
+                REQUIRE(saved == 999);
+                REQUIRE(storage.aggregateEvents("trip").count == 999);
+                REQUIRE(storage.aggregateEvents("trip").sum == 999 * 12.5);
+            }
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/standing_query.h"
+#include "telemetry/telemetry_processor.h"
+#include "telemetry/telemetry_storage.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kBase = 1617235200;
+
+} // namespace
+
+SCENARIO("Standing queries are maintained on ingest", "[standing]") {
+    GIVEN("A registry with a query over a time range") {
+        StandingQueryRegistry registry;
+        auto noHistory = [](const std::string&, std::optional<uint64_t>, std::optional<uint64_t>) {
+            return PathAggregate{};
+        };
+        auto save = [] { return true; };
+        registry.define("morning", "user_flow", kBase, kBase + 3599, noHistory);
+
+        WHEN("Events inside and outside the range are ingested") {
+            registry.ingest("user_flow", std::vector<double>(10, 1.0), kBase, save);
+            registry.ingest("user_flow", std::vector<double>(10, 3.0), kBase + 3599, save);
+            registry.ingest("user_flow", std::vector<double>(10, 9.0), kBase + 3600, save);
+            registry.ingest("other_flow", std::vector<double>(10, 9.0), kBase + 10, save);
+
+            THEN("Only events of that name within the range are counted") {
+                auto aggregate = registry.read("morning");
+                REQUIRE(aggregate);
+                REQUIRE(aggregate->count == 2);
+                REQUIRE_THAT(aggregate->sum, Catch::Matchers::WithinRel(40.0, 1e-9));
+            }
+        }
+
+        WHEN("A save is rejected") {
+            registry.ingest("user_flow", std::vector<double>(10, 1.0), kBase, [] { return false; });
+
+            THEN("The query does not count it") {
+                REQUIRE(registry.read("morning")->count == 0);
+            }
+        }
+
+        WHEN("The query is redefined over another event") {
+            registry.define("morning", "other_flow", std::nullopt, std::nullopt,
+                [](const std::string& eventName, std::optional<uint64_t> start, std::optional<uint64_t> end) {
+                    REQUIRE(eventName == "other_flow");
+                    REQUIRE_FALSE(start);
+                    REQUIRE_FALSE(end);
+                    return PathAggregate{50.0, 5};
+                });
+            registry.ingest("user_flow", std::vector<double>(10, 1.0), kBase, save);
+            registry.ingest("other_flow", std::vector<double>(10, 1.0), kBase, save);
+
+            THEN("It starts from the seeded history and follows only the new event") {
+                auto aggregate = registry.read("morning");
+                REQUIRE(aggregate->count == 6);
+                REQUIRE_THAT(aggregate->sum, Catch::Matchers::WithinRel(60.0, 1e-9));
+            }
+        }
+
+        WHEN("The query is removed") {
+            REQUIRE(registry.remove("morning"));
+
+            THEN("It can no longer be read or removed") {
+                REQUIRE_FALSE(registry.read("morning"));
+                REQUIRE_FALSE(registry.remove("morning"));
+            }
+        }
+    }
+}
+
+SCENARIO("Defining a standing query holds off saves of its event only", "[standing]") {
+    GIVEN("A registry seeding a new query from a slow scan") {
+        StandingQueryRegistry registry;
+        std::promise<void> seeding;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        std::thread definer([&] {
+            registry.define("today", "hot", kBase, std::nullopt,
+                [&](const std::string&, std::optional<uint64_t>, std::optional<uint64_t>) {
+                    seeding.set_value();
+                    released.wait();
+                    return PathAggregate{};
+                });
+        });
+        seeding.get_future().wait();
+
+        WHEN("Events of that and another name are saved during the scan") {
+            auto save = [] { return true; };
+            auto other = std::async(std::launch::async, [&] {
+                return registry.ingest("cold", std::vector<double>(10, 1.0), kBase, save);
+            });
+            const bool otherFinished = other.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+            auto same = std::async(std::launch::async, [&] {
+                return registry.ingest("hot", std::vector<double>(10, 1.0), kBase, save);
+            });
+            const bool sameWaited = same.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout;
+            release.set_value();
+            definer.join();
+
+            THEN("Only the seeded event waits, and its save is counted once") {
+                REQUIRE(otherFinished);
+                REQUIRE(other.get());
+                REQUIRE(sameWaited);
+                REQUIRE(same.get());
+                REQUIRE(registry.read("today")->count == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Standing queries agree with scans under concurrent ingest", "[standing][processor]") {
+    GIVEN("A processor over storage with history") {
+        TelemetryStorage storage;
+        TelemetryProcessor processor(storage);
+        for (uint64_t i = 0; i < 1000; ++i) {
+            REQUIRE(processor.saveEvent("user_flow", std::vector<double>(10, 1.0), kBase + i));
+        }
+
+        WHEN("A standing query is defined while writers keep saving") {
+            constexpr int kWriters = 4;
+            constexpr uint64_t kSavesPerWriter = 5000;
+            std::atomic<bool> started{false};
+            std::vector<std::thread> writers;
+            for (int w = 0; w < kWriters; ++w) {
+                writers.emplace_back([&, w] {
+                    started = true;
+                    for (uint64_t i = 0; i < kSavesPerWriter; ++i) {
+                        processor.saveEvent("user_flow", std::vector<double>(10, 2.0), kBase + 500 + w * kSavesPerWriter + i);
+                    }
+                });
+            }
+            while (!started) {
+                std::this_thread::yield();
+            }
+            processor.registerStandingQuery("since_noon", "user_flow", kBase + 500, std::nullopt);
+
+            // Every read sees the sum and count of the same set of events
+            bool consistent = true;
+            for (int i = 0; i < 1000; ++i) {
+                auto aggregate = processor.readStandingQuery("since_noon");
+                consistent = consistent && aggregate && aggregate->count >= 500 &&
+                             aggregate->sum == 10.0 * 500 + 20.0 * (aggregate->count - 500);
+            }
+            for (auto& writer : writers) {
+                writer.join();
+            }
+
+            THEN("Reads stay consistent and the final value matches a scan") {
+                REQUIRE(consistent);
+                auto aggregate = processor.readStandingQuery("since_noon");
+                auto scanned = storage.aggregateEvents("user_flow", kBase + 500, std::nullopt);
+                REQUIRE(aggregate->count == 500 + kWriters * kSavesPerWriter);
+                REQUIRE(aggregate->count == scanned.count);
+                REQUIRE_THAT(aggregate->sum, Catch::Matchers::WithinRel(scanned.sum, 1e-12));
+            }
+        }
+
+        WHEN("An unknown standing query is read") {
+            THEN("There is nothing to return") {
+                REQUIRE_FALSE(processor.readStandingQuery("nothing"));
+                REQUIRE_FALSE(processor.removeStandingQuery("nothing"));
+            }
+        }
+    }
+
+    GIVEN("A processor over float32 storage") {
+        TelemetryStorage storage(PrecisionPolicy{ValuePrecision::Float32, {}});
+        TelemetryProcessor processor(storage);
+        processor.registerStandingQuery("all", "user_flow", std::nullopt, std::nullopt);
+
+        WHEN("Values that float32 cannot hold exactly are saved") {
+            for (uint64_t i = 0; i < 100; ++i) {
+                REQUIRE(processor.saveEvent("user_flow", std::vector<double>(10, 0.1 + 0.01 * static_cast<double>(i)), kBase + i));
+            }
+
+            THEN("The query adds them as stored and matches a scan") {
+                auto aggregate = processor.readStandingQuery("all");
+                auto scanned = storage.aggregateEvents("user_flow");
+                REQUIRE(aggregate->count == scanned.count);
+                REQUIRE_THAT(aggregate->sum, Catch::Matchers::WithinRel(scanned.sum, 1e-12));
+            }
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/storage_stress.h"
+#include "telemetry/forwarding_storage.h"
+#include "telemetry/telemetry_storage.h"
+#include <atomic>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Storage that acknowledges every save but silently drops one in every `period`
+class LossyStorage : public ForwardingStorage {
+public:
+    explicit LossyStorage(uint64_t period)
+        : ForwardingStorage(inner_), period_(period) {}
+
+    bool saveEvent(const std::string& eventName,
+                   const std::vector<double>& values,
+                   uint64_t timestamp) override {
+        if (saves_.fetch_add(1) % period_ == period_ - 1) {
+            return true;
+        }
+        return ForwardingStorage::saveEvent(eventName, values, timestamp);
+    }
+
+private:
+    TelemetryStorage inner_; // Only referenced until constructed, never used before
+    uint64_t period_;
+    std::atomic<uint64_t> saves_{0};
+};
+
+StressScenario smallScenario(const char* name, double writeRatio, double zipfExponent, double lateFraction) {
+    StressScenario scenario;
+    scenario.name = name;
+    scenario.writeRatio = writeRatio;
+    scenario.zipfExponent = zipfExponent;
+    scenario.lateFraction = lateFraction;
+    scenario.eventNames = 16;
+    scenario.operationsPerThread = 3000;
+    return scenario;
+}
+
+} // namespace
+
+SCENARIO("Zipf draws favour low ranks", "[harness]") {
+    GIVEN("Uniform and skewed distributions over 100 ranks") {
+        std::mt19937_64 generator(7);
+        ZipfDistribution uniform(100, 0.0);
+        ZipfDistribution skewed(100, 1.2);
+
+        WHEN("Many ranks are drawn") {
+            std::vector<int> uniformCounts(100, 0);
+            std::vector<int> skewedCounts(100, 0);
+            for (int i = 0; i < 100000; ++i) {
+                ++uniformCounts[uniform(generator)];
+                ++skewedCounts[skewed(generator)];
+            }
+
+            THEN("Uniform draws are spread evenly and skewed ones pile onto the first ranks") {
+                REQUIRE(uniformCounts[0] < 1500);
+                REQUIRE(uniformCounts[99] > 500);
+                REQUIRE(skewedCounts[0] > 10 * skewedCounts[99]);
+                REQUIRE(skewedCounts[0] > 20000);
+            }
+        }
+    }
+}
+
+SCENARIO("Built-in storages agree with the reference model under concurrency", "[harness][storage]") {
+    GIVEN("Every built-in storage and workloads with skew and late events") {
+        auto storages = builtinStorages();
+        REQUIRE(storages.size() == 5);
+        std::vector<StressScenario> scenarios = {
+            smallScenario("mixed", 0.5, 1.0, 0.05),
+            smallScenario("late", 0.9, 0.8, 0.3),
+        };
+
+        for (const auto& [name, factory] : storages) {
+            for (const auto& scenario : scenarios) {
+                WHEN("The " + name + " storage runs the " + scenario.name + " scenario on 8 threads") {
+                    auto result = runStress(factory, scenario, 8);
+
+                    THEN("All operations complete without violations") {
+                        INFO(name << "/" << scenario.name << ": "
+                                  << (result.failures.empty() ? std::string() : result.failures.front()));
+                        REQUIRE(result.operations == 8 * scenario.operationsPerThread);
+                        REQUIRE(result.operationsPerSecond > 0.0);
+                        REQUIRE(result.writeP99Micros >= result.writeP50Micros);
+                        REQUIRE(result.readP99Micros >= result.readP50Micros);
+                        REQUIRE(result.violations == 0);
+                        REQUIRE(result.failures.empty());
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("The reference model catches lost writes", "[harness]") {
+    GIVEN("A storage that drops every 100th save while reporting success") {
+        StorageFactory lossy = [] { return std::make_unique<LossyStorage>(100); };
+
+        WHEN("A write-heavy scenario runs against it") {
+            auto result = runStress(lossy, smallScenario("ingest", 1.0, 0.0, 0.0), 4);
+
+            THEN("The run reports violations with descriptions") {
+                REQUIRE(result.violations > 0);
+                REQUIRE_FALSE(result.failures.empty());
+                REQUIRE(result.failures.size() <= 10);
+            }
+        }
+    }
+}
@@ -0,0 +1,194 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/task.h"
+#include "telemetry/forwarding_storage.h"
+#include "telemetry/query_context.h"
+#include "telemetry/telemetry_processor.h"
+#include "telemetry/telemetry_storage.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Task<int> answer() {
+    co_return 42;
+}
+
+Task<int> doubled() {
+    co_return 2 * co_await answer();
+}
+
+Task<int> failing() {
+    throw std::runtime_error("backend failed");
+    co_return 0;
+}
+
+// Storage whose events become durable only when the test says so, like a write-ahead log
+// whose flusher has not run yet
+class DeferredStorage : public ForwardingStorage {
+public:
+    using ForwardingStorage::ForwardingStorage;
+
+    bool saveEventAsync(const std::string& eventName,
+                        const std::vector<double>& values,
+                        uint64_t timestamp,
+                        const std::function<void(bool durable)>& onDurable) override {
+        if (!saveEvent(eventName, values, timestamp)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(onDurable);
+        return true;
+    }
+
+    // Completes every pending save
+    void flush() {
+        std::vector<std::function<void(bool)>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending.swap(pending_);
+        }
+        for (auto& done : pending) {
+            done(true);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::function<void(bool)>> pending_;
+};
+
+// Awaits one save and records how and where it completed
+DetachedTask saveAndRecord(ITelemetryProcessor& processor, uint64_t timestamp,
+                           std::atomic<int>& saved, std::atomic<int>& resumedOn,
+                           std::thread::id expectedThread) {
+    auto status = co_await processor.saveEventTask("flow", std::vector<double>(10, 1.0), timestamp);
+    if (status == SaveStatus::Saved) {
+        saved.fetch_add(1);
+    }
+    if (std::this_thread::get_id() == expectedThread) {
+        resumedOn.fetch_add(1);
+    }
+}
+
+} // namespace
+
+SCENARIO("Tasks produce values and exceptions", "[task]") {
+    GIVEN("Coroutines that complete without suspending") {
+        THEN("Awaiting them yields their value") {
+            REQUIRE(syncWait(answer()) == 42);
+            REQUIRE(syncWait(doubled()) == 84);
+        }
+
+        THEN("An exception in the body reaches the awaiter") {
+            REQUIRE_THROWS_AS(syncWait(failing()), std::runtime_error);
+        }
+    }
+
+    GIVEN("An operation completed by a callback") {
+        WHEN("The callback runs before the coroutine suspends") {
+            auto task = []() -> Task<int> {
+                co_return co_await CallbackAwaiter<int>([](std::function<void(int)> done) { done(7); });
+            };
+
+            THEN("The coroutine continues on the calling thread") {
+                REQUIRE(syncWait(task()) == 7);
+            }
+        }
+
+        WHEN("The callback runs later on another thread") {
+            std::thread completer;
+            auto task = [&]() -> Task<std::thread::id> {
+                co_await CallbackAwaiter<int>([&](std::function<void(int)> done) {
+                    completer = std::thread([done = std::move(done)] {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                        done(1);
+                    });
+                });
+                co_return std::this_thread::get_id();
+            };
+            auto resumedOn = syncWait(task());
+            auto completerId = completer.get_id();
+            completer.join();
+
+            THEN("The coroutine resumes on that thread") {
+                REQUIRE(resumedOn == completerId);
+            }
+        }
+    }
+}
+
+SCENARIO("Coroutine saves wait for durability without holding threads", "[task][processor]") {
+    GIVEN("A processor over storage that acknowledges events later") {
+        TelemetryStorage storage;
+        DeferredStorage deferred(storage);
+        TelemetryProcessor processor(deferred);
+
+        WHEN("Thousands of saves are started from one thread") {
+            constexpr int kSaves = 5000;
+            std::atomic<int> saved{0};
+            std::atomic<int> resumedOnFlusher{0};
+            std::thread::id flusherId;
+            std::thread flusher;
+            {
+                // The flusher's id must be known before the saves start, so it waits to be released
+                std::mutex gate;
+                std::unique_lock<std::mutex> closed(gate);
+                flusher = std::thread([&] {
+                    std::lock_guard<std::mutex> opened(gate);
+                    deferred.flush();
+                });
+                flusherId = flusher.get_id();
+                for (int i = 0; i < kSaves; ++i) {
+                    saveAndRecord(processor, 1617235200 + i, saved, resumedOnFlusher, flusherId);
+                }
+
+                THEN("All of them are in flight at once") {
+                    REQUIRE(saved == 0);
+                    REQUIRE(storage.getFilteredEvents("flow").size() == kSaves);
+                }
+            }
+            flusher.join();
+
+            THEN("One thread completes them all once they are durable") {
+                REQUIRE(saved == kSaves);
+                REQUIRE(resumedOnFlusher == kSaves);
+            }
+        }
+
+        WHEN("An invalid event is saved") {
+            auto status = syncWait(processor.saveEventTask("flow", {1.0, 2.0}, 1617235200));
+
+            THEN("It is rejected without waiting") {
+                REQUIRE(status == SaveStatus::Rejected);
+            }
+        }
+    }
+}
+
+SCENARIO("Query contexts can leave a thread with a suspended coroutine", "[task][deadline]") {
+    GIVEN("A context installed on top of another") {
+        QueryContext outer(QueryContext::Clock::now() + std::chrono::seconds(10), false);
+        auto inner = std::make_unique<QueryContext>(QueryContext::Clock::now() - std::chrono::seconds(1), true);
+        REQUIRE(QueryContext::current() == inner.get());
+
+        WHEN("The inner context is detached") {
+            QueryContext::detachAbove(&outer);
+
+            THEN("The thread runs under the outer context again") {
+                REQUIRE(QueryContext::current() == &outer);
+                REQUIRE_FALSE(QueryContext::deadlineReached());
+            }
+
+            THEN("Ending the detached context elsewhere leaves the thread alone") {
+                std::thread([&] { inner.reset(); }).join();
+                REQUIRE(QueryContext::current() == &outer);
+            }
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/tiering.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Fresh directory that is removed again at the end of the test
+class TemporaryDirectory {
+public:
+    explicit TemporaryDirectory(const std::string& name)
+        : path_((std::filesystem::temp_directory_path() / ("telemetry-" + name)).string()) {
+        std::filesystem::remove_all(path_);
+        std::filesystem::create_directories(path_);
+    }
+    ~TemporaryDirectory() { std::filesystem::remove_all(path_); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+std::vector<double> valuesAt(uint64_t i) {
+    return std::vector<double>(10, 0.001 * static_cast<double>(i % 1000));
+}
+
+} // namespace
+
+SCENARIO("Compressed blocks decode the same after relocation", "[tiering]") {
+    GIVEN("A compressed block") {
+        std::vector<EventData> events;
+        for (uint64_t i = 0; i < 300; ++i) {
+            events.push_back(EventData{valuesAt(i), 1617235200 + i * 7});
+        }
+        auto block = CompressedBlock::encode(events);
+
+        WHEN("Its stream is relocated to a copy owned elsewhere") {
+            auto copy = std::make_shared<std::vector<uint64_t>>(block.words().begin(), block.words().end());
+            block.relocate(copy->data(), copy);
+
+            THEN("It decodes from the copy") {
+                REQUIRE(block.isRelocated());
+                REQUIRE(block.words().data() == copy->data());
+                std::vector<EventData> decoded;
+                block.forEach([&](const EventData& event) { decoded.push_back(event); });
+                REQUIRE(decoded.size() == events.size());
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(decoded[i].timestamp == events[i].timestamp);
+                    REQUIRE(decoded[i].values == events[i].values);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Tiered storage moves cold blocks to mapped segment files", "[tiering][storage]") {
+    const uint64_t base = 1617235200;
+
+    GIVEN("A tiered storage keeping the last hour hot, and an untiered reference") {
+        TemporaryDirectory directory("tiering");
+        TieringPolicy tiering;
+        tiering.directory = directory.path();
+        tiering.hotSeconds = 3600;
+        tiering.segmentBlocks = 2;
+        TelemetryStorage storage({}, tiering);
+        TelemetryStorage reference;
+
+        WHEN("Three hours of events are saved") {
+            for (uint64_t i = 0; i < 10800; ++i) {
+                storage.saveEvent("trip", valuesAt(i), base + i);
+                reference.saveEvent("trip", valuesAt(i), base + i);
+            }
+            storage.waitForCompactions();
+            auto stats = storage.tierStats();
+
+            THEN("Blocks older than an hour are cold, in whole segments") {
+                // 21 sealed blocks; those ending before the last hour are cold
+                REQUIRE(stats.coldBlocks + stats.hotBlocks == 21);
+                REQUIRE(stats.coldBlocks >= 12);
+                REQUIRE(stats.coldBlocks % 2 == 0);
+                REQUIRE(stats.coldBytes > 0);
+                REQUIRE(stats.spillFailures == 0);
+            }
+
+            THEN("Segment files are unlinked once mapped") {
+                REQUIRE(std::filesystem::is_empty(directory.path()));
+            }
+
+            THEN("Queries over both tiers match the untiered storage") {
+                auto events = storage.getFilteredEvents("trip", base + 1000, base + 9000);
+                auto expected = reference.getFilteredEvents("trip", base + 1000, base + 9000);
+                REQUIRE(events.size() == expected.size());
+                for (std::size_t i = 0; i < events.size(); ++i) {
+                    REQUIRE(events[i].timestamp == expected[i].timestamp);
+                    REQUIRE(events[i].values == expected[i].values);
+                }
+
+                auto aggregate = storage.aggregateEvents("trip", base + 100, base + 10000);
+                auto exact = reference.aggregateEvents("trip", base + 100, base + 10000);
+                REQUIRE(aggregate.count == exact.count);
+                REQUIRE_THAT(aggregate.sum, Catch::Matchers::WithinRel(exact.sum, 1e-12));
+
+                auto buckets = storage.aggregateSeries("trip", 3600, base);
+                REQUIRE(buckets.size() == 3);
+                REQUIRE(buckets[0].aggregate.count == 3600);
+            }
+
+            THEN("Clearing the storage releases the cold tier") {
+                storage.clear();
+                REQUIRE(storage.tierStats().coldBlocks == 0);
+                REQUIRE(storage.getFilteredEvents("trip").empty());
+            }
+        }
+
+        WHEN("The storage is cleared while spills may still be pending") {
+            for (uint64_t i = 0; i < 10800; ++i) {
+                storage.saveEvent("trip", valuesAt(i), base + i);
+            }
+            storage.clear();
+            storage.saveEvent("trip", valuesAt(0), base);
+            storage.waitForCompactions();
+
+            THEN("No cleared blocks come back from the cold tier") {
+                REQUIRE(storage.tierStats().coldBlocks == 0);
+                REQUIRE(storage.aggregateEvents("trip").count == 1);
+            }
+        }
+    }
+
+    GIVEN("A tiered storage whose directory does not exist") {
+        TieringPolicy tiering;
+        tiering.directory = (std::filesystem::temp_directory_path() / "telemetry-missing-tier").string();
+        tiering.hotSeconds = 60;
+        tiering.segmentBlocks = 1;
+        std::filesystem::remove_all(tiering.directory);
+        TelemetryStorage storage({}, tiering);
+
+        WHEN("Cold blocks cannot be spilled") {
+            for (uint64_t i = 0; i < 2048; ++i) {
+                storage.saveEvent("trip", valuesAt(i), base + i);
+            }
+            storage.waitForCompactions();
+
+            THEN("They stay in memory and the failures are counted") {
+                auto stats = storage.tierStats();
+                REQUIRE(stats.coldBlocks == 0);
+                REQUIRE(stats.spillFailures > 0);
+                REQUIRE(storage.aggregateEvents("trip").count == 2048);
+            }
+        }
+    }
+
+    GIVEN("A sharded storage with tiering") {
+        TemporaryDirectory directory("tiering-sharded");
+        TieringPolicy tiering;
+        tiering.directory = directory.path();
+        tiering.hotSeconds = 600;
+        tiering.segmentBlocks = 1;
+        ShardedStorage storage(2, false, {}, tiering);
+
+        WHEN("Events are saved") {
+            for (uint64_t i = 0; i < 4096; ++i) {
+                storage.saveEvent("trip", valuesAt(i), base + i);
+            }
+            storage.waitForCompactions();
+
+            THEN("The shards' tiers are summed") {
+                auto stats = storage.tierStats();
+                REQUIRE(stats.coldBlocks + stats.hotBlocks == 8);
+                REQUIRE(stats.coldBlocks > 0);
+                REQUIRE(storage.aggregateEvents("trip").count == 4096);
+            }
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include <catch2/catch_test_macros.hpp>
+#include "telemetry/tracing.h"
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/telemetry_processor.h"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Writes the current trace and returns its events
+json dumpTrace(std::size_t& spans) {
+    const std::string path = "tracing_tests_trace.json";
+    spans = tracing::writeChromeTrace(path);
+    std::ifstream file(path);
+    auto trace = json::parse(file);
+    std::remove(path.c_str());
+    return trace["traceEvents"];
+}
+
+} // namespace
+
+SCENARIO("Sampled requests record their phases as Chrome trace events", "[tracing]") {
+    GIVEN("A processor over storage with every request traced") {
+        tracing::configure(1);
+        TelemetryStorage storage;
+        TelemetryProcessor processor(storage);
+
+        WHEN("A save and a query run inside request scopes") {
+            {
+                tracing::RequestScope request("POST /paths/:event");
+                REQUIRE(processor.saveEvent("trip", std::vector<double>(10, 1.0), 1617235200));
+            }
+            {
+                tracing::RequestScope request("GET /paths/:event/meanLength");
+                processor.calculateMeanLength("trip");
+            }
+
+            std::size_t spans = 0;
+            auto events = dumpTrace(spans);
+
+            THEN("Every phase is written as a complete event nested in its request") {
+                REQUIRE(spans == events.size());
+                std::map<std::string, json> byName;
+                for (const auto& event : events) {
+                    REQUIRE(event["ph"] == "X");
+                    REQUIRE(event["dur"].get<double>() >= 0.0);
+                    byName[event["name"].get<std::string>()] = event;
+                }
+                REQUIRE(byName.count("POST /paths/:event") == 1);
+                REQUIRE(byName.count("processor.saveEvent") == 1);
+                REQUIRE(byName.count("storage.saveEvent") == 1);
+                REQUIRE(byName.count("storage.lockWait") == 1);
+                REQUIRE(byName.count("processor.calculateMeanLength") == 1);
+
+                const auto& root = byName["POST /paths/:event"];
+                const auto& inner = byName["storage.saveEvent"];
+                REQUIRE(inner["ts"].get<double>() >= root["ts"].get<double>());
+                REQUIRE(inner["ts"].get<double>() + inner["dur"].get<double>() <=
+                        root["ts"].get<double>() + root["dur"].get<double>() + 0.001);
+                REQUIRE(inner["tid"] == root["tid"]);
+            }
+        }
+
+        WHEN("Work runs outside any request scope") {
+            processor.saveEvent("trip", std::vector<double>(10, 1.0), 1617235200);
+
+            std::size_t spans = 0;
+            dumpTrace(spans);
+
+            THEN("Nothing is recorded") {
+                REQUIRE(spans == 0);
+            }
+        }
+
+        tracing::configure(0);
+    }
+
+    GIVEN("Tracing of one request in four") {
+        tracing::configure(4);
+
+        WHEN("Eight requests run") {
+            for (int i = 0; i < 8; ++i) {
+                tracing::RequestScope request("GET /aggregates");
+                tracing::Span span("phase");
+            }
+
+            std::size_t spans = 0;
+            dumpTrace(spans);
+
+            THEN("Two of them are traced") {
+                REQUIRE(spans == 4);
+            }
+        }
+
+        tracing::configure(0);
+    }
+
+    GIVEN("Per-thread buffers of eight spans") {
+        tracing::configure(1, 8);
+
+        WHEN("More spans than fit are recorded") {
+            for (int i = 0; i < 20; ++i) {
+                tracing::RequestScope request("GET /aggregates");
+            }
+
+            std::size_t spans = 0;
+            dumpTrace(spans);
+
+            THEN("Only the newest spans are kept") {
+                REQUIRE(spans == 8);
+            }
+        }
+
+        tracing::configure(0);
+    }
+
+    GIVEN("Tracing disabled") {
+        tracing::configure(0);
+
+        WHEN("A request runs") {
+            {
+                tracing::RequestScope request("GET /aggregates");
+                tracing::Span span("phase");
+            }
+
+            std::size_t spans = 0;
+            dumpTrace(spans);
+
+            THEN("Nothing is recorded") {
+                REQUIRE_FALSE(tracing::enabled());
+                REQUIRE(spans == 0);
+            }
+        }
+    }
+}
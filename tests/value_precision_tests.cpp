@@ -0,0 +1,133 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/value_precision.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Whole-millisecond durations that vary per event and per value
+std::vector<double> millisecondValues(std::size_t event) {
+    std::vector<double> values;
+    for (std::size_t v = 0; v < 10; ++v) {
+        values.push_back(static_cast<double>((event * 37 + v * 11) % 5000) / 1000.0);
+    }
+    return values;
+}
+
+} // namespace
+
+SCENARIO("Value precision names and representable ranges", "[precision]") {
+    GIVEN("The supported precision names") {
+        THEN("They parse to their modes") {
+            REQUIRE(parseValuePrecision("double") == ValuePrecision::Double);
+            REQUIRE(parseValuePrecision("float32") == ValuePrecision::Float32);
+            REQUIRE(parseValuePrecision("ms") == ValuePrecision::Milliseconds);
+            REQUIRE_THROWS_AS(parseValuePrecision("half"), std::invalid_argument);
+        }
+
+        THEN("Each mode accepts only values it can hold") {
+            REQUIRE(isRepresentable(1e300, ValuePrecision::Double));
+            REQUIRE(isRepresentable(1.234567, ValuePrecision::Float32));
+            REQUIRE_FALSE(isRepresentable(1e300, ValuePrecision::Float32));
+            REQUIRE_FALSE(isRepresentable(std::numeric_limits<double>::infinity(), ValuePrecision::Float32));
+            REQUIRE(isRepresentable(1.234, ValuePrecision::Milliseconds));
+            REQUIRE(isRepresentable(0.0, ValuePrecision::Milliseconds));
+            REQUIRE_FALSE(isRepresentable(1.2345, ValuePrecision::Milliseconds));
+            REQUIRE_FALSE(isRepresentable(-0.001, ValuePrecision::Milliseconds));
+            REQUIRE_FALSE(isRepresentable(5e6, ValuePrecision::Milliseconds));
+        }
+    }
+}
+
+SCENARIO("Storage keeps values at the configured precision", "[precision][storage]") {
+    GIVEN("A storage in millisecond mode with a double override for one event") {
+        PrecisionPolicy policy;
+        policy.defaultPrecision = ValuePrecision::Milliseconds;
+        policy.perEvent["exact"] = ValuePrecision::Double;
+        TelemetryStorage storage(policy);
+
+        WHEN("Values finer than a millisecond are saved") {
+            THEN("The millisecond event rejects them and the override accepts them") {
+                std::vector<double> fine(10, 0.0001);
+                REQUIRE_FALSE(storage.saveEvent("compact", fine, 1617235200));
+                REQUIRE(storage.getFilteredEvents("compact").empty());
+                REQUIRE(storage.saveEvent("exact", fine, 1617235200));
+                REQUIRE(storage.getFilteredEvents("exact")[0].values == fine);
+            }
+        }
+
+        WHEN("More events are saved than fit in the uncompressed head") {
+            const std::size_t count = 1300;
+            double sum = 0.0;
+            for (std::size_t i = 0; i < count; ++i) {
+                auto values = millisecondValues(i);
+                for (double value : values) {
+                    sum += value;
+                }
+                REQUIRE(storage.saveEvent("compact", values, 1617235200 + i));
+            }
+
+            THEN("Every value reads back as the same whole number of milliseconds") {
+                auto events = storage.getFilteredEvents("compact");
+                REQUIRE(events.size() == count);
+                for (std::size_t i = 0; i < count; ++i) {
+                    REQUIRE(events[i].timestamp == 1617235200 + i);
+                    auto expected = millisecondValues(i);
+                    for (std::size_t v = 0; v < 10; ++v) {
+                        REQUIRE(std::round(events[i].values[v] * 1000.0) == std::round(expected[v] * 1000.0));
+                    }
+                }
+            }
+
+            THEN("Aggregates over sealed blocks and the head match the saved values") {
+                auto all = storage.aggregateEvents("compact");
+                REQUIRE(all.count == count);
+                REQUIRE_THAT(all.sum, Catch::Matchers::WithinRel(sum, 1e-9));
+
+                // A range that cuts through a sealed block and into the head
+                double partial = 0.0;
+                for (std::size_t i = 500; i <= 1200; ++i) {
+                    for (double value : millisecondValues(i)) {
+                        partial += value;
+                    }
+                }
+                auto range = storage.aggregateEvents("compact", 1617235200 + 500, 1617235200 + 1200);
+                REQUIRE(range.count == 701);
+                REQUIRE_THAT(range.sum, Catch::Matchers::WithinRel(partial, 1e-9));
+            }
+        }
+    }
+
+    GIVEN("A storage in float32 mode") {
+        PrecisionPolicy policy;
+        policy.defaultPrecision = ValuePrecision::Float32;
+        TelemetryStorage storage(policy);
+
+        WHEN("Arbitrary durations are saved") {
+            double sum = 0.0;
+            for (std::size_t i = 0; i < 700; ++i) {
+                std::vector<double> values(10, 0.1 + 0.0001 * static_cast<double>(i));
+                sum += 10 * values[0];
+                REQUIRE(storage.saveEvent("trip", values, 1617235200 + i));
+            }
+
+            THEN("Values and means stay within float precision") {
+                auto events = storage.getFilteredEvents("trip");
+                REQUIRE(events.size() == 700);
+                REQUIRE_THAT(events[123].values[0], Catch::Matchers::WithinRel(0.1123, 1e-6));
+                auto aggregate = storage.aggregateEvents("trip");
+                REQUIRE_THAT(aggregate.sum, Catch::Matchers::WithinRel(sum, 1e-6));
+            }
+        }
+
+        WHEN("A value outside float range is saved") {
+            THEN("The event is rejected") {
+                REQUIRE_FALSE(storage.saveEvent("trip", std::vector<double>(10, 1e40), 1617235200));
+            }
+        }
+    }
+}
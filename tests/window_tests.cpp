@@ -0,0 +1,139 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "telemetry/telemetry_storage.h"
+#include "telemetry/sharded_storage.h"
+#include "telemetry/forwarding_storage.h"
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kBase = 1617235200;
+
+// Expected results computed the slow way, one range query per window
+void requireSameAsRangeQueries(ITelemetryStorage& storage, const std::string& eventName,
+                               const std::vector<TimeWindow>& windows) {
+    auto aggregates = storage.aggregateWindows(eventName, windows);
+    REQUIRE(aggregates.size() == windows.size());
+    for (std::size_t i = 0; i < windows.size(); ++i) {
+        auto expected = storage.aggregateEvents(eventName, windows[i].start, windows[i].end);
+        REQUIRE(aggregates[i].count == expected.count);
+        REQUIRE_THAT(aggregates[i].sum, Catch::Matchers::WithinRel(expected.sum, 1e-9));
+    }
+}
+
+// Sealed blocks, a partial head and late events that land out of order
+void fill(ITelemetryStorage& storage, const std::string& eventName) {
+    for (uint64_t i = 0; i < 1500; ++i) {
+        REQUIRE(storage.saveEvent(eventName, std::vector<double>(10, 0.5 + static_cast<double>(i % 7)), kBase + i * 10));
+    }
+    REQUIRE(storage.saveEvent(eventName, std::vector<double>(10, 9.0), kBase + 35));
+    REQUIRE(storage.saveEvent(eventName, std::vector<double>(10, 9.0), kBase + 12000));
+}
+
+} // namespace
+
+SCENARIO("Storage answers many time windows in one sweep", "[windows][storage]") {
+    GIVEN("A storage with sealed blocks, a partial head and some late events") {
+        TelemetryStorage storage;
+        fill(storage, "trip");
+
+        WHEN("Disjoint, overlapping, nested and repeated windows are requested") {
+            std::vector<TimeWindow> windows{
+                {kBase, kBase + 3599},
+                {kBase + 1800, kBase + 5399},
+                {kBase + 2000, kBase + 2100},
+                {kBase, kBase + 3599},
+                {kBase + 9000, kBase + 9000},
+                {kBase + 14000, kBase + 20000},
+            };
+
+            THEN("Every window matches a separate range query, in request order") {
+                requireSameAsRangeQueries(storage, "trip", windows);
+            }
+        }
+
+        WHEN("Windows cover whole blocks, gaps and time before and after the data") {
+            std::vector<TimeWindow> windows{
+                {0, kBase - 1},
+                {kBase - 100, kBase + 6000},
+                {kBase + 10000, std::numeric_limits<uint64_t>::max()},
+            };
+
+            THEN("Whole blocks are added from their totals and the results still match") {
+                requireSameAsRangeQueries(storage, "trip", windows);
+                auto aggregates = storage.aggregateWindows("trip", windows);
+                REQUIRE(aggregates[0].count == 0);
+                REQUIRE(aggregates[1].count > TelemetryStorage::kBlockSize);
+            }
+        }
+
+        WHEN("Random windows are requested") {
+            std::mt19937_64 generator(11);
+            std::uniform_int_distribution<uint64_t> offset(0, 16000);
+            std::vector<TimeWindow> windows;
+            for (int i = 0; i < 200; ++i) {
+                auto a = kBase + offset(generator);
+                auto b = kBase + offset(generator);
+                windows.push_back({std::min(a, b), std::max(a, b)});
+            }
+
+            THEN("They all match separate range queries") {
+                requireSameAsRangeQueries(storage, "trip", windows);
+            }
+        }
+
+        WHEN("An unknown event or no windows are requested") {
+            THEN("Every window is empty") {
+                auto aggregates = storage.aggregateWindows("unknown", {{kBase, kBase + 10}, {0, 5}});
+                REQUIRE(aggregates.size() == 2);
+                REQUIRE(aggregates[0].count == 0);
+                REQUIRE(aggregates[1].count == 0);
+                REQUIRE(storage.aggregateWindows("trip", {}).empty());
+            }
+        }
+    }
+
+    GIVEN("A sharded storage and a storage that only implements the default") {
+        ShardedStorage sharded(3, false);
+        for (int t = 0; t < 3; ++t) {
+            std::thread([&, t] {
+                for (uint64_t i = 0; i < 200; ++i) {
+                    sharded.saveEvent("trip", std::vector<double>(10, 1.0 + t), kBase + i * 7);
+                }
+            }).join();
+        }
+
+        TelemetryStorage plain;
+        fill(plain, "trip");
+        // Decorator that hides the storage's own override
+        struct DefaultWindows : ForwardingStorage {
+            using ForwardingStorage::ForwardingStorage;
+            std::vector<PathAggregate> aggregateWindows(const std::string& eventName,
+                                                        const std::vector<TimeWindow>& windows) override {
+                return ITelemetryStorage::aggregateWindows(eventName, windows);
+            }
+        } fallback(plain);
+
+        std::vector<TimeWindow> windows{{kBase, kBase + 600}, {kBase + 300, kBase + 1400}, {kBase + 700, kBase + 700}};
+
+        THEN("Shard results are added up per window") {
+            auto aggregates = sharded.aggregateWindows("trip", windows);
+            REQUIRE(aggregates[0].count == 3 * 86);
+            requireSameAsRangeQueries(sharded, "trip", windows);
+        }
+
+        THEN("The default implementation agrees with the storage") {
+            auto expected = plain.aggregateWindows("trip", windows);
+            auto actual = fallback.aggregateWindows("trip", windows);
+            REQUIRE(actual.size() == expected.size());
+            for (std::size_t i = 0; i < windows.size(); ++i) {
+                REQUIRE(actual[i].count == expected[i].count);
+                REQUIRE_THAT(actual[i].sum, Catch::Matchers::WithinRel(expected[i].sum, 1e-9));
+            }
+        }
+    }
+}